@@ -387,6 +387,7 @@ public class Bob {
 
         options.addOption("tp", "texture-profiles", true, "Use texture profiles (deprecated)");
         options.addOption("tc", "texture-compression", true, "Use texture compression as specified in texture profiles");
+        options.addOption(null, "texture-threads", true, "Number of threads used to process and compress each texture. Default is 4");
         options.addOption("k", "keep-unused", false, "Keep unused resources in archived output");
 
         options.addOption("br", "build-report", true, "Filepath where to save a build report as JSON");
@@ -807,6 +807,11 @@ public class Project {
                         fileHTMLWriter = new FileWriter(reportHTMLFile);
                     }
 
+                    // The textures are built one at a time, each of them split over this many threads
+                    if (this.hasOption("texture-threads")) {
+                        TexcLibrary.TEXC_SetMaxThreads(Integer.parseInt(this.option("texture-threads", "4")));
+                    }
+
                     IProgress m = monitor.subProgress(99);
                     BundleHelper.throwIfCanceled(monitor);
                     m.beginTask("Building...", newTasks.size());
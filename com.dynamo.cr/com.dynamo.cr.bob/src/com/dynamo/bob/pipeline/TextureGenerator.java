@@ -74,6 +74,7 @@ public class TextureGenerator {
         pixelFormatLUT.put(TextureFormat.TEXTURE_FORMAT_RGBA_PVRTC_2BPPV1, PixelFormat.RGBA_PVRTC_2BPPV1);
         pixelFormatLUT.put(TextureFormat.TEXTURE_FORMAT_RGBA_PVRTC_4BPPV1, PixelFormat.RGBA_PVRTC_4BPPV1);
         pixelFormatLUT.put(TextureFormat.TEXTURE_FORMAT_RGB_ETC1, PixelFormat.RGB_ETC1);
+        pixelFormatLUT.put(TextureFormat.TEXTURE_FORMAT_RGB_UNIVERSAL, PixelFormat.RGB_ETC1);
         pixelFormatLUT.put(TextureFormat.TEXTURE_FORMAT_RGB_16BPP, PixelFormat.R5G6B5);
         pixelFormatLUT.put(TextureFormat.TEXTURE_FORMAT_RGBA_16BPP, PixelFormat.R4G4B4A4);
         pixelFormatLUT.put(TextureFormat.TEXTURE_FORMAT_LUMINANCE_ALPHA, PixelFormat.L8A8);
@@ -188,9 +189,9 @@ public class TextureGenerator {
             texcCompressionLevel = CompressionLevel.CL_FAST;
             texcCompressionType = CompressionType.CT_DEFAULT;
 
-            // If pvrtc or etc1, set these as rgba instead. Since these formats will take some time to compress even
+            // If pvrtc, etc1 or universal, set these as rgba instead. Since these formats will take some time to compress even
             // with "fast" setting and we don't want to increase the build time more than we have to.
-            if (textureFormat == TextureFormat.TEXTURE_FORMAT_RGB_PVRTC_2BPPV1 || textureFormat == TextureFormat.TEXTURE_FORMAT_RGB_PVRTC_4BPPV1 || textureFormat == TextureFormat.TEXTURE_FORMAT_RGB_ETC1) {
+            if (textureFormat == TextureFormat.TEXTURE_FORMAT_RGB_PVRTC_2BPPV1 || textureFormat == TextureFormat.TEXTURE_FORMAT_RGB_PVRTC_4BPPV1 || textureFormat == TextureFormat.TEXTURE_FORMAT_RGB_ETC1 || textureFormat == TextureFormat.TEXTURE_FORMAT_RGB_UNIVERSAL) {
                 textureFormat = TextureFormat.TEXTURE_FORMAT_RGB;
             } else if (textureFormat == TextureFormat.TEXTURE_FORMAT_RGBA_PVRTC_2BPPV1 || textureFormat == TextureFormat.TEXTURE_FORMAT_RGBA_PVRTC_4BPPV1) {
                 textureFormat = TextureFormat.TEXTURE_FORMAT_RGBA;
@@ -193,6 +193,95 @@ namespace dmCrypt
         }
     }
 
+    struct HashState
+    {
+        HashAlgorithm m_Algorithm;
+        union
+        {
+            mbedtls_md5_context    m_Md5;
+            mbedtls_sha1_context   m_Sha1;
+            mbedtls_sha256_context m_Sha256;
+            mbedtls_sha512_context m_Sha512;
+        };
+    };
+
+    HHashState NewHash(HashAlgorithm algorithm)
+    {
+        HashState* state = new HashState;
+        state->m_Algorithm = algorithm;
+        switch (algorithm)
+        {
+        case HASH_ALGORITHM_MD5:
+            mbedtls_md5_init(&state->m_Md5);
+            mbedtls_md5_starts_ret(&state->m_Md5);
+            break;
+        case HASH_ALGORITHM_SHA1:
+            mbedtls_sha1_init(&state->m_Sha1);
+            mbedtls_sha1_starts_ret(&state->m_Sha1);
+            break;
+        case HASH_ALGORITHM_SHA256:
+            mbedtls_sha256_init(&state->m_Sha256);
+            mbedtls_sha256_starts_ret(&state->m_Sha256, 0);
+            break;
+        case HASH_ALGORITHM_SHA512:
+            mbedtls_sha512_init(&state->m_Sha512);
+            mbedtls_sha512_starts_ret(&state->m_Sha512, 0);
+            break;
+        }
+        return state;
+    }
+
+    void UpdateHash(HHashState state, const uint8_t* buf, uint32_t buflen)
+    {
+        switch (state->m_Algorithm)
+        {
+        case HASH_ALGORITHM_MD5:    mbedtls_md5_update_ret(&state->m_Md5, (const unsigned char*)buf, (size_t)buflen); break;
+        case HASH_ALGORITHM_SHA1:   mbedtls_sha1_update_ret(&state->m_Sha1, (const unsigned char*)buf, (size_t)buflen); break;
+        case HASH_ALGORITHM_SHA256: mbedtls_sha256_update_ret(&state->m_Sha256, (const unsigned char*)buf, (size_t)buflen); break;
+        case HASH_ALGORITHM_SHA512: mbedtls_sha512_update_ret(&state->m_Sha512, (const unsigned char*)buf, (size_t)buflen); break;
+        }
+    }
+
+    void FinalizeHash(HHashState state, uint8_t* digest)
+    {
+        int ret = 0;
+        switch (state->m_Algorithm)
+        {
+        case HASH_ALGORITHM_MD5:
+            ret = mbedtls_md5_finish_ret(&state->m_Md5, (unsigned char*)digest);
+            mbedtls_md5_free(&state->m_Md5);
+            break;
+        case HASH_ALGORITHM_SHA1:
+            ret = mbedtls_sha1_finish_ret(&state->m_Sha1, (unsigned char*)digest);
+            mbedtls_sha1_free(&state->m_Sha1);
+            break;
+        case HASH_ALGORITHM_SHA256:
+            ret = mbedtls_sha256_finish_ret(&state->m_Sha256, (unsigned char*)digest);
+            mbedtls_sha256_free(&state->m_Sha256);
+            break;
+        case HASH_ALGORITHM_SHA512:
+            ret = mbedtls_sha512_finish_ret(&state->m_Sha512, (unsigned char*)digest);
+            mbedtls_sha512_free(&state->m_Sha512);
+            break;
+        }
+        if (ret != 0) {
+            memset(digest, 0, GetHashLength(state->m_Algorithm));
+        }
+        delete state;
+    }
+
+    uint32_t GetHashLength(HashAlgorithm algorithm)
+    {
+        switch (algorithm)
+        {
+        case HASH_ALGORITHM_MD5:    return 16;
+        case HASH_ALGORITHM_SHA1:   return 20;
+        case HASH_ALGORITHM_SHA256: return 32;
+        case HASH_ALGORITHM_SHA512: return 64;
+        }
+        return 0;
+    }
+
     bool Base64Encode(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t* dst_len)
     {
         size_t out_len = 0;
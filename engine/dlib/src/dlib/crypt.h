@@ -29,6 +29,19 @@ namespace dmCrypt
         RESULT_ERROR = 1,
     };
 
+    enum HashAlgorithm
+    {
+        HASH_ALGORITHM_MD5,     // 16 bytes
+        HASH_ALGORITHM_SHA1,    // 20 bytes
+        HASH_ALGORITHM_SHA256,  // 32 bytes
+        HASH_ALGORITHM_SHA512,  // 64 bytes
+    };
+
+    /**
+     * Incremental hash state
+     */
+    typedef struct HashState* HHashState;
+
     /**
      *  Encrypt data in place
      *  @param algo algorithm
@@ -60,6 +73,36 @@ namespace dmCrypt
      * @return RESULT_OK if decrypting went ok.
      */
     Result Decrypt(const uint8_t* key, uint32_t keylen, const uint8_t* data, uint32_t datalen, uint8_t** output, uint32_t* outputlen);
+
+    /**
+     * Start an incremental hash. Gives the same digest as hashing all data at once,
+     * without requiring the data to be in a single buffer
+     * @param algorithm hash algorithm
+     * @return hash state. Freed by FinalizeHash
+     */
+    HHashState NewHash(HashAlgorithm algorithm);
+
+    /**
+     * Add data to the hash
+     * @param state hash state
+     * @param buf data
+     * @param buflen data length in bytes
+     */
+    void UpdateHash(HHashState state, const uint8_t* buf, uint32_t buflen);
+
+    /**
+     * Write the digest and free the hash state
+     * @param state hash state
+     * @param digest [out] The digest, GetHashLength() bytes
+     */
+    void FinalizeHash(HHashState state, uint8_t* digest);
+
+    /**
+     * Get the digest length of a hash algorithm
+     * @param algorithm hash algorithm
+     * @return digest length in bytes
+     */
+    uint32_t GetHashLength(HashAlgorithm algorithm);
 }
 
 #endif /* DM_CRYPT_H */
@@ -15,6 +15,10 @@
 #include <dlib/math.h>
 #include "easing.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace dmEasing
 {
     #include "easing_lookup.h"
@@ -59,5 +63,49 @@ namespace dmEasing
         float diff = (t - index1 * (1.0f / (sample_count-1))) * (sample_count-1);
         return val1 * (1.0f - diff) + val2 * diff;
     }
-}
 
+    void GetValues(const Curve* curves, const float* t, float* out, uint32_t count)
+    {
+        uint32_t i = 0;
+#if defined(__SSE2__)
+        // Same arithmetic as GetValue() so that the results are identical, only the lookups are scalar
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 scale = _mm_set1_ps((float)(EASING_SAMPLES-1));
+        const __m128 inv_scale = _mm_set1_ps(1.0f / (EASING_SAMPLES-1));
+        for (; i + 4 <= count; i += 4)
+        {
+            const Curve* c = curves + i;
+            if (c[0].type == TYPE_FLOAT_VECTOR || c[1].type == TYPE_FLOAT_VECTOR || c[2].type == TYPE_FLOAT_VECTOR || c[3].type == TYPE_FLOAT_VECTOR)
+            {
+                for (uint32_t j = 0; j < 4; ++j)
+                {
+                    out[i + j] = GetValue(c[j], t[i + j]);
+                }
+                continue;
+            }
+
+            __m128 tv = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(t + i), zero), one);
+            __m128i index1 = _mm_cvttps_epi32(_mm_mul_ps(tv, scale));
+            __m128 diff = _mm_mul_ps(_mm_sub_ps(tv, _mm_mul_ps(_mm_cvtepi32_ps(index1), inv_scale)), scale);
+
+            int32_t index[4];
+            _mm_storeu_si128((__m128i*)index, index1);
+            float v1[4], v2[4];
+            for (uint32_t j = 0; j < 4; ++j)
+            {
+                // NOTE: The last sample is duplicated, so index + 1 is always valid
+                const float* lookup = EASING_LOOKUP + c[j].type * (EASING_SAMPLES + 1) + index[j];
+                v1[j] = lookup[0];
+                v2[j] = lookup[1];
+            }
+            __m128 val = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(v1), _mm_sub_ps(one, diff)), _mm_mul_ps(_mm_loadu_ps(v2), diff));
+            _mm_storeu_ps(out + i, val);
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            out[i] = GetValue(curves[i], t[i]);
+        }
+    }
+}
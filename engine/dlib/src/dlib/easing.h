@@ -103,6 +103,16 @@ namespace dmEasing
      */
     float GetValue(Type type, float t);
     float GetValue(Curve curve, float t);
+
+    /**
+     * Batch easing-curve evaluation. Built-in curves are evaluated four at a time
+     * using SIMD where available, custom curves fall back to GetValue().
+     * @param curves curve per value
+     * @param t time values in the range [0,1]
+     * @param out curve values, may alias t
+     * @param count number of values
+     */
+    void GetValues(const Curve* curves, const float* t, float* out, uint32_t count);
 }
 
 #endif // DM_EASING
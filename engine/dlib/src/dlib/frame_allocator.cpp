@@ -0,0 +1,166 @@
+// Copyright 2020 The Defold Foundation
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include <stdint.h>
+#include <assert.h>
+#include "frame_allocator.h"
+#include "align.h"
+#include "array.h"
+#include "atomic.h"
+#include "math.h"
+#include "memory.h"
+#include "mutex.h"
+
+namespace dmFrameAllocator
+{
+    static const uint32_t ALIGNMENT = 16;
+    /// Sub allocators take at least this much memory at a time from the frame allocator
+    static const uint32_t SUB_ALLOCATOR_BLOCK_SIZE = 16 * 1024;
+
+    struct FrameAllocator
+    {
+        uint8_t*        m_Memory;
+        uint32_t        m_FrameSize;
+        // Frame buffer currently allocated from, 0 or 1
+        uint32_t        m_Frame;
+        // Bytes allocated in the current frame. Keeps counting past the frame size, which makes it the memory the frame needed
+        int32_atomic_t  m_Offset;
+        int32_atomic_t  m_Overflow;
+        uint32_t        m_HighWaterMark;
+        dmMutex::HMutex m_Mutex;
+        // Heap allocations of each frame buffer
+        dmArray<void*>  m_HeapAllocations[2];
+    };
+
+    static inline uint8_t* GetFrameBuffer(HAllocator allocator)
+    {
+        return allocator->m_Memory + allocator->m_Frame * allocator->m_FrameSize;
+    }
+
+    static void FreeHeapAllocations(dmArray<void*>& allocations)
+    {
+        for (uint32_t i = 0; i < allocations.Size(); ++i)
+        {
+            dmMemory::AlignedFree(allocations[i]);
+        }
+        allocations.SetSize(0);
+    }
+
+    HAllocator New(uint32_t frame_size)
+    {
+        FrameAllocator* allocator = new FrameAllocator;
+        allocator->m_FrameSize = DM_ALIGN(frame_size, ALIGNMENT);
+        allocator->m_Memory = 0;
+        if (allocator->m_FrameSize > 0)
+        {
+            dmMemory::Result r = dmMemory::AlignedMalloc((void**) &allocator->m_Memory, ALIGNMENT, allocator->m_FrameSize * 2);
+            assert(r == dmMemory::RESULT_OK);
+            (void) r;
+        }
+        allocator->m_Frame = 0;
+        allocator->m_Offset = 0;
+        allocator->m_Overflow = 0;
+        allocator->m_HighWaterMark = 0;
+        allocator->m_Mutex = dmMutex::New();
+        return allocator;
+    }
+
+    void Delete(HAllocator allocator)
+    {
+        FreeHeapAllocations(allocator->m_HeapAllocations[0]);
+        FreeHeapAllocations(allocator->m_HeapAllocations[1]);
+        if (allocator->m_Memory)
+            dmMemory::AlignedFree(allocator->m_Memory);
+        dmMutex::Delete(allocator->m_Mutex);
+        delete allocator;
+    }
+
+    void NewFrame(HAllocator allocator)
+    {
+        allocator->m_HighWaterMark = dmMath::Max(allocator->m_HighWaterMark, (uint32_t) allocator->m_Offset);
+        allocator->m_Frame ^= 1;
+        FreeHeapAllocations(allocator->m_HeapAllocations[allocator->m_Frame]);
+        allocator->m_Offset = 0;
+        allocator->m_Overflow = 0;
+    }
+
+    void* Alloc(HAllocator allocator, uint32_t size)
+    {
+        size = DM_ALIGN(dmMath::Max(size, 1U), ALIGNMENT);
+        uint32_t offset = (uint32_t) dmAtomicAdd32(&allocator->m_Offset, (int32_t) size);
+        if (offset + size <= allocator->m_FrameSize)
+        {
+            return GetFrameBuffer(allocator) + offset;
+        }
+
+        void* memory = 0;
+        dmMemory::Result r = dmMemory::AlignedMalloc(&memory, ALIGNMENT, size);
+        assert(r == dmMemory::RESULT_OK);
+        (void) r;
+        dmAtomicAdd32(&allocator->m_Overflow, (int32_t) size);
+
+        dmMutex::ScopedLock lk(allocator->m_Mutex);
+        dmArray<void*>& allocations = allocator->m_HeapAllocations[allocator->m_Frame];
+        if (allocations.Full())
+        {
+            allocations.OffsetCapacity(dmMath::Max(16U, allocations.Capacity()));
+        }
+        allocations.Push(memory);
+        return memory;
+    }
+
+    bool Extend(HAllocator allocator, void* memory, uint32_t size, uint32_t new_size)
+    {
+        uint8_t* buffer = GetFrameBuffer(allocator);
+        if ((uint8_t*) memory < buffer || (uint8_t*) memory >= buffer + allocator->m_FrameSize)
+            return false;
+
+        uint32_t start = (uint32_t) ((uint8_t*) memory - buffer);
+        uint32_t end = start + DM_ALIGN(size, ALIGNMENT);
+        uint32_t new_end = start + DM_ALIGN(new_size, ALIGNMENT);
+        if (new_end <= end)
+            return true;
+        if (new_end > allocator->m_FrameSize)
+            return false;
+        // Only the latest allocation can grow, which is when nothing has been allocated after it
+        return (uint32_t) dmAtomicCompareStore32(&allocator->m_Offset, (int32_t) new_end, (int32_t) end) == end;
+    }
+
+    void InitSubAllocator(HAllocator allocator, SubAllocator* sub_allocator)
+    {
+        sub_allocator->m_Allocator = allocator;
+        sub_allocator->m_Current = 0;
+        sub_allocator->m_End = 0;
+    }
+
+    void* Alloc(SubAllocator* sub_allocator, uint32_t size)
+    {
+        size = DM_ALIGN(dmMath::Max(size, 1U), ALIGNMENT);
+        if ((uint32_t) (sub_allocator->m_End - sub_allocator->m_Current) < size)
+        {
+            uint32_t block_size = dmMath::Max(size, SUB_ALLOCATOR_BLOCK_SIZE);
+            sub_allocator->m_Current = (uint8_t*) Alloc(sub_allocator->m_Allocator, block_size);
+            sub_allocator->m_End = sub_allocator->m_Current + block_size;
+        }
+        void* memory = sub_allocator->m_Current;
+        sub_allocator->m_Current += size;
+        return memory;
+    }
+
+    void GetStats(HAllocator allocator, Stats* stats)
+    {
+        stats->m_FrameSize = allocator->m_FrameSize;
+        stats->m_Used = (uint32_t) allocator->m_Offset;
+        stats->m_Overflow = (uint32_t) allocator->m_Overflow;
+        stats->m_HighWaterMark = dmMath::Max(allocator->m_HighWaterMark, stats->m_Used);
+    }
+}
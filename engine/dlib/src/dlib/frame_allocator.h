@@ -0,0 +1,154 @@
+// Copyright 2020 The Defold Foundation
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef DM_FRAME_ALLOCATOR_H
+#define DM_FRAME_ALLOCATOR_H
+
+#include <stdint.h>
+#include <string.h>
+#include <dlib/array.h>
+
+namespace dmFrameAllocator
+{
+    /**
+     * Frame allocator handle. Linear allocator over two fixed size frame buffers that are
+     * used every other frame. Individual allocations are not freeable, all memory of a frame
+     * is released when the allocator gets back to its buffer, i.e. memory allocated one frame
+     * stays valid during the next frame. Allocations that don't fit in the frame buffer are
+     * made on the heap and are released the same way.
+     */
+    typedef struct FrameAllocator* HAllocator;
+
+    /**
+     * Per thread allocator that takes blocks of memory from the frame allocator,
+     * so that threads allocating many small blocks don't contend on the frame allocator.
+     * Only valid until the next call to NewFrame.
+     */
+    struct SubAllocator
+    {
+        HAllocator  m_Allocator;
+        uint8_t*    m_Current;
+        uint8_t*    m_End;
+    };
+
+    struct Stats
+    {
+        /// Size of each of the two frame buffers
+        uint32_t m_FrameSize;
+        /// Bytes allocated in the current frame, including the ones allocated on the heap
+        uint32_t m_Used;
+        /// Bytes allocated on the heap in the current frame since the frame buffer was full
+        uint32_t m_Overflow;
+        /// Most bytes allocated in any frame. A frame size of at least this much avoids heap allocations
+        uint32_t m_HighWaterMark;
+    };
+
+    /**
+     * Create a new frame allocator
+     * @param frame_size size of each of the two frame buffers
+     * @return frame allocator handle
+     */
+    HAllocator New(uint32_t frame_size);
+
+    /**
+     * Delete frame allocator and free all allocated memory.
+     * @param allocator frame allocator handle
+     */
+    void Delete(HAllocator allocator);
+
+    /**
+     * Start a new frame. Releases the memory allocated the frame before the current one.
+     * @note Must not be called while other threads allocate
+     * @param allocator frame allocator handle
+     */
+    void NewFrame(HAllocator allocator);
+
+    /**
+     * Allocate memory for the current frame. Thread safe.
+     * @param allocator frame allocator handle
+     * @param size size
+     * @return pointer to memory, 16 byte aligned
+     */
+    void* Alloc(HAllocator allocator, uint32_t size);
+
+    /**
+     * Grow the latest allocation of the current frame in place. Thread safe.
+     * @param allocator frame allocator handle
+     * @param memory memory returned by Alloc
+     * @param size size the memory was allocated with
+     * @param new_size new size
+     * @return true if the memory now holds new_size bytes, false if it must be reallocated
+     */
+    bool Extend(HAllocator allocator, void* memory, uint32_t size, uint32_t new_size);
+
+    /**
+     * Initialize a sub allocator for the calling thread
+     * @param allocator frame allocator handle
+     * @param sub_allocator sub allocator
+     */
+    void InitSubAllocator(HAllocator allocator, SubAllocator* sub_allocator);
+
+    /**
+     * Allocate memory for the current frame from a sub allocator. Not thread safe.
+     * @param sub_allocator sub allocator
+     * @param size size
+     * @return pointer to memory, 16 byte aligned
+     */
+    void* Alloc(SubAllocator* sub_allocator, uint32_t size);
+
+    /**
+     * Get memory usage
+     * @param allocator frame allocator handle
+     * @param stats memory usage
+     */
+    void GetStats(HAllocator allocator, Stats* stats);
+
+    /**
+     * Make room for at least capacity elements in an array with frame memory. The array
+     * is grown in place when it holds the latest allocation and moved otherwise.
+     * @param allocator frame allocator handle
+     * @param array array, either empty or with storage from this frame
+     * @param capacity capacity
+     */
+    template <typename T>
+    void SetCapacity(HAllocator allocator, dmArray<T>& array, uint32_t capacity)
+    {
+        if (capacity <= array.Capacity())
+            return;
+        T* data = array.Begin();
+        if (data == 0 || !Extend(allocator, data, array.Capacity() * sizeof(T), capacity * sizeof(T)))
+        {
+            data = (T*) Alloc(allocator, capacity * sizeof(T));
+            if (!array.Empty())
+                memcpy(data, array.Begin(), array.Size() * sizeof(T));
+        }
+        dmArray<T> tmp(data, array.Size(), capacity);
+        array.Swap(tmp);
+    }
+
+    /**
+     * Detach an array from its storage so that it can be given new frame memory. Returns the
+     * previous capacity, which makes a good initial capacity for the next frame.
+     * @param array array
+     * @return previous capacity
+     */
+    template <typename T>
+    uint32_t ResetArray(dmArray<T>& array)
+    {
+        uint32_t capacity = array.Capacity();
+        dmArray<T> tmp;
+        array.Swap(tmp);
+        return capacity;
+    }
+}
+
+#endif // DM_FRAME_ALLOCATOR_H
@@ -0,0 +1,1222 @@
+// Copyright 2020 The Defold Foundation
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+// 
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+// 
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "array.h"
+#include "condition_variable.h"
+#include "dlib.h"
+#include "dstrings.h"
+#include "log.h"
+#include "math.h"
+#include "mutex.h"
+#include "socket.h"
+#include "thread.h"
+#include "time.h"
+#include "uri.h"
+#include "http_async.h"
+#include "http_client_private.h"
+
+namespace dmHttpAsync
+{
+    const uint32_t RECEIVE_CHUNK_SIZE = 16 * 1024;
+    const uint32_t MAX_HEADER_SIZE = 64 * 1024;
+    // Idempotent requests are resent once if a reused connection was closed by the server
+    const uint32_t MAX_RETRIES = 1;
+    const uint32_t RESOLVER_THREAD_STACK_SIZE = 0x20000;
+
+    enum BodyMode
+    {
+        BODY_NONE,
+        BODY_LENGTH,
+        BODY_CHUNKED,
+        BODY_UNTIL_CLOSE,
+    };
+
+    enum ResolveState
+    {
+        RESOLVE_NONE,
+        RESOLVE_PENDING,
+        RESOLVE_DONE,
+        RESOLVE_FAILED,
+    };
+
+    enum ChunkState
+    {
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_DATA_END,
+        CHUNK_TRAILER,
+    };
+
+    struct Host;
+    struct Connection;
+
+    struct Transfer
+    {
+        Host*            m_Host;
+        dmArray<char>    m_Send;
+        uint32_t         m_Sent;
+        uint64_t         m_Deadline;
+        ResponseCallback m_Callback;
+        void*            m_UserData;
+        Result           m_Result;
+        uint32_t         m_Retries;
+
+        int              m_Status;
+        int              m_Major;
+        int              m_Minor;
+        int              m_HeaderSize;
+        int64_t          m_ContentLength;
+        dmArray<char>    m_Headers;
+        dmArray<char>    m_Content;
+        BodyMode         m_BodyMode;
+        ChunkState       m_ChunkState;
+        uint32_t         m_Remaining;
+
+        uint32_t         m_Idempotent : 1;
+        uint32_t         m_Head : 1;
+        uint32_t         m_HeadersDone : 1;
+        uint32_t         m_Chunked : 1;
+        uint32_t         m_ConnectionClose : 1;
+        uint32_t         m_ConnectionKeepAlive : 1;
+    };
+
+    struct Connection
+    {
+        Host*              m_Host;
+        dmSocket::Socket   m_Socket;
+        // Transfers in the order they are sent. The first one is being received
+        dmArray<Transfer*> m_Pipeline;
+        // Index of the first transfer in m_Pipeline that isn't completely sent
+        uint32_t           m_SendIndex;
+        dmArray<char>      m_Recv;
+        uint32_t           m_RecvOffset;
+        uint64_t           m_IdleSince;
+        uint32_t           m_Completed;
+        uint32_t           m_Connected : 1;
+        uint32_t           m_Persistent : 1;
+        // The server will close the connection after the current response
+        uint32_t           m_Closing : 1;
+        uint32_t           m_Dead : 1;
+    };
+
+    struct Host
+    {
+        char               m_Hostname[dmURI::MAX_LOCATION_LEN];
+        uint16_t           m_Port;
+        // Written by the resolver thread while the state is RESOLVE_PENDING
+        dmSocket::Address  m_Address;
+        // Protected by the resolver mutex when there is a resolver thread
+        ResolveState       m_ResolveState;
+        dmArray<Transfer*> m_Queue;
+        uint32_t           m_ConnectionCount;
+    };
+
+    struct Client
+    {
+        NewParams            m_Params;
+        dmArray<Host*>       m_Hosts;
+        dmArray<Connection*> m_Connections;
+        dmArray<Transfer*>   m_Done;
+        uint32_t             m_ActiveCount;
+        Stats                m_Stats;
+
+        // Host names are looked up on a separate thread so that a slow lookup doesn't stall
+        // the other connections. The transfers stay queued on the host until it is resolved
+        dmThread::Thread                        m_Resolver;
+        dmMutex::HMutex                         m_ResolverMutex;
+        dmConditionVariable::HConditionVariable m_ResolverCondition;
+        dmArray<Host*>                          m_ResolveQueue;
+        uint32_t                                m_PendingResolves;
+        bool                                    m_ResolverStarted;
+        bool                                    m_ResolverQuit;
+    };
+
+    NewParams::NewParams()
+    {
+        memset(this, 0, sizeof(*this));
+        m_MaxConnections = 32;
+        m_MaxConnectionsPerHost = 6;
+        m_MaxPipelineDepth = 4;
+        m_MaxKeepAlive = 10;
+    }
+
+    RequestParams::RequestParams()
+    {
+        memset(this, 0, sizeof(*this));
+        m_Method = "GET";
+    }
+
+    template <typename T>
+    static void PushArray(dmArray<T>& array, const T* values, uint32_t count)
+    {
+        if (count == 0)
+            return;
+        if (array.Remaining() < count)
+        {
+            array.OffsetCapacity(dmMath::Max(count, array.Capacity()));
+        }
+        array.PushArray(values, count);
+    }
+
+    template <typename T>
+    static void PushValue(dmArray<T>& array, T value)
+    {
+        PushArray(array, &value, 1);
+    }
+
+    static void PushString(dmArray<char>& array, const char* s)
+    {
+        PushArray(array, s, strlen(s));
+    }
+
+    template <typename T>
+    static void EraseFront(dmArray<T>& array)
+    {
+        uint32_t size = array.Size();
+        memmove(array.Begin(), array.Begin() + 1, (size - 1) * sizeof(T));
+        array.SetSize(size - 1);
+    }
+
+    static void InsertFront(dmArray<Transfer*>& array, Transfer** transfers, uint32_t count)
+    {
+        uint32_t size = array.Size();
+        if (array.Remaining() < count)
+        {
+            array.OffsetCapacity(dmMath::Max(count, 8U));
+        }
+        array.SetSize(size + count);
+        memmove(array.Begin() + count, array.Begin(), size * sizeof(Transfer*));
+        memcpy(array.Begin(), transfers, count * sizeof(Transfer*));
+    }
+
+    HClient New(const NewParams* params)
+    {
+        Client* client = new Client;
+        client->m_Params = *params;
+        if (client->m_Params.m_MaxPipelineDepth == 0)
+            client->m_Params.m_MaxPipelineDepth = 1;
+        if (client->m_Params.m_MaxConnectionsPerHost == 0)
+            client->m_Params.m_MaxConnectionsPerHost = 1;
+        client->m_ActiveCount = 0;
+        memset(&client->m_Stats, 0, sizeof(client->m_Stats));
+        client->m_ResolverMutex = 0;
+        client->m_ResolverCondition = 0;
+        client->m_PendingResolves = 0;
+        client->m_ResolverStarted = false;
+        client->m_ResolverQuit = false;
+        return client;
+    }
+
+    static Host* GetHost(HClient client, const char* hostname, uint16_t port)
+    {
+        for (uint32_t i = 0; i < client->m_Hosts.Size(); ++i)
+        {
+            Host* host = client->m_Hosts[i];
+            if (host->m_Port == port && strcmp(host->m_Hostname, hostname) == 0)
+                return host;
+        }
+
+        Host* host = new Host;
+        dmStrlCpy(host->m_Hostname, hostname, sizeof(host->m_Hostname));
+        host->m_Port = port;
+        host->m_ResolveState = RESOLVE_NONE;
+        host->m_ConnectionCount = 0;
+        PushValue(client->m_Hosts, host);
+        return host;
+    }
+
+    static void AppendRequestHeaders(dmArray<char>& send, const char* headers, uint32_t headers_length)
+    {
+        // "key:value\n" lines, the last line may lack the new line
+        const char* end = headers + headers_length;
+        const char* line = headers;
+        while (line < end)
+        {
+            const char* line_end = (const char*) memchr(line, '\n', end - line);
+            if (line_end == 0)
+                line_end = end;
+            uint32_t length = line_end - line;
+            if (length > 0 && line[length - 1] == '\0')
+                --length;
+            if (length > 0 && memchr(line, ':', length) != 0)
+            {
+                PushArray(send, line, length);
+                PushString(send, "\r\n");
+            }
+            line = line_end + 1;
+        }
+    }
+
+    static void ResetResponse(Transfer* t)
+    {
+        t->m_Status = 0;
+        t->m_Major = 0;
+        t->m_Minor = 0;
+        t->m_HeaderSize = 0;
+        t->m_ContentLength = -1;
+        t->m_Headers.SetSize(0);
+        t->m_Content.SetSize(0);
+        t->m_BodyMode = BODY_NONE;
+        t->m_ChunkState = CHUNK_SIZE;
+        t->m_Remaining = 0;
+        t->m_HeadersDone = 0;
+        t->m_Chunked = 0;
+        t->m_ConnectionClose = 0;
+        t->m_ConnectionKeepAlive = 0;
+    }
+
+    Result Request(HClient client, const RequestParams* params)
+    {
+        dmURI::Parts url;
+        if (params->m_Method == 0 || params->m_Url == 0 || dmURI::Parse(params->m_Url, &url) != dmURI::RESULT_OK || url.m_Hostname[0] == '\0')
+            return RESULT_INVAL;
+        if (strcmp(url.m_Scheme, "http") != 0)
+            return RESULT_UNSUPPORTED;
+
+        uint16_t port = url.m_Port == -1 ? 80 : (uint16_t) url.m_Port;
+        Transfer* t = new Transfer;
+        t->m_Host = GetHost(client, url.m_Hostname, port);
+        t->m_Sent = 0;
+        t->m_Deadline = params->m_Timeout ? dmTime::GetTime() + params->m_Timeout : 0;
+        t->m_Callback = params->m_Callback;
+        t->m_UserData = params->m_UserData;
+        t->m_Result = RESULT_OK;
+        t->m_Retries = 0;
+        ResetResponse(t);
+        t->m_Head = strcmp(params->m_Method, "HEAD") == 0;
+        t->m_Idempotent = t->m_Head || strcmp(params->m_Method, "GET") == 0;
+
+        const char* path = url.m_Path[0] ? url.m_Path : "/";
+        char buf[64];
+        dmArray<char>& send = t->m_Send;
+        send.SetCapacity(256 + params->m_HeadersLength + params->m_BodyLength);
+        PushString(send, params->m_Method);
+        PushString(send, " ");
+        PushString(send, path);
+        PushString(send, " HTTP/1.1\r\nHost: ");
+        PushString(send, url.m_Location);
+        PushString(send, "\r\n");
+        if (params->m_Headers)
+        {
+            AppendRequestHeaders(send, params->m_Headers, params->m_HeadersLength);
+        }
+        if (!t->m_Idempotent || params->m_BodyLength > 0)
+        {
+            dmSnPrintf(buf, sizeof(buf), "Content-Length: %u\r\n", params->m_BodyLength);
+            PushString(send, buf);
+        }
+        PushString(send, "\r\n");
+        if (params->m_BodyLength > 0)
+        {
+            PushArray(send, (const char*) params->m_Body, params->m_BodyLength);
+        }
+
+        PushValue(t->m_Host->m_Queue, t);
+        client->m_ActiveCount++;
+        return RESULT_OK;
+    }
+
+    static void Complete(HClient client, Transfer* t, Result result)
+    {
+        t->m_Result = result;
+        PushValue(client->m_Done, t);
+    }
+
+    static void CloseConnection(HClient client, Connection* c)
+    {
+        if (c->m_Dead)
+            return;
+        dmSocket::Delete(c->m_Socket);
+        c->m_Host->m_ConnectionCount--;
+        c->m_Dead = 1;
+    }
+
+    /*
+     * Remove the transfers from index 'first' in the pipeline. Idempotent transfers
+     * that haven't used up their retries are queued again, in order, the rest fail.
+     */
+    static void AbortPipeline(HClient client, Connection* c, uint32_t first, Result result)
+    {
+        Transfer* retry[64];
+        uint32_t retry_count = 0;
+        for (uint32_t i = first; i < c->m_Pipeline.Size(); ++i)
+        {
+            Transfer* t = c->m_Pipeline[i];
+            bool received = i == 0 && (t->m_HeadersDone || c->m_RecvOffset < c->m_Recv.Size());
+            if (t->m_Idempotent && !received && t->m_Retries < MAX_RETRIES && retry_count < DM_ARRAY_SIZE(retry))
+            {
+                t->m_Retries++;
+                t->m_Sent = 0;
+                ResetResponse(t);
+                retry[retry_count++] = t;
+            }
+            else
+            {
+                Complete(client, t, result);
+            }
+        }
+        if (retry_count > 0)
+        {
+            InsertFront(c->m_Host->m_Queue, retry, retry_count);
+        }
+        c->m_Pipeline.SetSize(first);
+        c->m_SendIndex = dmMath::Min(c->m_SendIndex, first);
+    }
+
+    static void FailConnection(HClient client, Connection* c, Result result)
+    {
+        AbortPipeline(client, c, 0, result);
+        CloseConnection(client, c);
+    }
+
+    static bool ResolveHost(dmDNS::HChannel channel, const char* hostname, dmSocket::Address* address)
+    {
+        if (channel)
+        {
+            if (dmDNS::GetHostByName(hostname, address, channel, 0) == dmDNS::RESULT_OK)
+                return true;
+            // The network may have come up since the channel was created, see dmHttpClient::New
+            dmDNS::RefreshChannel(channel);
+            return dmDNS::GetHostByName(hostname, address, channel, 0) == dmDNS::RESULT_OK;
+        }
+        return dmSocket::GetHostByName(hostname, address) == dmSocket::RESULT_OK;
+    }
+
+    static void ResolverThread(void* arg)
+    {
+        Client* client = (Client*) arg;
+        dmMutex::ScopedLock lk(client->m_ResolverMutex);
+        while (!client->m_ResolverQuit)
+        {
+            if (client->m_ResolveQueue.Empty())
+            {
+                dmConditionVariable::Wait(client->m_ResolverCondition, client->m_ResolverMutex);
+                continue;
+            }
+
+            Host* host = client->m_ResolveQueue[0];
+            EraseFront(client->m_ResolveQueue);
+
+            // The host is only read by the I/O thread while the lookup is pending
+            dmMutex::Unlock(client->m_ResolverMutex);
+            dmSocket::Address address;
+            bool resolved = ResolveHost(client->m_Params.m_DNSChannel, host->m_Hostname, &address);
+            dmMutex::Lock(client->m_ResolverMutex);
+
+            host->m_Address = address;
+            host->m_ResolveState = resolved ? RESOLVE_DONE : RESOLVE_FAILED;
+        }
+    }
+
+    // Returns the resolve state of the host, starting a lookup if there is none
+    static ResolveState GetResolveState(HClient client, Host* host)
+    {
+        if (!client->m_ResolverStarted && dLib::FeaturesSupported(DM_FEATURE_BIT_THREADS))
+        {
+            client->m_ResolverMutex = dmMutex::New();
+            client->m_ResolverCondition = dmConditionVariable::New();
+            client->m_Resolver = dmThread::New(ResolverThread, RESOLVER_THREAD_STACK_SIZE, client, "http_resolve");
+            client->m_ResolverStarted = true;
+        }
+
+        if (!client->m_ResolverStarted)
+        {
+            // No threads, the lookup blocks
+            if (host->m_ResolveState == RESOLVE_NONE)
+            {
+                host->m_ResolveState = ResolveHost(client->m_Params.m_DNSChannel, host->m_Hostname, &host->m_Address) ? RESOLVE_DONE : RESOLVE_FAILED;
+            }
+            return host->m_ResolveState;
+        }
+
+        dmMutex::ScopedLock lk(client->m_ResolverMutex);
+        if (host->m_ResolveState == RESOLVE_NONE)
+        {
+            host->m_ResolveState = RESOLVE_PENDING;
+            PushValue(client->m_ResolveQueue, host);
+            dmConditionVariable::Signal(client->m_ResolverCondition);
+        }
+        return host->m_ResolveState;
+    }
+
+    static void SetResolveState(HClient client, Host* host, ResolveState state)
+    {
+        if (client->m_ResolverStarted)
+        {
+            dmMutex::ScopedLock lk(client->m_ResolverMutex);
+            host->m_ResolveState = state;
+        }
+        else
+        {
+            host->m_ResolveState = state;
+        }
+    }
+
+    static void StopResolver(HClient client)
+    {
+        if (!client->m_ResolverStarted)
+            return;
+        dmMutex::Lock(client->m_ResolverMutex);
+        client->m_ResolverQuit = true;
+        client->m_ResolveQueue.SetSize(0);
+        dmConditionVariable::Signal(client->m_ResolverCondition);
+        dmMutex::Unlock(client->m_ResolverMutex);
+        // Waits for a lookup in progress, dmDNS::StopChannel aborts it
+        dmThread::Join(client->m_Resolver);
+        dmConditionVariable::Delete(client->m_ResolverCondition);
+        dmMutex::Delete(client->m_ResolverMutex);
+        client->m_ResolverStarted = false;
+    }
+
+    static Connection* OpenConnection(HClient client, Host* host, Result* result)
+    {
+        dmSocket::Socket socket;
+        dmSocket::Result sr = dmSocket::New(host->m_Address.m_family, dmSocket::TYPE_STREAM, dmSocket::PROTOCOL_TCP, &socket);
+        if (sr != dmSocket::RESULT_OK)
+        {
+            *result = RESULT_SOCKET_ERROR;
+            return 0;
+        }
+
+        dmSocket::SetBlocking(socket, false);
+        dmSocket::SetNoDelay(socket, true);
+        sr = dmSocket::Connect(socket, host->m_Address, host->m_Port);
+        if (sr != dmSocket::RESULT_OK)
+        {
+            dmSocket::Delete(socket);
+            // Resolve again on the next attempt in case the address has changed
+            SetResolveState(client, host, RESOLVE_NONE);
+            *result = RESULT_SOCKET_ERROR;
+            return 0;
+        }
+
+        Connection* c = new Connection;
+        c->m_Host = host;
+        c->m_Socket = socket;
+        c->m_SendIndex = 0;
+        c->m_RecvOffset = 0;
+        c->m_IdleSince = dmTime::GetTime();
+        c->m_Completed = 0;
+        c->m_Connected = 0;
+        c->m_Persistent = 0;
+        c->m_Closing = 0;
+        c->m_Dead = 0;
+        c->m_Recv.SetCapacity(RECEIVE_CHUNK_SIZE + 1);
+        host->m_ConnectionCount++;
+        PushValue(client->m_Connections, c);
+        client->m_Stats.m_ConnectionsOpened++;
+        return c;
+    }
+
+    static bool CanPipeline(HClient client, Connection* c)
+    {
+        if (c->m_Dead || c->m_Closing || !c->m_Persistent || c->m_Completed == 0)
+            return false;
+        if (c->m_Pipeline.Size() >= client->m_Params.m_MaxPipelineDepth)
+            return false;
+        for (uint32_t i = 0; i < c->m_Pipeline.Size(); ++i)
+        {
+            if (!c->m_Pipeline[i]->m_Idempotent)
+                return false;
+        }
+        return true;
+    }
+
+    static bool CloseIdleConnection(HClient client)
+    {
+        Connection* oldest = 0;
+        for (uint32_t i = 0; i < client->m_Connections.Size(); ++i)
+        {
+            Connection* c = client->m_Connections[i];
+            if (!c->m_Dead && c->m_Pipeline.Empty() && (oldest == 0 || c->m_IdleSince < oldest->m_IdleSince))
+                oldest = c;
+        }
+        if (oldest)
+        {
+            CloseConnection(client, oldest);
+            return true;
+        }
+        return false;
+    }
+
+    static uint32_t GetOpenCount(HClient client)
+    {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < client->m_Connections.Size(); ++i)
+        {
+            count += client->m_Connections[i]->m_Dead ? 0 : 1;
+        }
+        return count;
+    }
+
+    // Assign queued transfers to connections: idle connection, new connection, then pipelining
+    static void Schedule(HClient client, Host* host)
+    {
+        if (host->m_Queue.Empty())
+            return;
+
+        // The queued transfers wait for the lookup, a failed lookup fails all of them
+        ResolveState resolve_state = GetResolveState(client, host);
+        if (resolve_state == RESOLVE_PENDING)
+        {
+            client->m_PendingResolves++;
+            return;
+        }
+        if (resolve_state == RESOLVE_FAILED)
+        {
+            for (uint32_t i = 0; i < host->m_Queue.Size(); ++i)
+            {
+                Complete(client, host->m_Queue[i], RESULT_SOCKET_ERROR);
+            }
+            host->m_Queue.SetSize(0);
+            // Later requests look the host up again
+            SetResolveState(client, host, RESOLVE_NONE);
+            return;
+        }
+
+        while (!host->m_Queue.Empty())
+        {
+            Transfer* t = host->m_Queue[0];
+            Connection* target = 0;
+            Connection* pipeline_target = 0;
+
+            for (uint32_t i = 0; i < client->m_Connections.Size(); ++i)
+            {
+                Connection* c = client->m_Connections[i];
+                if (c->m_Host != host || c->m_Dead || c->m_Closing)
+                    continue;
+                if (c->m_Pipeline.Empty())
+                {
+                    target = c;
+                    break;
+                }
+                if (t->m_Idempotent && CanPipeline(client, c) &&
+                    (pipeline_target == 0 || c->m_Pipeline.Size() < pipeline_target->m_Pipeline.Size()))
+                {
+                    pipeline_target = c;
+                }
+            }
+
+            if (target && target->m_Completed > 0)
+            {
+                client->m_Stats.m_Reused++;
+            }
+
+            if (target == 0 && host->m_ConnectionCount < client->m_Params.m_MaxConnectionsPerHost &&
+                (GetOpenCount(client) < client->m_Params.m_MaxConnections || CloseIdleConnection(client)))
+            {
+                Result result = RESULT_OK;
+                target = OpenConnection(client, host, &result);
+                if (target == 0)
+                {
+                    EraseFront(host->m_Queue);
+                    Complete(client, t, result);
+                    // The rest wait for the host to be looked up again
+                    break;
+                }
+            }
+
+            if (target == 0 && pipeline_target)
+            {
+                target = pipeline_target;
+                client->m_Stats.m_Pipelined++;
+            }
+
+            if (target == 0)
+                break;
+
+            EraseFront(host->m_Queue);
+            PushValue(target->m_Pipeline, t);
+        }
+    }
+
+    static void SendPending(HClient client, Connection* c)
+    {
+        while (c->m_SendIndex < c->m_Pipeline.Size())
+        {
+            Transfer* t = c->m_Pipeline[c->m_SendIndex];
+            int sent = 0;
+            dmSocket::Result sr = dmSocket::Send(c->m_Socket, t->m_Send.Begin() + t->m_Sent, t->m_Send.Size() - t->m_Sent, &sent);
+            if (sr == dmSocket::RESULT_WOULDBLOCK || sr == dmSocket::RESULT_TRY_AGAIN)
+                return;
+            if (sr != dmSocket::RESULT_OK)
+            {
+                FailConnection(client, c, RESULT_SOCKET_ERROR);
+                return;
+            }
+            t->m_Sent += sent;
+            if (t->m_Sent < t->m_Send.Size())
+                return;
+            c->m_SendIndex++;
+        }
+    }
+
+    static void OnVersion(void* user_data, int major, int minor, int status, const char* status_str)
+    {
+        Transfer* t = (Transfer*) user_data;
+        t->m_Major = major;
+        t->m_Minor = minor;
+        t->m_Status = status;
+    }
+
+    static void OnHeader(void* user_data, const char* key, const char* value)
+    {
+        Transfer* t = (Transfer*) user_data;
+        PushString(t->m_Headers, key);
+        PushValue(t->m_Headers, ':');
+        PushString(t->m_Headers, value);
+        PushValue(t->m_Headers, '\n');
+
+        if (dmStrCaseCmp(key, "Content-Length") == 0)
+        {
+            t->m_ContentLength = strtoll(value, 0, 10);
+        }
+        else if (dmStrCaseCmp(key, "Transfer-Encoding") == 0)
+        {
+            t->m_Chunked = dmStrCaseCmp(value, "chunked") == 0;
+        }
+        else if (dmStrCaseCmp(key, "Connection") == 0)
+        {
+            t->m_ConnectionClose = dmStrCaseCmp(value, "close") == 0;
+            t->m_ConnectionKeepAlive = dmStrCaseCmp(value, "keep-alive") == 0;
+        }
+    }
+
+    static void OnBody(void* user_data, int offset)
+    {
+        Transfer* t = (Transfer*) user_data;
+        t->m_HeaderSize = offset;
+    }
+
+    static const char* FindLineEnd(const char* start, const char* end)
+    {
+        for (const char* p = start; p + 1 < end; ++p)
+        {
+            if (p[0] == '\r' && p[1] == '\n')
+                return p;
+        }
+        return 0;
+    }
+
+    enum ParseStatus
+    {
+        PARSE_DONE,
+        PARSE_NEED_MORE,
+        PARSE_ERROR,
+    };
+
+    static ParseStatus ParseHeaders(Connection* c, Transfer* t, bool eof)
+    {
+        char* start = c->m_Recv.Begin() + c->m_RecvOffset;
+        uint32_t available = c->m_Recv.Size() - c->m_RecvOffset;
+        // The receive buffer is always null terminated
+        dmHttpClientPrivate::ParseResult pr = dmHttpClientPrivate::ParseHeader(start, t, eof, OnVersion, OnHeader, OnBody);
+        if (pr == dmHttpClientPrivate::PARSE_RESULT_NEED_MORE_DATA)
+            return available > MAX_HEADER_SIZE ? PARSE_ERROR : PARSE_NEED_MORE;
+        if (pr != dmHttpClientPrivate::PARSE_RESULT_OK)
+            return PARSE_ERROR;
+
+        c->m_RecvOffset += t->m_HeaderSize;
+
+        // Informational responses, eg "100 Continue", are followed by the real response
+        if (t->m_Status >= 100 && t->m_Status < 200)
+        {
+            ResetResponse(t);
+            return ParseHeaders(c, t, eof);
+        }
+
+        t->m_HeadersDone = 1;
+        if (t->m_Head || t->m_Status == 204 || t->m_Status == 304)
+        {
+            t->m_BodyMode = BODY_NONE;
+        }
+        else if (t->m_Chunked)
+        {
+            t->m_BodyMode = BODY_CHUNKED;
+            t->m_ChunkState = CHUNK_SIZE;
+        }
+        else if (t->m_ContentLength >= 0)
+        {
+            t->m_BodyMode = BODY_LENGTH;
+            t->m_Remaining = (uint32_t) t->m_ContentLength;
+            t->m_Content.SetCapacity(t->m_Remaining);
+        }
+        else
+        {
+            t->m_BodyMode = BODY_UNTIL_CLOSE;
+        }
+
+        bool http10 = t->m_Major == 1 && t->m_Minor == 0;
+        if (t->m_ConnectionClose || (http10 && !t->m_ConnectionKeepAlive) || t->m_BodyMode == BODY_UNTIL_CLOSE)
+        {
+            t->m_ConnectionClose = 1;
+        }
+        return PARSE_DONE;
+    }
+
+    static void TakeContent(Connection* c, Transfer* t, uint32_t size)
+    {
+        PushArray(t->m_Content, (const char*) c->m_Recv.Begin() + c->m_RecvOffset, size);
+        c->m_RecvOffset += size;
+    }
+
+    static ParseStatus ParseChunked(Connection* c, Transfer* t, bool eof)
+    {
+        for (;;)
+        {
+            const char* start = c->m_Recv.Begin() + c->m_RecvOffset;
+            const char* end = c->m_Recv.Begin() + c->m_Recv.Size();
+            uint32_t available = end - start;
+
+            switch (t->m_ChunkState)
+            {
+            case CHUNK_SIZE:
+            {
+                const char* line_end = FindLineEnd(start, end);
+                if (line_end == 0)
+                    return eof ? PARSE_ERROR : PARSE_NEED_MORE;
+                char* size_end;
+                unsigned long size = strtoul(start, &size_end, 16);
+                if (size_end == start)
+                    return PARSE_ERROR;
+                c->m_RecvOffset += (line_end + 2) - start;
+                t->m_Remaining = (uint32_t) size;
+                t->m_ChunkState = size == 0 ? CHUNK_TRAILER : CHUNK_DATA;
+                break;
+            }
+            case CHUNK_DATA:
+            {
+                uint32_t size = dmMath::Min(available, t->m_Remaining);
+                TakeContent(c, t, size);
+                t->m_Remaining -= size;
+                if (t->m_Remaining > 0)
+                    return eof ? PARSE_ERROR : PARSE_NEED_MORE;
+                t->m_ChunkState = CHUNK_DATA_END;
+                break;
+            }
+            case CHUNK_DATA_END:
+            {
+                if (available < 2)
+                    return eof ? PARSE_ERROR : PARSE_NEED_MORE;
+                if (start[0] != '\r' || start[1] != '\n')
+                    return PARSE_ERROR;
+                c->m_RecvOffset += 2;
+                t->m_ChunkState = CHUNK_SIZE;
+                break;
+            }
+            case CHUNK_TRAILER:
+            {
+                const char* line_end = FindLineEnd(start, end);
+                if (line_end == 0)
+                    return eof ? PARSE_ERROR : PARSE_NEED_MORE;
+                c->m_RecvOffset += (line_end + 2) - start;
+                if (line_end == start)
+                    return PARSE_DONE;
+                break;
+            }
+            }
+        }
+    }
+
+    static ParseStatus ParseBody(Connection* c, Transfer* t, bool eof)
+    {
+        uint32_t available = c->m_Recv.Size() - c->m_RecvOffset;
+        switch (t->m_BodyMode)
+        {
+        case BODY_NONE:
+            return PARSE_DONE;
+        case BODY_LENGTH:
+        {
+            uint32_t size = dmMath::Min(available, t->m_Remaining);
+            TakeContent(c, t, size);
+            t->m_Remaining -= size;
+            if (t->m_Remaining == 0)
+                return PARSE_DONE;
+            return eof ? PARSE_ERROR : PARSE_NEED_MORE;
+        }
+        case BODY_UNTIL_CLOSE:
+            TakeContent(c, t, available);
+            return eof ? PARSE_DONE : PARSE_NEED_MORE;
+        case BODY_CHUNKED:
+            return ParseChunked(c, t, eof);
+        }
+        return PARSE_ERROR;
+    }
+
+    static void CompactReceiveBuffer(Connection* c)
+    {
+        uint32_t size = c->m_Recv.Size();
+        if (c->m_RecvOffset == 0)
+            return;
+        memmove(c->m_Recv.Begin(), c->m_Recv.Begin() + c->m_RecvOffset, size - c->m_RecvOffset);
+        c->m_Recv.SetSize(size - c->m_RecvOffset);
+        c->m_RecvOffset = 0;
+        c->m_Recv.Begin()[c->m_Recv.Size()] = '\0';
+    }
+
+    static void ProcessResponses(HClient client, Connection* c, bool eof)
+    {
+        while (!c->m_Pipeline.Empty())
+        {
+            Transfer* t = c->m_Pipeline[0];
+            // Data before the request is completely sent is an early error response, which is fine to read
+            if (!t->m_HeadersDone)
+            {
+                if (c->m_RecvOffset == c->m_Recv.Size())
+                {
+                    if (eof)
+                        FailConnection(client, c, RESULT_UNEXPECTED_EOF);
+                    break;
+                }
+
+                ParseStatus ps = ParseHeaders(c, t, eof);
+                if (ps == PARSE_NEED_MORE)
+                {
+                    if (eof)
+                        FailConnection(client, c, RESULT_UNEXPECTED_EOF);
+                    break;
+                }
+                if (ps == PARSE_ERROR)
+                {
+                    FailConnection(client, c, RESULT_INVALID_RESPONSE);
+                    break;
+                }
+
+                if (t->m_ConnectionClose && c->m_Pipeline.Size() > 1)
+                {
+                    // The server won't answer the pipelined requests, send them again elsewhere
+                    AbortPipeline(client, c, 1, RESULT_UNEXPECTED_EOF);
+                }
+            }
+
+            ParseStatus ps = ParseBody(c, t, eof);
+            if (ps == PARSE_NEED_MORE)
+                break;
+            if (ps == PARSE_ERROR)
+            {
+                FailConnection(client, c, eof ? RESULT_UNEXPECTED_EOF : RESULT_INVALID_RESPONSE);
+                break;
+            }
+
+            EraseFront(c->m_Pipeline);
+            c->m_SendIndex = c->m_SendIndex > 0 ? c->m_SendIndex - 1 : 0;
+            c->m_Completed++;
+            c->m_Persistent = !t->m_ConnectionClose;
+            c->m_Closing = t->m_ConnectionClose;
+            Complete(client, t, RESULT_OK);
+            if (c->m_Pipeline.Empty())
+            {
+                c->m_IdleSince = dmTime::GetTime();
+            }
+        }
+
+        if (!c->m_Dead)
+        {
+            CompactReceiveBuffer(c);
+            if (c->m_Pipeline.Empty() && (eof || c->m_Closing))
+            {
+                CloseConnection(client, c);
+            }
+        }
+    }
+
+    static void ReceivePending(HClient client, Connection* c)
+    {
+        bool eof = false;
+        for (;;)
+        {
+            if (c->m_Recv.Remaining() < RECEIVE_CHUNK_SIZE + 1)
+            {
+                c->m_Recv.OffsetCapacity(dmMath::Max(RECEIVE_CHUNK_SIZE + 1, c->m_Recv.Capacity()));
+            }
+
+            int received = 0;
+            uint32_t size = c->m_Recv.Size();
+            dmSocket::Result sr = dmSocket::Receive(c->m_Socket, c->m_Recv.Begin() + size, RECEIVE_CHUNK_SIZE, &received);
+            if (sr == dmSocket::RESULT_WOULDBLOCK || sr == dmSocket::RESULT_TRY_AGAIN)
+                break;
+            if (sr != dmSocket::RESULT_OK)
+            {
+                FailConnection(client, c, RESULT_SOCKET_ERROR);
+                return;
+            }
+            if (received == 0)
+            {
+                eof = true;
+                break;
+            }
+            c->m_Recv.SetSize(size + received);
+            c->m_Recv.Begin()[c->m_Recv.Size()] = '\0';
+        }
+
+        if (eof && c->m_Pipeline.Empty())
+        {
+            // Idle keep-alive connection closed by the server
+            CloseConnection(client, c);
+            return;
+        }
+        ProcessResponses(client, c, eof);
+    }
+
+    static void CheckTimeouts(HClient client)
+    {
+        uint64_t now = dmTime::GetTime();
+        for (uint32_t i = 0; i < client->m_Hosts.Size(); ++i)
+        {
+            dmArray<Transfer*>& queue = client->m_Hosts[i]->m_Queue;
+            for (uint32_t j = 0; j < queue.Size(); )
+            {
+                Transfer* t = queue[j];
+                if (t->m_Deadline != 0 && now >= t->m_Deadline)
+                {
+                    memmove(queue.Begin() + j, queue.Begin() + j + 1, (queue.Size() - j - 1) * sizeof(Transfer*));
+                    queue.SetSize(queue.Size() - 1);
+                    Complete(client, t, RESULT_TIMEOUT);
+                }
+                else
+                {
+                    ++j;
+                }
+            }
+        }
+
+        for (uint32_t i = 0; i < client->m_Connections.Size(); ++i)
+        {
+            Connection* c = client->m_Connections[i];
+            if (c->m_Dead)
+                continue;
+
+            for (uint32_t j = 0; j < c->m_Pipeline.Size(); ++j)
+            {
+                Transfer* t = c->m_Pipeline[j];
+                if (t->m_Deadline != 0 && now >= t->m_Deadline)
+                {
+                    // A response can't be skipped on a connection. Close it and let the others retry
+                    memmove(c->m_Pipeline.Begin() + j, c->m_Pipeline.Begin() + j + 1, (c->m_Pipeline.Size() - j - 1) * sizeof(Transfer*));
+                    c->m_Pipeline.SetSize(c->m_Pipeline.Size() - 1);
+                    Complete(client, t, RESULT_TIMEOUT);
+                    FailConnection(client, c, RESULT_SOCKET_ERROR);
+                    break;
+                }
+            }
+
+            if (!c->m_Dead && c->m_Pipeline.Empty() && now - c->m_IdleSince > client->m_Params.m_MaxKeepAlive * 1000000ULL)
+            {
+                CloseConnection(client, c);
+            }
+        }
+    }
+
+    static void RemoveDeadConnections(HClient client)
+    {
+        for (uint32_t i = 0; i < client->m_Connections.Size(); )
+        {
+            Connection* c = client->m_Connections[i];
+            if (c->m_Dead)
+            {
+                client->m_Connections.EraseSwap(i);
+                delete c;
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+
+    static void InvokeCallbacks(HClient client)
+    {
+        // Callbacks may queue new requests
+        for (uint32_t i = 0; i < client->m_Done.Size(); ++i)
+        {
+            Transfer* t = client->m_Done[i];
+            if (t->m_Callback)
+            {
+                Response response;
+                response.m_Result = t->m_Result;
+                response.m_Status = t->m_Result == RESULT_OK ? t->m_Status : 0;
+                response.m_Headers = t->m_Headers.Begin();
+                response.m_HeadersLength = t->m_Headers.Size();
+                response.m_Content = t->m_Content.Begin();
+                response.m_ContentLength = t->m_Content.Size();
+                t->m_Callback(t->m_UserData, &response);
+            }
+            client->m_ActiveCount--;
+            delete t;
+        }
+        client->m_Done.SetSize(0);
+    }
+
+    /*
+     * Detect idle keep-alive connections that the server has closed before new requests
+     * are assigned to them. Otherwise non-idempotent requests would fail on a stale connection.
+     */
+    static void ReapIdleConnections(HClient client)
+    {
+        dmSocket::Selector selector;
+        dmSocket::SelectorZero(&selector);
+        uint32_t idle_count = 0;
+        for (uint32_t i = 0; i < client->m_Connections.Size(); ++i)
+        {
+            Connection* c = client->m_Connections[i];
+            if (!c->m_Dead && c->m_Connected && c->m_Pipeline.Empty())
+            {
+                dmSocket::SelectorSet(&selector, dmSocket::SELECTOR_KIND_READ, c->m_Socket);
+                ++idle_count;
+            }
+        }
+        if (idle_count == 0 || dmSocket::Select(&selector, 0) != dmSocket::RESULT_OK)
+            return;
+
+        for (uint32_t i = 0; i < client->m_Connections.Size(); ++i)
+        {
+            Connection* c = client->m_Connections[i];
+            if (!c->m_Dead && c->m_Connected && c->m_Pipeline.Empty() && dmSocket::SelectorIsSet(&selector, dmSocket::SELECTOR_KIND_READ, c->m_Socket))
+            {
+                // Either eof or unsolicited data, the connection can't be used in both cases
+                CloseConnection(client, c);
+            }
+        }
+    }
+
+    void Update(HClient client, uint32_t timeout)
+    {
+        ReapIdleConnections(client);
+        client->m_PendingResolves = 0;
+        for (uint32_t i = 0; i < client->m_Hosts.Size(); ++i)
+        {
+            Schedule(client, client->m_Hosts[i]);
+        }
+
+        dmSocket::Selector selector;
+        dmSocket::SelectorZero(&selector);
+        uint32_t socket_count = 0;
+        for (uint32_t i = 0; i < client->m_Connections.Size(); ++i)
+        {
+            Connection* c = client->m_Connections[i];
+            if (c->m_Dead)
+                continue;
+            dmSocket::SelectorSet(&selector, dmSocket::SELECTOR_KIND_READ, c->m_Socket);
+            dmSocket::SelectorSet(&selector, dmSocket::SELECTOR_KIND_EXCEPT, c->m_Socket);
+            if (!c->m_Connected || c->m_SendIndex < c->m_Pipeline.Size())
+            {
+                dmSocket::SelectorSet(&selector, dmSocket::SELECTOR_KIND_WRITE, c->m_Socket);
+            }
+            ++socket_count;
+        }
+
+        if (socket_count > 0)
+        {
+            dmSocket::Result sr = dmSocket::Select(&selector, timeout);
+            if (sr == dmSocket::RESULT_OK)
+            {
+                // New connections may be opened by the callbacks below, only visit the selected ones
+                uint32_t connection_count = client->m_Connections.Size();
+                for (uint32_t i = 0; i < connection_count; ++i)
+                {
+                    Connection* c = client->m_Connections[i];
+                    if (c->m_Dead)
+                        continue;
+                    if (dmSocket::SelectorIsSet(&selector, dmSocket::SELECTOR_KIND_EXCEPT, c->m_Socket))
+                    {
+                        FailConnection(client, c, RESULT_SOCKET_ERROR);
+                        continue;
+                    }
+                    if (dmSocket::SelectorIsSet(&selector, dmSocket::SELECTOR_KIND_WRITE, c->m_Socket))
+                    {
+                        c->m_Connected = 1;
+                        SendPending(client, c);
+                    }
+                    if (!c->m_Dead && dmSocket::SelectorIsSet(&selector, dmSocket::SELECTOR_KIND_READ, c->m_Socket))
+                    {
+                        ReceivePending(client, c);
+                    }
+                }
+            }
+        }
+        else if (client->m_PendingResolves > 0)
+        {
+            // Nothing to select on until the lookups are done
+            dmTime::Sleep(timeout);
+        }
+
+        CheckTimeouts(client);
+        RemoveDeadConnections(client);
+        InvokeCallbacks(client);
+        client->m_Stats.m_Connections = client->m_Connections.Size();
+    }
+
+    uint32_t GetActiveCount(HClient client)
+    {
+        return client->m_ActiveCount;
+    }
+
+    void GetStats(HClient client, Stats* stats)
+    {
+        *stats = client->m_Stats;
+    }
+
+    void Delete(HClient client)
+    {
+        StopResolver(client);
+
+        for (uint32_t i = 0; i < client->m_Connections.Size(); ++i)
+        {
+            Connection* c = client->m_Connections[i];
+            for (uint32_t j = 0; j < c->m_Pipeline.Size(); ++j)
+            {
+                Complete(client, c->m_Pipeline[j], RESULT_CANCELLED);
+            }
+            c->m_Pipeline.SetSize(0);
+            CloseConnection(client, c);
+        }
+        RemoveDeadConnections(client);
+
+        for (uint32_t i = 0; i < client->m_Hosts.Size(); ++i)
+        {
+            Host* host = client->m_Hosts[i];
+            for (uint32_t j = 0; j < host->m_Queue.Size(); ++j)
+            {
+                Complete(client, host->m_Queue[j], RESULT_CANCELLED);
+            }
+            delete host;
+        }
+        client->m_Hosts.SetSize(0);
+
+        InvokeCallbacks(client);
+        delete client;
+    }
+
+    #define DM_HTTPASYNC_RESULT_TO_STRING_CASE(x) case RESULT_##x: return #x;
+    const char* ResultToString(Result r)
+    {
+        switch (r)
+        {
+            DM_HTTPASYNC_RESULT_TO_STRING_CASE(OK);
+            DM_HTTPASYNC_RESULT_TO_STRING_CASE(SOCKET_ERROR);
+            DM_HTTPASYNC_RESULT_TO_STRING_CASE(INVALID_RESPONSE);
+            DM_HTTPASYNC_RESULT_TO_STRING_CASE(UNEXPECTED_EOF);
+            DM_HTTPASYNC_RESULT_TO_STRING_CASE(TIMEOUT);
+            DM_HTTPASYNC_RESULT_TO_STRING_CASE(INVAL);
+            DM_HTTPASYNC_RESULT_TO_STRING_CASE(UNSUPPORTED);
+            DM_HTTPASYNC_RESULT_TO_STRING_CASE(CANCELLED);
+            default:
+                break;
+        }
+        dmLogError("Unable to convert result %d to string", r);
+        return "RESULT_UNDEFINED";
+    }
+    #undef DM_HTTPASYNC_RESULT_TO_STRING_CASE
+}
@@ -0,0 +1,168 @@
+// Copyright 2020 The Defold Foundation
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+// 
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+// 
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef DM_HTTP_ASYNC_H
+#define DM_HTTP_ASYNC_H
+
+#include <stdint.h>
+#include <dlib/dns.h>
+
+/**
+ * Non-blocking HTTP/1.1 client. Many requests are multiplexed over pooled keep-alive
+ * connections from a single thread. Idempotent requests (GET and HEAD) are pipelined
+ * on connections that have proven to be persistent.
+ * Only plain http is supported, the TLS handshake in dmSSLSocket is blocking.
+ * Host names are looked up on a helper thread, requests to a host wait until it is resolved.
+ * The client is not thread-safe, all functions must be called from the same thread.
+ */
+namespace dmHttpAsync
+{
+    /**
+     * Result values
+     */
+    enum Result
+    {
+        RESULT_OK = 0,                  //!< RESULT_OK
+        RESULT_SOCKET_ERROR = -1,       //!< RESULT_SOCKET_ERROR
+        RESULT_INVALID_RESPONSE = -2,   //!< RESULT_INVALID_RESPONSE
+        RESULT_UNEXPECTED_EOF = -3,     //!< RESULT_UNEXPECTED_EOF
+        RESULT_TIMEOUT = -4,            //!< RESULT_TIMEOUT
+        RESULT_INVAL = -5,              //!< RESULT_INVAL
+        RESULT_UNSUPPORTED = -6,        //!< RESULT_UNSUPPORTED
+        RESULT_CANCELLED = -7,          //!< RESULT_CANCELLED
+    };
+
+    /**
+     * Client handle
+     */
+    typedef struct Client* HClient;
+
+    /**
+     * Completed request
+     */
+    struct Response
+    {
+        Result      m_Result;
+        /// HTTP status code. 0 when the request failed
+        int         m_Status;
+        /// Response headers in the format "key:value\n"
+        const char* m_Headers;
+        uint32_t    m_HeadersLength;
+        const char* m_Content;
+        uint32_t    m_ContentLength;
+    };
+
+    /**
+     * Response callback. Invoked exactly once per request, from Update() or Delete()
+     * @param user_data User data
+     * @param response Response, only valid during the call
+     */
+    typedef void (*ResponseCallback)(void* user_data, const Response* response);
+
+    struct NewParams
+    {
+        NewParams();
+
+        /// Maximum number of open connections. Default 32
+        uint32_t        m_MaxConnections;
+        /// Maximum number of open connections to a single host. Default 6
+        uint32_t        m_MaxConnectionsPerHost;
+        /// Maximum number of requests in flight on a connection. Default 4, 1 disables pipelining
+        uint32_t        m_MaxPipelineDepth;
+        /// Idle connections older than this (in seconds) are closed. Default 10
+        uint32_t        m_MaxKeepAlive;
+        /// Channel to resolve host names with, only used from the lookup thread. Default 0 (use dmSocket::GetHostByName)
+        dmDNS::HChannel m_DNSChannel;
+    };
+
+    struct RequestParams
+    {
+        RequestParams();
+
+        /// Method, eg "GET"
+        const char*      m_Method;
+        /// Absolute url, eg "http://localhost:8080/index.html"
+        const char*      m_Url;
+        /// Extra request headers in the format "key:value\n"
+        const char*      m_Headers;
+        uint32_t         m_HeadersLength;
+        const void*      m_Body;
+        uint32_t         m_BodyLength;
+        /// Timeout in us for the complete request. 0 for no timeout
+        uint64_t         m_Timeout;
+        ResponseCallback m_Callback;
+        void*            m_UserData;
+    };
+
+    struct Stats
+    {
+        /// Currently open connections
+        uint32_t m_Connections;
+        /// Connections opened since the client was created
+        uint32_t m_ConnectionsOpened;
+        /// Requests sent on a connection that already had a request in flight
+        uint32_t m_Pipelined;
+        /// Requests sent on a previously used keep-alive connection
+        uint32_t m_Reused;
+    };
+
+    /**
+     * Create a new client
+     * @param params Parameters
+     * @return Client handle
+     */
+    HClient New(const NewParams* params);
+
+    /**
+     * Delete client. Outstanding requests complete with RESULT_CANCELLED
+     * @param client Client handle
+     */
+    void Delete(HClient client);
+
+    /**
+     * Queue a request. All request data is copied. The callback is invoked from a later Update()
+     * @param client Client handle
+     * @param params Request parameters
+     * @return RESULT_OK if queued, RESULT_INVAL for a malformed url or RESULT_UNSUPPORTED for other schemes than http
+     */
+    Result Request(HClient client, const RequestParams* params);
+
+    /**
+     * Wait for socket activity, send and receive pending data and invoke callbacks for completed requests
+     * @param client Client handle
+     * @param timeout Maximum time to wait for socket activity in us
+     */
+    void Update(HClient client, uint32_t timeout);
+
+    /**
+     * Get number of requests that have not completed yet
+     * @param client Client handle
+     * @return Number of requests
+     */
+    uint32_t GetActiveCount(HClient client);
+
+    /**
+     * Get statistics
+     * @param client Client handle
+     * @param stats Statistics [out]
+     */
+    void GetStats(HClient client, Stats* stats);
+
+    /**
+     * Convert result value to string
+     * @param result Result value
+     * @return Result as a string
+     */
+    const char* ResultToString(Result result);
+}
+
+#endif // DM_HTTP_ASYNC_H
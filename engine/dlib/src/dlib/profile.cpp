@@ -13,6 +13,8 @@
 #include "profile.h"
 
 #include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #if defined(_WIN32)
@@ -34,22 +36,94 @@
 #include "math.h"
 #include "time.h"
 #include "thread.h"
+#include "mutex.h"
+#include "condition_variable.h"
 #include "array.h"
 
 namespace dmProfile
 {
     const uint32_t PROFILE_BUFFER_COUNT = 3;
+    // Number of threads recording at once. Same limit as the active thread set in CalculateScopeProfile
+    const uint32_t MAX_THREAD_COUNT = 64;
+    // Each thread buffer holds this fraction of the frame sample budget, but no less than MIN_THREAD_SAMPLES
+    const uint32_t THREAD_SAMPLES_BUDGET_FRACTION = 4;
+    const uint32_t MIN_THREAD_SAMPLES = 1024;
+    const uint32_t MAX_THREAD_NAME_LENGTH = 32;
+    // Number of frames worth of samples staged before they are handed to the capture writer thread
+    const uint32_t CAPTURE_BUFFER_FRAME_COUNT = 4;
+    const uint32_t INVALID_INDEX = 0xffffffffu;
+
+    /*
+     * Samples are recorded into a ring buffer owned by the recording thread and merged into the
+     * profile when the frame is closed in Begin(). The owning thread is the only writer of a ring
+     * slot, so recording a sample never takes a lock. A slot is published by storing the write
+     * index, and consumed by storing the read index.
+     *
+     * A thread holds its buffer slot until it exits. The slot is then released, and made free for
+     * other threads once Begin() has merged the samples left in it.
+     */
+    struct ThreadSample
+    {
+        const char*    m_Name;
+        Scope*         m_Scope;
+        uint64_t       m_StartTicks;
+        uint32_t       m_NameHash;
+        // Write index of the sample, used by EndScope to detect that the slot has been reused
+        uint32_t       m_Sequence;
+        int32_atomic_t m_Elapsed;
+    };
+
+    enum ThreadBufferState
+    {
+        THREAD_BUFFER_FREE     = 0,
+        THREAD_BUFFER_ACTIVE   = 1,
+        // The owning thread has exited, the buffer is free once merged
+        THREAD_BUFFER_RELEASED = 2,
+    };
+
+    struct ThreadBuffer
+    {
+        ThreadSample*  m_Samples;
+        // Ring size (power of two) and maximum number of unmerged samples
+        uint32_t       m_Mask;
+        uint32_t       m_Limit;
+        int32_atomic_t m_Write;
+        int32_atomic_t m_Read;
+        int32_atomic_t m_Overflow;
+        int32_atomic_t m_State;
+        // Keeps buffers of different threads on separate cache lines
+        uint8_t        m_Pad[64 - sizeof(ThreadSample*) - 6 * sizeof(uint32_t)];
+    };
+
+    static const int32_t ELAPSED_OPEN = -1;
+
+    /*
+     * Scopes and counters are registered from any thread through a lock-free open addressing
+     * table keyed on the name hash. A slot is claimed by a compare-and-swap on the key and
+     * published by storing the entry index + 1 once the entry has been filled in.
+     */
+    struct NameTable
+    {
+        int32_atomic_t* m_Keys;
+        int32_atomic_t* m_Values;
+        uint32_t        m_Mask;
+    };
 
     dmArray<Scope> g_Scopes;
+    int32_atomic_t g_ScopeCount = 0;
+    NameTable      g_ScopeTable;
 
-    dmHashTable32<uint32_t> g_CountersTable;
     dmArray<Counter> g_Counters;
+    int32_atomic_t   g_CounterCount = 0;
+    int32_atomic_t*  g_CounterValues = 0;
+    NameTable        g_CounterTable;
 
     struct Profile
     {
         dmArray<Sample>      m_Samples;
         dmArray<CounterData> m_CountersData;
         dmArray<ScopeData>   m_ScopesData;
+        uint64_t             m_BeginTicks;
         uint32_t             m_ScopeCount;
         uint32_t             m_CounterCount;
     };
@@ -77,14 +151,126 @@ namespace dmProfile
     bool g_OutOfCounters = false;
     bool g_IsInitialized = false;
     bool g_Paused = false;
+    uint32_t g_MaxSamples = 0;
+    // Protects the profile free list. Recording samples and counters never takes it.
     dmSpinlock::lock_t g_ProfileLock;
 
-    dmThread::TlsKey g_TlsKey = dmThread::AllocTls();
+    // Number of buffer slots that have been in use, free slots are reused before new ones
     int32_atomic_t g_ThreadCount = 0;
+    ThreadBuffer g_ThreadBuffers[MAX_THREAD_COUNT];
+    // Written by the owning thread when it takes the buffer slot
+    char g_ThreadNames[MAX_THREAD_COUNT][MAX_THREAD_NAME_LENGTH];
+
+    // Stored for threads that found no free buffer slot
+    static void* const NO_THREAD_BUFFER = (void*) ~(uintptr_t) 0;
+
+    static void ReleaseThreadBuffer(void* tls_data);
+
+    /*
+     * The thread local buffer slot needs a destructor to be released when the thread exits,
+     * which dmThread TLS doesn't have.
+     */
+#if defined(_WIN32)
+    typedef DWORD ThreadKey;
+
+    static void WINAPI ReleaseThreadBufferCallback(void* tls_data)
+    {
+        if (tls_data)
+            ReleaseThreadBuffer(tls_data);
+    }
+
+    static ThreadKey NewThreadKey()
+    {
+        return FlsAlloc(ReleaseThreadBufferCallback);
+    }
+
+    static inline void* GetThreadKeyValue(ThreadKey key)
+    {
+        return FlsGetValue(key);
+    }
+
+    static inline void SetThreadKeyValue(ThreadKey key, void* value)
+    {
+        FlsSetValue(key, value);
+    }
+#else
+    typedef pthread_key_t ThreadKey;
+
+    static void ReleaseThreadBufferCallback(void* tls_data)
+    {
+        ReleaseThreadBuffer(tls_data);
+    }
+
+    static ThreadKey NewThreadKey()
+    {
+        pthread_key_t key;
+        int ret = pthread_key_create(&key, ReleaseThreadBufferCallback);
+        assert(ret == 0);
+        (void) ret;
+        return key;
+    }
+
+    static inline void* GetThreadKeyValue(ThreadKey key)
+    {
+        return pthread_getspecific(key);
+    }
 
-    // Used when out of scopes in order to remove conditional branches
-    ScopeData g_DummyScopeData;
-    Scope g_DummyScope = { "foo", 0u, 0, &g_DummyScopeData };
+    static inline void SetThreadKeyValue(ThreadKey key, void* value)
+    {
+        pthread_setspecific(key, value);
+    }
+#endif
+
+    ThreadKey g_ThreadKey = NewThreadKey();
+
+    struct CaptureFrame
+    {
+        uint64_t m_BeginTicks;
+        uint32_t m_SampleStart;
+        uint32_t m_SampleCount;
+        uint32_t m_CounterStart;
+        uint32_t m_CounterCount;
+    };
+
+    struct CaptureBatch
+    {
+        dmArray<CaptureFrame> m_Frames;
+        dmArray<Sample>       m_Samples;
+        dmArray<CounterData>  m_Counters;
+    };
+
+    /*
+     * Begin() copies the closed frames into the staging batch, and hands full batches over to the
+     * writer thread. Writing to file thus never happens in the frame being measured. The frame thread
+     * only waits for the writer if it falls a whole batch behind.
+     */
+    struct Capture
+    {
+        FILE*                                   m_File;
+        CaptureFormat                           m_Format;
+        CaptureBatch                            m_Batches[2];
+        // Filled by the thread calling Begin()
+        CaptureBatch*                           m_Staging;
+        uint64_t                                m_StartTicks;
+        uint32_t                                m_FramesLeft;
+
+        dmThread::Thread                        m_Thread;
+        dmMutex::HMutex                         m_Mutex;
+        dmConditionVariable::HConditionVariable m_Condition;
+        // Batch being written, 0 when the writer is idle. Protected by m_Mutex
+        CaptureBatch*                           m_Pending;
+        bool                                    m_Quit;
+
+        // Only used by the writer, or by the thread calling Begin() when there is no writer thread
+        dmHashTable32<uint8_t>                  m_WrittenStrings;
+        uint64_t                                m_WrittenThreads;
+        uint32_t                                m_FramesWritten;
+        bool                                    m_FirstEvent;
+    };
+
+    Capture g_Capture;
+
+    static void CaptureProfile(Profile* profile);
 
     struct InitSpinLocks
     {
@@ -96,6 +282,115 @@ namespace dmProfile
 
     InitSpinLocks g_InitSpinlocks;
 
+    static inline int32_t AtomicLoad32(int32_atomic_t* ptr)
+    {
+        return dmAtomicAdd32(ptr, 0);
+    }
+
+    static uint32_t RoundUpPowerOfTwo(uint32_t n)
+    {
+        uint32_t p = 1;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+
+    static void NewNameTable(NameTable* table, uint32_t max_entries)
+    {
+        uint32_t size = RoundUpPowerOfTwo(dmMath::Max(16U, max_entries * 2));
+        table->m_Keys = (int32_atomic_t*) malloc(sizeof(int32_atomic_t) * size);
+        table->m_Values = (int32_atomic_t*) malloc(sizeof(int32_atomic_t) * size);
+        memset((void*) table->m_Keys, 0, sizeof(int32_atomic_t) * size);
+        memset((void*) table->m_Values, 0, sizeof(int32_atomic_t) * size);
+        table->m_Mask = size - 1;
+    }
+
+    static void DeleteNameTable(NameTable* table)
+    {
+        free((void*) table->m_Keys);
+        free((void*) table->m_Values);
+        memset(table, 0, sizeof(*table));
+    }
+
+    /*
+     * Returns the index registered for name_hash, registering a new entry with init_entry if needed.
+     * Returns INVALID_INDEX if the table has no room for the entry.
+     */
+    static uint32_t GetOrRegisterName(NameTable* table, int32_atomic_t* count, uint32_t max_count, uint32_t name_hash,
+                                      const char* name, void (*init_entry)(uint32_t index, const char* name, uint32_t name_hash))
+    {
+        if (table->m_Keys == 0)
+            return INVALID_INDEX;
+
+        // Zero marks an empty slot
+        int32_t key = (int32_t)(name_hash ? name_hash : 1);
+        uint32_t slot = name_hash & table->m_Mask;
+        for (uint32_t probe = 0; probe <= table->m_Mask; ++probe, slot = (slot + 1) & table->m_Mask)
+        {
+            int32_t slot_key = table->m_Keys[slot];
+            if (slot_key == 0)
+            {
+                slot_key = dmAtomicCompareStore32(&table->m_Keys[slot], key, 0);
+                if (slot_key == 0)
+                {
+                    uint32_t index = (uint32_t) dmAtomicIncrement32(count);
+                    if (index >= max_count)
+                    {
+                        dmAtomicStore32(&table->m_Values[slot], -1);
+                        return INVALID_INDEX;
+                    }
+                    init_entry(index, name, name_hash);
+                    dmAtomicStore32(&table->m_Values[slot], (int32_t)(index + 1));
+                    return index;
+                }
+            }
+
+            if (slot_key == key)
+            {
+                // Another thread may be filling in the entry
+                int32_t value;
+                while ((value = AtomicLoad32(&table->m_Values[slot])) == 0)
+                {
+                }
+                return value < 0 ? INVALID_INDEX : (uint32_t)(value - 1);
+            }
+        }
+        return INVALID_INDEX;
+    }
+
+    static uint32_t GetScopeCount()
+    {
+        return dmMath::Min((uint32_t) AtomicLoad32(&g_ScopeCount), g_Scopes.Capacity());
+    }
+
+    static uint32_t GetCounterCount()
+    {
+        return dmMath::Min((uint32_t) AtomicLoad32(&g_CounterCount), g_Counters.Capacity());
+    }
+
+    static uint32_t GetThreadSampleLimit()
+    {
+        return dmMath::Max(g_MaxSamples / THREAD_SAMPLES_BUDGET_FRACTION, dmMath::Min(g_MaxSamples, MIN_THREAD_SAMPLES));
+    }
+
+    static void FreeThreadSamples(ThreadBuffer* buffer)
+    {
+        free(buffer->m_Samples);
+        buffer->m_Samples = 0;
+        buffer->m_Limit = 0;
+    }
+
+    static void AllocateThreadSamples(ThreadBuffer* buffer)
+    {
+        FreeThreadSamples(buffer);
+        buffer->m_Limit = GetThreadSampleLimit();
+        buffer->m_Mask = RoundUpPowerOfTwo(dmMath::Max(1U, buffer->m_Limit)) - 1;
+        buffer->m_Samples = (ThreadSample*) malloc(sizeof(ThreadSample) * (buffer->m_Mask + 1));
+        dmAtomicStore32(&buffer->m_Write, 0);
+        dmAtomicStore32(&buffer->m_Read, 0);
+        dmAtomicStore32(&buffer->m_Overflow, 0);
+    }
+
     void Initialize(uint32_t max_scopes, uint32_t max_samples, uint32_t max_counters)
     {
         if (!dLib::IsDebugMode())
@@ -109,6 +404,9 @@ namespace dmProfile
         }
 
         g_StringTable.SetCapacity(1024, 1536); // Rather arbitrary...
+        // Could be set if Initialize is called again without Finalize
+        if (g_StringPool != 0)
+            dmStringPool::Delete(g_StringPool);
         g_StringPool = dmStringPool::New();
 
         if (g_Scopes.Capacity() == 0)
@@ -116,7 +414,9 @@ namespace dmProfile
             // Only allocate first time and leave already allocated scopes as is
             // Scopes are static variables in functions
             g_Scopes.SetCapacity(max_scopes);
-            g_Scopes.SetSize(0);
+            g_Scopes.SetSize(max_scopes);
+            memset(g_Scopes.Begin(), 0, sizeof(Scope) * max_scopes);
+            NewNameTable(&g_ScopeTable, max_scopes);
         }
 
         g_FreeProfiles.SetCapacity(PROFILE_BUFFER_COUNT);
@@ -135,6 +435,7 @@ namespace dmProfile
             p->m_ScopesData.SetCapacity(max_scopes);
             p->m_ScopesData.SetSize(max_scopes);
 
+            p->m_BeginTicks = 0;
             p->m_ScopeCount = 0;
             p->m_CounterCount = 0;
 
@@ -144,28 +445,34 @@ namespace dmProfile
         g_ActiveProfile = g_FreeProfiles[0];
         g_FreeProfiles.EraseSwap(0);
 
-        /*
-          Set up initial scope-data for the active profile as scope-data
-          is used in CalculateScopeProfile before initial profile swap is performed.
-          We now keep scopes over Initialize and Finalize.
-          Before that change all scopes where reallocated and the scope-data
-          was initialized at scope-allocation, see AllocateScope
-         */
-        uint32_t n = g_Scopes.Size();
-        for (uint32_t i = 0; i < n; ++i)
+        g_Counters.SetCapacity(max_counters);
+        g_Counters.SetSize(max_counters);
+        memset(g_Counters.Begin(), 0, sizeof(Counter) * max_counters);
+        free((void*) g_CounterValues);
+        g_CounterValues = (int32_atomic_t*) malloc(sizeof(int32_atomic_t) * dmMath::Max(1U, max_counters));
+        memset((void*) g_CounterValues, 0, sizeof(int32_atomic_t) * dmMath::Max(1U, max_counters));
+        dmAtomicStore32(&g_CounterCount, 0);
+        DeleteNameTable(&g_CounterTable);
+        NewNameTable(&g_CounterTable, max_counters);
+
+        // Running threads that have recorded samples before keep their buffer slot. Slots of threads
+        // that have exited are freed, their buffers are allocated again by the next thread taking them.
+        g_MaxSamples = max_samples;
+        uint32_t thread_count = dmMath::Min((uint32_t) AtomicLoad32(&g_ThreadCount), MAX_THREAD_COUNT);
+        for (uint32_t i = 0; i < thread_count; ++i)
         {
-            ScopeData* scope_data = &g_ActiveProfile->m_ScopesData[i];
-            scope_data->m_Elapsed = 0;
-            scope_data->m_Count = 0;
-            g_ActiveProfile->m_ScopesData[i].m_Scope = &g_Scopes[i];
+            ThreadBuffer* buffer = &g_ThreadBuffers[i];
+            if (AtomicLoad32(&buffer->m_State) == THREAD_BUFFER_ACTIVE)
+            {
+                AllocateThreadSamples(buffer);
+            }
+            else
+            {
+                FreeThreadSamples(buffer);
+                dmAtomicStore32(&buffer->m_State, THREAD_BUFFER_FREE);
+            }
         }
 
-        g_CountersTable.SetCapacity(dmMath::Max(16U, 2 * max_counters / 3), max_counters);
-        g_CountersTable.Clear();
-
-        g_Counters.SetCapacity(max_counters);
-        g_Counters.SetSize(0);
-
 #if defined(_WIN32)
         QueryPerformanceFrequency((LARGE_INTEGER*)&g_TicksPerSecond);
 #elif defined(__APPLE__)
@@ -178,7 +485,8 @@ namespace dmProfile
         // Set g_BeginTime even if we haven't started since threads may calculate scopes outside of
         // engine Begin()/End() of profiles which happens in Engine::Step() - just so we don't get
         // totally crazy numbers if this happens
-        g_BeginTime = GetNowTicks();
+        g_ActiveProfile->m_BeginTicks = GetNowTicks();
+        g_BeginTime = (uint32_t)g_ActiveProfile->m_BeginTicks;
         g_IsInitialized = true;
     }
 
@@ -188,6 +496,10 @@ namespace dmProfile
         // Might be dangerous as we have static references to Scope* in functions due to DM_PROFILE
         // See Initialize. It's not even valid to change the number of scopes
 
+        StopCapture();
+
+        g_IsInitialized = false;
+
         for (uint32_t i = 0; i < PROFILE_BUFFER_COUNT; ++i)
         {
             Profile* p = &g_AllProfiles[i];
@@ -196,8 +508,16 @@ namespace dmProfile
             p->m_CountersData.SetCapacity(0);
         }
 
-        g_CountersTable.Clear();
+        uint32_t thread_count = dmMath::Min((uint32_t) AtomicLoad32(&g_ThreadCount), MAX_THREAD_COUNT);
+        for (uint32_t i = 0; i < thread_count; ++i)
+        {
+            FreeThreadSamples(&g_ThreadBuffers[i]);
+        }
+
         g_Counters.SetCapacity(0);
+        free((void*) g_CounterValues);
+        g_CounterValues = 0;
+        DeleteNameTable(&g_CounterTable);
 
         g_ActiveProfile = &g_EmptyProfile;
 
@@ -205,12 +525,94 @@ namespace dmProfile
         if (g_StringPool != 0)
             dmStringPool::Delete(g_StringPool);
         g_StringPool = 0;
-        g_IsInitialized = false;
+    }
+
+    /*
+     * Moves the samples recorded by a thread since the last call into the profile.
+     * Samples still running are reported with the time elapsed so far.
+     */
+    static void MergeThreadSamples(Profile* profile, ThreadBuffer* buffer, uint16_t thread_id, uint64_t end_ticks)
+    {
+        if (buffer->m_Samples == 0)
+            return;
+
+        const uint32_t write_end = (uint32_t) AtomicLoad32(&buffer->m_Write);
+        uint32_t write = write_end;
+        uint32_t read = (uint32_t) buffer->m_Read;
+
+        if (dmAtomicStore32(&buffer->m_Overflow, 0))
+        {
+            g_OutOfSamples = true;
+        }
+
+        uint32_t available = profile->m_Samples.Remaining();
+        if (write - read > available)
+        {
+            g_OutOfSamples = true;
+            write = read + available;
+        }
+
+        for (uint32_t i = read; i != write; ++i)
+        {
+            const ThreadSample* thread_sample = &buffer->m_Samples[i & buffer->m_Mask];
+            int32_t elapsed = thread_sample->m_Elapsed;
+            uint64_t start = dmMath::Max(thread_sample->m_StartTicks, profile->m_BeginTicks);
+
+            profile->m_Samples.SetSize(profile->m_Samples.Size() + 1);
+            Sample* sample = profile->m_Samples.End() - 1;
+            sample->m_Name = thread_sample->m_Name;
+            sample->m_Scope = thread_sample->m_Scope;
+            sample->m_NameHash = thread_sample->m_NameHash;
+            sample->m_Start = (uint32_t)(start - profile->m_BeginTicks);
+            sample->m_Elapsed = elapsed == ELAPSED_OPEN ? (uint32_t)(end_ticks - start) : (uint32_t)elapsed;
+            sample->m_ThreadId = thread_id;
+            sample->m_Pad = 0;
+        }
+
+        // Consume the whole range, samples that did not fit are dropped
+        dmAtomicStore32(&buffer->m_Read, (int32_t) write_end);
+    }
+
+    // Closes the frame recorded into the profile: merges the thread buffers and collects the counters
+    static void CloseProfile(Profile* profile, uint64_t end_ticks)
+    {
+        profile->m_Samples.SetSize(0);
+        uint32_t thread_count = dmMath::Min((uint32_t) AtomicLoad32(&g_ThreadCount), MAX_THREAD_COUNT);
+        for (uint32_t i = 0; i < thread_count; ++i)
+        {
+            ThreadBuffer* buffer = &g_ThreadBuffers[i];
+            // Read before merging, a thread releasing the slot during the merge is freed the next frame
+            bool released = AtomicLoad32(&buffer->m_State) == THREAD_BUFFER_RELEASED;
+            MergeThreadSamples(profile, buffer, (uint16_t) i, end_ticks);
+            if (released)
+            {
+                dmAtomicStore32(&buffer->m_State, THREAD_BUFFER_FREE);
+            }
+        }
+
+        uint32_t n = GetScopeCount();
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            ScopeData* scope_data = &profile->m_ScopesData[i];
+            scope_data->m_Scope = &g_Scopes[i];
+            scope_data->m_Elapsed = 0;
+            scope_data->m_Count = 0;
+        }
+        profile->m_ScopeCount = n;
+
+        n = dmMath::Min(GetCounterCount(), profile->m_CountersData.Size());
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            CounterData* counter_data = &profile->m_CountersData[i];
+            counter_data->m_Counter = &g_Counters[i];
+            counter_data->m_Value = dmAtomicStore32(&g_CounterValues[i], 0);
+        }
+        profile->m_CounterCount = n;
     }
 
     static void CalculateScopeProfileThread(Profile* profile, const uint32_t* key, uint8_t* value)
     {
-        const uint32_t n_scopes = g_Scopes.Size();
+        const uint32_t n_scopes = profile->m_ScopeCount;
         const uint32_t n_samples = profile->m_Samples.Size();
         const uint32_t thread_id = *key;
 
@@ -219,8 +621,6 @@ namespace dmProfile
             g_Scopes[i].m_Internal = 0;
         }
 
-        g_DummyScope.m_Internal = 0;
-
         for (uint32_t i = 0; i < n_samples; ++i)
         {
             Sample* sample = &profile->m_Samples[i];
@@ -291,11 +691,11 @@ namespace dmProfile
         // Frame-time is defined as the maximum scope in frame 0, ie main frame
         if (thread_id == 0)
         {
-            if (g_Scopes.Size() > 0)
+            if (n_scopes > 0)
             {
                 float millisPerTick = (float)(1000.0 / g_TicksPerSecond);
                 g_FrameTime = profile->m_ScopesData[0].m_Elapsed * millisPerTick;
-                for (uint32_t i = 1; i < g_Scopes.Size(); ++i)
+                for (uint32_t i = 1; i < n_scopes; ++i)
                 {
                     float time = profile->m_ScopesData[i].m_Elapsed * millisPerTick;
                     g_FrameTime = dmMath::Select(g_FrameTime - time, g_FrameTime, time);
@@ -351,11 +751,15 @@ namespace dmProfile
 
         dmSpinlock::Lock(&g_ProfileLock);
 
-        CalculateScopeProfile(g_ActiveProfile);
+        g_OutOfScopes = false;
+        g_OutOfSamples = false;
+        g_OutOfCounters = false;
 
+        // Close the active frame. Samples recorded from here on go to the next frame.
+        uint64_t now = GetNowTicks();
         Profile* ret = g_ActiveProfile;
-        ret->m_ScopeCount = g_Scopes.Size();
-        ret->m_CounterCount = g_Counters.Size();
+        CloseProfile(ret, now);
+        CalculateScopeProfile(ret);
 
         int wait_count = 0;
         while (g_FreeProfiles.Size() == 0)
@@ -374,33 +778,18 @@ namespace dmProfile
 
         Profile* profile = g_FreeProfiles[0];
         g_FreeProfiles.EraseSwap(0);
+        profile->m_Samples.SetSize(0);
+        profile->m_BeginTicks = now;
+        g_BeginTime = (uint32_t)now;
         g_ActiveProfile = profile;
 
-        uint32_t n = g_Scopes.Size();
-        for (uint32_t i = 0; i < n; ++i)
-        {
-            ScopeData* scope_data = &profile->m_ScopesData[i];
-            scope_data->m_Elapsed = 0;
-            scope_data->m_Count = 0;
-            profile->m_ScopesData[i].m_Scope = &g_Scopes[i];
-        }
+        dmSpinlock::Unlock(&g_ProfileLock);
 
-        n = g_Counters.Size();
-        for (uint32_t i = 0; i < n; ++i)
+        // The returned profile is no longer written to, so it can be captured outside the lock
+        if (g_Capture.m_File)
         {
-            profile->m_CountersData[i].m_Counter = &g_Counters[i];
-            profile->m_CountersData[i].m_Value = 0;
+            CaptureProfile(ret);
         }
-
-        profile->m_Samples.SetSize(0);
-
-        g_BeginTime = GetNowTicks();
-
-        g_OutOfScopes = false;
-        g_OutOfSamples = false;
-        g_OutOfCounters = false;
-
-        dmSpinlock::Unlock(&g_ProfileLock);
         return ret;
     }
 
@@ -423,91 +812,86 @@ namespace dmProfile
         g_FreeProfiles.Push(profile);
     }
 
+
+    static void InitScope(uint32_t index, const char* name, uint32_t name_hash)
+    {
+        Scope* s = &g_Scopes[index];
+        s->m_NameHash = name_hash;
+        s->m_Index = index;
+        s->m_Internal = 0;
+        s->m_Name = name;
+    }
+
     uint32_t AllocateScope(const char* name)
     {
-        DM_SPINLOCK_SCOPED_LOCK(g_ProfileLock)
-        if (g_Scopes.Full())
+        uint32_t name_hash = GetNameHash(name, (uint32_t)strlen(name));
+        uint32_t index = GetOrRegisterName(&g_ScopeTable, &g_ScopeCount, g_Scopes.Capacity(), name_hash, name, InitScope);
+        if (index == INVALID_INDEX)
         {
             g_OutOfScopes = true;
-            return 0xffffffffu;
-        }
-        else
-        {
-            // NOTE: Not optimal with O(n) but scopes are allocated only once
-            uint32_t n         = g_Scopes.Size();
-            uint32_t name_hash = GetNameHash(name, (uint32_t)strlen(name));
-            for (uint32_t i = 0; i < n; ++i)
-            {
-                if (g_Scopes[i].m_NameHash == name_hash)
-                {
-                    return i;
-                }
-            }
-
-            uint32_t i = g_Scopes.Size();
-            g_Scopes.SetSize(i + 1);
-            Scope* s = &g_Scopes[i];
-            ScopeData* sd = &g_ActiveProfile->m_ScopesData[i];
-            sd->m_Scope = s;
-            sd->m_Elapsed = 0;
-            sd->m_Count = 0;
-            s->m_Name = name;
-            s->m_NameHash = name_hash;
-            s->m_Index = i;
-            return i;
         }
+        return index;
     }
 
-    // Used when out of samples in order to remove conditional branches
-    Sample g_DummySample = { "OUT_OF_SAMPLES", 0, 0, 0, 0 };
+    static void GetCurrentThreadName(char* buffer, uint32_t buffer_size)
+    {
+        buffer[0] = 0;
+#if (defined(__linux__) && !defined(__ANDROID__)) || defined(__MACH__)
+        pthread_getname_np(pthread_self(), buffer, buffer_size);
+#endif
+    }
 
-    static Sample* AllocateNewSample()
+    // Takes a free buffer slot for the calling thread
+    static void* AcquireThreadBuffer()
     {
-        // NOTE: We can't take the spinlock if paused
-        // as it might already been taken in dmProfile:Begin()
-        // A deadlock case occur in dmMessage::Post if http-server is logging
-        // TODO: Use mutex instead?
-        if (g_Paused)
+        for (uint32_t i = 0; i < MAX_THREAD_COUNT; ++i)
         {
-            return &g_DummySample;
-        }
+            ThreadBuffer* buffer = &g_ThreadBuffers[i];
+            if (AtomicLoad32(&buffer->m_State) != THREAD_BUFFER_FREE ||
+                dmAtomicCompareStore32(&buffer->m_State, THREAD_BUFFER_ACTIVE, THREAD_BUFFER_FREE) != THREAD_BUFFER_FREE)
+            {
+                continue;
+            }
 
-        DM_SPINLOCK_SCOPED_LOCK(g_ProfileLock)
-        Profile* profile = g_ActiveProfile;
+            int32_t count;
+            while ((count = AtomicLoad32(&g_ThreadCount)) <= (int32_t) i)
+            {
+                dmAtomicCompareStore32(&g_ThreadCount, (int32_t)(i + 1), count);
+            }
 
-        bool full = profile->m_Samples.Full();
-        if (full)
-        {
-            g_OutOfSamples = true;
-            return &g_DummySample;
+            GetCurrentThreadName(g_ThreadNames[i], MAX_THREAD_NAME_LENGTH);
+            // The previous owner's samples are merged before the slot is freed
+            if (buffer->m_Samples == 0 || buffer->m_Limit != GetThreadSampleLimit())
+            {
+                AllocateThreadSamples(buffer);
+            }
+            // NOTE: We store thread_id + 1. Otherwise we can't differentiate between thread-id 0 and not initialized
+            return (void*)((uintptr_t)(i + 1));
         }
-        profile->m_Samples.SetSize(profile->m_Samples.Size() + 1);
-        Sample* ret = profile->m_Samples.End() - 1;
-        return ret;
+        return NO_THREAD_BUFFER;
     }
 
-    Sample* AllocateSample()
+    static void ReleaseThreadBuffer(void* tls_data)
     {
-        Sample* ret = AllocateNewSample();
-        if (ret == &g_DummySample)
-        {
-            return ret;
-        }
+        if (tls_data == NO_THREAD_BUFFER)
+            return;
+        ThreadBuffer* buffer = &g_ThreadBuffers[(uintptr_t)tls_data - 1];
+        dmAtomicStore32(&buffer->m_State, THREAD_BUFFER_RELEASED);
+    }
 
-        void* tls_data = dmThread::GetTlsValue(g_TlsKey);
+    static ThreadBuffer* GetThreadBuffer()
+    {
+        void* tls_data = GetThreadKeyValue(g_ThreadKey);
         if (tls_data == 0)
         {
-            // NOTE: We store thread_id + 1. Otherwise we can't differentiate between thread-id 0 and not initialized
-            int32_t next_thread_id = dmAtomicIncrement32(&g_ThreadCount) + 1;
-            void* thread_id = (void*)((uintptr_t)next_thread_id);
-            dmThread::SetTlsValue(g_TlsKey, thread_id);
-            tls_data = thread_id;
+            tls_data = AcquireThreadBuffer();
+            SetThreadKeyValue(g_ThreadKey, tls_data);
         }
-        intptr_t thread_id = ((intptr_t)tls_data) - 1;
-        assert(thread_id >= 0);
-
-        ret->m_ThreadId = thread_id;
-        return ret;
+        if (tls_data == NO_THREAD_BUFFER)
+        {
+            return 0;
+        }
+        return &g_ThreadBuffers[(uintptr_t)tls_data - 1];
     }
 
     const char* Internalize(const char* string, uint32_t string_length, uint32_t string_hash)
@@ -529,102 +913,49 @@ namespace dmProfile
         return dmHashBufferNoReverse32(name, string_length);
     }
 
-    void AddCounter(const char* name, uint32_t amount)
+    static void InitCounter(uint32_t index, const char* name, uint32_t name_hash)
     {
-        // dmProfile::Initialize allocates memory. If memprofile is activated this function is called from overloaded malloc while g_CountersTable is being created. No good!
-        if (!g_IsInitialized)
-        {
-            return;
-        }
-
-        if (g_Paused)
-            return;
-
-        uint32_t name_hash = GetNameHash(name, (uint32_t)strlen(name));
-
-        DM_SPINLOCK_SCOPED_LOCK(g_ProfileLock)
-        Profile* profile = g_ActiveProfile;
-
-        uint32_t* counter_index = g_CountersTable.Get(name_hash);
-        if (counter_index)
-        {
-            profile->m_CountersData[*counter_index].m_Value += amount;
-            return;
-        }
-
-        if (g_Counters.Full())
-        {
-            g_OutOfCounters = true;
-            return;
-        }
-
-        uint32_t new_index = g_Counters.Size();
-        g_Counters.SetSize(new_index + 1);
-
-        Counter* c = &g_Counters[new_index];
-        c->m_Name = name;
+        Counter* c = &g_Counters[index];
         c->m_NameHash = name_hash;
-
-        CounterData* cd = &profile->m_CountersData[new_index];
-        cd->m_Counter = c;
-        cd->m_Value = 0;
-
-        g_CountersTable.Put(c->m_NameHash, new_index);
-
-        profile->m_CountersData[new_index].m_Value += amount;
+        c->m_Name = name;
     }
 
     uint32_t AllocateCounter(const char* name)
     {
+        // dmProfile::Initialize allocates memory. If memprofile is activated this function is called from overloaded malloc while the counter table is being created. No good!
         if (!g_IsInitialized)
         {
-            return 0xffffffffu;
+            return INVALID_INDEX;
         }
 
         uint32_t name_hash = GetNameHash(name, (uint32_t)strlen(name));
-
-        DM_SPINLOCK_SCOPED_LOCK(g_ProfileLock)
-        uint32_t* counter_index = g_CountersTable.Get(name_hash);
-        if (counter_index)
-        {
-            return *counter_index;
-        }
-        if (g_Counters.Full())
+        uint32_t index = GetOrRegisterName(&g_CounterTable, &g_CounterCount, g_Counters.Capacity(), name_hash, name, InitCounter);
+        if (index == INVALID_INDEX)
         {
             g_OutOfCounters = true;
-            return 0xffffffffu;
         }
+        return index;
+    }
 
-        uint32_t new_index = g_Counters.Size();
-        g_Counters.SetSize(new_index + 1);
-
-        Counter* c = &g_Counters[new_index];
-        c->m_Name = name;
-        c->m_NameHash = name_hash;
-
-        Profile* profile = g_ActiveProfile;
-        CounterData* cd = &profile->m_CountersData[new_index];
-        cd->m_Counter = c;
-        cd->m_Value = 0;
-
-        g_CountersTable.Put(c->m_NameHash, new_index);
+    void AddCounter(const char* name, uint32_t amount)
+    {
+        if (g_Paused)
+            return;
 
-        return new_index;
+        AddCounterIndex(AllocateCounter(name), amount);
     }
 
     void AddCounterIndex(uint32_t counter_index, uint32_t amount)
     {
-        if (g_Paused)
+        if (g_Paused || !g_IsInitialized)
             return;
 
-        if (counter_index == 0xffffffffu)
+        if (counter_index == INVALID_INDEX || counter_index >= g_Counters.Capacity())
         {
             return;
         }
 
-        DM_SPINLOCK_SCOPED_LOCK(g_ProfileLock)
-        Profile* profile = g_ActiveProfile;
-        profile->m_CountersData[counter_index].m_Value += amount;
+        dmAtomicAdd32(&g_CounterValues[counter_index], (int32_t)amount);
     }
 
     float GetFrameTime()
@@ -659,11 +990,13 @@ namespace dmProfile
 
     void IterateScopes(HProfile profile, void* context, void (*call_back)(void* context, const Scope* scope_data))
     {
-        uint32_t n = g_Scopes.Size();
+        // Scopes being registered by another thread have no name yet
+        uint32_t n = GetScopeCount();
         for (uint32_t i = 0; i < n; ++i)
         {
             Scope* scope = &g_Scopes[i];
-            call_back(context, scope);
+            if (scope->m_Name)
+                call_back(context, scope);
         }
     }
 
@@ -689,7 +1022,8 @@ namespace dmProfile
         {
             for (uint32_t i = 0; i < n; ++i)
             {
-                call_back(context, &profile->m_ScopesData[i]);
+                if (profile->m_ScopesData[i].m_Scope->m_Name)
+                    call_back(context, &profile->m_ScopesData[i]);
             }
             return;
         }
@@ -703,7 +1037,9 @@ namespace dmProfile
 
         for (uint32_t i = 0; i < n; ++i)
         {
-            call_back(context, &profile->m_ScopesData[sorted_scopes[i]]);
+            const ScopeData* scope_data = &profile->m_ScopesData[sorted_scopes[i]];
+            if (scope_data->m_Scope->m_Name)
+                call_back(context, scope_data);
         }
     }
 
@@ -760,11 +1096,12 @@ namespace dmProfile
 
     void IterateCounters(HProfile profile, void* context, void (*call_back)(void* context, const Counter* counter))
     {
-        uint32_t n = g_Counters.Size();
+        uint32_t n = GetCounterCount();
         for (uint32_t i = 0; i < n; ++i)
         {
             Counter* counter = &g_Counters[i];
-            call_back(context, counter);
+            if (counter->m_Name)
+                call_back(context, counter);
         }
     }
 
@@ -773,8 +1110,409 @@ namespace dmProfile
         uint32_t n = profile->m_CounterCount;
         for (uint32_t i = 0; i < n; ++i)
         {
-            call_back(context, &profile->m_CountersData[i]);
+            if (profile->m_CountersData[i].m_Counter->m_Name)
+                call_back(context, &profile->m_CountersData[i]);
+        }
+    }
+
+    /*
+     * Binary capture layout. Values are in host byte order, i.e. little endian on all supported platforms.
+     *
+     *   header:  char[4] "DMPC", uint32 version, uint64 ticks per second
+     *   records: uint8 type followed by
+     *     CAPTURE_RECORD_STRING: uint32 hash, uint16 length, char[length]
+     *     CAPTURE_RECORD_THREAD: uint16 thread id, uint16 length, char[length]
+     *     CAPTURE_RECORD_FRAME:  uint64 begin ticks, uint32 sample count, uint32 counter count,
+     *                            sample count * { uint32 scope hash, uint32 name hash, uint32 start, uint32 elapsed, uint16 thread id }
+     *                            counter count * { uint32 name hash, uint32 value }
+     *
+     * Strings and thread names are written before the first frame that references them.
+     * Sample start is in ticks relative to the frame begin ticks.
+     */
+    static const char     CAPTURE_MAGIC[4] = { 'D', 'M', 'P', 'C' };
+    static const uint32_t CAPTURE_VERSION = 1;
+
+    enum CaptureRecord
+    {
+        CAPTURE_RECORD_STRING = 1,
+        CAPTURE_RECORD_THREAD = 2,
+        CAPTURE_RECORD_FRAME  = 3,
+    };
+
+    static const char* GetThreadName(uint32_t thread_id, char* buffer, uint32_t buffer_size)
+    {
+        if (thread_id < MAX_THREAD_COUNT && g_ThreadNames[thread_id][0] != 0)
+        {
+            return g_ThreadNames[thread_id];
+        }
+        dmSnPrintf(buffer, buffer_size, "Thread %u", thread_id);
+        return buffer;
+    }
+
+    // Returns true the first time a thread is seen in the capture
+    static bool MarkThreadWritten(Capture* capture, uint32_t thread_id)
+    {
+        if (thread_id >= MAX_THREAD_COUNT)
+            return false;
+        uint64_t bit = 1ull << thread_id;
+        if (capture->m_WrittenThreads & bit)
+            return false;
+        capture->m_WrittenThreads |= bit;
+        return true;
+    }
+
+    // Returns true the first time a string is seen in the capture. If the table is full, strings are repeated.
+    static bool MarkStringWritten(Capture* capture, uint32_t hash)
+    {
+        if (capture->m_WrittenStrings.Get(hash))
+            return false;
+        if (!capture->m_WrittenStrings.Full())
+            capture->m_WrittenStrings.Put(hash, 1);
+        return true;
+    }
+
+    static void WriteJsonString(FILE* file, const char* string)
+    {
+        fputc('"', file);
+        for (const char* c = string; *c; ++c)
+        {
+            if (*c == '"' || *c == '\\')
+            {
+                fputc('\\', file);
+                fputc(*c, file);
+            }
+            else if ((unsigned char)*c < 0x20)
+            {
+                fprintf(file, "\\u%04x", (unsigned char)*c);
+            }
+            else
+            {
+                fputc(*c, file);
+            }
+        }
+        fputc('"', file);
+    }
+
+    static void WriteChromeEventSeparator(Capture* capture)
+    {
+        if (!capture->m_FirstEvent)
+            fputs(",\n", capture->m_File);
+        capture->m_FirstEvent = false;
+    }
+
+    static void WriteChromeFrame(Capture* capture, CaptureBatch* batch, const CaptureFrame* frame)
+    {
+        FILE* file = capture->m_File;
+        const double us_per_tick = 1000000.0 / g_TicksPerSecond;
+        const uint64_t frame_offset = frame->m_BeginTicks - capture->m_StartTicks;
+        char name_buffer[MAX_THREAD_NAME_LENGTH];
+
+        const Sample* samples = batch->m_Samples.Begin() + frame->m_SampleStart;
+        for (uint32_t i = 0; i < frame->m_SampleCount; ++i)
+        {
+            const Sample* sample = &samples[i];
+            if (MarkThreadWritten(capture, sample->m_ThreadId))
+            {
+                WriteChromeEventSeparator(capture);
+                fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", sample->m_ThreadId);
+                WriteJsonString(file, GetThreadName(sample->m_ThreadId, name_buffer, sizeof(name_buffer)));
+                fputs("}}", file);
+            }
+
+            WriteChromeEventSeparator(capture);
+            fputs("{\"name\":", file);
+            WriteJsonString(file, sample->m_Name);
+            fputs(",\"cat\":", file);
+            WriteJsonString(file, sample->m_Scope->m_Name);
+            fprintf(file, ",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    sample->m_ThreadId, (frame_offset + sample->m_Start) * us_per_tick, sample->m_Elapsed * us_per_tick);
+        }
+
+        const CounterData* counters = batch->m_Counters.Begin() + frame->m_CounterStart;
+        for (uint32_t i = 0; i < frame->m_CounterCount; ++i)
+        {
+            WriteChromeEventSeparator(capture);
+            fputs("{\"name\":", file);
+            WriteJsonString(file, counters[i].m_Counter->m_Name);
+            fprintf(file, ",\"ph\":\"C\",\"pid\":0,\"ts\":%.3f,\"args\":{\"value\":%u}}", frame_offset * us_per_tick, (uint32_t)counters[i].m_Value);
+        }
+    }
+
+    static void WriteBinaryString(Capture* capture, uint32_t hash, const char* string)
+    {
+        if (!MarkStringWritten(capture, hash))
+            return;
+        uint8_t type = CAPTURE_RECORD_STRING;
+        uint16_t length = (uint16_t)dmMath::Min(strlen(string), (size_t)0xffff);
+        fwrite(&type, sizeof(type), 1, capture->m_File);
+        fwrite(&hash, sizeof(hash), 1, capture->m_File);
+        fwrite(&length, sizeof(length), 1, capture->m_File);
+        fwrite(string, 1, length, capture->m_File);
+    }
+
+    static void WriteBinaryFrame(Capture* capture, CaptureBatch* batch, const CaptureFrame* frame)
+    {
+        FILE* file = capture->m_File;
+        const Sample* samples = batch->m_Samples.Begin() + frame->m_SampleStart;
+        const CounterData* counters = batch->m_Counters.Begin() + frame->m_CounterStart;
+        char name_buffer[MAX_THREAD_NAME_LENGTH];
+
+        for (uint32_t i = 0; i < frame->m_SampleCount; ++i)
+        {
+            const Sample* sample = &samples[i];
+            WriteBinaryString(capture, sample->m_Scope->m_NameHash, sample->m_Scope->m_Name);
+            WriteBinaryString(capture, sample->m_NameHash, sample->m_Name);
+            if (MarkThreadWritten(capture, sample->m_ThreadId))
+            {
+                const char* name = GetThreadName(sample->m_ThreadId, name_buffer, sizeof(name_buffer));
+                uint8_t type = CAPTURE_RECORD_THREAD;
+                uint16_t length = (uint16_t)strlen(name);
+                fwrite(&type, sizeof(type), 1, file);
+                fwrite(&sample->m_ThreadId, sizeof(sample->m_ThreadId), 1, file);
+                fwrite(&length, sizeof(length), 1, file);
+                fwrite(name, 1, length, file);
+            }
+        }
+        for (uint32_t i = 0; i < frame->m_CounterCount; ++i)
+        {
+            WriteBinaryString(capture, counters[i].m_Counter->m_NameHash, counters[i].m_Counter->m_Name);
+        }
+
+        uint8_t type = CAPTURE_RECORD_FRAME;
+        fwrite(&type, sizeof(type), 1, file);
+        fwrite(&frame->m_BeginTicks, sizeof(frame->m_BeginTicks), 1, file);
+        fwrite(&frame->m_SampleCount, sizeof(frame->m_SampleCount), 1, file);
+        fwrite(&frame->m_CounterCount, sizeof(frame->m_CounterCount), 1, file);
+
+        for (uint32_t i = 0; i < frame->m_SampleCount; ++i)
+        {
+            const Sample* sample = &samples[i];
+            uint8_t record[18];
+            memcpy(&record[0], &sample->m_Scope->m_NameHash, 4);
+            memcpy(&record[4], &sample->m_NameHash, 4);
+            memcpy(&record[8], &sample->m_Start, 4);
+            memcpy(&record[12], &sample->m_Elapsed, 4);
+            memcpy(&record[16], &sample->m_ThreadId, 2);
+            fwrite(record, sizeof(record), 1, file);
+        }
+        for (uint32_t i = 0; i < frame->m_CounterCount; ++i)
+        {
+            uint32_t record[2] = { counters[i].m_Counter->m_NameHash, (uint32_t)counters[i].m_Value };
+            fwrite(record, sizeof(record), 1, file);
+        }
+    }
+
+    // Writes the frames of the batch to file and empties it
+    static void WriteCaptureBatch(Capture* capture, CaptureBatch* batch)
+    {
+        uint32_t n = batch->m_Frames.Size();
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            if (capture->m_Format == CAPTURE_FORMAT_CHROME_TRACE)
+                WriteChromeFrame(capture, batch, &batch->m_Frames[i]);
+            else
+                WriteBinaryFrame(capture, batch, &batch->m_Frames[i]);
+        }
+        capture->m_FramesWritten += n;
+        batch->m_Frames.SetSize(0);
+        batch->m_Samples.SetSize(0);
+        batch->m_Counters.SetSize(0);
+    }
+
+    static void CaptureWriterThread(void* arg)
+    {
+        Capture* capture = (Capture*) arg;
+        dmMutex::Lock(capture->m_Mutex);
+        while (true)
+        {
+            while (capture->m_Pending == 0 && !capture->m_Quit)
+            {
+                dmConditionVariable::Wait(capture->m_Condition, capture->m_Mutex);
+            }
+            CaptureBatch* batch = capture->m_Pending;
+            if (batch == 0)
+            {
+                break;
+            }
+
+            dmMutex::Unlock(capture->m_Mutex);
+            WriteCaptureBatch(capture, batch);
+            dmMutex::Lock(capture->m_Mutex);
+
+            capture->m_Pending = 0;
+            dmConditionVariable::Broadcast(capture->m_Condition);
+        }
+        dmMutex::Unlock(capture->m_Mutex);
+    }
+
+    // Hands the staged frames over to the writer thread and continues staging into the other batch
+    static void SubmitCaptureBatch(Capture* capture)
+    {
+        CaptureBatch* batch = capture->m_Staging;
+        if (batch->m_Frames.Empty())
+            return;
+
+        if (!capture->m_Thread)
+        {
+            WriteCaptureBatch(capture, batch);
+            return;
+        }
+
+        dmMutex::Lock(capture->m_Mutex);
+        // The writer is done with the other batch once it is idle
+        while (capture->m_Pending != 0)
+        {
+            dmConditionVariable::Wait(capture->m_Condition, capture->m_Mutex);
         }
+        capture->m_Pending = batch;
+        dmConditionVariable::Broadcast(capture->m_Condition);
+        dmMutex::Unlock(capture->m_Mutex);
+
+        capture->m_Staging = batch == &capture->m_Batches[0] ? &capture->m_Batches[1] : &capture->m_Batches[0];
+    }
+
+    static void CaptureProfile(Profile* profile)
+    {
+        Capture* capture = &g_Capture;
+        uint32_t sample_count = profile->m_Samples.Size();
+        uint32_t counter_count = profile->m_CounterCount;
+
+        // A batch holds several frames worth of samples and counters, so a single frame always fits in an empty one
+        CaptureBatch* batch = capture->m_Staging;
+        if (batch->m_Frames.Full() || batch->m_Samples.Remaining() < sample_count || batch->m_Counters.Remaining() < counter_count)
+        {
+            SubmitCaptureBatch(capture);
+            batch = capture->m_Staging;
+        }
+
+        if (capture->m_StartTicks == 0)
+        {
+            capture->m_StartTicks = profile->m_BeginTicks;
+        }
+
+        CaptureFrame frame;
+        frame.m_BeginTicks = profile->m_BeginTicks;
+        frame.m_SampleStart = batch->m_Samples.Size();
+        frame.m_SampleCount = sample_count;
+        frame.m_CounterStart = batch->m_Counters.Size();
+        frame.m_CounterCount = counter_count;
+        batch->m_Samples.PushArray(profile->m_Samples.Begin(), sample_count);
+        batch->m_Counters.PushArray(profile->m_CountersData.Begin(), counter_count);
+        batch->m_Frames.Push(frame);
+
+        if (--capture->m_FramesLeft == 0)
+        {
+            StopCapture();
+        }
+    }
+
+    bool StartCapture(const char* path, CaptureFormat format, uint32_t frame_count)
+    {
+        if (!g_IsInitialized)
+        {
+            dmLogError("Unable to capture profile, dmProfile is not initialized");
+            return false;
+        }
+        if (frame_count == 0)
+        {
+            return false;
+        }
+
+        StopCapture();
+
+        Capture* capture = &g_Capture;
+        capture->m_File = fopen(path, "wb");
+        if (!capture->m_File)
+        {
+            dmLogError("Unable to open profile capture file '%s'", path);
+            return false;
+        }
+
+        capture->m_Format = format;
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            CaptureBatch* batch = &capture->m_Batches[i];
+            batch->m_Frames.SetCapacity(CAPTURE_BUFFER_FRAME_COUNT);
+            batch->m_Samples.SetCapacity(g_AllProfiles[0].m_Samples.Capacity() * CAPTURE_BUFFER_FRAME_COUNT);
+            batch->m_Counters.SetCapacity(g_AllProfiles[0].m_CountersData.Capacity() * CAPTURE_BUFFER_FRAME_COUNT);
+        }
+        capture->m_Staging = &capture->m_Batches[0];
+        capture->m_StartTicks = 0;
+        capture->m_WrittenThreads = 0;
+        capture->m_FramesLeft = frame_count;
+        capture->m_FramesWritten = 0;
+        capture->m_FirstEvent = true;
+        capture->m_Pending = 0;
+        capture->m_Quit = false;
+
+        if (format == CAPTURE_FORMAT_CHROME_TRACE)
+        {
+            fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", capture->m_File);
+        }
+        else
+        {
+            if (capture->m_WrittenStrings.Capacity() == 0)
+            {
+                capture->m_WrittenStrings.SetCapacity(512, 2048);
+            }
+            capture->m_WrittenStrings.Clear();
+            fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC), 1, capture->m_File);
+            fwrite(&CAPTURE_VERSION, sizeof(CAPTURE_VERSION), 1, capture->m_File);
+            fwrite(&g_TicksPerSecond, sizeof(g_TicksPerSecond), 1, capture->m_File);
+        }
+
+        // Without threads the batches are written from Begin()
+        capture->m_Thread = 0;
+        if (dLib::FeaturesSupported(DM_FEATURE_BIT_THREADS))
+        {
+            capture->m_Mutex = dmMutex::New();
+            capture->m_Condition = dmConditionVariable::New();
+            capture->m_Thread = dmThread::New(CaptureWriterThread, 0x20000, capture, "profile_capture");
+        }
+        return true;
+    }
+
+    void StopCapture()
+    {
+        Capture* capture = &g_Capture;
+        if (!capture->m_File)
+            return;
+
+        SubmitCaptureBatch(capture);
+        if (capture->m_Thread)
+        {
+            // The writer finishes the pending batch before it quits
+            dmMutex::Lock(capture->m_Mutex);
+            capture->m_Quit = true;
+            dmConditionVariable::Broadcast(capture->m_Condition);
+            dmMutex::Unlock(capture->m_Mutex);
+            dmThread::Join(capture->m_Thread);
+            dmConditionVariable::Delete(capture->m_Condition);
+            dmMutex::Delete(capture->m_Mutex);
+            capture->m_Thread = 0;
+        }
+
+        if (capture->m_Format == CAPTURE_FORMAT_CHROME_TRACE)
+        {
+            fputs("\n]}\n", capture->m_File);
+        }
+        fclose(capture->m_File);
+        capture->m_File = 0;
+
+        dmLogInfo("Wrote %u frames of profile capture", capture->m_FramesWritten);
+
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            CaptureBatch* batch = &capture->m_Batches[i];
+            batch->m_Frames.SetCapacity(0);
+            batch->m_Samples.SetCapacity(0);
+            batch->m_Counters.SetCapacity(0);
+        }
+    }
+
+    bool IsCapturing()
+    {
+        return g_Capture.m_File != 0;
     }
 
     uint32_t GetTickSinceBegin()
@@ -802,24 +1540,56 @@ namespace dmProfile
 
     void ProfileScope::StartScope(uint32_t scope_index, const char* name, uint32_t name_hash)
     {
-        m_StartTick = GetNowTicks();
-        Sample* s = AllocateSample();
+        m_Buffer = 0;
+        if (g_Paused || !g_IsInitialized)
+            return;
+
+        ThreadBuffer* buffer = GetThreadBuffer();
+        if (buffer == 0 || buffer->m_Samples == 0)
+            return;
+
+        // Only the owning thread writes m_Write, Begin() only advances m_Read
+        uint32_t write = (uint32_t) buffer->m_Write;
+        if (write - (uint32_t) AtomicLoad32(&buffer->m_Read) >= buffer->m_Limit)
+        {
+            dmAtomicStore32(&buffer->m_Overflow, 1);
+            g_OutOfSamples = true;
+            return;
+        }
+
+        ThreadSample* s = &buffer->m_Samples[write & buffer->m_Mask];
         s->m_Name = name;
         s->m_Scope = &g_Scopes[scope_index];
         s->m_NameHash = name_hash;
-        s->m_Start = (uint32_t)(m_StartTick - g_BeginTime);
-        m_Sample = s;
+        s->m_Sequence = write;
+        s->m_Elapsed = ELAPSED_OPEN;
+        s->m_StartTicks = GetNowTicks();
+        dmAtomicStore32(&buffer->m_Write, (int32_t)(write + 1));
+
+        m_Buffer = buffer;
+        m_Index = write;
     }
 
     void ProfileScope::EndScope()
     {
         uint64_t end = GetNowTicks();
-        m_Sample->m_Elapsed = (uint32_t)(end - m_StartTick);
-        if (m_Sample->m_Elapsed > (dmProfile::GetTicksPerSecond() * 2))
+        ThreadBuffer* buffer = (ThreadBuffer*) m_Buffer;
+        // The buffers are freed by Finalize, possibly while the scope was open
+        if (!g_IsInitialized || buffer->m_Samples == 0)
+            return;
+        ThreadSample* s = &buffer->m_Samples[m_Index & buffer->m_Mask];
+        // The slot is reused if the sample was merged and the ring wrapped while the scope was open
+        if (s->m_Sequence != m_Index)
+            return;
+
+        uint32_t elapsed = (uint32_t)(end - s->m_StartTicks);
+        // Keep clear of the open marker
+        elapsed = dmMath::Min(elapsed, 0x7fffffffu);
+        s->m_Elapsed = (int32_t) elapsed;
+        if (elapsed > (dmProfile::GetTicksPerSecond() * 2))
         {
-            double elapsed_s = (double)(m_Sample->m_Elapsed) / dmProfile::GetTicksPerSecond();
-            dmLogWarning("Profiler %s.%s took %.3lf seconds", m_Sample->m_Scope->m_Name, m_Sample->m_Name, elapsed_s);
+            double elapsed_s = (double)(elapsed) / dmProfile::GetTicksPerSecond();
+            dmLogWarning("Profiler %s.%s took %.3lf seconds", s->m_Scope->m_Name, s->m_Name, elapsed_s);
         }
-
     }
 } // namespace dmProfile
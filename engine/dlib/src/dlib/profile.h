@@ -181,7 +181,7 @@ namespace dmProfile
     /**
      * Initialize profiler
      * @param max_scopes Maximum scopes
-     * @param max_samples Maximum samples
+     * @param max_samples Maximum samples per frame. Each thread's sample buffer holds a quarter of it, but at least 1024
      * @param max_counters Maximum counters
      */
     void Initialize(uint32_t max_scopes, uint32_t max_samples, uint32_t max_counters);
@@ -273,12 +273,6 @@ namespace dmProfile
      */
     uint32_t AllocateScope(const char* name);
 
-    /**
-     * Internal function
-     * @return #Sample
-     */
-    Sample* AllocateSample();
-
     /**
      * Create an internalized string. Use this function in DM_PROFILE if the
      * name isn't valid for the life-time of the application
@@ -342,6 +336,40 @@ namespace dmProfile
      */
     bool IsOutOfSamples();
 
+    /**
+     * Capture file formats
+     */
+    enum CaptureFormat
+    {
+        /// Chrome trace-event JSON. Loads in chrome://tracing, Perfetto and Speedscope
+        CAPTURE_FORMAT_CHROME_TRACE = 0,
+        /// Compact binary record stream, see profile.cpp for the layout
+        CAPTURE_FORMAT_BINARY       = 1,
+    };
+
+    /**
+     * Start streaming the samples, counters and thread names of the next #frame_count
+     * frames to a file. #Begin copies the frames into fixed size buffers, allocated here, and
+     * a writer thread writes them to file in batches. The capture stops by itself after #frame_count frames.
+     * @note Must be called from the thread calling #Begin
+     * @param path File to write
+     * @param format File format
+     * @param frame_count Number of frames to capture
+     * @return true if the capture was started
+     */
+    bool StartCapture(const char* path, CaptureFormat format, uint32_t frame_count);
+
+    /**
+     * Flush and close the current capture, if any
+     */
+    void StopCapture();
+
+    /**
+     * Check if a capture is in progress
+     * @return True if capturing
+     */
+    bool IsCapturing();
+
     /// Internal, do not use.
     extern bool g_IsInitialized;
 
@@ -350,8 +378,9 @@ namespace dmProfile
     /// Internal, do not use.
     struct ProfileScope
     {
-        Sample* m_Sample;
-        uint64_t m_StartTick;
+        /// Per-thread sample buffer, 0 if no sample was recorded
+        void*    m_Buffer;
+        uint32_t m_Index;
         inline ProfileScope(uint32_t scope_index, const char* name, uint32_t name_hash)
         {
             if (scope_index != 0xffffffffu)
@@ -360,13 +389,13 @@ namespace dmProfile
             }
             else
             {
-                m_Sample = 0;
+                m_Buffer = 0;
             }
         }
 
         inline ~ProfileScope()
         {
-            if (m_Sample)
+            if (m_Buffer)
             {
                 EndScope();
             }
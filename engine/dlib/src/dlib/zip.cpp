@@ -77,5 +77,25 @@ Result GetEntryData(HZip zip, void* buffer, uint32_t buffer_size)
     return RESULT_OK;
 }
 
+struct EntryDataStream
+{
+    EntryDataCallback m_Callback;
+    void*             m_Context;
+};
+
+static size_t OnExtract(void* arg, unsigned long long offset, const void* data, size_t size)
+{
+    EntryDataStream* stream = (EntryDataStream*)arg;
+    // Returning anything but size makes the extraction fail
+    return stream->m_Callback(stream->m_Context, (uint32_t)offset, data, (uint32_t)size) ? size : 0;
+}
+
+Result GetEntryDataStream(HZip zip, EntryDataCallback callback, void* ctx)
+{
+    EntryDataStream stream = { callback, ctx };
+    int r = zip_entry_extract(zip, OnExtract, &stream);
+    return r == 0 ? RESULT_OK : RESULT_NO_SUCH_ENTRY;
+}
+
 
 } // namespace
@@ -77,6 +77,25 @@ namespace dmZip
      *
      */
     Result GetEntryData(HZip zip, void* buffer, uint32_t buffer_size);
+
+    /*# Callback for streamed entry data
+     *
+     * @param ctx [type: void*] user context
+     * @param offset [type: uint32_t] offset of the data within the uncompressed entry
+     * @param data [type: const void*] uncompressed data, only valid during the call
+     * @param size [type: uint32_t] size of the data
+     * @return [type: bool] false to stop reading the entry
+     */
+    typedef bool (*EntryDataCallback)(void* ctx, uint32_t offset, const void* data, uint32_t size);
+
+    /*# gets the data for an entry in chunks, without buffering the whole entry
+     *
+     * @param zip zip archive
+     * @param callback [type: EntryDataCallback] called for each decompressed chunk, in order
+     * @param ctx [type: void*] user context
+     * @return [type:Result] RESULT_OK if the whole entry was read
+     */
+    Result GetEntryDataStream(HZip zip, EntryDataCallback callback, void* ctx);
 }
 
 #endif // DM_ZIP_H
\ No newline at end of file
@@ -11,6 +11,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
@@ -18,6 +19,7 @@
 #define JC_TEST_IMPLEMENTATION
 #include <jc_test/jc_test.h>
 #include "../dlib/crypt.h"
+#include "../dlib/time.h"
 
 TEST(dmCrypt, SameAsLibMCrypt)
 {
@@ -120,6 +122,64 @@ TEST(dmCrypt, SHA512)
 }
 
 
+typedef void (*HashFunction)(const uint8_t* buf, uint32_t buflen, uint8_t* digest);
+
+static const dmCrypt::HashAlgorithm g_HashAlgorithms[] = {dmCrypt::HASH_ALGORITHM_MD5, dmCrypt::HASH_ALGORITHM_SHA1, dmCrypt::HASH_ALGORITHM_SHA256, dmCrypt::HASH_ALGORITHM_SHA512};
+static const HashFunction g_HashFunctions[] = {dmCrypt::HashMd5, dmCrypt::HashSha1, dmCrypt::HashSha256, dmCrypt::HashSha512};
+static const char* g_HashNames[] = {"MD5", "SHA1", "SHA256", "SHA512"};
+
+TEST(dmCrypt, HashStream)
+{
+    const uint32_t size = 100000;
+    uint8_t* buf = (uint8_t*)malloc(size);
+    for (uint32_t i = 0; i < size; ++i)
+        buf[i] = (uint8_t)(i * 31);
+
+    for (uint32_t a = 0; a < sizeof(g_HashAlgorithms) / sizeof(g_HashAlgorithms[0]); ++a)
+    {
+        uint8_t expected[64] = {0};
+        g_HashFunctions[a](buf, size, expected);
+
+        uint8_t digest[64] = {0};
+        dmCrypt::HHashState state = dmCrypt::NewHash(g_HashAlgorithms[a]);
+        ASSERT_NE((dmCrypt::HHashState)0, state);
+        uint32_t offset = 0;
+        uint32_t chunk = 1;
+        while (offset < size)
+        {
+            uint32_t n = size - offset < chunk ? size - offset : chunk;
+            dmCrypt::UpdateHash(state, buf + offset, n);
+            offset += n;
+            chunk = chunk * 3 + 1;
+        }
+        dmCrypt::FinalizeHash(state, digest);
+
+        ASSERT_EQ(0, memcmp(expected, digest, dmCrypt::GetHashLength(g_HashAlgorithms[a])));
+    }
+
+    free(buf);
+}
+
+TEST(dmCrypt, HashBenchmark)
+{
+    const uint32_t size = 16 * 1024 * 1024;
+    uint8_t* buf = (uint8_t*)malloc(size);
+    for (uint32_t i = 0; i < size; ++i)
+        buf[i] = (uint8_t)rand();
+
+    for (uint32_t a = 0; a < sizeof(g_HashAlgorithms) / sizeof(g_HashAlgorithms[0]); ++a)
+    {
+        uint8_t digest[64];
+        uint64_t start = dmTime::GetTime();
+        g_HashFunctions[a](buf, size, digest);
+        uint64_t end = dmTime::GetTime();
+        float elapsed = (end - start) / 1000000.0f;
+        printf("%-6s %8.1f MB/s\n", g_HashNames[a], elapsed > 0 ? (size / (1024.0f * 1024.0f)) / elapsed : 0.0f);
+    }
+
+    free(buf);
+}
+
 TEST(dmCrypt, Base64Encode)
 {
     const char* source = "Lorem Ipsum";
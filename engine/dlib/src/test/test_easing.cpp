@@ -106,6 +106,45 @@ TEST(dmEasing, CurstomCurve)
     }
 }
 
+TEST(dmEasing, GetValues)
+{
+    dmVMath::FloatVector vector(64);
+    for (int i = 0; i < 64; ++i) {
+        float t = i / 63.0f;
+        vector.values[i] = t * t;
+    }
+
+    // Mix all built-in curves with a custom one, and a count that isn't a multiple of four
+    const uint32_t count = 1021;
+    dmEasing::Curve* curves = new dmEasing::Curve[count];
+    float* t = new float[count];
+    float* out = new float[count];
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        curves[i].type = (dmEasing::Type) (i % dmEasing::TYPE_COUNT);
+        if (curves[i].type == dmEasing::TYPE_FLOAT_VECTOR)
+            curves[i].vector = &vector;
+        t[i] = -0.1f + 1.2f * (i / (float)(count - 1));
+    }
+
+    dmEasing::GetValues(curves, t, out, count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(dmEasing::GetValue(curves[i], t[i]), out[i]);
+    }
+
+    // In-place evaluation
+    dmEasing::GetValues(curves, t, t, count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(out[i], t[i]);
+    }
+
+    delete [] curves;
+    delete [] t;
+    delete [] out;
+}
+
 int main(int argc, char **argv)
 {
     jc_test_init(&argc, argv);
@@ -0,0 +1,216 @@
+// Copyright 2020 The Defold Foundation
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include <stdint.h>
+#include <string.h>
+#define JC_TEST_IMPLEMENTATION
+#include <jc_test/jc_test.h>
+#include "../dlib/array.h"
+#include "../dlib/frame_allocator.h"
+#include "../dlib/thread.h"
+
+TEST(dmFrameAllocator, Alloc)
+{
+    dmFrameAllocator::HAllocator allocator = dmFrameAllocator::New(1024);
+
+    uint8_t* a = (uint8_t*) dmFrameAllocator::Alloc(allocator, 10);
+    uint8_t* b = (uint8_t*) dmFrameAllocator::Alloc(allocator, 1);
+    uint8_t* c = (uint8_t*) dmFrameAllocator::Alloc(allocator, 0);
+    ASSERT_EQ(0u, (uintptr_t) a % 16);
+    ASSERT_EQ(a + 16, b);
+    ASSERT_EQ(b + 16, c);
+
+    dmFrameAllocator::Stats stats;
+    dmFrameAllocator::GetStats(allocator, &stats);
+    ASSERT_EQ(1024u, stats.m_FrameSize);
+    ASSERT_EQ(48u, stats.m_Used);
+    ASSERT_EQ(0u, stats.m_Overflow);
+
+    dmFrameAllocator::Delete(allocator);
+}
+
+TEST(dmFrameAllocator, DoubleBuffered)
+{
+    dmFrameAllocator::HAllocator allocator = dmFrameAllocator::New(1024);
+
+    uint8_t* frame0 = (uint8_t*) dmFrameAllocator::Alloc(allocator, 512);
+    memset(frame0, 0xaa, 512);
+
+    // The previous frame is left as is
+    dmFrameAllocator::NewFrame(allocator);
+    uint8_t* frame1 = (uint8_t*) dmFrameAllocator::Alloc(allocator, 512);
+    memset(frame1, 0xbb, 512);
+    ASSERT_TRUE(frame1 + 512 <= frame0 || frame0 + 512 <= frame1);
+    for (uint32_t i = 0; i < 512; ++i)
+        ASSERT_EQ(0xaa, frame0[i]);
+
+    // ... and reused the frame after
+    dmFrameAllocator::NewFrame(allocator);
+    ASSERT_EQ(frame0, dmFrameAllocator::Alloc(allocator, 512));
+    dmFrameAllocator::NewFrame(allocator);
+    ASSERT_EQ(frame1, dmFrameAllocator::Alloc(allocator, 512));
+
+    dmFrameAllocator::Delete(allocator);
+}
+
+TEST(dmFrameAllocator, Overflow)
+{
+    dmFrameAllocator::HAllocator allocator = dmFrameAllocator::New(256);
+
+    uint8_t* a = (uint8_t*) dmFrameAllocator::Alloc(allocator, 200);
+    uint8_t* b = (uint8_t*) dmFrameAllocator::Alloc(allocator, 100);
+    uint8_t* c = (uint8_t*) dmFrameAllocator::Alloc(allocator, 1000);
+    ASSERT_EQ(0u, (uintptr_t) b % 16);
+    ASSERT_EQ(0u, (uintptr_t) c % 16);
+    memset(a, 1, 200);
+    memset(b, 2, 100);
+    memset(c, 3, 1000);
+
+    dmFrameAllocator::Stats stats;
+    dmFrameAllocator::GetStats(allocator, &stats);
+    ASSERT_EQ(208u + 112u + 1008u, stats.m_Used);
+    ASSERT_EQ(112u + 1008u, stats.m_Overflow);
+    ASSERT_EQ(stats.m_Used, stats.m_HighWaterMark);
+
+    // The high water mark is kept over frames
+    dmFrameAllocator::NewFrame(allocator);
+    dmFrameAllocator::Alloc(allocator, 16);
+    dmFrameAllocator::GetStats(allocator, &stats);
+    ASSERT_EQ(16u, stats.m_Used);
+    ASSERT_EQ(0u, stats.m_Overflow);
+    ASSERT_EQ(208u + 112u + 1008u, stats.m_HighWaterMark);
+
+    dmFrameAllocator::NewFrame(allocator);
+    dmFrameAllocator::Delete(allocator);
+
+    // Everything goes on the heap without frame buffers
+    allocator = dmFrameAllocator::New(0);
+    a = (uint8_t*) dmFrameAllocator::Alloc(allocator, 0);
+    ASSERT_NE((uint8_t*) 0, a);
+    ASSERT_FALSE(dmFrameAllocator::Extend(allocator, a, 0, 16));
+    dmFrameAllocator::Delete(allocator);
+}
+
+TEST(dmFrameAllocator, Extend)
+{
+    dmFrameAllocator::HAllocator allocator = dmFrameAllocator::New(1024);
+
+    uint8_t* a = (uint8_t*) dmFrameAllocator::Alloc(allocator, 100);
+    ASSERT_TRUE(dmFrameAllocator::Extend(allocator, a, 100, 300));
+    ASSERT_TRUE(dmFrameAllocator::Extend(allocator, a, 300, 200));
+    uint8_t* b = (uint8_t*) dmFrameAllocator::Alloc(allocator, 100);
+    ASSERT_EQ(a + 304, b);
+
+    // Only the latest allocation grows in place, and not past the frame buffer
+    ASSERT_FALSE(dmFrameAllocator::Extend(allocator, a, 304, 400));
+    ASSERT_TRUE(dmFrameAllocator::Extend(allocator, b, 100, 1024 - 304));
+    ASSERT_FALSE(dmFrameAllocator::Extend(allocator, b, 1024 - 304, 1024));
+
+    dmFrameAllocator::Delete(allocator);
+}
+
+TEST(dmFrameAllocator, Array)
+{
+    dmFrameAllocator::HAllocator allocator = dmFrameAllocator::New(4096);
+
+    dmArray<uint32_t> array;
+    array.SetCapacity(4);
+    array.Push(1);
+
+    // Heap storage is moved to the frame buffer, and grows in place from there
+    dmFrameAllocator::SetCapacity(allocator, array, 16);
+    ASSERT_EQ(16u, array.Capacity());
+    ASSERT_EQ(1u, array.Size());
+    ASSERT_EQ(1u, array[0]);
+    uint32_t* data = array.Begin();
+    for (uint32_t i = 1; i < 16; ++i)
+        array.Push(i + 1);
+    dmFrameAllocator::SetCapacity(allocator, array, 32);
+    ASSERT_EQ(data, array.Begin());
+
+    // Other allocations in between moves it
+    dmFrameAllocator::Alloc(allocator, 16);
+    dmFrameAllocator::SetCapacity(allocator, array, 64);
+    ASSERT_NE(data, array.Begin());
+    ASSERT_EQ(64u, array.Capacity());
+    for (uint32_t i = 0; i < 16; ++i)
+        ASSERT_EQ(i + 1, array[i]);
+
+    ASSERT_EQ(64u, dmFrameAllocator::ResetArray(array));
+    ASSERT_EQ(0u, array.Capacity());
+    ASSERT_EQ(0u, array.Size());
+
+    dmFrameAllocator::Delete(allocator);
+}
+
+struct SubAllocatorContext
+{
+    dmFrameAllocator::HAllocator m_Allocator;
+    uint8_t*                     m_Blocks[1000];
+    uint8_t                      m_Value;
+};
+
+static void SubAllocatorThread(void* arg)
+{
+    SubAllocatorContext* ctx = (SubAllocatorContext*) arg;
+    dmFrameAllocator::SubAllocator sub_allocator;
+    dmFrameAllocator::InitSubAllocator(ctx->m_Allocator, &sub_allocator);
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        ctx->m_Blocks[i] = (uint8_t*) dmFrameAllocator::Alloc(&sub_allocator, 1 + i % 100);
+        memset(ctx->m_Blocks[i], ctx->m_Value, 1 + i % 100);
+    }
+}
+
+TEST(dmFrameAllocator, SubAllocators)
+{
+    // Some of it won't fit in the frame buffer
+    dmFrameAllocator::HAllocator allocator = dmFrameAllocator::New(128 * 1024);
+
+    const uint32_t thread_count = 4;
+    SubAllocatorContext contexts[thread_count];
+    dmThread::Thread threads[thread_count];
+    for (uint32_t i = 0; i < thread_count; ++i)
+    {
+        contexts[i].m_Allocator = allocator;
+        contexts[i].m_Value = (uint8_t) (i + 1);
+        threads[i] = dmThread::New(SubAllocatorThread, 0x10000, &contexts[i], "frame_alloc");
+    }
+    for (uint32_t i = 0; i < thread_count; ++i)
+    {
+        dmThread::Join(threads[i]);
+    }
+
+    for (uint32_t i = 0; i < thread_count; ++i)
+    {
+        for (uint32_t j = 0; j < 1000; ++j)
+        {
+            uint8_t* block = contexts[i].m_Blocks[j];
+            ASSERT_EQ(0u, (uintptr_t) block % 16);
+            for (uint32_t k = 0; k < 1 + j % 100; ++k)
+                ASSERT_EQ(contexts[i].m_Value, block[k]);
+        }
+    }
+
+    dmFrameAllocator::Stats stats;
+    dmFrameAllocator::GetStats(allocator, &stats);
+    ASSERT_LT(0u, stats.m_Overflow);
+    ASSERT_EQ(stats.m_Used, stats.m_HighWaterMark);
+
+    dmFrameAllocator::Delete(allocator);
+}
+
+int main(int argc, char **argv)
+{
+    jc_test_init(&argc, argv);
+    return jc_test_run_all();
+}
@@ -23,6 +23,7 @@
 #include "dlib/uri.h"
 #include "dlib/socket.h"
 #include "dlib/sslsocket.h"
+#include "dlib/http_async.h"
 #include "dlib/http_client.h"
 #include "dlib/http_client_private.h"
 #include "dlib/http_cache_verify.h"
@@ -1145,6 +1146,216 @@ TEST(dmHttpClient, ConnectionRefused)
     dmDNS::DeleteChannel(params.m_DNSChannel);
 }
 
+struct HttpAsyncResponses
+{
+    std::map<uint32_t, std::string> m_Content;
+    uint32_t m_Count;
+    uint32_t m_Failed;
+    dmHttpAsync::Result m_LastResult;
+
+    HttpAsyncResponses() : m_Count(0), m_Failed(0), m_LastResult(dmHttpAsync::RESULT_OK) {}
+};
+
+struct HttpAsyncRequest
+{
+    HttpAsyncResponses* m_Responses;
+    uint32_t m_Index;
+};
+
+static void HttpAsyncResponse(void* user_data, const dmHttpAsync::Response* response)
+{
+    HttpAsyncRequest* request = (HttpAsyncRequest*) user_data;
+    HttpAsyncResponses* responses = request->m_Responses;
+    responses->m_Count++;
+    responses->m_LastResult = response->m_Result;
+    if (response->m_Result != dmHttpAsync::RESULT_OK || response->m_Status != 200)
+        responses->m_Failed++;
+    else
+        responses->m_Content[request->m_Index].assign(response->m_Content, response->m_ContentLength);
+}
+
+static void HttpAsyncWait(dmHttpAsync::HClient client)
+{
+    uint64_t start = dmTime::GetTime();
+    while (dmHttpAsync::GetActiveCount(client) > 0 && dmTime::GetTime() - start < 30 * 1000000)
+    {
+        dmHttpAsync::Update(client, 10 * 1000);
+    }
+}
+
+TEST(dmHttpAsync, Simple)
+{
+    const uint32_t count = 200;
+    char url[128];
+    HttpAsyncResponses responses;
+    HttpAsyncRequest requests[count];
+
+    dmHttpAsync::NewParams params;
+    params.m_MaxConnectionsPerHost = 2;
+    dmHttpAsync::HClient client = dmHttpAsync::New(&params);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        requests[i].m_Responses = &responses;
+        requests[i].m_Index = i;
+        dmSnPrintf(url, sizeof(url), "http://localhost:%d/add/%u/1000", g_HttpPort, i);
+        dmHttpAsync::RequestParams request_params;
+        request_params.m_Url = url;
+        request_params.m_Callback = HttpAsyncResponse;
+        request_params.m_UserData = &requests[i];
+        ASSERT_EQ(dmHttpAsync::RESULT_OK, dmHttpAsync::Request(client, &request_params));
+    }
+    ASSERT_EQ(count, dmHttpAsync::GetActiveCount(client));
+
+    HttpAsyncWait(client);
+    ASSERT_EQ(0U, dmHttpAsync::GetActiveCount(client));
+    ASSERT_EQ(count, responses.m_Count);
+    ASSERT_EQ(0U, responses.m_Failed);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(1000 + (int) i, strtol(responses.m_Content[i].c_str(), 0, 10));
+    }
+
+    dmHttpAsync::Stats stats;
+    dmHttpAsync::GetStats(client, &stats);
+    // Keep-alive connections are shared by all requests
+    ASSERT_GE(2U, stats.m_ConnectionsOpened);
+    ASSERT_LT(0U, stats.m_Pipelined + stats.m_Reused);
+    dmHttpAsync::Delete(client);
+}
+
+TEST(dmHttpAsync, Post)
+{
+    char url[128];
+    HttpAsyncResponses responses;
+    HttpAsyncRequest request = { &responses, 0 };
+    const char* body = "defold";
+
+    dmHttpAsync::NewParams params;
+    dmHttpAsync::HClient client = dmHttpAsync::New(&params);
+
+    dmSnPrintf(url, sizeof(url), "http://localhost:%d/post", g_HttpPort);
+    dmHttpAsync::RequestParams request_params;
+    request_params.m_Method = "POST";
+    request_params.m_Url = url;
+    request_params.m_Body = body;
+    request_params.m_BodyLength = strlen(body);
+    request_params.m_Callback = HttpAsyncResponse;
+    request_params.m_UserData = &request;
+    ASSERT_EQ(dmHttpAsync::RESULT_OK, dmHttpAsync::Request(client, &request_params));
+
+    HttpAsyncWait(client);
+    ASSERT_EQ(1U, responses.m_Count);
+    ASSERT_EQ(0U, responses.m_Failed);
+    // The server responds with the sum of the bytes
+    int sum = 0;
+    for (uint32_t i = 0; i < strlen(body); ++i)
+        sum += body[i];
+    ASSERT_EQ(sum, strtol(responses.m_Content[0].c_str(), 0, 10));
+    dmHttpAsync::Delete(client);
+}
+
+TEST(dmHttpAsync, Timeout)
+{
+    char url[128];
+    HttpAsyncResponses responses;
+    HttpAsyncRequest request = { &responses, 0 };
+
+    dmHttpAsync::NewParams params;
+    dmHttpAsync::HClient client = dmHttpAsync::New(&params);
+
+    dmSnPrintf(url, sizeof(url), "http://localhost:%d/sleep/2000", g_HttpPort);
+    dmHttpAsync::RequestParams request_params;
+    request_params.m_Url = url;
+    request_params.m_Timeout = 100 * 1000;
+    request_params.m_Callback = HttpAsyncResponse;
+    request_params.m_UserData = &request;
+    ASSERT_EQ(dmHttpAsync::RESULT_OK, dmHttpAsync::Request(client, &request_params));
+
+    HttpAsyncWait(client);
+    ASSERT_EQ(1U, responses.m_Count);
+    ASSERT_EQ(dmHttpAsync::RESULT_TIMEOUT, responses.m_LastResult);
+    dmHttpAsync::Delete(client);
+}
+
+TEST(dmHttpAsync, ConnectionRefused)
+{
+    HttpAsyncResponses responses;
+    HttpAsyncRequest request = { &responses, 0 };
+
+    dmHttpAsync::NewParams params;
+    dmHttpAsync::HClient client = dmHttpAsync::New(&params);
+
+    dmHttpAsync::RequestParams request_params;
+    request_params.m_Url = "http://localhost:9999/";
+    request_params.m_Callback = HttpAsyncResponse;
+    request_params.m_UserData = &request;
+    ASSERT_EQ(dmHttpAsync::RESULT_OK, dmHttpAsync::Request(client, &request_params));
+
+    HttpAsyncWait(client);
+    ASSERT_EQ(1U, responses.m_Count);
+    ASSERT_EQ(dmHttpAsync::RESULT_SOCKET_ERROR, responses.m_LastResult);
+
+    request_params.m_Url = "https://localhost:9999/";
+    ASSERT_EQ(dmHttpAsync::RESULT_UNSUPPORTED, dmHttpAsync::Request(client, &request_params));
+    request_params.m_Url = "not a url";
+    ASSERT_EQ(dmHttpAsync::RESULT_INVAL, dmHttpAsync::Request(client, &request_params));
+    dmHttpAsync::Delete(client);
+}
+
+TEST(dmHttpAsync, HostNotFound)
+{
+    char url[128];
+    HttpAsyncResponses responses;
+    HttpAsyncRequest requests[2] = { { &responses, 0 }, { &responses, 1 } };
+
+    dmHttpAsync::NewParams params;
+    dmDNS::NewChannel(&params.m_DNSChannel);
+    dmHttpAsync::HClient client = dmHttpAsync::New(&params);
+
+    // The lookup of the missing host doesn't hold up the other request
+    dmHttpAsync::RequestParams request_params;
+    request_params.m_Url = "http://host_not_found/";
+    request_params.m_Callback = HttpAsyncResponse;
+    request_params.m_UserData = &requests[0];
+    ASSERT_EQ(dmHttpAsync::RESULT_OK, dmHttpAsync::Request(client, &request_params));
+
+    dmSnPrintf(url, sizeof(url), "http://localhost:%d/add/1/2", g_HttpPort);
+    request_params.m_Url = url;
+    request_params.m_UserData = &requests[1];
+    ASSERT_EQ(dmHttpAsync::RESULT_OK, dmHttpAsync::Request(client, &request_params));
+
+    HttpAsyncWait(client);
+    ASSERT_EQ(2U, responses.m_Count);
+    ASSERT_EQ(1U, responses.m_Failed);
+    ASSERT_EQ(3, strtol(responses.m_Content[1].c_str(), 0, 10));
+    ASSERT_EQ(0U, responses.m_Content.count(0));
+    dmHttpAsync::Delete(client);
+    dmDNS::DeleteChannel(params.m_DNSChannel);
+}
+
+TEST(dmHttpAsync, DeleteCancels)
+{
+    char url[128];
+    HttpAsyncResponses responses;
+    HttpAsyncRequest request = { &responses, 0 };
+
+    dmHttpAsync::NewParams params;
+    dmHttpAsync::HClient client = dmHttpAsync::New(&params);
+
+    dmSnPrintf(url, sizeof(url), "http://localhost:%d/sleep/2000", g_HttpPort);
+    dmHttpAsync::RequestParams request_params;
+    request_params.m_Url = url;
+    request_params.m_Callback = HttpAsyncResponse;
+    request_params.m_UserData = &request;
+    ASSERT_EQ(dmHttpAsync::RESULT_OK, dmHttpAsync::Request(client, &request_params));
+    dmHttpAsync::Update(client, 0);
+
+    dmHttpAsync::Delete(client);
+    ASSERT_EQ(1U, responses.m_Count);
+    ASSERT_EQ(dmHttpAsync::RESULT_CANCELLED, responses.m_LastResult);
+}
+
 static void Usage()
 {
     dmLogError("Usage: <exe> <config>");
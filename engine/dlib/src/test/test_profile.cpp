@@ -21,6 +21,7 @@
 #include "dlib/profile.h"
 #include "dlib/time.h"
 #include "dlib/thread.h"
+#include "dlib/sys.h"
 
 #if !defined(_WIN32)
 
@@ -307,7 +308,7 @@ TEST(dmProfile, Counter1)
             { DM_COUNTER("c2", 123); }
 
             profile = dmProfile::Begin();
-            std::map<std::string, dmProfile::CounterData*> counters;
+            std::map<std::string, const dmProfile::CounterData*> counters;
             dmProfile::IterateCounterData(profile, &counters, ProfileCounterCallback);
             dmProfile::Release(profile);
 
@@ -340,7 +341,7 @@ TEST(dmProfile, Counter2)
     dmThread::Join(t1);
     dmThread::Join(t2);
 
-    std::map<std::string, dmProfile::CounterData*> counters;
+    std::map<std::string, const dmProfile::CounterData*> counters;
     profile = dmProfile::Begin();
     dmProfile::IterateCounterData(profile, &counters, ProfileCounterCallback);
     dmProfile::Release(profile);
@@ -481,6 +482,297 @@ TEST(dmProfile, DynamicScope)
     dmProfile::Finalize();
 }
 
+static void CounterRegisterThread(void* arg)
+{
+    // All threads register the same counters at once
+    static const char* names[] = { "dyn0", "dyn1", "dyn2", "dyn2", "dyn2", "dyn2", "dyn2", "dyn2" };
+    for (int i = 0; i < 1000; ++i)
+    {
+        dmProfile::AddCounter(names[i % 8], 1);
+    }
+}
+
+TEST(dmProfile, CounterRegisterThreads)
+{
+    dmProfile::Initialize(128, 0, 16);
+
+    dmProfile::HProfile profile = dmProfile::Begin();
+    dmProfile::Release(profile);
+
+    dmThread::Thread threads[4];
+    for (int i = 0; i < 4; ++i)
+        threads[i] = dmThread::New(CounterRegisterThread, 0xf0000, 0, "cr");
+    for (int i = 0; i < 4; ++i)
+        dmThread::Join(threads[i]);
+
+    std::map<std::string, const dmProfile::CounterData*> counters;
+    profile = dmProfile::Begin();
+    dmProfile::IterateCounterData(profile, &counters, ProfileCounterCallback);
+    dmProfile::Release(profile);
+
+    ASSERT_EQ(3U, counters.size());
+    ASSERT_EQ(4 * 125, counters["dyn0"]->m_Value);
+    ASSERT_EQ(4 * 125, counters["dyn1"]->m_Value);
+    ASSERT_EQ(4 * 750, counters["dyn2"]->m_Value);
+
+    dmProfile::Finalize();
+}
+
+static void RecordSampleThread(void* arg)
+{
+    DM_PROFILE(Thread, "sample")
+}
+
+// Threads that have exited give their buffer slot to new threads
+TEST(dmProfile, ThreadSlotsReused)
+{
+    dmProfile::Initialize(128, 1024, 0);
+
+    const uint32_t thread_count = 32;
+    for (uint32_t round = 0; round < 8; ++round)
+    {
+        dmProfile::HProfile profile = dmProfile::Begin();
+        dmProfile::Release(profile);
+
+        dmThread::Thread threads[thread_count];
+        for (uint32_t i = 0; i < thread_count; ++i)
+            threads[i] = dmThread::New(RecordSampleThread, 0xf0000, 0, "slot");
+        for (uint32_t i = 0; i < thread_count; ++i)
+            dmThread::Join(threads[i]);
+
+        std::vector<dmProfile::Sample> samples;
+        profile = dmProfile::Begin();
+        dmProfile::IterateSamples(profile, &samples, false, &ProfileSampleCallback);
+        dmProfile::Release(profile);
+
+        ASSERT_EQ(thread_count, samples.size());
+    }
+
+    dmProfile::Finalize();
+}
+
+TEST(dmProfile, ScopeOpenOverFinalize)
+{
+    dmProfile::Initialize(128, 1024, 0);
+    {
+        DM_PROFILE(X, "open")
+        dmProfile::Finalize();
+    }
+
+    // Initializing again reallocates the buffer of the thread, instead of leaking the previous one
+    dmProfile::Initialize(128, 1024, 0);
+    dmProfile::Initialize(128, 1024, 0);
+    {
+        dmProfile::HProfile profile = dmProfile::Begin();
+        dmProfile::Release(profile);
+        { DM_PROFILE(X, "a") }
+    }
+    std::vector<dmProfile::Sample> samples;
+    dmProfile::HProfile profile = dmProfile::Begin();
+    dmProfile::IterateSamples(profile, &samples, false, &ProfileSampleCallback);
+    dmProfile::Release(profile);
+    ASSERT_EQ(1U, samples.size());
+
+    dmProfile::Finalize();
+}
+
+static const uint32_t OVERHEAD_ITERATIONS = 100000;
+
+static void OverheadThread(void* arg)
+{
+    uint64_t* elapsed = (uint64_t*) arg;
+    uint64_t start = dmTime::GetTime();
+    for (uint32_t i = 0; i < OVERHEAD_ITERATIONS; ++i)
+    {
+        DM_PROFILE(Overhead, "sample")
+    }
+    *elapsed = dmTime::GetTime() - start;
+}
+
+// Measures the cost of recording a sample, with one and several threads recording at once
+TEST(dmProfile, Overhead)
+{
+    const uint32_t max_threads = 4;
+    dmProfile::Initialize(128, OVERHEAD_ITERATIONS * max_threads, 16);
+
+    for (uint32_t thread_count = 1; thread_count <= max_threads; thread_count *= 2)
+    {
+        dmProfile::HProfile profile = dmProfile::Begin();
+        dmProfile::Release(profile);
+
+        uint64_t elapsed[max_threads];
+        dmThread::Thread threads[max_threads];
+        for (uint32_t i = 0; i < thread_count; ++i)
+            threads[i] = dmThread::New(OverheadThread, 0xf0000, &elapsed[i], "overhead");
+        for (uint32_t i = 0; i < thread_count; ++i)
+            dmThread::Join(threads[i]);
+
+        std::vector<dmProfile::Sample> samples;
+        profile = dmProfile::Begin();
+        dmProfile::IterateSamples(profile, &samples, false, &ProfileSampleCallback);
+        dmProfile::Release(profile);
+
+        // Each thread records into its own buffer, so no sample is lost
+        ASSERT_EQ(OVERHEAD_ITERATIONS * thread_count, samples.size());
+        ASSERT_FALSE(dmProfile::IsOutOfSamples());
+
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < thread_count; ++i)
+            total += elapsed[i];
+        printf("Overhead with %u thread(s): %.1f ns per sample\n", thread_count, total * 1000.0 / (OVERHEAD_ITERATIONS * thread_count));
+    }
+
+    dmProfile::Finalize();
+}
+
+static void ProfileCaptureFrames(uint32_t frame_count)
+{
+    for (uint32_t i = 0; i < frame_count; ++i)
+    {
+        dmProfile::HProfile profile = dmProfile::Begin();
+        dmProfile::Release(profile);
+        {
+            DM_PROFILE(Capture, "outer")
+            {
+                DM_PROFILE(Capture, "inner \"quoted\"")
+            }
+        }
+        dmProfile::AddCounter("CaptureCounter", 2);
+    }
+}
+
+static std::string ReadCaptureFile(const char* path)
+{
+    std::string data;
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return data;
+    char buffer[1024];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        data.append(buffer, n);
+    fclose(f);
+    return data;
+}
+
+static uint32_t CountOccurrences(const std::string& data, const char* pattern)
+{
+    uint32_t count = 0;
+    for (size_t i = data.find(pattern); i != std::string::npos; i = data.find(pattern, i + 1))
+        ++count;
+    return count;
+}
+
+TEST(dmProfile, CaptureChromeTrace)
+{
+    dmSys::Mkdir("tmp", 0755);
+    const char* path = "tmp/profile_capture.json";
+
+    dmProfile::Initialize(128, 1024, 16);
+    ASSERT_TRUE(dmProfile::StartCapture(path, dmProfile::CAPTURE_FORMAT_CHROME_TRACE, 10));
+    ASSERT_TRUE(dmProfile::IsCapturing());
+
+    // The capture stops after 10 frames, the remaining ones are not written
+    ProfileCaptureFrames(12);
+    ASSERT_FALSE(dmProfile::IsCapturing());
+    dmProfile::Finalize();
+
+    std::string data = ReadCaptureFile(path);
+    ASSERT_EQ(0U, data.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+    ASSERT_EQ(data.size() - 4, data.rfind("\n]}\n"));
+
+    // The first captured frame is the one before the capture started
+    ASSERT_EQ(9U, CountOccurrences(data, "{\"name\":\"outer\",\"cat\":\"Capture\",\"ph\":\"X\""));
+    ASSERT_EQ(9U, CountOccurrences(data, "{\"name\":\"inner \\\"quoted\\\"\""));
+    ASSERT_EQ(9U, CountOccurrences(data, "{\"name\":\"CaptureCounter\",\"ph\":\"C\""));
+    ASSERT_EQ(1U, CountOccurrences(data, "\"thread_name\""));
+}
+
+TEST(dmProfile, CaptureBinary)
+{
+    dmSys::Mkdir("tmp", 0755);
+    const char* path = "tmp/profile_capture.bin";
+
+    dmProfile::Initialize(128, 1024, 16);
+    ASSERT_TRUE(dmProfile::StartCapture(path, dmProfile::CAPTURE_FORMAT_BINARY, 100));
+    ProfileCaptureFrames(9);
+    // Stopping early flushes the frames staged so far
+    dmProfile::StopCapture();
+    ASSERT_FALSE(dmProfile::IsCapturing());
+    dmProfile::Finalize();
+
+    std::string data = ReadCaptureFile(path);
+    ASSERT_LT(16U, data.size());
+    ASSERT_EQ(0, memcmp(data.data(), "DMPC", 4));
+    uint32_t version;
+    memcpy(&version, data.data() + 4, sizeof(version));
+    ASSERT_EQ(1U, version);
+
+    uint32_t frames = 0, strings = 0, threads = 0, samples = 0;
+    size_t offset = 16;
+    while (offset < data.size())
+    {
+        uint8_t type = (uint8_t)data[offset++];
+        if (type == 1)
+        {
+            uint16_t length;
+            memcpy(&length, data.data() + offset + 4, sizeof(length));
+            offset += 6 + length;
+            ++strings;
+        }
+        else if (type == 2)
+        {
+            uint16_t length;
+            memcpy(&length, data.data() + offset + 2, sizeof(length));
+            offset += 4 + length;
+            ++threads;
+        }
+        else
+        {
+            ASSERT_EQ(3, type);
+            uint32_t sample_count, counter_count;
+            memcpy(&sample_count, data.data() + offset + 8, sizeof(sample_count));
+            memcpy(&counter_count, data.data() + offset + 12, sizeof(counter_count));
+            offset += 16 + sample_count * 18 + counter_count * 8;
+            samples += sample_count;
+            ++frames;
+        }
+    }
+    ASSERT_EQ(data.size(), offset);
+    ASSERT_EQ(9U, frames);
+    ASSERT_EQ(8U * 2U, samples);
+    // "Capture", "outer", "inner" and the counter name are written once each
+    ASSERT_EQ(4U, strings);
+    ASSERT_EQ(1U, threads);
+}
+
+// Many batches handed over to the writer thread, in order
+TEST(dmProfile, CaptureManyFrames)
+{
+    dmSys::Mkdir("tmp", 0755);
+    const char* path = "tmp/profile_capture_many.json";
+
+    dmProfile::Initialize(128, 1024, 16);
+    ASSERT_TRUE(dmProfile::StartCapture(path, dmProfile::CAPTURE_FORMAT_CHROME_TRACE, 201));
+    ProfileCaptureFrames(201);
+    ASSERT_FALSE(dmProfile::IsCapturing());
+    dmProfile::Finalize();
+
+    std::string data = ReadCaptureFile(path);
+    ASSERT_EQ(data.size() - 4, data.rfind("\n]}\n"));
+    ASSERT_EQ(200U, CountOccurrences(data, "{\"name\":\"outer\",\"cat\":\"Capture\",\"ph\":\"X\""));
+
+    // Frames are written in capture order
+    double last_ts = -1.0;
+    const char* pattern = "{\"name\":\"outer\",\"cat\":\"Capture\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":";
+    for (size_t i = data.find(pattern); i != std::string::npos; i = data.find(pattern, i + 1))
+    {
+        double ts = atof(data.c_str() + i + strlen(pattern));
+        ASSERT_LE(last_ts, ts);
+        last_ts = ts;
+    }
+}
+
 #else
 #endif
 
@@ -74,6 +74,42 @@ TEST(dmZip, Read)
     dmZip::Close(zip);
 }
 
+static bool AppendEntryData(void* ctx, uint32_t offset, const void* data, uint32_t size)
+{
+    char* out = (char*)ctx;
+    memcpy(out + offset, data, size);
+    return true;
+}
+
+static bool AbortEntryData(void* ctx, uint32_t offset, const void* data, uint32_t size)
+{
+    return false;
+}
+
+TEST(dmZip, ReadStream)
+{
+    char path[64];
+    dmSnPrintf(path, 64, MOUNTFS PATH_FORMAT, "foo.zip");
+
+    dmZip::HZip zip;
+    dmZip::Result zr = dmZip::Open(path, &zip);
+    ASSERT_EQ(dmZip::RESULT_OK, zr);
+
+    zr = dmZip::OpenEntry(zip, "hello.txt");
+    ASSERT_EQ(dmZip::RESULT_OK, zr);
+
+    char data[32] = {0};
+    zr = dmZip::GetEntryDataStream(zip, AppendEntryData, data);
+    ASSERT_EQ(dmZip::RESULT_OK, zr);
+    ASSERT_STREQ("Hello World", data);
+
+    zr = dmZip::GetEntryDataStream(zip, AbortEntryData, 0);
+    ASSERT_NE(dmZip::RESULT_OK, zr);
+
+    dmZip::CloseEntry(zip);
+    dmZip::Close(zip);
+}
+
 TEST(dmZip, Iterate)
 {
     char path[64];
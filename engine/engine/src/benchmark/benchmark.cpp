@@ -0,0 +1,432 @@
+// Copyright 2020 The Defold Foundation
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// Headless engine benchmark runner
+//
+// Boots the engine against the null graphics, sound and hid backends, steps a fixed
+// number of frames with a fixed dt and writes the aggregated profile data as JSON.
+//
+//   dmengine_benchmark [--frames=N] [--warmup=N] [--output=file.json] [engine arguments...]
+//
+// All arguments not recognized by the runner are passed on to the engine, e.g.
+//   --config=bootstrap.main_collection=/sprites/sprites.collectionc
+//   build/default/game.projectc  or  a bundled game.arcd directory
+//
+// The memory section always has the peak and current resident set size. Run with the
+// memprofile library preloaded (LD_PRELOAD/DYLD_INSERT_LIBRARIES=libdlib_memprofile) to
+// also get the active heap bytes and the number of allocations per frame.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__) || defined(__MACH__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#if defined(__MACH__)
+#include <mach/mach.h>
+#endif
+
+#include <dlib/array.h>
+#include <dlib/hash.h>
+#include <dlib/hashtable.h>
+#include <dlib/log.h>
+#include <dlib/math.h>
+#include <dlib/memprofile.h>
+#include <dlib/profile.h>
+
+#include "engine.h"
+#include "engine_private.h"
+
+namespace dmEngineBenchmark
+{
+    static const uint32_t DEFAULT_FRAMES = 600;
+    static const uint32_t DEFAULT_WARMUP = 60;
+
+    struct TimingStat
+    {
+        const char* m_Scope;
+        const char* m_Name;
+        uint64_t    m_TotalTicks;
+        uint32_t    m_FrameTicks;
+        uint32_t    m_MaxFrameTicks;
+        uint32_t    m_Count;
+        uint32_t    m_Frames;
+    };
+
+    struct CounterStat
+    {
+        const char* m_Name;
+        uint64_t    m_Total;
+        uint32_t    m_Max;
+        uint32_t    m_Last;
+    };
+
+    struct Context
+    {
+        dmHashTable32<TimingStat>  m_Scopes;
+        dmHashTable32<TimingStat>  m_Samples;
+        dmHashTable32<CounterStat> m_Counters;
+        uint32_t                   m_Frame;
+        uint32_t                   m_Warmup;
+        uint32_t                   m_Recorded;
+        float                      m_FrameTimeMin;
+        float                      m_FrameTimeMax;
+        double                     m_FrameTimeTotal;
+        // Memory sampled at the end of each recorded frame
+        uint64_t                   m_RSSMax;
+        uint64_t                   m_ActiveMax;
+        uint32_t                   m_AllocationCount;
+        uint32_t                   m_AllocationsMax;
+        uint64_t                   m_AllocationsTotal;
+    };
+
+    template <typename T>
+    static T* GetOrCreate(dmHashTable32<T>& table, uint32_t key, const T& initial)
+    {
+        T* value = table.Get(key);
+        if (value)
+            return value;
+        if (table.Full())
+        {
+            uint32_t capacity = table.Capacity() + 64;
+            table.SetCapacity(capacity / 2 + 1, capacity);
+        }
+        table.Put(key, initial);
+        return table.Get(key);
+    }
+
+    static void AddTiming(dmHashTable32<TimingStat>& table, uint32_t key, const char* scope, const char* name, uint32_t elapsed, uint32_t count)
+    {
+        TimingStat initial;
+        memset(&initial, 0, sizeof(initial));
+        initial.m_Scope = scope;
+        initial.m_Name = name;
+        TimingStat* stat = GetOrCreate(table, key, initial);
+        stat->m_FrameTicks += elapsed;
+        stat->m_Count += count;
+    }
+
+    static void EndFrameTiming(Context*, const uint32_t* key, TimingStat* stat)
+    {
+        if (stat->m_FrameTicks == 0)
+            return;
+        stat->m_TotalTicks += stat->m_FrameTicks;
+        stat->m_MaxFrameTicks = dmMath::Max(stat->m_MaxFrameTicks, stat->m_FrameTicks);
+        stat->m_FrameTicks = 0;
+        stat->m_Frames++;
+    }
+
+    static void ScopeCallback(void* context, const dmProfile::ScopeData* scope_data)
+    {
+        Context* ctx = (Context*) context;
+        if (scope_data->m_Count == 0)
+            return;
+        const dmProfile::Scope* scope = scope_data->m_Scope;
+        AddTiming(ctx->m_Scopes, scope->m_NameHash, scope->m_Name, 0x0, scope_data->m_Elapsed, scope_data->m_Count);
+    }
+
+    static void SampleCallback(void* context, const dmProfile::Sample* sample)
+    {
+        Context* ctx = (Context*) context;
+        uint32_t keys[2] = { sample->m_Scope->m_NameHash, sample->m_NameHash };
+        uint32_t key = dmHashBufferNoReverse32(keys, sizeof(keys));
+        AddTiming(ctx->m_Samples, key, sample->m_Scope->m_Name, sample->m_Name, sample->m_Elapsed, 1);
+    }
+
+    static void CounterCallback(void* context, const dmProfile::CounterData* counter_data)
+    {
+        Context* ctx = (Context*) context;
+        const dmProfile::Counter* counter = counter_data->m_Counter;
+        CounterStat initial;
+        memset(&initial, 0, sizeof(initial));
+        initial.m_Name = counter->m_Name;
+        CounterStat* stat = GetOrCreate(ctx->m_Counters, counter->m_NameHash, initial);
+        uint32_t value = (uint32_t) counter_data->m_Value;
+        stat->m_Total += value;
+        stat->m_Max = dmMath::Max(stat->m_Max, value);
+        stat->m_Last = value;
+    }
+
+    // Peak resident set size in bytes, 0 if not available on the platform
+    static uint64_t GetPeakRSS()
+    {
+#if defined(__linux__) || defined(__MACH__)
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+#if defined(__MACH__)
+        return (uint64_t) usage.ru_maxrss;
+#else
+        return (uint64_t) usage.ru_maxrss * 1024u;
+#endif
+#else
+        return 0;
+#endif
+    }
+
+    // Current resident set size in bytes, 0 if not available on the platform
+    static uint64_t GetCurrentRSS()
+    {
+#if defined(__MACH__)
+        mach_task_basic_info_data_t info;
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+        if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t) &info, &count) != KERN_SUCCESS)
+            return 0;
+        return (uint64_t) info.resident_size;
+#elif defined(__linux__)
+        FILE* f = fopen("/proc/self/statm", "r");
+        if (!f)
+            return 0;
+        unsigned long size = 0;
+        unsigned long resident = 0;
+        int n = fscanf(f, "%lu %lu", &size, &resident);
+        fclose(f);
+        if (n != 2)
+            return 0;
+        return (uint64_t) resident * (uint64_t) sysconf(_SC_PAGESIZE);
+#else
+        return 0;
+#endif
+    }
+
+    // The allocation stats are only available when running with the memprofile library preloaded
+    static void SampleMemory(Context* ctx)
+    {
+        ctx->m_RSSMax = dmMath::Max(ctx->m_RSSMax, GetCurrentRSS());
+        if (!dmMemProfile::IsEnabled())
+            return;
+        dmMemProfile::Stats stats;
+        dmMemProfile::GetStats(&stats);
+        ctx->m_ActiveMax = dmMath::Max(ctx->m_ActiveMax, (uint64_t) (uint32_t) stats.m_TotalActive);
+        uint32_t allocations = (uint32_t) stats.m_AllocationCount - ctx->m_AllocationCount;
+        ctx->m_AllocationCount = (uint32_t) stats.m_AllocationCount;
+        // The first recorded frame only sets the baseline
+        if (ctx->m_Recorded == 0)
+            return;
+        ctx->m_AllocationsMax = dmMath::Max(ctx->m_AllocationsMax, allocations);
+        ctx->m_AllocationsTotal += allocations;
+    }
+
+    // Invoked by the engine once per frame with the profile of the previous frame
+    static void ProfileCallback(void* context, dmProfile::HProfile profile)
+    {
+        Context* ctx = (Context*) context;
+        uint32_t frame = ctx->m_Frame++;
+        // The first callback carries the profile of the frame before the engine started stepping
+        if (profile == 0x0 || frame <= ctx->m_Warmup)
+            return;
+
+        dmProfile::IterateScopeData(profile, ctx, false, ScopeCallback);
+        dmProfile::IterateSamples(profile, ctx, false, SampleCallback);
+        dmProfile::IterateCounterData(profile, ctx, CounterCallback);
+
+        ctx->m_Scopes.Iterate(EndFrameTiming, ctx);
+        ctx->m_Samples.Iterate(EndFrameTiming, ctx);
+
+        float frame_time = dmProfile::GetFrameTime();
+        ctx->m_FrameTimeMin = ctx->m_Recorded == 0 ? frame_time : dmMath::Min(ctx->m_FrameTimeMin, frame_time);
+        ctx->m_FrameTimeMax = dmMath::Max(ctx->m_FrameTimeMax, frame_time);
+        ctx->m_FrameTimeTotal += frame_time;
+        SampleMemory(ctx);
+        ctx->m_Recorded++;
+    }
+
+    static void WriteString(FILE* out, const char* str)
+    {
+        fputc('"', out);
+        for (const char* c = str ? str : ""; *c; ++c)
+        {
+            switch (*c)
+            {
+                case '"':  fputs("\\\"", out); break;
+                case '\\': fputs("\\\\", out); break;
+                case '\n': fputs("\\n", out); break;
+                case '\t': fputs("\\t", out); break;
+                default:
+                    if ((unsigned char)*c < 0x20)
+                        fprintf(out, "\\u%04x", (unsigned char)*c);
+                    else
+                        fputc(*c, out);
+            }
+        }
+        fputc('"', out);
+    }
+
+    struct WriteContext
+    {
+        FILE*    m_Out;
+        double   m_MsPerTick;
+        uint32_t m_Frames;
+        bool     m_First;
+    };
+
+    static void WriteTiming(WriteContext* ctx, const uint32_t* key, TimingStat* stat)
+    {
+        FILE* out = ctx->m_Out;
+        fprintf(out, "%s\n    {\"scope\": ", ctx->m_First ? "" : ",");
+        WriteString(out, stat->m_Scope);
+        if (stat->m_Name)
+        {
+            fprintf(out, ", \"name\": ");
+            WriteString(out, stat->m_Name);
+        }
+        double total = stat->m_TotalTicks * ctx->m_MsPerTick;
+        fprintf(out, ", \"total_ms\": %.4f, \"avg_ms\": %.4f, \"max_ms\": %.4f, \"count\": %u, \"frames\": %u}",
+                total, ctx->m_Frames ? total / ctx->m_Frames : 0.0, stat->m_MaxFrameTicks * ctx->m_MsPerTick, stat->m_Count, stat->m_Frames);
+        ctx->m_First = false;
+    }
+
+    static void WriteCounter(WriteContext* ctx, const uint32_t* key, CounterStat* stat)
+    {
+        FILE* out = ctx->m_Out;
+        fprintf(out, "%s\n    {\"name\": ", ctx->m_First ? "" : ",");
+        WriteString(out, stat->m_Name);
+        fprintf(out, ", \"avg\": %.2f, \"max\": %u, \"last\": %u}",
+                ctx->m_Frames ? (double)stat->m_Total / ctx->m_Frames : 0.0, stat->m_Max, stat->m_Last);
+        ctx->m_First = false;
+    }
+
+    static bool WriteReport(Context* ctx, const char* path, uint32_t frames, uint32_t warmup)
+    {
+        FILE* out = path ? fopen(path, "wb") : stdout;
+        if (!out)
+        {
+            dmLogError("Unable to open '%s' for writing", path);
+            return false;
+        }
+
+        WriteContext wctx;
+        wctx.m_Out = out;
+        wctx.m_MsPerTick = 1000.0 / (double) dmProfile::GetTicksPerSecond();
+        wctx.m_Frames = ctx->m_Recorded;
+
+        fprintf(out, "{\n  \"frames\": %u,\n  \"warmup\": %u,\n  \"recorded_frames\": %u,\n", frames, warmup, ctx->m_Recorded);
+        fprintf(out, "  \"frame_time_ms\": {\"min\": %.4f, \"avg\": %.4f, \"max\": %.4f},\n",
+                ctx->m_FrameTimeMin, ctx->m_Recorded ? ctx->m_FrameTimeTotal / ctx->m_Recorded : 0.0, ctx->m_FrameTimeMax);
+        fprintf(out, "  \"memory\": {\"peak_rss\": %llu, \"rss\": %llu, \"max_frame_rss\": %llu",
+                (unsigned long long) GetPeakRSS(), (unsigned long long) GetCurrentRSS(), (unsigned long long) ctx->m_RSSMax);
+        if (dmMemProfile::IsEnabled())
+        {
+            dmMemProfile::Stats stats;
+            dmMemProfile::GetStats(&stats);
+            uint32_t alloc_frames = ctx->m_Recorded > 1 ? ctx->m_Recorded - 1 : 0;
+            fprintf(out, ", \"active\": %u, \"max_active\": %llu, \"total_allocated\": %u, \"allocation_count\": %u, \"allocations_per_frame\": {\"avg\": %.2f, \"max\": %u}",
+                    (uint32_t) stats.m_TotalActive, (unsigned long long) ctx->m_ActiveMax, (uint32_t) stats.m_TotalAllocated, (uint32_t) stats.m_AllocationCount,
+                    alloc_frames ? (double) ctx->m_AllocationsTotal / alloc_frames : 0.0, ctx->m_AllocationsMax);
+        }
+        fprintf(out, "},\n");
+
+        fprintf(out, "  \"scopes\": [");
+        wctx.m_First = true;
+        ctx->m_Scopes.Iterate(WriteTiming, &wctx);
+        fprintf(out, "\n  ],\n  \"samples\": [");
+        wctx.m_First = true;
+        ctx->m_Samples.Iterate(WriteTiming, &wctx);
+        fprintf(out, "\n  ],\n  \"counters\": [");
+        wctx.m_First = true;
+        ctx->m_Counters.Iterate(WriteCounter, &wctx);
+        fprintf(out, "\n  ]\n}\n");
+
+        if (out != stdout)
+            fclose(out);
+        return true;
+    }
+
+    static bool ParseUInt(const char* arg, const char* prefix, uint32_t* out)
+    {
+        size_t len = strlen(prefix);
+        if (strncmp(arg, prefix, len) != 0)
+            return false;
+        *out = (uint32_t) strtoul(arg + len, 0, 10);
+        return true;
+    }
+
+    static int Run(int argc, char* argv[])
+    {
+        uint32_t frames = DEFAULT_FRAMES;
+        uint32_t warmup = DEFAULT_WARMUP;
+        const char* output = 0x0;
+
+        // Fixed dt: with vsync enabled the engine steps with 1/update frequency, and the null
+        // adapter never throttles the frame. Later --config arguments still take precedence.
+        dmArray<char*> engine_argv;
+        engine_argv.SetCapacity(argc + 2);
+        engine_argv.Push(argv[0]);
+        engine_argv.Push((char*) "--config=display.vsync=1");
+        for (int i = 1; i < argc; ++i)
+        {
+            const char* arg = argv[i];
+            if (ParseUInt(arg, "--frames=", &frames) || ParseUInt(arg, "--warmup=", &warmup))
+                continue;
+            if (strncmp(arg, "--output=", 9) == 0)
+            {
+                output = arg + 9;
+                continue;
+            }
+            engine_argv.Push(argv[i]);
+        }
+
+        dmEngineInitialize();
+
+        dmEngine::HEngine engine = dmEngineCreate((int) engine_argv.Size(), engine_argv.Begin());
+        if (!engine)
+        {
+            dmEngineFinalize();
+            return 1;
+        }
+
+        Context ctx;
+        ctx.m_Scopes.SetCapacity(64, 128);
+        ctx.m_Samples.SetCapacity(256, 512);
+        ctx.m_Counters.SetCapacity(64, 128);
+        ctx.m_Frame = 0;
+        ctx.m_Warmup = warmup;
+        ctx.m_Recorded = 0;
+        ctx.m_FrameTimeMin = 0.0f;
+        ctx.m_FrameTimeMax = 0.0f;
+        ctx.m_FrameTimeTotal = 0.0;
+        ctx.m_RSSMax = 0;
+        ctx.m_ActiveMax = 0;
+        ctx.m_AllocationCount = 0;
+        ctx.m_AllocationsMax = 0;
+        ctx.m_AllocationsTotal = 0;
+
+        engine->m_ProfileCallback = ProfileCallback;
+        engine->m_ProfileCallbackCtx = &ctx;
+
+        // One extra step since each frame's profile is reported during the next one
+        uint32_t steps = warmup + frames + 1;
+        for (uint32_t i = 0; i < steps; ++i)
+        {
+            if (dmEngineUpdate(engine) != dmEngine::RESULT_OK)
+            {
+                dmLogWarning("Engine stopped after %u of %u frames", i, steps);
+                break;
+            }
+        }
+
+        bool ok = WriteReport(&ctx, output, frames, warmup);
+
+        engine->m_ProfileCallback = 0x0;
+        engine->m_ProfileCallbackCtx = 0x0;
+        dmEngineDestroy(engine);
+        dmEngineFinalize();
+        return ok ? 0 : 1;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    return dmEngineBenchmark::Run(argc, argv);
+}
@@ -0,0 +1,4 @@
+components {
+  id: "particlefx"
+  component: "/particles/fountain.particlefx"
+}
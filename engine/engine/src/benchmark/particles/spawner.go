@@ -0,0 +1,9 @@
+components {
+  id: "script"
+  component: "/particles/spawner.script"
+}
+embedded_components {
+  id: "factory"
+  type: "factory"
+  data: "prototype: \"/particles/emitter.go\""
+}
@@ -0,0 +1,4 @@
+components {
+  id: "co"
+  component: "/physics/body.collisionobject"
+}
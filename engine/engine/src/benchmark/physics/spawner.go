@@ -0,0 +1,9 @@
+components {
+  id: "script"
+  component: "/physics/spawner.script"
+}
+embedded_components {
+  id: "factory"
+  type: "factory"
+  data: "prototype: \"/physics/body.go\""
+}
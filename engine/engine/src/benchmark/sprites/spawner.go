@@ -0,0 +1,9 @@
+components {
+  id: "script"
+  component: "/sprites/spawner.script"
+}
+embedded_components {
+  id: "factory"
+  type: "factory"
+  data: "prototype: \"/sprites/sprite.go\""
+}
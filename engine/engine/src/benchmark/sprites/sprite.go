@@ -0,0 +1,5 @@
+embedded_components {
+  id: "sprite"
+  type: "sprite"
+  data: "tile_set: \"/shared/white.tilesource\"\ndefault_animation: \"anim\"\n"
+}
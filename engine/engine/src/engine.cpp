@@ -181,6 +181,12 @@ namespace dmEngine
 
     Stats::Stats()
     : m_FrameCount(0)
+    , m_SimTime(0)
+    , m_RenderTime(0)
+    , m_FlipTime(0)
+    , m_TotalSimTime(0)
+    , m_TotalRenderTime(0)
+    , m_TotalFlipTime(0)
     {
 
     }
@@ -210,10 +216,16 @@ namespace dmEngine
     , m_QuitOnEsc(false)
     , m_ConnectionAppMode(false)
     , m_RunWhileIconified(0)
+    , m_FixedUpdateFrequency(0)
+    , m_MaxFixedUpdates(5)
+    , m_FixedUpdateAccumulator(0.0f)
+    , m_GCStepBudget(0)
     , m_Width(960)
     , m_Height(640)
     , m_InvPhysicalWidth(1.0f/960)
     , m_InvPhysicalHeight(1.0f/640)
+    , m_ProfileCallback(0x0)
+    , m_ProfileCallbackCtx(0x0)
     {
         m_EngineService = engine_service;
         m_Register = dmGameObject::NewRegister();
@@ -304,10 +316,28 @@ namespace dmEngine
             }
         }
 
+        // The streamer loads from the factory, the textures are left as they are
+        if (engine->m_TextureContext.m_Streamer) {
+            dmGameSystem::DeleteTextureStreamer(engine->m_TextureContext.m_Streamer);
+            engine->m_TextureContext.m_Streamer = 0;
+            engine->m_SpriteContext.m_TextureStreamer = 0;
+            engine->m_GuiContext.m_TextureStreamer = 0;
+            engine->m_ParticleFXContext.m_TextureStreamer = 0;
+            engine->m_TilemapContext.m_TextureStreamer = 0;
+            engine->m_ModelContext.m_TextureStreamer = 0;
+            engine->m_MeshContext.m_TextureStreamer = 0;
+            engine->m_SpineModelContext.m_TextureStreamer = 0;
+        }
+
         if (engine->m_Factory) {
             dmResource::DeleteFactory(engine->m_Factory);
         }
 
+        if (engine->m_TextureContext.m_Decoder) {
+            dmGameSystem::DeleteTextureDecoder(engine->m_TextureContext.m_Decoder);
+            engine->m_TextureContext.m_Decoder = 0;
+        }
+
         if (engine->m_GraphicsContext)
         {
             dmGraphics::CloseWindow(engine->m_GraphicsContext);
@@ -715,6 +745,12 @@ namespace dmEngine
         SetUpdateFrequency(engine, update_frequency);
         SetSwapInterval(engine, swap_interval);
 
+        // Run the simulation at its own rate, and blend the transforms of the last two steps when rendering
+        engine->m_FixedUpdateFrequency = dmMath::Max(0, dmConfigFile::GetInt(engine->m_Config, "engine.fixed_update_frequency", 0));
+        engine->m_MaxFixedUpdates = dmMath::Max(1, dmConfigFile::GetInt(engine->m_Config, "engine.max_fixed_updates", 5));
+        engine->m_FixedUpdateAccumulator = 0.0f;
+        dmGameObject::SetInterpolateTransforms(engine->m_Register, engine->m_FixedUpdateFrequency > 0);
+
         const uint32_t max_resources = dmConfigFile::GetInt(engine->m_Config, dmResource::MAX_RESOURCES_KEY, 1024);
         dmResource::NewFactoryParams params;
         params.m_MaxResources = max_resources;
@@ -790,6 +826,16 @@ namespace dmEngine
             module_script_contexts.Push(engine->m_GuiScriptContext);
         }
 
+        // Collect garbage in the slack at the end of each frame rather than whenever the allocations trigger it
+        engine->m_GCStepBudget = dmMath::Max(0, dmConfigFile::GetInt(engine->m_Config, "script.gc_step_budget", 0));
+        if (engine->m_GCStepBudget > 0)
+        {
+            for (uint32_t i = 0; i < module_script_contexts.Size(); ++i)
+            {
+                dmScript::SetGCStepBudget(module_script_contexts[i], engine->m_GCStepBudget);
+            }
+        }
+
         dmHID::Init(engine->m_HidContext);
 
         dmSound::InitializeParams sound_params;
@@ -824,6 +870,7 @@ namespace dmEngine
         render_params.m_CommandBufferSize = 1024;
         render_params.m_ScriptContext = engine->m_RenderScriptContext;
         render_params.m_MaxDebugVertexCount = (uint32_t) dmConfigFile::GetInt(engine->m_Config, "graphics.max_debug_vertices", 10000);
+        render_params.m_FrameMemorySize = (uint32_t) dmConfigFile::GetInt(engine->m_Config, "graphics.frame_memory_size", 1024) * 1024;
         engine->m_RenderContext = dmRender::NewRenderContext(engine->m_GraphicsContext, render_params);
 
         dmGameObject::Initialize(engine->m_Register, engine->m_GOScriptContext);
@@ -930,7 +977,28 @@ namespace dmEngine
             dmPhysics::SetDebugCallbacks2D(engine->m_PhysicsContext.m_Context2D, debug_callbacks);
 #endif
 
+        engine->m_TextureContext.m_GraphicsContext = engine->m_GraphicsContext;
+        // Shared by all texture loads, the loading thread decodes too
+        engine->m_TextureContext.m_Decoder = dmGameSystem::NewTextureDecoder(dmConfigFile::GetInt(engine->m_Config, "graphics.texture_decode_threads", 2));
+        uint32_t texture_streaming_budget = dmConfigFile::GetInt(engine->m_Config, "graphics.texture_streaming_budget", 0);
+        if (texture_streaming_budget > 0)
+        {
+            dmGameSystem::TextureStreamerParams texture_streamer_params;
+            texture_streamer_params.m_Budget = texture_streaming_budget * 1024 * 1024;
+            texture_streamer_params.m_InitialSize = dmConfigFile::GetInt(engine->m_Config, "graphics.texture_streaming_initial_size", 64);
+            texture_streamer_params.m_Decoder = engine->m_TextureContext.m_Decoder;
+            engine->m_TextureContext.m_Streamer = dmGameSystem::NewTextureStreamer(engine->m_Factory, engine->m_GraphicsContext, texture_streamer_params);
+        }
+
         engine->m_SpriteContext.m_RenderContext = engine->m_RenderContext;
+        // Every component that draws textures reports them, so that shared textures aren't lowered while in use
+        engine->m_SpriteContext.m_TextureStreamer = engine->m_TextureContext.m_Streamer;
+        engine->m_GuiContext.m_TextureStreamer = engine->m_TextureContext.m_Streamer;
+        engine->m_ParticleFXContext.m_TextureStreamer = engine->m_TextureContext.m_Streamer;
+        engine->m_TilemapContext.m_TextureStreamer = engine->m_TextureContext.m_Streamer;
+        engine->m_ModelContext.m_TextureStreamer = engine->m_TextureContext.m_Streamer;
+        engine->m_MeshContext.m_TextureStreamer = engine->m_TextureContext.m_Streamer;
+        engine->m_SpineModelContext.m_TextureStreamer = engine->m_TextureContext.m_Streamer;
         engine->m_SpriteContext.m_MaxSpriteCount = dmConfigFile::GetInt(engine->m_Config, "sprite.max_count", 128);
         engine->m_SpriteContext.m_Subpixels = dmConfigFile::GetInt(engine->m_Config, "sprite.subpixels", 1);
 
@@ -981,7 +1049,7 @@ namespace dmEngine
         fact_result = dmGameObject::RegisterResourceTypes(engine->m_Factory, engine->m_Register, engine->m_GOScriptContext, &engine->m_ModuleContext);
         if (fact_result != dmResource::RESULT_OK)
             goto bail;
-        fact_result = dmGameSystem::RegisterResourceTypes(engine->m_Factory, engine->m_RenderContext, &engine->m_GuiContext, engine->m_InputContext, &engine->m_PhysicsContext);
+        fact_result = dmGameSystem::RegisterResourceTypes(engine->m_Factory, engine->m_RenderContext, &engine->m_GuiContext, engine->m_InputContext, &engine->m_PhysicsContext, &engine->m_TextureContext);
         if (fact_result != dmResource::RESULT_OK)
             goto bail;
 
@@ -1260,6 +1328,82 @@ bail:
         return memcount;
     }
 
+    // Spends the time left before the frame should be flipped on garbage collection, at most the configured budget
+    // per script context. Without any time left, each context still takes a minimal step to keep its heap in check.
+    static void StepLuaGC(HEngine engine, uint64_t target_frametime, uint64_t prev_flip_time)
+    {
+        DM_PROFILE(Engine, "LuaGC");
+        uint64_t frame_dt = dmTime::GetTime() - prev_flip_time + engine->m_PreviousRenderTime;
+        uint32_t slack = frame_dt < target_frametime ? (uint32_t)(target_frametime - frame_dt) : 0;
+
+        if (engine->m_SharedScriptContext)
+        {
+            uint32_t time = dmScript::StepGC(engine->m_SharedScriptContext, dmMath::Min(slack, engine->m_GCStepBudget));
+            DM_COUNTER("Lua.GC.Shared (us)", time);
+            return;
+        }
+
+        uint32_t slack_per_context = slack / 3;
+        uint32_t time = dmScript::StepGC(engine->m_GOScriptContext, dmMath::Min(slack_per_context, engine->m_GCStepBudget));
+        DM_COUNTER("Lua.GC.GO (us)", time);
+        time = dmScript::StepGC(engine->m_GuiScriptContext, dmMath::Min(slack_per_context, engine->m_GCStepBudget));
+        DM_COUNTER("Lua.GC.Gui (us)", time);
+        time = dmScript::StepGC(engine->m_RenderScriptContext, dmMath::Min(slack_per_context, engine->m_GCStepBudget));
+        DM_COUNTER("Lua.GC.Render (us)", time);
+    }
+
+    // Builds and draws the render list on the main thread, between the simulation and flip stages.
+    // Components draw straight from their worlds when the render list is dispatched, so the stages
+    // can't overlap with the next simulation step without a recorded copy of the render data.
+    static void RenderFrame(HEngine engine, float dt)
+    {
+        DM_PROFILE(Engine, "Render");
+
+        // Call pre render functions for extensions, if available.
+        // We do it here before we render rest of the frame
+        // if any extension wants to render on under of the game.
+        dmExtension::Params ext_params;
+        ext_params.m_ConfigFile = engine->m_Config;
+        if (engine->m_SharedScriptContext) {
+            ext_params.m_L = dmScript::GetLuaState(engine->m_SharedScriptContext);
+        } else {
+            ext_params.m_L = dmScript::GetLuaState(engine->m_GOScriptContext);
+        }
+        dmExtension::PreRender(&ext_params);
+
+        // Make the render list that will be used later.
+        dmRender::NewFrame(engine->m_RenderContext);
+        dmRender::RenderListBegin(engine->m_RenderContext);
+        dmGameObject::Render(engine->m_MainCollection);
+
+        // Make sure we dispatch messages to the render script
+        // since it could have some "draw_text" messages waiting.
+        if (engine->m_RenderScriptPrototype)
+        {
+            dmRender::DispatchRenderScriptInstance(engine->m_RenderScriptPrototype->m_Instance);
+        }
+
+        dmRender::RenderListEnd(engine->m_RenderContext);
+
+        dmGraphics::BeginFrame(engine->m_GraphicsContext);
+
+        if (engine->m_RenderScriptPrototype)
+        {
+            dmRender::UpdateRenderScriptInstance(engine->m_RenderScriptPrototype->m_Instance, dt);
+        }
+        else
+        {
+            dmGraphics::SetViewport(engine->m_GraphicsContext, 0, 0, dmGraphics::GetWindowWidth(engine->m_GraphicsContext), dmGraphics::GetWindowHeight(engine->m_GraphicsContext));
+            dmGraphics::Clear(engine->m_GraphicsContext, dmGraphics::BUFFER_TYPE_COLOR_BIT | dmGraphics::BUFFER_TYPE_DEPTH_BIT | dmGraphics::BUFFER_TYPE_STENCIL_BIT,
+                                (float)((engine->m_ClearColor>> 0)&0xFF),
+                                (float)((engine->m_ClearColor>> 8)&0xFF),
+                                (float)((engine->m_ClearColor>>16)&0xFF),
+                                (float)((engine->m_ClearColor>>24)&0xFF),
+                                1.0f, 0);
+            dmRender::DrawRenderList(engine->m_RenderContext, 0x0, 0x0);
+        }
+    }
+
     void Step(HEngine engine)
     {
         engine->m_Alive = true;
@@ -1273,16 +1417,20 @@ bail:
         float fps = engine->m_UpdateFrequency;
         float fixed_dt = 1.0f / fps;
         float dt = fixed_dt;
-        bool variable_dt = engine->m_UseVariableDt;
-        if (variable_dt && time > engine->m_PreviousFrameTime) {
-            dt = (float)((time - engine->m_PreviousFrameTime) * 0.000001);
+        float frame_time = fixed_dt;
+        if (time > engine->m_PreviousFrameTime) {
+            frame_time = (float)((time - engine->m_PreviousFrameTime) * 0.000001);
             // safety mechanism for crazy; GetTime() is not guaranteed to always
             // produce small deltas between calls, cap to 25 frames in one.
             const float max = fixed_dt * 25.0f;
-            if (dt > max) {
-                dt = max;
+            if (frame_time > max) {
+                frame_time = max;
             }
         }
+        bool variable_dt = engine->m_UseVariableDt;
+        if (variable_dt) {
+            dt = frame_time;
+        }
         engine->m_PreviousFrameTime = time;
 
         if (engine->m_Alive)
@@ -1334,9 +1482,14 @@ bail:
 
                 {
                     DM_PROFILE(Engine, "Sim");
+                    uint64_t sim_time_start = dmTime::GetTime();
 
                     dmLiveUpdate::Update();
                     dmResource::UpdateFactory(engine->m_Factory);
+                    if (engine->m_TextureContext.m_Streamer)
+                    {
+                        dmGameSystem::UpdateTextureStreamer(engine->m_TextureContext.m_Streamer);
+                    }
 
                     dmHID::Update(engine->m_HidContext);
                     if (!engine->m_RunWhileIconified) {
@@ -1401,56 +1554,46 @@ bail:
                     }
 
 
-                    dmGameObject::UpdateContext update_context;
-                    update_context.m_DT = dt;
-                    dmGameObject::Update(engine->m_MainCollection, &update_context);
-
-                    // Don't render while iconified
-                    if (!dmGraphics::GetWindowState(engine->m_GraphicsContext, dmGraphics::WINDOW_STATE_ICONIFIED))
+                    uint32_t sim_steps = 1;
+                    float sim_dt = dt;
+                    if (engine->m_FixedUpdateFrequency > 0)
                     {
-                        // Call pre render functions for extensions, if available.
-                        // We do it here before we render rest of the frame
-                        // if any extension wants to render on under of the game.
-                        dmExtension::Params ext_params;
-                        ext_params.m_ConfigFile = engine->m_Config;
-                        if (engine->m_SharedScriptContext) {
-                            ext_params.m_L = dmScript::GetLuaState(engine->m_SharedScriptContext);
-                        } else {
-                            ext_params.m_L = dmScript::GetLuaState(engine->m_GOScriptContext);
-                        }
-                        dmExtension::PreRender(&ext_params);
-
-                        // Make the render list that will be used later.
-                        dmRender::RenderListBegin(engine->m_RenderContext);
-                        dmGameObject::Render(engine->m_MainCollection);
-
-                        // Make sure we dispatch messages to the render script
-                        // since it could have some "draw_text" messages waiting.
-                        if (engine->m_RenderScriptPrototype)
+                        sim_dt = 1.0f / engine->m_FixedUpdateFrequency;
+                        engine->m_FixedUpdateAccumulator += frame_time;
+                        sim_steps = (uint32_t)(engine->m_FixedUpdateAccumulator / sim_dt);
+                        if (sim_steps > engine->m_MaxFixedUpdates)
                         {
-                            dmRender::DispatchRenderScriptInstance(engine->m_RenderScriptPrototype->m_Instance);
+                            // Drop the time we can't catch up with, rather than falling further behind every frame
+                            sim_steps = engine->m_MaxFixedUpdates;
+                            engine->m_FixedUpdateAccumulator = sim_steps * sim_dt;
                         }
+                        engine->m_FixedUpdateAccumulator -= sim_steps * sim_dt;
+                        dmGameObject::SetRenderInterpolation(engine->m_Register, engine->m_FixedUpdateAccumulator / sim_dt);
+                    }
+                    DM_COUNTER("Engine.SimSteps", sim_steps);
 
-                        dmRender::RenderListEnd(engine->m_RenderContext);
-
-                        dmGraphics::BeginFrame(engine->m_GraphicsContext);
-
-                        if (engine->m_RenderScriptPrototype)
-                        {
-                            dmRender::UpdateRenderScriptInstance(engine->m_RenderScriptPrototype->m_Instance, dt);
-                        }
-                        else
+                    dmGameObject::UpdateContext update_context;
+                    update_context.m_DT = sim_dt;
+                    for (uint32_t i = 0; i < sim_steps; ++i)
+                    {
+                        if (i > 0)
                         {
-                            dmGraphics::SetViewport(engine->m_GraphicsContext, 0, 0, dmGraphics::GetWindowWidth(engine->m_GraphicsContext), dmGraphics::GetWindowHeight(engine->m_GraphicsContext));
-                            dmGraphics::Clear(engine->m_GraphicsContext, dmGraphics::BUFFER_TYPE_COLOR_BIT | dmGraphics::BUFFER_TYPE_DEPTH_BIT | dmGraphics::BUFFER_TYPE_STENCIL_BIT,
-                                                (float)((engine->m_ClearColor>> 0)&0xFF),
-                                                (float)((engine->m_ClearColor>> 8)&0xFF),
-                                                (float)((engine->m_ClearColor>>16)&0xFF),
-                                                (float)((engine->m_ClearColor>>24)&0xFF),
-                                                1.0f, 0);
-                            dmRender::DrawRenderList(engine->m_RenderContext, 0x0, 0x0);
+                            // Finish the previous step, the last one is finished after rendering
+                            dmGameObject::PostUpdate(engine->m_MainCollection);
+                            dmGameObject::PostUpdate(engine->m_Register);
                         }
+                        dmGameObject::Update(engine->m_MainCollection, &update_context);
+                    }
+
+                    // Don't render while iconified
+                    uint64_t render_time = 0;
+                    if (!dmGraphics::GetWindowState(engine->m_GraphicsContext, dmGraphics::WINDOW_STATE_ICONIFIED))
+                    {
+                        uint64_t render_time_start = dmTime::GetTime();
+                        RenderFrame(engine, dt);
+                        render_time = dmTime::GetTime() - render_time_start;
                     }
+                    engine->m_Stats.m_RenderTime = (uint32_t)render_time;
 
                     dmGameObject::PostUpdate(engine->m_MainCollection);
                     dmGameObject::PostUpdate(engine->m_Register);
@@ -1459,6 +1602,8 @@ bail:
 
 
                     dmMessage::Dispatch(engine->m_SystemSocket, Dispatch, engine);
+
+                    engine->m_Stats.m_SimTime = (uint32_t)(dmTime::GetTime() - sim_time_start - render_time);
                 }
 
                 DM_COUNTER("Lua.Refs", dmScript::GetLuaRefCount());
@@ -1477,6 +1622,11 @@ bail:
                     dmEngineService::Update(engine->m_EngineService, profile);
                 }
 
+                if (engine->m_ProfileCallback)
+                {
+                    engine->m_ProfileCallback(engine->m_ProfileCallbackCtx, profile);
+                }
+
                 dmProfiler::RenderProfiler(profile, engine->m_GraphicsContext, engine->m_RenderContext, engine->m_SystemFontMap);
 
                 // Call post render functions for extensions, if available.
@@ -1495,6 +1645,11 @@ bail:
                     dmExtension::PostRender(&ext_params);
                 }
 
+                if (engine->m_GCStepBudget > 0)
+                {
+                    StepLuaGC(engine, target_frametime, prev_flip_time);
+                }
+
                 if (engine->m_UseSwVsync)
                 {
                     uint64_t flip_dt = dmTime::GetTime() - prev_flip_time;
@@ -1517,6 +1672,15 @@ bail:
 
                 engine->m_FlipTime = dmTime::GetTime();
                 engine->m_PreviousRenderTime = engine->m_FlipTime - flip_time_start;
+                engine->m_Stats.m_FlipTime = (uint32_t)engine->m_PreviousRenderTime;
+
+                engine->m_Stats.m_TotalSimTime += engine->m_Stats.m_SimTime;
+                engine->m_Stats.m_TotalRenderTime += engine->m_Stats.m_RenderTime;
+                engine->m_Stats.m_TotalFlipTime += engine->m_Stats.m_FlipTime;
+
+                DM_COUNTER("Engine.Sim (us)", engine->m_Stats.m_SimTime);
+                DM_COUNTER("Engine.Render (us)", engine->m_Stats.m_RenderTime);
+                DM_COUNTER("Engine.Flip (us)", engine->m_Stats.m_FlipTime);
 
                 RecordData* record_data = &engine->m_RecordData;
                 if (record_data->m_Recorder)
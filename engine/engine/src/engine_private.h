@@ -18,6 +18,7 @@
 #include <dlib/configfile.h>
 #include <dlib/hashtable.h>
 #include <dlib/message.h>
+#include <dlib/profile.h>
 
 #include <resource/resource.h>
 
@@ -82,6 +83,14 @@ namespace dmEngine
         Stats();
 
         uint32_t m_FrameCount;
+        // Time (us) spent in each stage of the last frame
+        uint32_t m_SimTime;
+        uint32_t m_RenderTime;
+        uint32_t m_FlipTime;
+        // Time (us) spent in each stage over all frames
+        uint64_t m_TotalSimTime;
+        uint64_t m_TotalRenderTime;
+        uint64_t m_TotalFlipTime;
     };
 
     struct RecordData
@@ -134,6 +143,7 @@ namespace dmEngine
         dmResource::HFactory                        m_Factory;
         dmGameSystem::GuiContext                    m_GuiContext;
         dmMessage::HSocket                          m_SystemSocket;
+        dmGameSystem::TextureContext                m_TextureContext;
         dmGameSystem::SpriteContext                 m_SpriteContext;
         dmGameSystem::CollectionProxyContext        m_CollectionProxyContext;
         dmGameSystem::FactoryContext                m_FactoryContext;
@@ -166,6 +176,10 @@ namespace dmEngine
         uint64_t                                    m_PreviousRenderTime;
         uint64_t                                    m_FlipTime;
         uint32_t                                    m_UpdateFrequency;
+        uint32_t                                    m_FixedUpdateFrequency;     //!< Simulation steps per second, independent of the frame rate. 0 to update once per frame
+        uint32_t                                    m_MaxFixedUpdates;          //!< Max simulation steps in one frame, time beyond that is dropped
+        float                                       m_FixedUpdateAccumulator;   //!< Time not yet simulated, in seconds
+        uint32_t                                    m_GCStepBudget;             //!< Lua garbage collection time per script context and frame, in microseconds. 0 for automatic collection
         uint32_t                                    m_Width;
         uint32_t                                    m_Height;
         uint32_t                                    m_ClearColor;
@@ -174,6 +188,10 @@ namespace dmEngine
         Vsync                                       m_VsyncMode;
 
         RecordData                                  m_RecordData;
+
+        /// Optional per-frame hook, invoked with the profile of the previous frame. Used by the benchmark runner.
+        void                                        (*m_ProfileCallback)(void* ctx, dmProfile::HProfile profile);
+        void*                                       m_ProfileCallbackCtx;
     };
 
 
@@ -16,6 +16,7 @@
 #include <dlib/thread.h>
 #include <dlib/dstrings.h>
 #include <dlib/profile.h>
+#include <dlib/time.h>
 #include "test_engine.h"
 #include "../../../graphics/src/graphics_private.h"
 #include "../engine.h"
@@ -120,6 +121,26 @@ TEST_F(EngineTest, Project)
     ASSERT_GT(frame_count, 5u);
 }
 
+static void PostRunStats(dmEngine::HEngine engine, void* ctx)
+{
+    *((dmEngine::Stats*) ctx) = engine->m_Stats;
+}
+
+TEST_F(EngineTest, StageTimes)
+{
+    dmEngine::Stats stats;
+    const char* argv[] = {"test_engine", "--config=dmengine.unload_builtins=0", CONTENT_ROOT "/game.projectc"};
+    uint64_t start = dmTime::GetTime();
+    ASSERT_EQ(0, Launch(sizeof(argv)/sizeof(argv[0]), (char**)argv, 0, PostRunStats, &stats));
+    uint64_t elapsed = dmTime::GetTime() - start;
+    ASSERT_GT(stats.m_FrameCount, 5u);
+    // The null graphics adapter is fast, but the simulation and rendering of all frames should not be free
+    ASSERT_GT(stats.m_TotalSimTime, 0u);
+    ASSERT_GT(stats.m_TotalRenderTime, 0u);
+    // The stages run one after the other on the main thread and don't overlap
+    ASSERT_LE(stats.m_TotalSimTime + stats.m_TotalRenderTime + stats.m_TotalFlipTime, elapsed);
+}
+
 TEST_F(EngineTest, SharedLuaState)
 {
     uint32_t frame_count = 0;
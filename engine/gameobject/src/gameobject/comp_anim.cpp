@@ -39,14 +39,9 @@ namespace dmGameObject
         dmhash_t            m_ComponentId;
         dmhash_t            m_PropertyId;
         Playback            m_Playback;
-        dmEasing::Curve     m_Easing;
+        PropertyType        m_PropertyType;
         float*              m_Value;
-        float               m_From;
-        float               m_To;
         float               m_Delay;
-        float               m_Cursor;
-        float               m_Duration;
-        float               m_InvDuration;
         AnimationStopped    m_AnimationStopped;
         void*               m_Userdata1;
         void*               m_Userdata2;
@@ -54,16 +49,35 @@ namespace dmGameObject
         uint16_t            m_NextListener;
         uint16_t            m_Index;
         uint16_t            m_Next;
+        /// Composite: element animations that are written as one property (map indices), see WriteElementGroup
+        uint16_t            m_Elements[4];
+        /// Element: the composite animation (map index)
+        uint16_t            m_Parent;
+        uint16_t            m_ElementCount : 3;
         uint16_t            m_Playing : 1;
         uint16_t            m_Finished : 1;
         uint16_t            m_Composite : 1;
         uint16_t            m_Backwards : 1;
         uint16_t            m_FirstUpdate : 1;
+        uint16_t            m_Evaluated : 1;
+        uint16_t            m_Written : 1;
     };
 
     struct AnimWorld
     {
         dmArray<Animation>                  m_Animations;
+        // The evaluation state is kept in arrays parallel to m_Animations,
+        // so that the easing and interpolation can be done in batches
+        dmArray<dmEasing::Curve>            m_Easing;
+        dmArray<float>                      m_From;
+        dmArray<float>                      m_To;
+        dmArray<float>                      m_Cursor;
+        dmArray<float>                      m_Duration;
+        dmArray<float>                      m_InvDuration;
+        dmArray<float>                      m_Time;
+        // Scratch lists rebuilt each update
+        dmArray<uint16_t>                   m_EvalIndices;
+        dmArray<uint16_t>                   m_GroupIndices;
         dmArray<uint16_t>                   m_AnimMap;
         dmIndexPool<uint16_t>               m_AnimMapIndexPool;
         dmHashTable<uintptr_t, uint16_t>    m_InstanceToIndex;
@@ -71,6 +85,51 @@ namespace dmGameObject
         uint32_t                            m_InUpdate : 1;
     };
 
+    static void SetAnimationCapacity(AnimWorld* world, uint32_t capacity)
+    {
+        world->m_Animations.SetCapacity(capacity);
+        world->m_Easing.SetCapacity(capacity);
+        world->m_From.SetCapacity(capacity);
+        world->m_To.SetCapacity(capacity);
+        world->m_Cursor.SetCapacity(capacity);
+        world->m_Duration.SetCapacity(capacity);
+        world->m_InvDuration.SetCapacity(capacity);
+        world->m_Time.SetCapacity(capacity);
+        world->m_EvalIndices.SetCapacity(capacity);
+        world->m_GroupIndices.SetCapacity(capacity);
+    }
+
+    static void SetAnimationCount(AnimWorld* world, uint32_t count)
+    {
+        world->m_Animations.SetSize(count);
+        world->m_Easing.SetSize(count);
+        world->m_From.SetSize(count);
+        world->m_To.SetSize(count);
+        world->m_Cursor.SetSize(count);
+        world->m_Duration.SetSize(count);
+        world->m_InvDuration.SetSize(count);
+        world->m_Time.SetSize(count);
+    }
+
+    // Returns the animation that was moved into the erased slot
+    static Animation* EraseAnimation(AnimWorld* world, uint32_t anim_index)
+    {
+        Animation* anim = &world->m_Animations.EraseSwap(anim_index);
+        world->m_Easing.EraseSwap(anim_index);
+        world->m_From.EraseSwap(anim_index);
+        world->m_To.EraseSwap(anim_index);
+        world->m_Cursor.EraseSwap(anim_index);
+        world->m_Duration.EraseSwap(anim_index);
+        world->m_InvDuration.EraseSwap(anim_index);
+        world->m_Time.EraseSwap(anim_index);
+        if (world->m_Animations.Size() > anim_index)
+        {
+            // We swapped, anim points to the swapped animation, update its map
+            world->m_AnimMap[anim->m_Index] = anim_index;
+        }
+        return anim;
+    }
+
     CreateResult CompAnimNewWorld(const ComponentNewWorldParams& params)
     {
         if (params.m_World != 0x0)
@@ -78,7 +137,7 @@ namespace dmGameObject
             AnimWorld* world = new AnimWorld();
             *params.m_World = world;
             const uint32_t anim_count = 512;
-            world->m_Animations.SetCapacity(anim_count);
+            SetAnimationCapacity(world, anim_count);
             world->m_AnimMap.SetCapacity(MAX_CAPACITY);
             world->m_AnimMap.SetSize(MAX_CAPACITY);
             world->m_AnimMapIndexPool.SetCapacity(MAX_CAPACITY);
@@ -153,6 +212,49 @@ namespace dmGameObject
         return CREATE_RESULT_OK;
     }
 
+    // Writes the element animations of a composite as one property, if they were all evaluated this frame
+    static void WriteElementGroup(AnimWorld* world, uint16_t anim_index)
+    {
+        Animation& anim = world->m_Animations[anim_index];
+        const uint32_t size = world->m_Animations.Size();
+        const uint32_t element_count = anim.m_ElementCount;
+        Animation* elements[4];
+        float v[4];
+        for (uint32_t i = 0; i < element_count; ++i)
+        {
+            uint16_t element_index = world->m_AnimMap[anim.m_Elements[i]];
+            if (element_index >= size)
+                return;
+            Animation* element = &world->m_Animations[element_index];
+            // The element might have been removed, and its index reused
+            if (element->m_Index != anim.m_Elements[i] || element->m_Parent != anim.m_Index || !element->m_Evaluated)
+                return;
+            elements[i] = element;
+            v[i] = world->m_Time[element_index];
+        }
+
+        PropertyVar var;
+        switch (anim.m_PropertyType)
+        {
+        case PROPERTY_TYPE_VECTOR3:
+            var = PropertyVar(Vector3(v[0], v[1], v[2]));
+            break;
+        case PROPERTY_TYPE_VECTOR4:
+            var = PropertyVar(Vector4(v[0], v[1], v[2], v[3]));
+            break;
+        case PROPERTY_TYPE_QUAT:
+            var = PropertyVar(Quat(v[0], v[1], v[2], v[3]));
+            break;
+        default:
+            return;
+        }
+        SetProperty(anim.m_Instance, anim.m_ComponentId, anim.m_PropertyId, var);
+        for (uint32_t i = 0; i < element_count; ++i)
+        {
+            elements[i]->m_Written = 1;
+        }
+    }
+
     UpdateResult CompAnimUpdate(const ComponentsUpdateParams& params, ComponentsUpdateResult& update_result)
     {
         DM_PROFILE(Animation, "Update");
@@ -167,7 +269,10 @@ namespace dmGameObject
          * have an incorrect value when read by the newly started animation to
          * retrieve the from-value.
          *
-         * The second pass advances and evaluates the animations.
+         * The second pass advances and evaluates the animations. The cursors are
+         * advanced per animation, after which the easing curves and the interpolation
+         * are evaluated in batch over the evaluation state arrays. Finally the values are
+         * written, where the elements of a composite are written as a single property when possible.
          *
          * The third pass prunes stopped animations and call callbacks.
          *
@@ -198,12 +303,12 @@ namespace dmGameObject
                 if (!anim.m_Composite)
                 {
                     if (anim.m_Value != 0x0)
-                        anim.m_From = *anim.m_Value;
+                        world->m_From[i] = *anim.m_Value;
                     else
                     {
                         PropertyDesc desc;
                         GetProperty(anim.m_Instance, anim.m_ComponentId, anim.m_PropertyId, desc);
-                        anim.m_From = (float)desc.m_Variant.m_Number;
+                        world->m_From[i] = (float)desc.m_Variant.m_Number;
                     }
                 }
                 // Cancel other currently playing animations
@@ -225,10 +330,21 @@ namespace dmGameObject
                 }
             }
         }
+
+        float* from = world->m_From.Begin();
+        float* to = world->m_To.Begin();
+        float* cursor = world->m_Cursor.Begin();
+        float* duration = world->m_Duration.Begin();
+        float* inv_duration = world->m_InvDuration.Begin();
+        float* time = world->m_Time.Begin();
+        world->m_EvalIndices.SetSize(0);
+        world->m_GroupIndices.SetSize(0);
         i = 0;
         for (i = 0; i < size; ++i)
         {
             Animation& anim = world->m_Animations[i];
+            anim.m_Evaluated = 0;
+            anim.m_Written = 0;
             // Ignore canceled or delayed animations
             if (!anim.m_Playing)
                 continue;
@@ -245,7 +361,7 @@ namespace dmGameObject
             // Advance cursor
             if (anim.m_Playback != PLAYBACK_NONE)
             {
-                anim.m_Cursor += dt;
+                cursor[i] += dt;
             }
             // Adjust cursor
             bool completed = false;
@@ -255,28 +371,28 @@ namespace dmGameObject
             case PLAYBACK_ONCE_FORWARD:
             case PLAYBACK_ONCE_BACKWARD:
             case PLAYBACK_ONCE_PINGPONG:
-                if (anim.m_Cursor >= anim.m_Duration)
+                if (cursor[i] >= duration[i])
                 {
-                    anim.m_Cursor = anim.m_Duration;
+                    cursor[i] = duration[i];
                     completed = true;
                 }
                 break;
             case PLAYBACK_LOOP_FORWARD:
             case PLAYBACK_LOOP_BACKWARD:
-                if (anim.m_Duration > 0)
+                if (duration[i] > 0)
                 {
-                    while (anim.m_Cursor >= anim.m_Duration)
+                    while (cursor[i] >= duration[i])
                     {
-                        anim.m_Cursor -= anim.m_Duration;
+                        cursor[i] -= duration[i];
                     }
                 }
                 break;
             case PLAYBACK_LOOP_PINGPONG:
-                if (anim.m_Duration > 0)
+                if (duration[i] > 0)
                 {
-                    while (anim.m_Cursor >= anim.m_Duration)
+                    while (cursor[i] >= duration[i])
                     {
-                        anim.m_Cursor -= anim.m_Duration;
+                        cursor[i] -= duration[i];
                         anim.m_Backwards = ~anim.m_Backwards;
                     }
                 }
@@ -285,36 +401,65 @@ namespace dmGameObject
                 break;
             }
 
-            // Evaluate animation
+            // Normalized time, the easing is evaluated in batch below
+            float t = 1.0f;
+            if (cursor[i] < duration[i])
+                t = dmMath::Clamp(cursor[i] * inv_duration[i], 0.0f, 1.0f);
+            if (anim.m_Backwards)
+                t = 1.0f - t;
+            if (anim.m_Playback == PLAYBACK_ONCE_PINGPONG || anim.m_Playback == PLAYBACK_LOOP_PINGPONG) {
+                t *= 2.0f;
+                if (t > 1.0f) {
+                    t = 2.0f - t;
+                }
+            }
+            time[i] = t;
+            anim.m_Evaluated = 1;
             if (!anim.m_Composite)
             {
-                float t = 1.0f;
-                if (anim.m_Cursor < anim.m_Duration)
-                    t = dmMath::Clamp(anim.m_Cursor * anim.m_InvDuration, 0.0f, 1.0f);
-                if (anim.m_Backwards)
-                    t = 1.0f - t;
-                if (anim.m_Playback == PLAYBACK_ONCE_PINGPONG || anim.m_Playback == PLAYBACK_LOOP_PINGPONG) {
-                    t *= 2.0f;
-                    if (t > 1.0f) {
-                        t = 2.0f - t;
-                    }
-                }
-                t = dmEasing::GetValue(anim.m_Easing, t);
-                float v = anim.m_From + (anim.m_To - anim.m_From) * t;
-                if (anim.m_Value != 0x0)
-                {
-                    *anim.m_Value = v;
-                }
-                else
-                {
-                    SetProperty(anim.m_Instance, anim.m_ComponentId, anim.m_PropertyId, PropertyVar(v));
-                }
+                world->m_EvalIndices.Push((uint16_t)i);
+            }
+            else if (anim.m_ElementCount > 0)
+            {
+                world->m_GroupIndices.Push((uint16_t)i);
             }
             if (completed)
             {
                 StopAnimation(&anim, true);
             }
         }
+
+        // Evaluate all animations, those not evaluated this frame are simply not written
+        dmEasing::GetValues(world->m_Easing.Begin(), time, time, size);
+        for (i = 0; i < size; ++i)
+        {
+            time[i] = from[i] + (to[i] - from[i]) * time[i];
+        }
+
+        uint32_t group_count = world->m_GroupIndices.Size();
+        for (i = 0; i < group_count; ++i)
+        {
+            WriteElementGroup(world, world->m_GroupIndices[i]);
+        }
+
+        uint32_t eval_count = world->m_EvalIndices.Size();
+        for (i = 0; i < eval_count; ++i)
+        {
+            uint16_t anim_index = world->m_EvalIndices[i];
+            Animation& anim = world->m_Animations[anim_index];
+            if (anim.m_Written)
+                continue;
+            float v = time[anim_index];
+            if (anim.m_Value != 0x0)
+            {
+                *anim.m_Value = v;
+            }
+            else
+            {
+                SetProperty(anim.m_Instance, anim.m_ComponentId, anim.m_PropertyId, PropertyVar(v));
+            }
+        }
+
         i = 0;
         // Prune canceled animations and call callbacks
         while (i < size)
@@ -333,9 +478,10 @@ namespace dmGameObject
                         anim = &world->m_Animations[i];
                     RemoveAnimationCallback(world, anim);
 
-                    if (anim->m_Easing.release_callback != 0x0)
+                    dmEasing::Curve& easing = world->m_Easing[i];
+                    if (easing.release_callback != 0x0)
                     {
-                        anim->m_Easing.release_callback(&anim->m_Easing);
+                        easing.release_callback(&easing);
                     }
                 }
                 uint16_t* head_ptr = world->m_InstanceToIndex.Get((uintptr_t)anim->m_Instance);
@@ -359,13 +505,8 @@ namespace dmGameObject
                     world->m_InstanceToIndex.Erase((uintptr_t)anim->m_Instance);
                 }
                 // delete the instance from the list
-                anim = &world->m_Animations.EraseSwap(i);
+                EraseAnimation(world, i);
                 --size;
-                if (size > i)
-                {
-                    // We swapped, anim points to the swapped animation, update its map
-                    world->m_AnimMap[anim->m_Index] = i;
-                }
             }
             else
             {
@@ -435,10 +576,10 @@ namespace dmGameObject
             uint32_t capacity = world->m_Animations.Capacity();
             uint32_t growth = dmMath::Min(MIN_CAPACITY_GROWTH, (MIN_CAPACITY_GROWTH + capacity / 2) / 2);
             capacity = dmMath::Min(capacity + growth, MAX_CAPACITY);
-            world->m_Animations.SetCapacity(capacity);
+            SetAnimationCapacity(world, capacity);
         }
         uint32_t anim_count = top + 1;
-        world->m_Animations.SetSize(anim_count);
+        SetAnimationCount(world, anim_count);
 
         Animation& animation = world->m_Animations[top];
         memset(&animation, 0, sizeof(Animation));
@@ -450,15 +591,18 @@ namespace dmGameObject
         animation.m_ComponentId = component_id;
         animation.m_PropertyId = property_id;
         animation.m_Playback = playback;
-        animation.m_Easing = easing;
         animation.m_Value = value;
-        animation.m_From = from;
-        animation.m_To = to;
         animation.m_Delay = dmMath::Max(delay, 0.0f);
-        animation.m_Duration = dmMath::Max(duration, 0.0f);
-        animation.m_InvDuration = 0.0f;
-        if (animation.m_Duration > 0.0f)
-            animation.m_InvDuration = 1.0f / animation.m_Duration;
+        animation.m_Parent = INVALID_INDEX;
+        world->m_Easing[top] = easing;
+        world->m_From[top] = from;
+        world->m_To[top] = to;
+        world->m_Cursor[top] = 0.0f;
+        world->m_Duration[top] = dmMath::Max(duration, 0.0f);
+        world->m_InvDuration[top] = 0.0f;
+        if (world->m_Duration[top] > 0.0f)
+            world->m_InvDuration[top] = 1.0f / world->m_Duration[top];
+        world->m_Time[top] = 0.0f;
         animation.m_AnimationStopped = animation_stopped;
         animation.m_Userdata1 = userdata1;
         animation.m_Userdata2 = userdata2;
@@ -567,6 +711,8 @@ namespace dmGameObject
             if (!PlayCompositeAnimation(world, instance, component_id, property_id, playback,
                     duration, delay, easing, animation_stopped, userdata1, userdata2))
                 return PROPERTY_RESULT_BUFFER_OVERFLOW;
+            uint16_t composite_index = world->m_Animations.Back().m_Index;
+            world->m_Animations.Back().m_PropertyType = prop_desc.m_Variant.m_Type;
 
             // Clear the release_callback for element animation to make sure we only call it once in the composite animation
             easing.release_callback = 0x0;
@@ -579,6 +725,15 @@ namespace dmGameObject
                 if (!PlayAnimation(world, instance, component_id, prop_desc.m_ElementIds[i], playback, val_ptr,
                         *(v + i), to.m_V4[i], easing, duration, delay, 0x0, 0x0, 0x0, false))
                     return PROPERTY_RESULT_BUFFER_OVERFLOW;
+                // Elements without a value pointer are set through the component, group them so they can be set as one property
+                if (val_ptr == 0x0)
+                {
+                    Animation& element = world->m_Animations.Back();
+                    element.m_Parent = composite_index;
+                    Animation& composite = world->m_Animations[world->m_AnimMap[composite_index]];
+                    composite.m_Elements[i] = element.m_Index;
+                    composite.m_ElementCount = i + 1;
+                }
             }
         }
         else
@@ -633,7 +788,6 @@ namespace dmGameObject
             uint16_t* head_ptr = world->m_InstanceToIndex.Get((uintptr_t)instance);
             if (head_ptr != 0x0)
             {
-                uint32_t anim_count = world->m_Animations.Size();
                 uint16_t index = *head_ptr;
                 while (index != INVALID_INDEX)
                 {
@@ -646,21 +800,16 @@ namespace dmGameObject
                                 anim->m_Userdata1, anim->m_Userdata2);
                         RemoveAnimationCallback(world, anim);
                     }
-                    if (anim->m_Easing.release_callback != 0x0)
+                    anim_index = (uint16_t)(anim - world->m_Animations.Begin());
+                    dmEasing::Curve& easing = world->m_Easing[anim_index];
+                    if (easing.release_callback != 0x0)
                     {
-                        anim->m_Easing.release_callback(&anim->m_Easing);
+                        easing.release_callback(&easing);
                     }
                     world->m_AnimMapIndexPool.Push(index);
                     index = anim->m_Next;
                     // delete the instance from the list
-                    anim_index = (uint16_t)(anim - world->m_Animations.Begin());
-                    anim = &world->m_Animations.EraseSwap(anim_index);
-                    --anim_count;
-                    if (anim_count > anim_index)
-                    {
-                        // We swapped, anim points to the swapped animation, update its map
-                        world->m_AnimMap[anim->m_Index] = anim_index;
-                    }
+                    EraseAnimation(world, anim_index);
                 }
                 world->m_InstanceToIndex.Erase((uintptr_t)instance);
             }
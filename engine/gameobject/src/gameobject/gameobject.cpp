@@ -79,6 +79,7 @@ namespace dmGameObject
 
     static Collection* AllocCollection(const char* name, HRegister regist, uint32_t max_instances);
     static void DeallocCollection(Collection* collection);
+    static void FreePooledInstances(Collection* collection);
     static bool InitCollection(Collection* collection);
     static bool FinalCollection(Collection* collection);
 
@@ -164,6 +165,8 @@ namespace dmGameObject
         m_DefaultInputStackCapacity = DEFAULT_MAX_INPUT_STACK_CAPACITY;
         m_Mutex = dmMutex::New();
         m_SocketToCollection.SetCapacity(15, 17);
+        m_RenderInterpolation = 1.0f;
+        m_InterpolateTransforms = 0;
     }
 
     Register::~Register()
@@ -302,6 +305,7 @@ namespace dmGameObject
             if (regist->m_ComponentTypes[i].m_DeleteWorldFunction)
                 regist->m_ComponentTypes[i].m_DeleteWorldFunction(params);
         }
+        FreePooledInstances(collection);
         dmMutex::Delete(collection->m_Mutex);
         delete collection;
     }
@@ -626,7 +630,7 @@ namespace dmGameObject
         instance->m_LevelIndex = level_index;
     }
 
-    static HInstance AllocInstance(Prototype* proto, const char* prototype_name) {
+    static HInstance AllocInstance(Collection* collection, Prototype* proto, const char* prototype_name) {
         // Count number of component userdata fields required
         uint32_t component_instance_userdata_count = 0;
         for (uint32_t i = 0; i < proto->m_ComponentCount; ++i)
@@ -642,15 +646,29 @@ namespace dmGameObject
                 component_instance_userdata_count++;
         }
 
-        uint32_t component_userdata_size = sizeof(((Instance*)0)->m_ComponentInstanceUserData[0]);
-        // NOTE: Allocate actual Instance with *all* component instance user-data accounted
-        void* instance_memory = ::operator new (sizeof(Instance) + component_instance_userdata_count * component_userdata_size);
+        void* instance_memory = 0;
+        if (component_instance_userdata_count <= MAX_POOLED_INSTANCE_USER_DATA_COUNT)
+        {
+            dmArray<void*>& free_instances = collection->m_FreeInstances[component_instance_userdata_count];
+            if (!free_instances.Empty())
+            {
+                instance_memory = free_instances.Back();
+                free_instances.Pop();
+            }
+        }
+        if (!instance_memory)
+        {
+            uint32_t component_userdata_size = sizeof(((Instance*)0)->m_ComponentInstanceUserData[0]);
+            // NOTE: Allocate actual Instance with *all* component instance user-data accounted
+            instance_memory = ::operator new (sizeof(Instance) + component_instance_userdata_count * component_userdata_size);
+        }
         Instance* instance = new(instance_memory) Instance(proto);
         instance->m_ComponentInstanceUserDataCount = component_instance_userdata_count;
         return instance;
     }
 
-    static void DeallocInstance(HInstance instance) {
+    static void DeallocInstance(Collection* collection, HInstance instance) {
+        uint32_t component_instance_userdata_count = instance->m_ComponentInstanceUserDataCount;
         instance->~Instance();
         void* instance_memory = (void*) instance;
 
@@ -658,16 +676,40 @@ namespace dmGameObject
         // TODO: #ifdef on something...?
         // Clear all memory excluding ComponentInstanceUserData
         memset(instance_memory, 0xcc, sizeof(Instance));
+
+        if (component_instance_userdata_count <= MAX_POOLED_INSTANCE_USER_DATA_COUNT)
+        {
+            dmArray<void*>& free_instances = collection->m_FreeInstances[component_instance_userdata_count];
+            if (free_instances.Size() < MAX_POOLED_INSTANCES)
+            {
+                if (free_instances.Full())
+                    free_instances.OffsetCapacity(dmMath::Min(dmMath::Max(16U, free_instances.Capacity()), MAX_POOLED_INSTANCES - free_instances.Capacity()));
+                free_instances.Push(instance_memory);
+                return;
+            }
+        }
         operator delete (instance_memory);
     }
 
+    static void FreePooledInstances(Collection* collection) {
+        for (uint32_t i = 0; i <= MAX_POOLED_INSTANCE_USER_DATA_COUNT; ++i)
+        {
+            dmArray<void*>& free_instances = collection->m_FreeInstances[i];
+            for (uint32_t j = 0; j < free_instances.Size(); ++j)
+            {
+                operator delete (free_instances[j]);
+            }
+            free_instances.SetCapacity(0);
+        }
+    }
+
     HInstance NewInstance(Collection* collection, Prototype* proto, const char* prototype_name) {
         if (collection->m_InstanceIndices.Remaining() == 0)
         {
             dmLogError("The game object instance could not be created since the buffer is full (%d).", collection->m_InstanceIndices.Capacity());
             return 0;
         }
-        HInstance instance = AllocInstance(proto, prototype_name);
+        HInstance instance = AllocInstance(collection, proto, prototype_name);
         instance->m_Collection = collection;
         instance->m_ScaleAlongZ = collection->m_ScaleAlongZ;
         uint16_t instance_index = collection->m_InstanceIndices.Pop();
@@ -696,7 +738,7 @@ namespace dmGameObject
         }
 
         uint16_t instance_index = instance->m_Index;
-        operator delete ((void*)instance);
+        DeallocInstance(collection, instance);
         collection->m_Instances[instance_index] = 0x0;
         collection->m_InstanceIndices.Push(instance_index);
         assert(collection->m_IDToInstance.Size() <= collection->m_InstanceIndices.Size());
@@ -706,21 +748,73 @@ namespace dmGameObject
         UndoNewInstance(hcollection->m_Collection, instance);
     }
 
+    static CreateResult CreateComponent(Collection* collection, HInstance instance, uint32_t component_index, uintptr_t* component_instance_data)
+    {
+        Prototype::Component* component = &instance->m_Prototype->m_Components[component_index];
+        ComponentType* component_type = component->m_Type;
+        if (component_instance_data)
+        {
+            *component_instance_data = 0;
+        }
+
+        ComponentCreateParams params;
+        params.m_Instance = instance;
+        params.m_Position = component->m_Position;
+        params.m_Rotation = component->m_Rotation;
+        params.m_ComponentIndex = component_index;
+        params.m_Resource = component->m_Resource;
+        params.m_World = collection->m_ComponentWorlds[component->m_TypeIndex];
+        params.m_Context = component_type->m_Context;
+        params.m_UserData = component_instance_data;
+        params.m_PropertySet = component->m_PropertySet;
+        CreateResult create_result = component_type->m_CreateFunction(params);
+        if (create_result == CREATE_RESULT_OK)
+        {
+            collection->m_ComponentInstanceCount[component->m_TypeIndex]++;
+        }
+        return create_result;
+    }
+
+    // Destroys the first component_count components of an instance, after a failed create
+    static void UndoCreateComponents(Collection* collection, HInstance instance, uint32_t component_count)
+    {
+        Prototype* proto = instance->m_Prototype;
+        uint32_t next_component_instance_data = 0;
+        for (uint32_t i = 0; i < component_count; ++i)
+        {
+            Prototype::Component* component = &proto->m_Components[i];
+            ComponentType* component_type = component->m_Type;
+            assert(component_type);
+            uintptr_t* component_instance_data = 0;
+            if (component_type->m_InstanceHasUserData)
+            {
+                component_instance_data = &instance->m_ComponentInstanceUserData[next_component_instance_data++];
+            }
+            assert(next_component_instance_data <= instance->m_ComponentInstanceUserDataCount);
+
+            collection->m_ComponentInstanceCount[component->m_TypeIndex]--;
+            ComponentDestroyParams params;
+            params.m_Collection = collection->m_HCollection;
+            params.m_Instance = instance;
+            params.m_World = collection->m_ComponentWorlds[component->m_TypeIndex];
+            params.m_Context = component_type->m_Context;
+            params.m_UserData = component_instance_data;
+            component_type->m_DestroyFunction(params);
+        }
+    }
+
     bool CreateComponents(Collection* collection, HInstance instance) {
         DM_PROFILE(GameObject, "CreateComponents");
 
         Prototype* proto = instance->m_Prototype;
-        uint32_t components_created = 0;
         uint32_t next_component_instance_data = 0;
-        bool ok = true;
         if (proto->m_ComponentCount > 0xFFFF ) {
             dmLogWarning("Too many components in game object: %u (max is 65536)", proto->m_ComponentCount);
             return false;
         }
         for (uint32_t i = 0; i < proto->m_ComponentCount; ++i)
         {
-            Prototype::Component* component = &proto->m_Components[i];
-            ComponentType* component_type = component->m_Type;
+            ComponentType* component_type = proto->m_Components[i].m_Type;
             assert(component_type);
 
             DM_PROFILE_DYN(GameObjectCreateComponents, component_type->m_Name, component_type->m_NameHash);
@@ -729,60 +823,73 @@ namespace dmGameObject
             if (component_type->m_InstanceHasUserData)
             {
                 component_instance_data = &instance->m_ComponentInstanceUserData[next_component_instance_data++];
-                *component_instance_data = 0;
             }
             assert(next_component_instance_data <= instance->m_ComponentInstanceUserDataCount);
 
-            ComponentCreateParams params;
-            params.m_Instance = instance;
-            params.m_Position = component->m_Position;
-            params.m_Rotation = component->m_Rotation;
-            params.m_ComponentIndex = i;
-            params.m_Resource = component->m_Resource;
-            params.m_World = collection->m_ComponentWorlds[component->m_TypeIndex];
-            params.m_Context = component_type->m_Context;
-            params.m_UserData = component_instance_data;
-            params.m_PropertySet = component->m_PropertySet;
-            CreateResult create_result =  component_type->m_CreateFunction(params);
-            if (create_result == CREATE_RESULT_OK)
+            if (CreateComponent(collection, instance, i, component_instance_data) != CREATE_RESULT_OK)
             {
-                collection->m_ComponentInstanceCount[component->m_TypeIndex]++;
-                components_created++;
+                UndoCreateComponents(collection, instance, i);
+                return false;
             }
-            else
+        }
+        return true;
+    }
+
+    // Creates the components of several instances of the same prototype. Each component of the prototype
+    // is created for all instances before the next one, so that the create calls of a component type are
+    // made back to back. Instances that fail are released and set to 0
+    static void CreateComponentsMany(Collection* collection, Prototype* proto, const char* prototype_name, HInstance* instances, uint32_t count)
+    {
+        DM_PROFILE(GameObject, "CreateComponents");
+
+        if (proto->m_ComponentCount > 0xFFFF ) {
+            dmLogWarning("Too many components in game object: %u (max is 65536)", proto->m_ComponentCount);
+            for (uint32_t i = 0; i < count; ++i)
             {
-                ok = false;
-                break;
+                if (instances[i] != 0)
+                {
+                    ReleaseIdentifier(collection, instances[i]);
+                    UndoNewInstance(collection, instances[i]);
+                    instances[i] = 0;
+                }
             }
+            return;
         }
 
-        if (!ok)
+        // All instances share the prototype, and with it the layout of the component user data
+        uint32_t next_component_instance_data = 0;
+        for (uint32_t c = 0; c < proto->m_ComponentCount; ++c)
         {
-            uint32_t next_component_instance_data = 0;
-            for (uint32_t i = 0; i < components_created; ++i)
+            ComponentType* component_type = proto->m_Components[c].m_Type;
+            assert(component_type);
+
+            DM_PROFILE_DYN(GameObjectCreateComponents, component_type->m_Name, component_type->m_NameHash);
+
+            uint32_t user_data_index = next_component_instance_data;
+            if (component_type->m_InstanceHasUserData)
             {
-                Prototype::Component* component = &proto->m_Components[i];
-                ComponentType* component_type = component->m_Type;
-                assert(component_type);
-                uintptr_t* component_instance_data = 0;
-                if (component_type->m_InstanceHasUserData)
+                ++next_component_instance_data;
+            }
+
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                HInstance instance = instances[i];
+                if (instance == 0)
                 {
-                    component_instance_data = &instance->m_ComponentInstanceUserData[next_component_instance_data++];
+                    continue;
                 }
                 assert(next_component_instance_data <= instance->m_ComponentInstanceUserDataCount);
-
-                collection->m_ComponentInstanceCount[component->m_TypeIndex]--;
-                ComponentDestroyParams params;
-                params.m_Collection = collection->m_HCollection;
-                params.m_Instance = instance;
-                params.m_World = collection->m_ComponentWorlds[component->m_TypeIndex];
-                params.m_Context = component_type->m_Context;
-                params.m_UserData = component_instance_data;
-                component_type->m_DestroyFunction(params);
+                uintptr_t* component_instance_data = component_type->m_InstanceHasUserData ? &instance->m_ComponentInstanceUserData[user_data_index] : 0;
+                if (CreateComponent(collection, instance, c, component_instance_data) != CREATE_RESULT_OK)
+                {
+                    dmLogError("Could not spawn an instance of prototype %s.", prototype_name);
+                    UndoCreateComponents(collection, instance, c);
+                    ReleaseIdentifier(collection, instance);
+                    UndoNewInstance(collection, instance);
+                    instances[i] = 0;
+                }
             }
         }
-
-        return ok;
     }
 
     bool CreateComponents(HCollection hcollection, HInstance instance) {
@@ -1058,14 +1165,9 @@ namespace dmGameObject
         return true;
     }
 
-    // Supplied 'proto' will be released after this function is done.
-    static HInstance SpawnInternal(Collection* collection, Prototype *proto, const char *prototype_name, dmhash_t id, uint8_t* property_buffer, uint32_t property_buffer_size, const Point3& position, const Quat& rotation, const Vector3& scale)
+    // Creates the instance with its transform and identifier, but not its components
+    static HInstance SpawnNewInternal(Collection* collection, Prototype *proto, const char *prototype_name, dmhash_t id, const Point3& position, const Quat& rotation, const Vector3& scale)
     {
-        if (collection->m_ToBeDeleted) {
-            dmLogWarning("Spawning is not allowed when the collection is being deleted.");
-            return 0;
-        }
-
         HInstance instance = dmGameObject::NewInstance(collection, proto, prototype_name);
         if (instance == 0) {
             return 0;
@@ -1088,6 +1190,16 @@ namespace dmGameObject
             UndoNewInstance(collection, instance);
             return 0;
         }
+        return instance;
+    }
+
+    // Creates the instance and its components, but does not initialize it
+    static HInstance SpawnCreateInternal(Collection* collection, Prototype *proto, const char *prototype_name, dmhash_t id, const Point3& position, const Quat& rotation, const Vector3& scale)
+    {
+        HInstance instance = SpawnNewInternal(collection, proto, prototype_name, id, position, rotation, scale);
+        if (instance == 0) {
+            return 0;
+        }
 
         bool success = CreateComponents(collection, instance);
         if (!success) {
@@ -1095,8 +1207,13 @@ namespace dmGameObject
             UndoNewInstance(collection, instance);
             return 0;
         }
+        return instance;
+    }
 
-        success = SetScriptPropertiesFromBuffer(instance, prototype_name, property_buffer, property_buffer_size);
+    // Sets the properties and initializes an instance created by SpawnCreateInternal. The instance is deleted on failure
+    static bool SpawnInitInternal(Collection* collection, HInstance instance, const char *prototype_name, uint8_t* property_buffer, uint32_t property_buffer_size)
+    {
+        bool success = SetScriptPropertiesFromBuffer(instance, prototype_name, property_buffer, property_buffer_size);
 
         if (success && !InitInstance(collection, instance))
         {
@@ -1108,6 +1225,24 @@ namespace dmGameObject
             AddToUpdate(collection, instance);
         } else {
             Delete(collection, instance, false);
+        }
+        return success;
+    }
+
+    // Supplied 'proto' will be released after this function is done.
+    static HInstance SpawnInternal(Collection* collection, Prototype *proto, const char *prototype_name, dmhash_t id, uint8_t* property_buffer, uint32_t property_buffer_size, const Point3& position, const Quat& rotation, const Vector3& scale)
+    {
+        if (collection->m_ToBeDeleted) {
+            dmLogWarning("Spawning is not allowed when the collection is being deleted.");
+            return 0;
+        }
+
+        HInstance instance = SpawnCreateInternal(collection, proto, prototype_name, id, position, rotation, scale);
+        if (instance == 0) {
+            return 0;
+        }
+
+        if (!SpawnInitInternal(collection, instance, prototype_name, property_buffer, property_buffer_size)) {
             return 0;
         }
 
@@ -1453,6 +1588,48 @@ namespace dmGameObject
         return instance;
     }
 
+    uint32_t SpawnMany(HCollection hcollection, HPrototype proto, const char* prototype_name, uint32_t count, const dmhash_t* ids, uint8_t* property_buffer, uint32_t property_buffer_size, const Point3* positions, const Quat& rotation, const Vector3& scale, HInstance* out_instances)
+    {
+        DM_PROFILE(GameObject, "SpawnMany");
+        memset(out_instances, 0, sizeof(HInstance) * count);
+        if (proto == 0x0) {
+            dmLogError("No prototype to spawn from.");
+            return 0;
+        }
+
+        Collection* collection = hcollection->m_Collection;
+        if (collection->m_ToBeDeleted) {
+            dmLogWarning("Spawning is not allowed when the collection is being deleted.");
+            return 0;
+        }
+
+        // Create all instances, then their components grouped by component, before any of them is initialized
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            out_instances[i] = SpawnNewInternal(collection, proto, prototype_name, ids[i], positions[i], rotation, scale);
+            if (out_instances[i] == 0) {
+                dmLogError("Could not spawn an instance of prototype %s.", prototype_name);
+            }
+        }
+        CreateComponentsMany(collection, proto, prototype_name, out_instances, count);
+
+        uint32_t spawned = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            HInstance instance = out_instances[i];
+            if (instance == 0) {
+                continue;
+            }
+            if (SpawnInitInternal(collection, instance, prototype_name, property_buffer, property_buffer_size)) {
+                ++spawned;
+            } else {
+                dmLogError("Could not spawn an instance of prototype %s.", prototype_name);
+                out_instances[i] = 0;
+            }
+        }
+        return spawned;
+    }
+
     static void Unlink(Collection* collection, Instance* instance)
     {
         // Unlink "me" from parent
@@ -1901,7 +2078,7 @@ namespace dmGameObject
             collection->m_InputFocusStack.Pop();
         }
 
-        DeallocInstance(instance);
+        DeallocInstance(collection, instance);
 
         assert(collection->m_IDToInstance.Size() <= collection->m_InstanceIndices.Size());
     }
@@ -2422,6 +2599,65 @@ namespace dmGameObject
         UpdateTransforms(hcollection->m_Collection);
     }
 
+    static void SavePrevWorldTransforms(Collection* collection)
+    {
+        DM_PROFILE(GameObject, "SavePrevWorldTransforms");
+
+        if (collection->m_PrevWorldTransforms.Empty())
+        {
+            collection->m_PrevWorldTransforms.SetCapacity(collection->m_MaxInstances);
+            collection->m_PrevWorldTransforms.SetSize(collection->m_MaxInstances);
+            collection->m_RenderWorldTransforms.SetCapacity(collection->m_MaxInstances);
+            collection->m_RenderWorldTransforms.SetSize(collection->m_MaxInstances);
+        }
+
+        // A level is never populated unless the level above it is
+        for (uint32_t level_i = 0; level_i < MAX_HIERARCHICAL_DEPTH; ++level_i)
+        {
+            dmArray<uint16_t>& level = collection->m_LevelIndices[level_i];
+            uint32_t instance_count = level.Size();
+            if (instance_count == 0)
+                break;
+            for (uint32_t i = 0; i < instance_count; ++i)
+            {
+                uint16_t index = level[i];
+                collection->m_PrevWorldTransforms[index] = collection->m_WorldTransforms[index];
+                collection->m_Instances[index]->m_HasPrevWorldTransform = 1;
+            }
+        }
+    }
+
+    static void BlendWorldTransforms(Collection* collection, float alpha)
+    {
+        DM_PROFILE(GameObject, "BlendWorldTransforms");
+
+        for (uint32_t level_i = 0; level_i < MAX_HIERARCHICAL_DEPTH; ++level_i)
+        {
+            dmArray<uint16_t>& level = collection->m_LevelIndices[level_i];
+            uint32_t instance_count = level.Size();
+            if (instance_count == 0)
+                break;
+            for (uint32_t i = 0; i < instance_count; ++i)
+            {
+                uint16_t index = level[i];
+                const Matrix4& current = collection->m_WorldTransforms[index];
+                const Matrix4& prev = collection->m_PrevWorldTransforms[index];
+                Matrix4& blended = collection->m_RenderWorldTransforms[index];
+                // Most instances don't move, and those created since the last update have nothing to blend from
+                if (!collection->m_Instances[index]->m_HasPrevWorldTransform || memcmp(&prev, &current, sizeof(Matrix4)) == 0)
+                {
+                    blended = current;
+                    continue;
+                }
+                dmTransform::Transform from = dmTransform::ToTransform(prev);
+                dmTransform::Transform to = dmTransform::ToTransform(current);
+                blended = dmTransform::ToMatrix4(dmTransform::Transform(lerp(alpha, from.GetTranslation(), to.GetTranslation()),
+                                                                        slerp(alpha, from.GetRotation(), to.GetRotation()),
+                                                                        lerp(alpha, from.GetScale(), to.GetScale())));
+            }
+        }
+    }
+
     static bool Update(Collection* collection, const UpdateContext* update_context)
     {
         DM_PROFILE(GameObject, "Update");
@@ -2429,6 +2665,11 @@ namespace dmGameObject
 
         assert(collection != 0x0);
 
+        if (collection->m_Register->m_InterpolateTransforms)
+        {
+            SavePrevWorldTransforms(collection);
+        }
+
         // Add to update
         DoAddToUpdate(collection);
 
@@ -2493,6 +2734,15 @@ namespace dmGameObject
         Collection* collection = hcollection->m_Collection;
         assert(collection != 0x0);
 
+        // The render functions read the blended transforms through the regular world transform getters
+        Register* regist = collection->m_Register;
+        bool interpolate = regist->m_InterpolateTransforms && regist->m_RenderInterpolation < 1.0f && !collection->m_PrevWorldTransforms.Empty();
+        if (interpolate)
+        {
+            BlendWorldTransforms(collection, regist->m_RenderInterpolation);
+            collection->m_WorldTransforms.Swap(collection->m_RenderWorldTransforms);
+        }
+
         bool ret = true;
         uint32_t component_types = collection->m_Register->m_ComponentTypeCount;
         for (uint32_t i = 0; i < component_types; ++i)
@@ -2511,9 +2761,29 @@ namespace dmGameObject
                     ret = false;
             }
         }
+
+        if (interpolate)
+        {
+            collection->m_WorldTransforms.Swap(collection->m_RenderWorldTransforms);
+        }
         return ret;
     }
 
+    void SetInterpolateTransforms(HRegister regist, bool interpolate)
+    {
+        regist->m_InterpolateTransforms = interpolate;
+    }
+
+    bool GetInterpolateTransforms(HRegister regist)
+    {
+        return regist->m_InterpolateTransforms;
+    }
+
+    void SetRenderInterpolation(HRegister regist, float alpha)
+    {
+        regist->m_RenderInterpolation = dmMath::Clamp(alpha, 0.0f, 1.0f);
+    }
+
     static bool DispatchAllSockets(Collection* collection) {
         bool result = true;
         dmMessage::HSocket sockets[] =
@@ -3425,7 +3695,7 @@ namespace dmGameObject
         // We don't support recreating instances that are 'transitioning'
         assert(instance->m_ToBeAdded == 0);
         assert(instance->m_ToBeDeleted == 0);
-        HInstance new_instance = AllocInstance(new_proto, new_proto_name);
+        HInstance new_instance = AllocInstance(collection, new_proto, new_proto_name);
         if (!new_instance) {
             return;
         }
@@ -3452,7 +3722,7 @@ namespace dmGameObject
         bool res = CreateComponents(hcollection, new_instance);
         if (!res) {
             dmHashRelease64(&new_instance->m_CollectionPathHashState);
-            DeallocInstance(new_instance);
+            DeallocInstance(collection, new_instance);
             return;
         }
         if (instance->m_Initialized) {
@@ -3478,7 +3748,7 @@ namespace dmGameObject
                 break;
             }
         }
-        DeallocInstance(instance);
+        DeallocInstance(collection, instance);
         DoAddToUpdate(collection, new_instance);
     }
 
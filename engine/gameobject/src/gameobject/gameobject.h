@@ -723,6 +723,25 @@ namespace dmGameObject
      */
     HInstance Spawn(HCollection collection, HPrototype prototype, const char* prototype_name, dmhash_t id, uint8_t* property_buffer, uint32_t property_buffer_size, const Point3& position, const Quat& rotation, const Vector3& scale);
 
+    /**
+     * Spawns several gameobject instances of the same prototype. All instances are created first, then
+     * each component of the prototype is created for all of them in turn, so that the create calls of a
+     * component type are made back to back. No instance is initialized until all components are created.
+     * @param collection Gameobject collection
+     * @param prototype Prototype to spawn from
+     * @param prototype_name Prototype file name
+     * @param count Number of instances to spawn
+     * @param ids Array of count ids of the spawned instances
+     * @param property_buffer Buffer with serialized properties, shared by all instances
+     * @param property_buffer_size Size of property buffer
+     * @param positions Array of count positions of the spawned objects
+     * @param rotation Rotation of the spawned objects
+     * @param scale Scale of the spawned objects
+     * @param out_instances Array of count spawned instances, 0 for the instances that failed [out]
+     * @return number of spawned instances
+     */
+    uint32_t SpawnMany(HCollection collection, HPrototype prototype, const char* prototype_name, uint32_t count, const dmhash_t* ids, uint8_t* property_buffer, uint32_t property_buffer_size, const Point3* positions, const Quat& rotation, const Vector3& scale, HInstance* out_instances);
+
     struct InstancePropertyBuffer
     {
         uint8_t *property_buffer;
@@ -935,6 +954,29 @@ namespace dmGameObject
      */
     bool Render(HCollection collection);
 
+    /**
+     * Enable interpolation of world transforms when rendering. The world transforms of all collections in the
+     * register are saved before each update and Render() blends them with the current ones, using the factor set
+     * with SetRenderInterpolation(). Used when the simulation runs with a fixed time step, decoupled from the frame rate.
+     * @param regist Register
+     * @param interpolate True to enable interpolation
+     */
+    void SetInterpolateTransforms(HRegister regist, bool interpolate);
+
+    /**
+     * Get if world transforms are interpolated when rendering.
+     * @param regist Register
+     * @return True if interpolation is enabled
+     */
+    bool GetInterpolateTransforms(HRegister regist);
+
+    /**
+     * Set the blend factor between the world transforms before and after the last update, used by Render().
+     * @param regist Register
+     * @param alpha Blend factor [0,1]. 0 renders the transforms before the last update, 1 the current transforms
+     */
+    void SetRenderInterpolation(HRegister regist, float alpha);
+
     /**
      * Performs clean up of the collection after update, such as deleting all instances scheduled for delete.
      * @param collection Game object collection
@@ -103,6 +103,7 @@ namespace dmGameObject
             m_ScaleAlongZ = 0;
             m_Bone = 0;
             m_Generated = 0;
+            m_HasPrevWorldTransform = 0;
             m_Parent = INVALID_INSTANCE_INDEX;
             m_Index = INVALID_INSTANCE_INDEX;
             m_LevelIndex = INVALID_INSTANCE_INDEX;
@@ -146,8 +147,10 @@ namespace dmGameObject
         uint16_t        m_Bone : 1;
         // If this is a generated instance, i.e. if the instance id is uniquely generated
         uint16_t        m_Generated : 1;
+        // If Collection::m_PrevWorldTransforms holds a valid transform for this instance
+        uint16_t        m_HasPrevWorldTransform : 1;
         // Padding
-        uint16_t        m_Pad : 4;
+        uint16_t        m_Pad : 3;
 
         // Index to parent
         uint16_t        m_Parent : 16;
@@ -214,6 +217,11 @@ namespace dmGameObject
 
         dmHashTable64<Collection*>  m_SocketToCollection;
 
+        // Blend factor between the previous and current world transforms in Render()
+        float                       m_RenderInterpolation;
+        // If world transforms are saved before each update and interpolated when rendering
+        uint32_t                    m_InterpolateTransforms : 1;
+
         Register();
         ~Register();
     };
@@ -222,6 +230,10 @@ namespace dmGameObject
     // depth is interpreted as up to <depth> levels of child nodes including root-nodes
     // Must be greater than zero
     const uint32_t MAX_HIERARCHICAL_DEPTH = 128;
+    // Instances with at most this many component user data slots have their memory recycled by the collection
+    const uint32_t MAX_POOLED_INSTANCE_USER_DATA_COUNT = 8;
+    // Max number of freed instances kept per size class
+    const uint32_t MAX_POOLED_INSTANCES = 1024;
     struct Collection
     {
         Collection(dmResource::HFactory factory, HRegister regist, uint32_t max_instances, uint32_t max_input_stack_entries);
@@ -254,6 +266,9 @@ namespace dmGameObject
         // Resources referenced through property overrides inside the collection
         dmArray<void*>           m_PropertyResources;
 
+        // Memory of deleted instances kept for reuse, indexed by component instance user data count
+        dmArray<void*>           m_FreeInstances[MAX_POOLED_INSTANCE_USER_DATA_COUNT + 1];
+
         // Array of dynamically allocated index arrays, one for each level
         // Used for calculating transforms in scene-graph
         // Two dimensional table of indices with stride "max_instances"
@@ -263,6 +278,10 @@ namespace dmGameObject
 
         // Array of world transforms. Calculated using m_LevelIndices above
         dmArray<Matrix4>         m_WorldTransforms;
+        // World transforms before the last update. Only allocated when interpolating transforms
+        dmArray<Matrix4>         m_PrevWorldTransforms;
+        // Blended world transforms, swapped with m_WorldTransforms during Render()
+        dmArray<Matrix4>         m_RenderWorldTransforms;
 
         // Identifier to Instance mapping
         dmHashTable64<Instance*> m_IDToInstance;
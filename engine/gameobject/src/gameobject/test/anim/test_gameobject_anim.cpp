@@ -650,6 +650,18 @@ TEST_F(AnimTest, ScriptedChainedEasing)
     }
 }
 
+TEST_F(AnimTest, ScriptedElementGroup)
+{
+    m_UpdateContext.m_DT = 0.25f;
+    dmGameObject::HInstance go = Spawn(m_Factory, m_Collection, "/element_group.goc", hash("element_group"), 0, 0, Point3(0, 0, 0), Quat(0, 0, 0, 1), Vector3(1, 1, 1));
+    ASSERT_NE((void*)0, go);
+
+    for (uint32_t i = 0; i < 10; ++i)
+    {
+        ASSERT_TRUE(dmGameObject::Update(m_Collection, &m_UpdateContext));
+    }
+}
+
 TEST_F(AnimTest, PositionUniformAnim)
 {
     dmGameObject::HInstance go = dmGameObject::New(m_Collection, "/dummy.goc");
@@ -25,6 +25,10 @@
 
 #include "gameobject/test/component/test_gameobject_component_ddf.h"
 
+#define EPSILON 0.0001f
+
+using namespace Vectormath::Aos;
+
 class ComponentTest : public jc_test_base_class
 {
 protected:
@@ -32,6 +36,7 @@ protected:
     {
         m_UpdateCount = 0;
         m_UpdateContext.m_DT = 1.0f / 60.0f;
+        m_RenderInstance = 0;
 
         dmResource::NewFactoryParams params;
         params.m_MaxResources = 16;
@@ -70,6 +75,7 @@ protected:
         a_type.m_FinalFunction = AComponentFinal;
         a_type.m_DestroyFunction = AComponentDestroy;
         a_type.m_UpdateFunction = AComponentsUpdate;
+        a_type.m_RenderFunction = AComponentsRender;
         a_type.m_InstanceHasUserData = true;
         result = dmGameObject::RegisterComponentType(m_Register, a_type);
         dmGameObject::SetUpdateOrderPrio(m_Register, resource_type, 2);
@@ -133,6 +139,7 @@ protected:
     static dmGameObject::ComponentDestroy       AComponentDestroy;
     static dmGameObject::ComponentAddToUpdate   AComponentAddToUpdate;
     static dmGameObject::ComponentsUpdate       AComponentsUpdate;
+    static dmGameObject::ComponentsRender       AComponentsRender;
 
     static dmResource::FResourceCreate          BCreate;
     static dmResource::FResourceDestroy         BDestroy;
@@ -169,6 +176,10 @@ public:
 
     std::map<uint64_t, int>      m_ComponentUserDataAcc;
 
+    // World position of m_RenderInstance, as seen from the render function
+    dmGameObject::HInstance      m_RenderInstance;
+    Point3                       m_RenderPosition;
+
     dmScript::HContext m_ScriptContext;
     dmGameObject::UpdateContext m_UpdateContext;
     dmGameObject::HRegister m_Register;
@@ -261,6 +272,16 @@ static dmGameObject::UpdateResult GenericComponentsUpdate(const dmGameObject::Co
     return dmGameObject::UPDATE_RESULT_OK;
 }
 
+template <typename T>
+static dmGameObject::UpdateResult GenericComponentsRender(const dmGameObject::ComponentsRenderParams& params)
+{
+    ComponentTest* game_object_test = (ComponentTest*) params.m_Context;
+    if (game_object_test->m_RenderInstance)
+    {
+        game_object_test->m_RenderPosition = dmGameObject::GetWorldPosition(game_object_test->m_RenderInstance);
+    }
+    return dmGameObject::UPDATE_RESULT_OK;
+}
 
 template <typename T>
 static dmGameObject::CreateResult GenericComponentDestroy(const dmGameObject::ComponentDestroyParams& params)
@@ -283,6 +304,7 @@ dmGameObject::ComponentFinal ComponentTest::AComponentFinal             = Generi
 dmGameObject::ComponentDestroy ComponentTest::AComponentDestroy         = GenericComponentDestroy<TestGameObjectDDF::AResource>;
 dmGameObject::ComponentAddToUpdate ComponentTest::AComponentAddToUpdate = GenericComponentAddToUpdate<TestGameObjectDDF::AResource>;
 dmGameObject::ComponentsUpdate ComponentTest::AComponentsUpdate         = GenericComponentsUpdate<TestGameObjectDDF::AResource>;
+dmGameObject::ComponentsRender ComponentTest::AComponentsRender         = GenericComponentsRender<TestGameObjectDDF::AResource>;
 
 dmResource::FResourceCreate ComponentTest::BCreate                      = GenericDDFCreate<TestGameObjectDDF::BResource>;
 dmResource::FResourceDestroy ComponentTest::BDestroy                    = GenericDDFDestory<TestGameObjectDDF::BResource>;
@@ -325,6 +347,45 @@ TEST_F(ComponentTest, TestUpdate)
     ASSERT_EQ((uint32_t) 1, m_ComponentDestroyCountMap[TestGameObjectDDF::AResource::m_DDFHash]);
 }
 
+TEST_F(ComponentTest, TestInterpolateTransforms)
+{
+    dmGameObject::SetInterpolateTransforms(m_Register, true);
+
+    dmGameObject::HInstance go = dmGameObject::New(m_Collection, "/go1.goc");
+    ASSERT_NE((void*) 0, (void*) go);
+    dmGameObject::Init(m_Collection);
+    m_RenderInstance = go;
+
+    // Created since the last update, nothing to blend from
+    dmGameObject::SetRenderInterpolation(m_Register, 0.5f);
+    ASSERT_TRUE(dmGameObject::Render(m_Collection));
+    ASSERT_NEAR(0.0f, m_RenderPosition.getX(), EPSILON);
+
+    ASSERT_TRUE(dmGameObject::Update(m_Collection, &m_UpdateContext));
+    dmGameObject::SetPosition(go, Point3(10.0f, 0.0f, 0.0f));
+    ASSERT_TRUE(dmGameObject::Update(m_Collection, &m_UpdateContext));
+
+    dmGameObject::SetRenderInterpolation(m_Register, 0.25f);
+    ASSERT_TRUE(dmGameObject::Render(m_Collection));
+    ASSERT_NEAR(2.5f, m_RenderPosition.getX(), EPSILON);
+    // The blended transforms are only visible while rendering
+    ASSERT_NEAR(10.0f, dmGameObject::GetWorldPosition(go).getX(), EPSILON);
+
+    dmGameObject::SetRenderInterpolation(m_Register, 1.0f);
+    ASSERT_TRUE(dmGameObject::Render(m_Collection));
+    ASSERT_NEAR(10.0f, m_RenderPosition.getX(), EPSILON);
+
+    // No movement during the last update
+    ASSERT_TRUE(dmGameObject::Update(m_Collection, &m_UpdateContext));
+    dmGameObject::SetRenderInterpolation(m_Register, 0.25f);
+    ASSERT_TRUE(dmGameObject::Render(m_Collection));
+    ASSERT_NEAR(10.0f, m_RenderPosition.getX(), EPSILON);
+
+    m_RenderInstance = 0;
+    dmGameObject::Delete(m_Collection, go, false);
+    ASSERT_TRUE(dmGameObject::PostUpdate(m_Collection));
+}
+
 TEST_F(ComponentTest, TestPostDeleteUpdate)
 {
     dmGameObject::HInstance go = dmGameObject::New(m_Collection, "/go1.goc");
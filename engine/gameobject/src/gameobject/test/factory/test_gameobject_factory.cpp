@@ -17,6 +17,7 @@
 
 #include <dlib/hash.h>
 #include <dlib/log.h>
+#include <dlib/time.h>
 
 #include "../gameobject.h"
 #include "../gameobject_private.h"
@@ -41,6 +42,8 @@ protected:
         dmGameObject::RegisterResourceTypes(m_Factory, m_Register, m_ScriptContext, &m_ModuleContext);
         dmGameObject::RegisterComponentTypes(m_Factory, m_Register, m_ScriptContext);
         m_Collection = dmGameObject::NewCollection("collection", m_Factory, m_Register, 1024);
+        m_LogCreate = false;
+        m_CreateCount = 0;
 
         dmResource::Result e;
         e = dmResource::RegisterType(m_Factory, "a", this, 0, ACreate, 0, ADestroy, 0);
@@ -85,6 +88,13 @@ public:
     dmGameObject::HCollection m_Collection;
     dmResource::HFactory m_Factory;
     dmGameObject::ModuleContext m_ModuleContext;
+
+    // Component create calls while m_LogCreate is set, in call order
+    static const uint32_t MAX_CREATE_LOG = 64;
+    dmGameObject::HInstance m_CreateInstances[MAX_CREATE_LOG];
+    uint32_t m_CreateComponents[MAX_CREATE_LOG];
+    uint32_t m_CreateCount;
+    bool m_LogCreate;
 };
 
 static dmResource::Result NullResourceCreate(const dmResource::ResourceCreateParams& params)
@@ -100,8 +110,19 @@ static dmResource::Result NullResourceDestroy(const dmResource::ResourceDestroyP
 
 static dmGameObject::CreateResult TestComponentCreate(const dmGameObject::ComponentCreateParams& params)
 {
-    // Hard coded for the specific case "CreateCallback" below
     dmGameObject::HInstance instance = params.m_Instance;
+    FactoryTest* test = (FactoryTest*) params.m_Context;
+    if (test->m_LogCreate) {
+        if (test->m_CreateCount == FactoryTest::MAX_CREATE_LOG) {
+            return dmGameObject::CREATE_RESULT_UNKNOWN_ERROR;
+        }
+        test->m_CreateInstances[test->m_CreateCount] = instance;
+        test->m_CreateComponents[test->m_CreateCount] = params.m_ComponentIndex;
+        test->m_CreateCount++;
+        return dmGameObject::CREATE_RESULT_OK;
+    }
+
+    // Hard coded for the specific case "CreateCallback" below
     if (dmGameObject::GetIdentifier(instance) != dmHashString64("/instance0")) {
         return dmGameObject::CREATE_RESULT_UNKNOWN_ERROR;
     }
@@ -257,6 +278,138 @@ TEST_F(FactoryTest, FactoryCreateCallback)
     ASSERT_NE((void*)0, instance);
 }
 
+TEST_F(FactoryTest, FactorySpawnMany)
+{
+    const uint32_t count = 16;
+    dmhash_t ids[count];
+    uint32_t indices[count];
+    Point3 positions[count];
+    dmGameObject::HInstance instances[count];
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        indices[i] = dmGameObject::AcquireInstanceIndex(m_Collection);
+        ids[i] = dmGameObject::ConstructInstanceId(indices[i]);
+        positions[i] = Point3((float)i, 0.0f, 0.0f);
+    }
+
+    dmGameObject::HPrototype prototype = 0x0;
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(m_Factory, "/test.goc", (void**)&prototype));
+    uint32_t spawned = dmGameObject::SpawnMany(m_Collection, prototype, "/test.goc", count, ids, 0x0, 0, positions, Quat::identity(), Vector3(1, 1, 1), instances);
+    dmResource::Release(m_Factory, prototype);
+    ASSERT_EQ(count, spawned);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        ASSERT_NE((void*)0, instances[i]);
+        dmGameObject::AssignInstanceIndex(indices[i], instances[i]);
+        ASSERT_EQ(ids[i], dmGameObject::GetIdentifier(instances[i]));
+        ASSERT_EQ((float)i, dmGameObject::GetPosition(instances[i]).getX());
+    }
+
+    // The id of the first instance is already taken
+    dmhash_t dup_ids[2] = { ids[0], dmGameObject::ConstructInstanceId(dmGameObject::AcquireInstanceIndex(m_Collection)) };
+    dmGameObject::HInstance dup_instances[2];
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(m_Factory, "/test.goc", (void**)&prototype));
+    spawned = dmGameObject::SpawnMany(m_Collection, prototype, "/test.goc", 2, dup_ids, 0x0, 0, positions, Quat::identity(), Vector3(1, 1, 1), dup_instances);
+    dmResource::Release(m_Factory, prototype);
+    ASSERT_EQ(1u, spawned);
+    ASSERT_EQ((void*)0, dup_instances[0]);
+    ASSERT_NE((void*)0, dup_instances[1]);
+}
+
+TEST_F(FactoryTest, FactorySpawnManyComponentOrder)
+{
+    const uint32_t count = 4;
+    dmhash_t ids[count];
+    Point3 positions[count];
+    dmGameObject::HInstance instances[count];
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        ids[i] = dmGameObject::ConstructInstanceId(dmGameObject::AcquireInstanceIndex(m_Collection));
+        positions[i] = Point3((float)i, 0.0f, 0.0f);
+    }
+
+    dmGameObject::HPrototype prototype = 0x0;
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(m_Factory, "/test_many.goc", (void**)&prototype));
+    m_LogCreate = true;
+    uint32_t spawned = dmGameObject::SpawnMany(m_Collection, prototype, "/test_many.goc", count, ids, 0x0, 0, positions, Quat::identity(), Vector3(1, 1, 1), instances);
+    m_LogCreate = false;
+    dmResource::Release(m_Factory, prototype);
+    ASSERT_EQ(count, spawned);
+
+    // Each component is created for all instances before the next component
+    ASSERT_EQ(2 * count, m_CreateCount);
+    for (uint32_t c = 0; c < 2; ++c)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            ASSERT_EQ(instances[i], m_CreateInstances[c * count + i]);
+            ASSERT_EQ(c, m_CreateComponents[c * count + i]);
+        }
+    }
+}
+
+TEST_F(FactoryTest, FactorySpawnDeleteThroughput)
+{
+    const uint32_t count = 1000;
+    const uint32_t iterations = 20;
+    dmhash_t ids[count];
+    uint32_t indices[count];
+    Point3 positions[count];
+    dmGameObject::HInstance instances[count];
+
+    dmGameObject::HPrototype prototype = 0x0;
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(m_Factory, "/test.goc", (void**)&prototype));
+
+    for (uint32_t batched = 0; batched < 2; ++batched)
+    {
+        uint64_t spawn_time = 0;
+        uint64_t delete_time = 0;
+        for (uint32_t iter = 0; iter < iterations; ++iter)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                indices[i] = dmGameObject::AcquireInstanceIndex(m_Collection);
+                ids[i] = dmGameObject::ConstructInstanceId(indices[i]);
+                positions[i] = Point3((float)i, 0.0f, 0.0f);
+            }
+
+            uint64_t start = dmTime::GetTime();
+            if (batched)
+            {
+                ASSERT_EQ(count, dmGameObject::SpawnMany(m_Collection, prototype, "/test.goc", count, ids, 0x0, 0, positions, Quat::identity(), Vector3(1, 1, 1), instances));
+            }
+            else
+            {
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    instances[i] = dmGameObject::Spawn(m_Collection, prototype, "/test.goc", ids[i], 0x0, 0, positions[i], Quat::identity(), Vector3(1, 1, 1));
+                }
+            }
+            spawn_time += dmTime::GetTime() - start;
+
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                ASSERT_NE((void*)0, instances[i]);
+                dmGameObject::AssignInstanceIndex(indices[i], instances[i]);
+            }
+
+            start = dmTime::GetTime();
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                dmGameObject::Delete(m_Collection, instances[i], false);
+            }
+            ASSERT_TRUE(dmGameObject::PostUpdate(m_Collection));
+            delete_time += dmTime::GetTime() - start;
+        }
+
+        printf("%s: %u instances spawned in %.3f ms, deleted in %.3f ms\n", batched ? "SpawnMany" : "Spawn", count,
+            spawn_time / (1000.0 * iterations), delete_time / (1000.0 * iterations));
+    }
+
+    dmResource::Release(m_Factory, prototype);
+}
+
 int main(int argc, char **argv)
 {
     jc_test_init(&argc, argv);
@@ -131,9 +131,8 @@ namespace dmGameSystem
         return dmGameObject::CREATE_RESULT_OK;
     }
 
-    dmGameObject::UpdateResult CompCameraUpdate(const dmGameObject::ComponentsUpdateParams& params, dmGameObject::ComponentsUpdateResult& update_result)
+    static dmGameObject::UpdateResult UpdateViewProjection(CameraWorld* w, dmRender::RenderContext* render_context)
     {
-        CameraWorld* w = (CameraWorld*)params.m_World;
         CameraComponent* camera = 0x0;
         if (w->m_FocusStack.Size() > 0)
         {
@@ -141,8 +140,6 @@ namespace dmGameSystem
         }
         if (camera != 0x0 && camera->m_AddedToUpdate)
         {
-            dmRender::RenderContext* render_context = (dmRender::RenderContext*)params.m_Context;
-
             float aspect_ratio = camera->m_AspectRatio;
             if (camera->m_AutoAspectRatio)
             {
@@ -192,6 +189,25 @@ namespace dmGameSystem
         return dmGameObject::UPDATE_RESULT_OK;
     }
 
+    dmGameObject::UpdateResult CompCameraUpdate(const dmGameObject::ComponentsUpdateParams& params, dmGameObject::ComponentsUpdateResult& update_result)
+    {
+        // With interpolated transforms, the view has to follow the blended transforms from CompCameraRender
+        if (dmGameObject::GetInterpolateTransforms(dmGameObject::GetRegister(params.m_Collection)))
+        {
+            return dmGameObject::UPDATE_RESULT_OK;
+        }
+        return UpdateViewProjection((CameraWorld*)params.m_World, (dmRender::RenderContext*)params.m_Context);
+    }
+
+    dmGameObject::UpdateResult CompCameraRender(const dmGameObject::ComponentsRenderParams& params)
+    {
+        if (!dmGameObject::GetInterpolateTransforms(dmGameObject::GetRegister(params.m_Collection)))
+        {
+            return dmGameObject::UPDATE_RESULT_OK;
+        }
+        return UpdateViewProjection((CameraWorld*)params.m_World, (dmRender::RenderContext*)params.m_Context);
+    }
+
     dmGameObject::UpdateResult CompCameraOnMessage(const dmGameObject::ComponentOnMessageParams& params)
     {
         CameraComponent* camera = (CameraComponent*)*params.m_UserData;
@@ -30,6 +30,8 @@ namespace dmGameSystem
 
     dmGameObject::UpdateResult CompCameraUpdate(const dmGameObject::ComponentsUpdateParams& params, dmGameObject::ComponentsUpdateResult& update_result);
 
+    dmGameObject::UpdateResult CompCameraRender(const dmGameObject::ComponentsRenderParams& params);
+
     dmGameObject::UpdateResult CompCameraOnMessage(const dmGameObject::ComponentOnMessageParams& params);
 
     void CompCameraOnReload(const dmGameObject::ComponentOnReloadParams& params);
@@ -34,6 +34,7 @@
 #include "../resources/res_gui.h"
 #include "../gamesys.h"
 #include "../gamesys_private.h"
+#include "../texture_streamer.h"
 
 extern unsigned char GUI_VPC[];
 extern uint32_t GUI_VPC_SIZE;
@@ -109,8 +110,8 @@ namespace dmGameSystem
         };
 
         gui_world->m_VertexDeclaration = dmGraphics::NewVertexDeclaration(dmRender::GetGraphicsContext(gui_context->m_RenderContext), ve, sizeof(ve) / sizeof(dmGraphics::VertexElement));
-        // Grows automatically
-        gui_world->m_ClientVertexBuffer.SetCapacity(512);
+        // The client vertices are frame memory, reserved when rendering
+        gui_world->m_ClientVertexHighWaterMark = 0;
         gui_world->m_VertexBuffer = dmGraphics::NewVertexBuffer(dmRender::GetGraphicsContext(gui_context->m_RenderContext), 0, 0, dmGraphics::BUFFER_USAGE_STREAM_DRAW);
 
         uint8_t white_texture[] = { 0xff, 0xff, 0xff, 0xff,
@@ -769,6 +770,17 @@ namespace dmGameSystem
         ApplyStencilClipping(gui_context, state, params.m_StencilTestParams);
     }
 
+    // The client vertex buffer is frame memory, see CompGuiRender. It only grows in a frame with more vertices than
+    // any frame before, and then by at least twice the size since the render list allocates in between and it is moved
+    static void ReserveClientVertices(RenderGuiContext* gui_context, uint32_t vertex_count)
+    {
+        dmArray<BoxVertex>& vertices = gui_context->m_GuiWorld->m_ClientVertexBuffer;
+        if (vertices.Remaining() < vertex_count) {
+            uint32_t capacity = dmMath::Max(vertices.Capacity() * 2, dmMath::Max(128U, vertices.Size() + vertex_count));
+            dmFrameAllocator::SetCapacity(dmRender::GetFrameAllocator(gui_context->m_RenderContext), vertices, capacity);
+        }
+    }
+
     static dmGraphics::HTexture GetNodeTexture(dmGui::HScene scene, dmGui::HNode node)
     {
         dmGui::NodeTextureType texture_type;
@@ -924,9 +936,7 @@ namespace dmGameSystem
 
         vertex_count = dmMath::Min(vertex_count, vb_max_size / (uint32_t)sizeof(ParticleGuiVertex));
 
-        if (gui_world->m_ClientVertexBuffer.Remaining() < vertex_count) {
-            gui_world->m_ClientVertexBuffer.OffsetCapacity(dmMath::Max(128U, vertex_count));
-        }
+        ReserveClientVertices(gui_context, vertex_count);
 
         ParticleGuiVertex *vb_begin = gui_world->m_ClientVertexBuffer.End();
         ParticleGuiVertex *vb_end = vb_begin;
@@ -1033,9 +1043,7 @@ namespace dmGameSystem
             ro.m_Textures[0] = gui_world->m_WhiteTexture;
         }
 
-        if (gui_world->m_ClientVertexBuffer.Remaining() < vertex_count) {
-            gui_world->m_ClientVertexBuffer.OffsetCapacity(dmMath::Max(128U, vertex_count));
-        }
+        ReserveClientVertices(gui_context, vertex_count);
 
         // Fill in vertex buffer
         BoxVertex *vb_begin = gui_world->m_ClientVertexBuffer.End();
@@ -1103,9 +1111,7 @@ namespace dmGameSystem
         else
             ro.m_Textures[0] = gui_world->m_WhiteTexture;
 
-        if (gui_world->m_ClientVertexBuffer.Remaining() < (max_total_vertices)) {
-            gui_world->m_ClientVertexBuffer.OffsetCapacity(dmMath::Max(128U, max_total_vertices));
-        }
+        ReserveClientVertices(gui_context, max_total_vertices);
 
         // 9-slice values are specified with reference to the original graphics and not by
         // the possibly stretched texture.
@@ -1413,9 +1419,7 @@ namespace dmGameSystem
             max_total_vertices += ComputeRequiredVertices(dmGui::GetNodePerimeterVertices(scene, entries[i].m_Node));
         }
 
-        if (gui_world->m_ClientVertexBuffer.Remaining() < max_total_vertices) {
-            gui_world->m_ClientVertexBuffer.OffsetCapacity(dmMath::Max(128U, max_total_vertices));
-        }
+        ReserveClientVertices(gui_context, max_total_vertices);
 
         for (uint32_t i = 0; i < node_count; ++i)
         {
@@ -1876,7 +1880,12 @@ namespace dmGameSystem
         }
 
         gui_world->m_GuiRenderObjects.SetSize(0);
-        gui_world->m_ClientVertexBuffer.SetSize(0);
+
+        // Vertices are uploaded as each scene is rendered, so they only need frame memory.
+        // Reserve as many as the most any frame has used, the buffer can't grow in place once the render list is allocated from
+        gui_world->m_ClientVertexHighWaterMark = dmMath::Max(gui_world->m_ClientVertexHighWaterMark, gui_world->m_ClientVertexBuffer.Size());
+        dmFrameAllocator::ResetArray(gui_world->m_ClientVertexBuffer);
+        dmFrameAllocator::SetCapacity(dmRender::GetFrameAllocator(gui_context->m_RenderContext), gui_world->m_ClientVertexBuffer, gui_world->m_ClientVertexHighWaterMark);
 
         uint32_t lastEnd = 0;
 
@@ -1899,6 +1908,10 @@ namespace dmGameSystem
             while (lastEnd < gui_world->m_GuiRenderObjects.Size())
             {
                 const GuiRenderObject& gro = gui_world->m_GuiRenderObjects[lastEnd];
+                if (gui_context->m_TextureStreamer)
+                {
+                    ReportTextureUsage(gui_context->m_TextureStreamer, gro.m_RenderObject);
+                }
                 write_ptr->m_MinorOrder = 0;
                 write_ptr->m_MajorOrder = dmRender::RENDER_ORDER_AFTER_WORLD;
                 write_ptr->m_Order = MakeFinalRenderOrder(render_order, gro.m_SortOrder);
@@ -86,6 +86,8 @@ namespace dmGameSystem
         dmGraphics::HVertexDeclaration   m_VertexDeclaration;
         dmGraphics::HVertexBuffer        m_VertexBuffer;
         dmArray<BoxVertex>               m_ClientVertexBuffer;
+        // Most client vertices used in a frame
+        uint32_t                         m_ClientVertexHighWaterMark;
         dmGraphics::HTexture             m_WhiteTexture;
         dmParticle::HParticleContext     m_ParticleContext;
         uint32_t                         m_MaxParticleFXCount;
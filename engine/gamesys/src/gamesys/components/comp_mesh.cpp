@@ -18,6 +18,7 @@
 
 #include <dlib/array.h>
 #include <dlib/hash.h>
+#include <dlib/hashtable.h>
 #include <dlib/log.h>
 #include <dlib/message.h>
 #include <dlib/profile.h>
@@ -37,6 +38,7 @@
 #include "mesh_ddf.h"
 
 #include "../resources/res_mesh.h"
+#include "../texture_streamer.h"
 
 namespace dmGameSystem
 {
@@ -73,6 +75,7 @@ namespace dmGameSystem
     struct MeshWorld
     {
         dmResource::HFactory               m_ResourceFactory;
+        HTextureStreamer                   m_TextureStreamer;
         uint32_t                           m_CurrentVertexBuffer;
         dmArray<dmGraphics::HVertexBuffer> m_VertexBuffers;
         void*                              m_WorldVertexData;
@@ -83,12 +86,22 @@ namespace dmGameSystem
 
         dmObjectPool<MeshComponent*>       m_Components;
         dmArray<dmRender::RenderObject>    m_RenderObjects;
+        /// Per-instance world transforms, one vec4 stream per matrix column
+        dmGraphics::HVertexDeclaration     m_InstanceVertexDeclaration;
+        dmArray<Matrix4>                   m_InstanceTransforms;
+        /// Mesh vertex declarations extended with the world transform of each vertex, used instead of
+        /// instancing when it isn't supported. Keyed by the hash of the declaration they extend.
+        dmHashTable32<dmGraphics::HVertexDeclaration> m_WorldTransformVertexDeclarations;
     };
 
     static const uint32_t MAX_TEXTURE_COUNT = dmRender::RenderObject::MAX_TEXTURE_COUNT;
 
     static const dmhash_t PROP_VERTICES = dmHashString64("vertices");
 
+    // Local space materials declaring this attribute are drawn with instancing, the
+    // world transform columns are then read from mtx_world_0 to mtx_world_3
+    static const char* INSTANCE_ATTRIBUTE = "mtx_world_0";
+
     static void ResourceReloadedCallback(const dmResource::ResourceReloadedParams& params);
 
     dmGameObject::CreateResult CompMeshNewWorld(const dmGameObject::ComponentNewWorldParams& params)
@@ -97,6 +110,7 @@ namespace dmGameSystem
 
         MeshWorld* world = new MeshWorld();
         world->m_ResourceFactory = context->m_Factory;
+        world->m_TextureStreamer = context->m_TextureStreamer;
         world->m_Components.SetCapacity(context->m_MaxMeshCount);
         world->m_RenderObjects.SetCapacity(context->m_MaxMeshCount);
 
@@ -109,6 +123,15 @@ namespace dmGameSystem
 
         world->m_RenderedVertexSize = 0;
 
+        dmGraphics::VertexElement ve[] =
+        {
+            {"mtx_world_0", 0, 4, dmGraphics::TYPE_FLOAT, false},
+            {"mtx_world_1", 1, 4, dmGraphics::TYPE_FLOAT, false},
+            {"mtx_world_2", 2, 4, dmGraphics::TYPE_FLOAT, false},
+            {"mtx_world_3", 3, 4, dmGraphics::TYPE_FLOAT, false},
+        };
+        world->m_InstanceVertexDeclaration = dmGraphics::NewVertexDeclaration(dmRender::GetGraphicsContext(context->m_RenderContext), ve, sizeof(ve) / sizeof(dmGraphics::VertexElement));
+
         *params.m_World = world;
 
         dmResource::RegisterResourceReloadedCallback(context->m_Factory, ResourceReloadedCallback, world);
@@ -116,6 +139,11 @@ namespace dmGameSystem
         return dmGameObject::CREATE_RESULT_OK;
     }
 
+    static void DeleteVertexDeclarationCallback(void*, const uint32_t* key, dmGraphics::HVertexDeclaration* vert_decl)
+    {
+        dmGraphics::DeleteVertexDeclaration(*vert_decl);
+    }
+
     dmGameObject::CreateResult CompMeshDeleteWorld(const dmGameObject::ComponentDeleteWorldParams& params)
     {
         MeshWorld* world = (MeshWorld*)params.m_World;
@@ -129,6 +157,9 @@ namespace dmGameSystem
             free(world->m_WorldVertexData);
         }
 
+        dmGraphics::DeleteVertexDeclaration(world->m_InstanceVertexDeclaration);
+        world->m_WorldTransformVertexDeclarations.Iterate(DeleteVertexDeclarationCallback, (void*)0);
+
         dmResource::UnregisterResourceReloadedCallback(((MeshContext*)params.m_Context)->m_Factory, ResourceReloadedCallback, world);
 
         delete world;
@@ -525,23 +556,78 @@ namespace dmGameSystem
 
         FillRenderObject(ro, mr->m_PrimitiveType, material, mr->m_Textures, vert_decl, vert_buffer, 0, element_count, Matrix4::identity(), first->m_RenderConstants);
         dmGraphics::SetVertexBufferData(vert_buffer, vert_size * element_count, world->m_WorldVertexData, dmGraphics::BUFFER_USAGE_DYNAMIC_DRAW);
+        if (world->m_TextureStreamer)
+        {
+            ReportTextureUsage(world->m_TextureStreamer, ro);
+        }
         dmRender::AddToRender(render_context, &ro);
     }
 
 
+    static dmGraphics::HVertexDeclaration GetWorldTransformVertexDeclaration(MeshWorld* world, BufferResource* br, dmGraphics::HVertexDeclaration vert_decl, uint32_t vert_size)
+    {
+        HashState32 state;
+        dmHashInit32(&state, false);
+        dmGraphics::HashVertexDeclaration(&state, vert_decl);
+        dmHashUpdateBuffer32(&state, &vert_size, sizeof(vert_size));
+        uint32_t key = dmHashFinal32(&state);
+
+        dmGraphics::HVertexDeclaration* cached = world->m_WorldTransformVertexDeclarations.Get(key);
+        if (cached)
+        {
+            return *cached;
+        }
+
+        dmGraphics::HVertexDeclaration transform_vert_decl;
+        uint32_t elem_count, transform_vert_size;
+        if (!BuildVertexDeclaration(br, &transform_vert_decl, &elem_count, &transform_vert_size, true))
+        {
+            return 0;
+        }
+
+        if (world->m_WorldTransformVertexDeclarations.Full())
+        {
+            uint32_t capacity = world->m_WorldTransformVertexDeclarations.Capacity() + 8;
+            world->m_WorldTransformVertexDeclarations.SetCapacity(capacity / 2 + 1, capacity);
+        }
+        world->m_WorldTransformVertexDeclarations.Put(key, transform_vert_decl);
+        return transform_vert_decl;
+    }
+
     static inline void RenderBatchLocalVS(MeshWorld* world, dmRender::HMaterial material, dmRender::HRenderContext render_context, dmRender::RenderListEntry *buf, uint32_t* begin, uint32_t* end)
     {
         DM_PROFILE(Mesh, "RenderBatchLocal");
 
-        for (uint32_t *i=begin;i!=end;i++)
+        bool instanced = dmRender::GetMaterialAttributeLocation(material, INSTANCE_ATTRIBUTE) != -1;
+        // Without instancing, the world transform is instead stored with each vertex of a non-instanced draw
+        bool world_transform_vertices = false;
+        if (instanced && !dmGraphics::IsInstancingSupported(dmRender::GetGraphicsContext(render_context)))
         {
-            dmRender::RenderObject& ro = *world->m_RenderObjects.End();
-            world->m_RenderObjects.SetSize(world->m_RenderObjects.Size()+1);
+            dmLogOnceWarning("The material uses the '%s' attribute but instancing isn't supported by the graphics device, the world transform is stored per vertex instead.", INSTANCE_ATTRIBUTE);
+            instanced = false;
+            world_transform_vertices = true;
+        }
 
+        for (uint32_t *i=begin;i!=end;)
+        {
             const MeshComponent* component = (MeshComponent*) buf[*i].m_UserData;
             const MeshResource* mr = component->m_Resource;
             dmGameSystem::BufferResource* br = GetVerticesBuffer(component, component->m_Resource);
 
+            // The batch shares material, textures and constants. Consecutive components that
+            // also share the mesh vertices are drawn as instances of a single render object.
+            uint32_t* run_end = i + 1;
+            if (instanced && !HasCustomVerticesBuffer(component, mr))
+            {
+                while (run_end != end)
+                {
+                    const MeshComponent* c = (MeshComponent*) buf[*run_end].m_UserData;
+                    if (c->m_Resource != mr || HasCustomVerticesBuffer(c, mr))
+                        break;
+                    ++run_end;
+                }
+            }
+
             // Setup vertex declaration, buffer, count and sizes etc.
             // These defaults to values in the mesh and buffer resources,
             // but will be overwritten if the component instance has a "custom"
@@ -554,7 +640,44 @@ namespace dmGameSystem
                 vert_decl = component->m_VertexDeclaration;
                 vert_size = component->m_VertSize;
                 elem_count = component->m_ElementCount;
+            }
+
+            uint8_t* bytes = 0x0;
+            uint32_t size = 0;
+            dmBuffer::Result r = dmBuffer::GetBytes(br->m_Buffer, (void**)&bytes, &size);
+            assert(r == dmBuffer::RESULT_OK);
+
+            if (world_transform_vertices)
+            {
+                // Each vertex is followed by the world transform, so the vertices are copied to a buffer of their own
+                vert_decl = GetWorldTransformVertexDeclaration(world, br, vert_decl, vert_size);
+                if (!vert_decl)
+                {
+                    i = run_end;
+                    continue;
+                }
+
+                uint32_t transform_vert_size = vert_size + sizeof(Matrix4);
+                if (world->m_WorldVertexDataSize < transform_vert_size * elem_count)
+                {
+                    world->m_WorldVertexDataSize = transform_vert_size * elem_count;
+                    world->m_WorldVertexData = realloc(world->m_WorldVertexData, world->m_WorldVertexDataSize);
+                }
 
+                uint8_t* dst = (uint8_t*) world->m_WorldVertexData;
+                for (uint32_t v = 0; v < elem_count; ++v)
+                {
+                    memcpy(dst, bytes + v * vert_size, vert_size);
+                    memcpy(dst + vert_size, &component->m_World, sizeof(Matrix4));
+                    dst += transform_vert_size;
+                }
+
+                vert_size = transform_vert_size;
+                bytes = (uint8_t*) world->m_WorldVertexData;
+                vert_buf = GetFreeVertexBuffer(world, render_context);
+            }
+            else if (HasCustomVerticesBuffer(component, mr))
+            {
                 // TODO: In the future we'd want a way to associate a custom buffer
                 //       with its own vertex buffer, so we can minimize the usage.
                 //       E.g. creating a dynamically updating buffer, and assigning
@@ -562,11 +685,6 @@ namespace dmGameSystem
                 vert_buf = GetFreeVertexBuffer(world, render_context);
             }
 
-            uint8_t* bytes = 0x0;
-            uint32_t size = 0;
-            dmBuffer::Result r = dmBuffer::GetBytes(br->m_Buffer, (void**)&bytes, &size);
-            assert(r == dmBuffer::RESULT_OK);
-
             // NOTE: Buffers can be updated at runtime from either Lua or C, and since
             // we always set the buffer data here each frame the change will be shown directly.
             // Preferably we would like to just reuse the vertex buffer, and only set the data
@@ -575,8 +693,41 @@ namespace dmGameSystem
 
             world->m_RenderedVertexSize += vert_size * elem_count;
 
-            FillRenderObject(ro, mr->m_PrimitiveType, material, mr->m_Textures, vert_decl, vert_buf, 0, elem_count, component->m_World, component->m_RenderConstants);
+            dmRender::RenderObject& ro = *world->m_RenderObjects.End();
+            world->m_RenderObjects.SetSize(world->m_RenderObjects.Size()+1);
+
+            if (instanced)
+            {
+                uint32_t instance_count = (uint32_t)(run_end - i);
+                dmArray<Matrix4>& transforms = world->m_InstanceTransforms;
+                if (transforms.Capacity() < instance_count)
+                {
+                    transforms.SetCapacity(instance_count);
+                }
+                transforms.SetSize(0);
+                for (uint32_t* j = i; j != run_end; ++j)
+                {
+                    transforms.Push(((MeshComponent*) buf[*j].m_UserData)->m_World);
+                }
+
+                dmGraphics::HVertexBuffer instance_buf = GetFreeVertexBuffer(world, render_context);
+                dmGraphics::SetVertexBufferData(instance_buf, instance_count * sizeof(Matrix4), transforms.Begin(), dmGraphics::BUFFER_USAGE_DYNAMIC_DRAW);
+
+                FillRenderObject(ro, mr->m_PrimitiveType, material, mr->m_Textures, vert_decl, vert_buf, 0, elem_count, Matrix4::identity(), component->m_RenderConstants);
+                ro.m_InstanceVertexDeclaration = world->m_InstanceVertexDeclaration;
+                ro.m_InstanceVertexBuffer = instance_buf;
+                ro.m_InstanceCount = instance_count;
+            }
+            else
+            {
+                FillRenderObject(ro, mr->m_PrimitiveType, material, mr->m_Textures, vert_decl, vert_buf, 0, elem_count, component->m_World, component->m_RenderConstants);
+            }
+            if (world->m_TextureStreamer)
+            {
+                ReportTextureUsage(world->m_TextureStreamer, ro);
+            }
             dmRender::AddToRender(render_context, &ro);
+            i = run_end;
         }
     }
 
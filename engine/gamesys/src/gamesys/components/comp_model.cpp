@@ -30,6 +30,7 @@
 
 #include "../gamesys.h"
 #include "../gamesys_private.h"
+#include "../texture_streamer.h"
 #include "comp_private.h"
 
 #include "gamesys_ddf.h"
@@ -76,6 +77,7 @@ namespace dmGameSystem
         // Temporary scratch array for instances, only used during the creation phase of components
         dmArray<dmGameObject::HInstance> m_ScratchInstances;
         dmRig::HRigContext              m_RigContext;
+        HTextureStreamer                m_TextureStreamer;
         uint32_t                        m_MaxElementsVertices;
         uint32_t                        m_VertexBufferSwapChainIndex;
         uint32_t                        m_VertexBufferSwapChainSize;
@@ -98,6 +100,7 @@ namespace dmGameSystem
         ModelContext* context = (ModelContext*)params.m_Context;
         dmRender::HRenderContext render_context = context->m_RenderContext;
         ModelWorld* world = new ModelWorld();
+        world->m_TextureStreamer = context->m_TextureStreamer;
 
         dmRig::NewContextParams rig_params = {0};
         rig_params.m_Context = &world->m_RigContext;
@@ -484,6 +487,11 @@ namespace dmGameSystem
                 dmRender::EnableRenderObjectConstant(&ro, c.m_NameHash, c.m_Value);
             }
 
+            if (world->m_TextureStreamer)
+            {
+                ReportTextureUsage(world->m_TextureStreamer, ro);
+            }
+
             dmRender::AddToRender(render_context, &ro);
         }
     }
@@ -556,6 +564,11 @@ namespace dmGameSystem
             dmRender::EnableRenderObjectConstant(&ro, c.m_NameHash, c.m_Value);
         }
 
+        if (world->m_TextureStreamer)
+        {
+            ReportTextureUsage(world->m_TextureStreamer, ro);
+        }
+
         dmRender::AddToRender(render_context, &ro);
     }
 
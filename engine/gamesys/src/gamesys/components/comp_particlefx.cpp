@@ -31,6 +31,7 @@
 
 #include "resources/res_particlefx.h"
 #include "resources/res_textureset.h"
+#include "texture_streamer.h"
 
 namespace dmGameSystem
 {
@@ -254,6 +255,10 @@ namespace dmGameSystem
         ro.m_Material = (dmRender::HMaterial)first->m_Material;
         ro.m_Textures[0] = (dmGraphics::HTexture)first->m_Texture;
         ro.m_VertexStart = vb_begin - vertex_buffer.Begin();
+        if (pfx_context->m_TextureStreamer)
+        {
+            ReportTextureUsage(pfx_context->m_TextureStreamer, ro);
+        }
         ro.m_VertexCount = ro_vertex_count;
         ro.m_VertexBuffer = pfx_world->m_VertexBuffer;
         ro.m_VertexDeclaration = pfx_world->m_VertexDeclaration;
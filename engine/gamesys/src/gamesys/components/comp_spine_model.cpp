@@ -31,6 +31,7 @@
 
 #include "../gamesys.h"
 #include "../gamesys_private.h"
+#include "../texture_streamer.h"
 
 #include "spine_ddf.h"
 #include "sprite_ddf.h"
@@ -72,6 +73,7 @@ namespace dmGameSystem
         SpineModelContext* context = (SpineModelContext*)params.m_Context;
         dmRender::HRenderContext render_context = context->m_RenderContext;
         SpineModelWorld* world = new SpineModelWorld();
+        world->m_TextureStreamer = context->m_TextureStreamer;
 
         dmRig::NewContextParams rig_params = {0};
         rig_params.m_Context = &world->m_RigContext;
@@ -496,6 +498,11 @@ namespace dmGameSystem
 
         ro.m_SetBlendFactors = 1;
 
+        if (world->m_TextureStreamer)
+        {
+            ReportTextureUsage(world->m_TextureStreamer, ro);
+        }
+
         dmRender::AddToRender(render_context, &ro);
     }
 
@@ -18,6 +18,7 @@
 #include <gameobject/gameobject.h>
 #include <rig/rig.h>
 
+#include "../gamesys.h"
 #include "../resources/res_spine_model.h"
 #include "comp_private.h"
 
@@ -58,6 +59,7 @@ namespace dmGameSystem
         // Temporary scratch array for instances, only used during the creation phase of components
         dmArray<dmGameObject::HInstance>    m_ScratchInstances;
         dmRig::HRigContext                  m_RigContext;
+        HTextureStreamer                    m_TextureStreamer;
     };
 
     dmGameObject::CreateResult CompSpineModelNewWorld(const dmGameObject::ComponentNewWorldParams& params);
@@ -17,6 +17,7 @@
 #include <algorithm>
 
 #include <dlib/array.h>
+#include <dlib/condition_variable.h>
 #include <dlib/hash.h>
 #include <dlib/log.h>
 #include <dlib/message.h>
@@ -24,6 +25,8 @@
 #include <dlib/dstrings.h>
 #include <dlib/object_pool.h>
 #include <dlib/math.h>
+#include <dlib/mutex.h>
+#include <dlib/thread.h>
 #include <graphics/graphics.h>
 #include <render/render.h>
 #include <gameobject/gameobject_ddf.h>
@@ -31,11 +34,18 @@
 #include "../resources/res_sprite.h"
 #include "../gamesys.h"
 #include "../gamesys_private.h"
+#include "../texture_streamer.h"
 #include "comp_private.h"
 
 #include "sprite_ddf.h"
 #include "gamesys_ddf.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 using namespace Vectormath::Aos;
 namespace dmGameSystem
 {
@@ -86,6 +96,36 @@ namespace dmGameSystem
         float v;
     };
 
+    /// Maximum number of helper threads filling sprite data besides the render thread
+    static const uint32_t SPRITE_MAX_WORKER_THREADS = 3;
+    static const uint32_t SPRITE_WORKER_THREAD_STACK_SIZE = 0x10000;
+    /// Number of sprites processed per job. Ranges shorter than two chunks are processed on the calling thread
+    static const uint32_t SPRITE_WORKER_CHUNK_SIZE = 2048;
+
+    typedef void (*SpriteRangeFunction)(void* context, uint32_t begin, uint32_t end);
+
+    struct SpriteWorkers
+    {
+        dmMutex::HMutex                         m_Mutex;
+        dmConditionVariable::HConditionVariable m_WorkAdded;
+        dmConditionVariable::HConditionVariable m_WorkDone;
+        dmThread::Thread                        m_Threads[SPRITE_MAX_WORKER_THREADS];
+        uint32_t                                m_ThreadCount;
+        // The range currently being processed, m_Function is 0 when idle
+        SpriteRangeFunction                     m_Function;
+        void*                                   m_Context;
+        uint32_t                                m_Count;
+        uint32_t                                m_Next;
+        uint32_t                                m_Active;
+        bool                                    m_Quit;
+    };
+
+    struct SpriteSortKey
+    {
+        float       m_Z;
+        uint32_t    m_BatchKey;
+    };
+
     struct SpriteWorld
     {
         dmObjectPool<SpriteComponent>   m_Components;
@@ -97,6 +137,13 @@ namespace dmGameSystem
         dmGraphics::HIndexBuffer        m_IndexBuffer;
         uint8_t*                        m_IndexBufferData;
         uint8_t*                        m_IndexBufferWritePtr;
+        // Owns the worker threads shared by the worlds
+        SpriteContext*                  m_Context;
+        HTextureStreamer                m_TextureStreamer;
+        // Component indices in render order, kept across frames. See UpdateSortOrder
+        dmArray<uint32_t>               m_SortOrder;
+        dmArray<SpriteSortKey>          m_SortKeys;
+        uint8_t                         m_SortOrderDirty : 1;
         uint8_t                         m_Is16BitIndex : 1;
         uint8_t                         m_UseGeometries : 1;
         uint8_t                         m_ReallocBuffers : 1;
@@ -113,6 +160,126 @@ namespace dmGameSystem
     static float GetPlaybackRate(SpriteComponent* component);
     static void SetPlaybackRate(SpriteComponent* component, float playback_rate);
 
+    // Must be called with the mutex locked. Returns false when there are no chunks left
+    static bool ProcessSpriteChunk(SpriteWorkers* workers)
+    {
+        if (!workers->m_Function || workers->m_Next >= workers->m_Count)
+            return false;
+
+        SpriteRangeFunction function = workers->m_Function;
+        void* context = workers->m_Context;
+        uint32_t begin = workers->m_Next;
+        uint32_t end = dmMath::Min(begin + SPRITE_WORKER_CHUNK_SIZE, workers->m_Count);
+        workers->m_Next = end;
+        workers->m_Active++;
+        dmMutex::Unlock(workers->m_Mutex);
+
+        function(context, begin, end);
+
+        dmMutex::Lock(workers->m_Mutex);
+        workers->m_Active--;
+        if (workers->m_Next >= workers->m_Count && workers->m_Active == 0)
+        {
+            dmConditionVariable::Broadcast(workers->m_WorkDone);
+        }
+        return true;
+    }
+
+    static void SpriteWorkerThread(void* context)
+    {
+        SpriteWorkers* workers = (SpriteWorkers*)context;
+        dmMutex::ScopedLock lk(workers->m_Mutex);
+        while (!workers->m_Quit)
+        {
+            if (!ProcessSpriteChunk(workers))
+            {
+                dmConditionVariable::Wait(workers->m_WorkAdded, workers->m_Mutex);
+            }
+        }
+    }
+
+    static SpriteWorkers* NewSpriteWorkers()
+    {
+#if defined(__EMSCRIPTEN__)
+        return 0;
+#else
+        SpriteWorkers* workers = new SpriteWorkers;
+        memset(workers, 0, sizeof(*workers));
+        workers->m_Mutex = dmMutex::New();
+        workers->m_WorkAdded = dmConditionVariable::New();
+        workers->m_WorkDone = dmConditionVariable::New();
+        for (uint32_t i = 0; i < SPRITE_MAX_WORKER_THREADS; ++i)
+        {
+            workers->m_Threads[workers->m_ThreadCount++] = dmThread::New(SpriteWorkerThread, SPRITE_WORKER_THREAD_STACK_SIZE, workers, "sprite");
+        }
+        return workers;
+#endif
+    }
+
+    static void DeleteSpriteWorkers(SpriteWorkers* workers)
+    {
+        if (!workers)
+            return;
+        dmMutex::Lock(workers->m_Mutex);
+        workers->m_Quit = true;
+        dmConditionVariable::Broadcast(workers->m_WorkAdded);
+        dmMutex::Unlock(workers->m_Mutex);
+        for (uint32_t i = 0; i < workers->m_ThreadCount; ++i)
+        {
+            dmThread::Join(workers->m_Threads[i]);
+        }
+        dmConditionVariable::Delete(workers->m_WorkDone);
+        dmConditionVariable::Delete(workers->m_WorkAdded);
+        dmMutex::Delete(workers->m_Mutex);
+        delete workers;
+    }
+
+    // Calls function for consecutive sub ranges covering [0, count) and returns when all are done.
+    // Large ranges are split into chunks that the render thread and the worker threads process in parallel.
+    // The workers are shared by all sprite worlds and handle one range at a time, a range submitted while
+    // another one is in progress is processed on the calling thread
+    static void ParallelFor(SpriteWorld* sprite_world, SpriteRangeFunction function, void* context, uint32_t count)
+    {
+        if (count < 2 * SPRITE_WORKER_CHUNK_SIZE)
+        {
+            function(context, 0, count);
+            return;
+        }
+
+        SpriteContext* sprite_context = sprite_world->m_Context;
+        if (!sprite_context->m_Workers)
+            sprite_context->m_Workers = NewSpriteWorkers();
+
+        SpriteWorkers* workers = sprite_context->m_Workers;
+        if (!workers)
+        {
+            function(context, 0, count);
+            return;
+        }
+
+        dmMutex::Lock(workers->m_Mutex);
+        if (workers->m_Function)
+        {
+            dmMutex::Unlock(workers->m_Mutex);
+            function(context, 0, count);
+            return;
+        }
+        workers->m_Function = function;
+        workers->m_Context = context;
+        workers->m_Count = count;
+        workers->m_Next = 0;
+        dmConditionVariable::Broadcast(workers->m_WorkAdded);
+        while (workers->m_Next < workers->m_Count || workers->m_Active > 0)
+        {
+            if (!ProcessSpriteChunk(workers))
+            {
+                dmConditionVariable::Wait(workers->m_WorkDone, workers->m_Mutex);
+            }
+        }
+        workers->m_Function = 0;
+        dmMutex::Unlock(workers->m_Mutex);
+    }
+
     template<typename T>
     void fillIndices(T* index, uint32_t indices_count) {
         for(uint32_t i = 0, v = 0; i < indices_count; i += 6, v += 4)
@@ -191,10 +358,17 @@ namespace dmGameSystem
         sprite_world->m_VertexBufferData = 0;
         sprite_world->m_IndexBuffer = 0;
         sprite_world->m_IndexBufferData = 0;
+        sprite_world->m_Context = sprite_context;
+        sprite_world->m_TextureStreamer = sprite_context->m_TextureStreamer;
+        sprite_world->m_SortOrder.SetCapacity(sprite_context->m_MaxSpriteCount);
+        sprite_world->m_SortKeys.SetCapacity(sprite_context->m_MaxSpriteCount);
+        sprite_world->m_SortOrderDirty = 1;
 
         sprite_world->m_UseGeometries = 0;
         sprite_world->m_ReallocBuffers = 1;
 
+        sprite_context->m_WorldCount++;
+
         *params.m_World = sprite_world;
         return dmGameObject::CREATE_RESULT_OK;
     }
@@ -202,6 +376,12 @@ namespace dmGameSystem
     dmGameObject::CreateResult CompSpriteDeleteWorld(const dmGameObject::ComponentDeleteWorldParams& params)
     {
         SpriteWorld* sprite_world = (SpriteWorld*)params.m_World;
+        SpriteContext* sprite_context = sprite_world->m_Context;
+        if (--sprite_context->m_WorldCount == 0)
+        {
+            DeleteSpriteWorkers(sprite_context->m_Workers);
+            sprite_context->m_Workers = 0;
+        }
         dmGraphics::DeleteVertexDeclaration(sprite_world->m_VertexDeclaration);
         dmGraphics::DeleteVertexBuffer(sprite_world->m_VertexBuffer);
         free(sprite_world->m_VertexBufferData);
@@ -364,6 +544,8 @@ namespace dmGameSystem
         sprite_world->m_ReallocBuffers |= (sprite_world->m_UseGeometries == 0 && texture_set->m_TextureSet->m_UseGeometries != 0) ? 1 : 0;
         sprite_world->m_UseGeometries |= texture_set->m_TextureSet->m_UseGeometries;
 
+        sprite_world->m_SortOrderDirty = 1;
+
         *params.m_UserData = (uintptr_t)index;
         return dmGameObject::CREATE_RESULT_OK;
     }
@@ -381,10 +563,130 @@ namespace dmGameSystem
             dmResource::Release(factory, component->m_TextureSet);
         }
         sprite_world->m_Components.Free(index, true);
+        // Free moves the last component into the freed slot
+        sprite_world->m_SortOrderDirty = 1;
         return dmGameObject::CREATE_RESULT_OK;
     }
 
 
+    struct SpriteQuadBatch
+    {
+        const dmRender::RenderListEntry*              m_Buf;
+        const uint32_t*                               m_Order;
+        const dmGameSystemDDF::TextureSetAnimation*   m_Animations;
+        const float*                                  m_TexCoords;
+        SpriteVertex*                                 m_Vertices;
+    };
+
+    static const int SPRITE_TEX_COORD_ORDER[] = {
+        0,1,2,2,3,0,
+        3,2,1,1,0,3,    //h
+        1,0,3,3,2,1,    //v
+        2,3,0,0,1,2     //hv
+    };
+
+    // Computes one coordinate of the four quad corners for four sprites: t - a - b, t - a + b, t + a + b, t + a - b
+    // The operations are done in the same order in all versions so that the results are identical
+    static inline void GetQuadCorners(const float* t, const float* a, const float* b, float corners[4][4])
+    {
+#if defined(__SSE2__)
+        __m128 tv = _mm_loadu_ps(t);
+        __m128 av = _mm_loadu_ps(a);
+        __m128 bv = _mm_loadu_ps(b);
+        __m128 t_minus_a = _mm_sub_ps(tv, av);
+        __m128 t_plus_a = _mm_add_ps(tv, av);
+        _mm_storeu_ps(corners[0], _mm_sub_ps(t_minus_a, bv));
+        _mm_storeu_ps(corners[1], _mm_add_ps(t_minus_a, bv));
+        _mm_storeu_ps(corners[2], _mm_add_ps(t_plus_a, bv));
+        _mm_storeu_ps(corners[3], _mm_sub_ps(t_plus_a, bv));
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+        float32x4_t tv = vld1q_f32(t);
+        float32x4_t av = vld1q_f32(a);
+        float32x4_t bv = vld1q_f32(b);
+        float32x4_t t_minus_a = vsubq_f32(tv, av);
+        float32x4_t t_plus_a = vaddq_f32(tv, av);
+        vst1q_f32(corners[0], vsubq_f32(t_minus_a, bv));
+        vst1q_f32(corners[1], vaddq_f32(t_minus_a, bv));
+        vst1q_f32(corners[2], vaddq_f32(t_plus_a, bv));
+        vst1q_f32(corners[3], vsubq_f32(t_plus_a, bv));
+#else
+        for (uint32_t k = 0; k < 4; ++k)
+        {
+            corners[0][k] = t[k] - a[k] - b[k];
+            corners[1][k] = t[k] - a[k] + b[k];
+            corners[2][k] = t[k] + a[k] + b[k];
+            corners[3][k] = t[k] + a[k] - b[k];
+        }
+#endif
+    }
+
+    // Fills the quads of the sprites [begin, end) of a batch. The corners are the translation plus or minus
+    // half of the x and y axes of the world matrix. Four sprites are transformed per iteration, laid out as
+    // structure of arrays for GetQuadCorners.
+    static void CreateQuadVertexData(void* context, uint32_t begin, uint32_t end)
+    {
+        DM_PROFILE(Sprite, "CreateQuadVertexData");
+
+        const SpriteQuadBatch* batch = (const SpriteQuadBatch*) context;
+        SpriteVertex* vertices = batch->m_Vertices + begin * 4;
+
+        for (uint32_t i = begin; i < end; i += 4)
+        {
+            uint32_t n = dmMath::Min(4U, end - i);
+
+            float tx[4], ty[4], tz[4];
+            float ax[4], ay[4], az[4];
+            float bx[4], by[4], bz[4];
+            const float* tc[4];
+            const int* tex_lookup[4];
+
+            for (uint32_t k = 0; k < 4; ++k)
+            {
+                // Pad a partial group with the first sprite, only the first n results are written
+                const SpriteComponent* component = (SpriteComponent*) batch->m_Buf[batch->m_Order[i + (k < n ? k : 0)]].m_UserData;
+                const dmGameSystemDDF::TextureSetAnimation* animation_ddf = &batch->m_Animations[component->m_AnimationID];
+
+                uint32_t frame_index = animation_ddf->m_Start + component->m_CurrentAnimationFrame;
+                tc[k] = &batch->m_TexCoords[frame_index * 4 * 2];
+
+                // ddf values are guaranteed to be 0 or 1 when saved by the editor
+                // component values are guaranteed to be 0 or 1
+                uint32_t flip_flag = (animation_ddf->m_FlipHorizontal ^ component->m_FlipHorizontal)
+                                   | ((animation_ddf->m_FlipVertical ^ component->m_FlipVertical) << 1);
+                tex_lookup[k] = &SPRITE_TEX_COORD_ORDER[flip_flag * 6];
+
+                const Matrix4& w = component->m_World;
+                const Vector4 c0 = w.getCol0();
+                const Vector4 c1 = w.getCol1();
+                const Vector4 c3 = w.getCol3();
+                tx[k] = c3.getX(); ty[k] = c3.getY(); tz[k] = c3.getZ();
+                ax[k] = 0.5f * c0.getX(); ay[k] = 0.5f * c0.getY(); az[k] = 0.5f * c0.getZ();
+                bx[k] = 0.5f * c1.getX(); by[k] = 0.5f * c1.getY(); bz[k] = 0.5f * c1.getZ();
+            }
+
+            // [corner][sprite], the corners are (-0.5, -0.5), (-0.5, 0.5), (0.5, 0.5) and (0.5, -0.5)
+            float x[4][4], y[4][4], z[4][4];
+            GetQuadCorners(tx, ax, bx, x);
+            GetQuadCorners(ty, ay, by, y);
+            GetQuadCorners(tz, az, bz, z);
+
+            static const int corner_lookup[] = {0, 1, 2, 4};
+            for (uint32_t k = 0; k < n; ++k)
+            {
+                for (uint32_t corner = 0; corner < 4; ++corner)
+                {
+                    int tex_index = tex_lookup[k][corner_lookup[corner]] * 2;
+                    vertices[corner].x = x[corner][k];
+                    vertices[corner].y = y[corner][k];
+                    vertices[corner].z = z[corner][k];
+                    vertices[corner].u = tc[k][tex_index];
+                    vertices[corner].v = tc[k][tex_index + 1];
+                }
+                vertices += 4;
+            }
+        }
+    }
+
     static void CreateVertexData(SpriteWorld* sprite_world, SpriteVertex** vb_where, uint8_t** ib_where, TextureSetResource* texture_set, dmRender::RenderListEntry* buf, uint32_t* begin, uint32_t* end)
     {
         DM_PROFILE(Sprite, "CreateVertexData");
@@ -472,80 +774,43 @@ namespace dmGameSystem
         }
         else // original path using quads
         {
-            static int tex_coord_order[] = {
-                0,1,2,2,3,0,
-                3,2,1,1,0,3,    //h
-                1,0,3,3,2,1,    //v
-                2,3,0,0,1,2     //hv
-            };
+            uint32_t count = end - begin;
 
-            const float* tex_coords = (const float*) texture_set->m_TextureSet->m_TexCoords.m_Data;
-
-            for (uint32_t *i = begin;i != end; ++i)
-            {
-                const SpriteComponent* component = (SpriteComponent*) buf[*i].m_UserData;
+            SpriteQuadBatch batch;
+            batch.m_Buf = buf;
+            batch.m_Order = begin;
+            batch.m_Animations = animations;
+            batch.m_TexCoords = (const float*) texture_set->m_TextureSet->m_TexCoords.m_Data;
+            batch.m_Vertices = vertices;
 
-                dmGameSystemDDF::TextureSetAnimation* animation_ddf = &animations[component->m_AnimationID];
+            // Each sprite writes exactly four vertices, so chunks can be filled independently
+            ParallelFor(sprite_world, CreateQuadVertexData, &batch, count);
 
-                uint32_t frame_index = animation_ddf->m_Start + component->m_CurrentAnimationFrame;
-                const float* tc = &tex_coords[frame_index * 4 * 2];
-                uint32_t flip_flag = 0;
-
-                // ddf values are guaranteed to be 0 or 1 when saved by the editor
-                // component values are guaranteed to be 0 or 1
-                if (animation_ddf->m_FlipHorizontal ^ component->m_FlipHorizontal)
-                {
-                    flip_flag = 1;
-                }
-                if (animation_ddf->m_FlipVertical ^ component->m_FlipVertical)
-                {
-                    flip_flag |= 2;
-                }
-
-                const int* tex_lookup = &tex_coord_order[flip_flag * 6];
-
-                const Matrix4& w = component->m_World;
-
-                Vector4 p0 = w * Point3(-0.5f, -0.5f, 0.0f);
-                vertices[0].x = p0.getX();
-                vertices[0].y = p0.getY();
-                vertices[0].z = p0.getZ();
-                vertices[0].u = tc[tex_lookup[0] * 2];
-                vertices[0].v = tc[tex_lookup[0] * 2 + 1];
-
-                Vector4 p1 = w * Point3(-0.5f, 0.5f, 0.0f);
-                vertices[1].x = p1.getX();
-                vertices[1].y = p1.getY();
-                vertices[1].z = p1.getZ();
-                vertices[1].u = tc[tex_lookup[1] * 2];
-                vertices[1].v = tc[tex_lookup[1] * 2 + 1];
-
-                Vector4 p2 = w * Point3(0.5f, 0.5f, 0.0f);
-                vertices[2].x = p2.getX();
-                vertices[2].y = p2.getY();
-                vertices[2].z = p2.getZ();
-                vertices[2].u = tc[tex_lookup[2] * 2];
-                vertices[2].v = tc[tex_lookup[2] * 2 + 1];
-
-                Vector4 p3 = w * Point3(0.5f, -0.5f, 0.0f);
-                vertices[3].x = p3.getX();
-                vertices[3].y = p3.getY();
-                vertices[3].z = p3.getZ();
-                vertices[3].u = tc[tex_lookup[4] * 2];
-                vertices[3].v = tc[tex_lookup[4] * 2 + 1];
-
-                // for (int f = 0; f < 4; ++f)
-                //     printf("  %u: %.2f, %.2f\t%.2f, %.2f\n", f, vertices[f].x, vertices[f].y, vertices[f].u, vertices[f].v );
-
-                vertices += 4;
-                indices += 6 * index_type_size;
-            }
+            vertices += 4 * count;
+            indices += 6 * index_type_size * count;
         }
 
         *vb_where = vertices;
         *ib_where = indices;
     }
 
+    // Largest number of pixels per texel in the batch, assuming one world unit per pixel and sprites sized after their images
+    static float GetMaxTexelScale(dmRender::RenderListEntry* buf, uint32_t* begin, uint32_t* end)
+    {
+        float max_scale_sq = 0.0f;
+        for (uint32_t* i = begin; i != end; ++i)
+        {
+            const SpriteComponent* c = (const SpriteComponent*) buf[*i].m_UserData;
+            float width = c->m_Size.getX();
+            float height = c->m_Size.getY();
+            if (width > 0.0f)
+                max_scale_sq = dmMath::Max(max_scale_sq, lengthSqr(c->m_World.getCol0().getXYZ()) / (width * width));
+            if (height > 0.0f)
+                max_scale_sq = dmMath::Max(max_scale_sq, lengthSqr(c->m_World.getCol1().getXYZ()) / (height * height));
+        }
+        return sqrtf(max_scale_sq);
+    }
+
     static void RenderBatch(SpriteWorld* sprite_world, dmRender::HRenderContext render_context, dmRender::RenderListEntry *buf, uint32_t* begin, uint32_t* end)
     {
         DM_PROFILE(Sprite, "RenderBatch");
@@ -577,6 +842,11 @@ namespace dmGameSystem
         ro.m_Material = GetMaterial(first, resource);
         ro.m_Textures[0] = texture_set->m_Texture;
         ro.m_PrimitiveType = dmGraphics::PRIMITIVE_TRIANGLES;
+
+        if (sprite_world->m_TextureStreamer)
+        {
+            ReportTextureUsage(sprite_world->m_TextureStreamer, texture_set->m_Texture, GetMaxTexelScale(buf, begin, end));
+        }
         ro.m_IndexType = sprite_world->m_Is16BitIndex ? dmGraphics::TYPE_UNSIGNED_SHORT : dmGraphics::TYPE_UNSIGNED_INT;
 
         // offset in bytes into element buffer
@@ -628,23 +898,22 @@ namespace dmGameSystem
         dmRender::AddToRender(render_context, &ro);
     }
 
-    static void UpdateTransforms(SpriteWorld* sprite_world, bool sub_pixels)
+    struct SpriteTransformBatch
     {
-        DM_PROFILE(Sprite, "UpdateTransforms");
-
-        dmArray<SpriteComponent>& components = sprite_world->m_Components.m_Objects;
-        uint32_t n = components.Size();
+        SpriteComponent*    m_Components;
+        bool                m_ScaleAlongZ;
+        bool                m_SubPixels;
+    };
 
-        bool scale_along_z = false;
-        if (n > 0) {
-            SpriteComponent* c = &components[0];
-            scale_along_z = dmGameObject::ScaleAlongZ(dmGameObject::GetCollection(c->m_Instance));
-        }
+    static void UpdateTransformsRange(void* context, uint32_t begin, uint32_t end)
+    {
+        DM_PROFILE(Sprite, "UpdateTransformsRange");
 
-        // Note: We update all sprites, even though they might be disabled, or not added to update
+        const SpriteTransformBatch* batch = (const SpriteTransformBatch*) context;
+        SpriteComponent* components = batch->m_Components;
 
-        if (scale_along_z) {
-            for (uint32_t i = 0; i < n; ++i)
+        if (batch->m_ScaleAlongZ) {
+            for (uint32_t i = begin; i < end; ++i)
             {
                 SpriteComponent* c = &components[i];
                 Matrix4 local = dmTransform::ToMatrix4(dmTransform::Transform(c->m_Position, c->m_Rotation, 1.0f));
@@ -654,7 +923,7 @@ namespace dmGameSystem
             }
         } else
         {
-            for (uint32_t i = 0; i < n; ++i)
+            for (uint32_t i = begin; i < end; ++i)
             {
                 SpriteComponent* c = &components[i];
                 Matrix4 local = dmTransform::ToMatrix4(dmTransform::Transform(c->m_Position, c->m_Rotation, 1.0f));
@@ -666,8 +935,8 @@ namespace dmGameSystem
         }
 
         // The "sub_pixels" is set by default
-        if (!sub_pixels) {
-            for (uint32_t i = 0; i < n; ++i) {
+        if (!batch->m_SubPixels) {
+            for (uint32_t i = begin; i < end; ++i) {
                 SpriteComponent* c = &components[i];
                 Vector4 position = c->m_World.getCol3();
                 position.setX((int) position.getX());
@@ -677,6 +946,24 @@ namespace dmGameSystem
         }
     }
 
+    static void UpdateTransforms(SpriteWorld* sprite_world, bool sub_pixels)
+    {
+        DM_PROFILE(Sprite, "UpdateTransforms");
+
+        dmArray<SpriteComponent>& components = sprite_world->m_Components.m_Objects;
+        uint32_t n = components.Size();
+        if (n == 0)
+            return;
+
+        SpriteTransformBatch batch;
+        batch.m_Components = components.Begin();
+        batch.m_ScaleAlongZ = dmGameObject::ScaleAlongZ(dmGameObject::GetCollection(components[0].m_Instance));
+        batch.m_SubPixels = sub_pixels;
+
+        // Note: We update all sprites, even though they might be disabled, or not added to update
+        ParallelFor(sprite_world, UpdateTransformsRange, &batch, n);
+    }
+
     static bool GetSender(SpriteComponent* component, dmMessage::URL* out_sender)
     {
         dmMessage::URL sender;
@@ -840,6 +1127,66 @@ namespace dmGameSystem
         return dmGameObject::UPDATE_RESULT_OK;
     }
 
+    struct SpriteSortKeyLess
+    {
+        bool operator()(uint32_t a, uint32_t b) const
+        {
+            const SpriteSortKey& u = m_Keys[a];
+            const SpriteSortKey& v = m_Keys[b];
+            return u.m_Z < v.m_Z || (u.m_Z == v.m_Z && u.m_BatchKey < v.m_BatchKey);
+        }
+        const SpriteSortKey* m_Keys;
+    };
+
+    // Keeps the components ordered on z and batch key, which is the order the render list sorts world entries
+    // in for the common 2D setup. Submitting in this order lets the render list merge instead of sort. The order
+    // is kept between frames and only re-sorted when a sprite was added or removed, or moved past another in z.
+    static void UpdateSortOrder(SpriteWorld* sprite_world)
+    {
+        DM_PROFILE(Sprite, "UpdateSortOrder");
+
+        dmArray<SpriteComponent>& components = sprite_world->m_Components.m_Objects;
+        uint32_t sprite_count = components.Size();
+
+        dmArray<SpriteSortKey>& keys = sprite_world->m_SortKeys;
+        keys.SetSize(sprite_count);
+        for (uint32_t i = 0; i < sprite_count; ++i)
+        {
+            SpriteComponent& component = components[i];
+            if (component.m_Enabled && component.m_AddedToUpdate &&
+                (component.m_ReHash || dmGameSystem::AreRenderConstantsUpdated(&component.m_RenderConstants)))
+            {
+                ReHash(&component);
+            }
+            keys[i].m_Z = component.m_World.getElem(3, 2);
+            // Only the lower 24 bits are part of the render list sort key
+            keys[i].m_BatchKey = component.m_MixedHash & 0x00ffffff;
+        }
+
+        dmArray<uint32_t>& order = sprite_world->m_SortOrder;
+        SpriteSortKeyLess less;
+        less.m_Keys = keys.Begin();
+
+        if (sprite_world->m_SortOrderDirty || order.Size() != sprite_count)
+        {
+            order.SetSize(sprite_count);
+            for (uint32_t i = 0; i < sprite_count; ++i)
+                order[i] = i;
+            sprite_world->m_SortOrderDirty = 0;
+        }
+        else
+        {
+            uint32_t i = 1;
+            while (i < sprite_count && !less(order[i], order[i-1]))
+                ++i;
+            if (i >= sprite_count)
+                return;
+        }
+
+        DM_PROFILE(Sprite, "SortSprites");
+        std::stable_sort(order.Begin(), order.End(), less);
+    }
+
     static void RenderListDispatch(dmRender::RenderListDispatchParams const &params)
     {
         SpriteWorld* world = (SpriteWorld*) params.m_UserData;
@@ -899,17 +1246,15 @@ namespace dmGameSystem
         dmRender::HRenderListDispatch sprite_dispatch = dmRender::RenderListMakeDispatch(render_context, &RenderListDispatch, sprite_world);
         dmRender::RenderListEntry* write_ptr = render_list;
 
+        UpdateSortOrder(sprite_world);
+        const uint32_t* order = sprite_world->m_SortOrder.Begin();
+
         for (uint32_t i = 0; i < sprite_count; ++i)
         {
-            SpriteComponent& component = components[i];
+            SpriteComponent& component = components[order[i]];
             if (!component.m_Enabled || !component.m_AddedToUpdate)
                 continue;
 
-            if (component.m_ReHash || dmGameSystem::AreRenderConstantsUpdated(&component.m_RenderConstants))
-            {
-                ReHash(&component);
-            }
-
             const Vector4 trans = component.m_World.getCol(3);
             write_ptr->m_WorldPosition = Point3(trans.getX(), trans.getY(), trans.getZ());
             write_ptr->m_UserData = (uintptr_t) &component;
@@ -34,6 +34,7 @@
 #include "../proto/tile_ddf.h"
 #include "../proto/physics_ddf.h"
 #include "../resources/res_tilegrid.h"
+#include "../texture_streamer.h"
 
 namespace dmGameSystem
 {
@@ -118,6 +119,8 @@ namespace dmGameSystem
         TileGridVertex*                 m_VertexBufferDataEnd;
         TileGridVertex*                 m_VertexBufferWritePtr;
 
+        HTextureStreamer                m_TextureStreamer;
+
         uint32_t                        m_MaxTilemapCount;
         uint32_t                        m_MaxTileCount;
     };
@@ -146,6 +149,7 @@ namespace dmGameSystem
         TileGridWorld* world = new TileGridWorld;
         TilemapContext* context = (TilemapContext*)params.m_Context;
         world->m_RenderContext = context->m_RenderContext;
+        world->m_TextureStreamer = context->m_TextureStreamer;
 
         world->m_MaxTilemapCount = context->m_MaxTilemapCount;
         world->m_MaxTileCount = context->m_MaxTileCount;
@@ -629,6 +633,11 @@ namespace dmGameSystem
         ro.m_Material = GetMaterial(first);
         ro.m_Textures[0] = texture_set->m_Texture;
 
+        if (world->m_TextureStreamer)
+        {
+            ReportTextureUsage(world->m_TextureStreamer, ro);
+        }
+
         const dmRender::Constant* constants = first->m_RenderConstants.m_RenderConstants;
         uint32_t size = first->m_RenderConstants.m_ConstantCount;
         for (uint32_t i = 0; i < size; ++i)
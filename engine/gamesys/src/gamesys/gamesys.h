@@ -41,6 +41,11 @@ namespace dmGameSystem
     /// Config key to use for tweaking maximum number of collection factories
     extern const char* COLLECTION_FACTORY_MAX_COUNT_KEY;
 
+    /// Texture streamer handle, see NewTextureStreamer
+    typedef struct TextureStreamer* HTextureStreamer;
+    /// Texture decoder handle, see NewTextureDecoder
+    typedef struct TextureDecoder* HTextureDecoder;
+
     struct TilemapContext
     {
         TilemapContext()
@@ -48,6 +53,8 @@ namespace dmGameSystem
             memset(this, 0, sizeof(*this));
         }
         dmRender::HRenderContext    m_RenderContext;
+        /// Optional, told which textures are drawn
+        HTextureStreamer            m_TextureStreamer;
         uint32_t                    m_MaxTilemapCount;
         uint32_t                    m_MaxTileCount;
     };
@@ -84,6 +91,8 @@ namespace dmGameSystem
         }
         dmResource::HFactory m_Factory;
         dmRender::HRenderContext m_RenderContext;
+        /// Optional, told which textures are drawn
+        HTextureStreamer m_TextureStreamer;
         uint32_t m_MaxParticleFXCount;
         uint32_t m_MaxParticleCount;
         bool m_Debug;
@@ -105,12 +114,55 @@ namespace dmGameSystem
         dmRender::HRenderContext    m_RenderContext;
         dmGui::HContext             m_GuiContext;
         dmScript::HContext          m_ScriptContext;
+        /// Optional, told which textures are drawn
+        HTextureStreamer            m_TextureStreamer;
         uint32_t                    m_MaxGuiComponents;
         uint32_t                    m_MaxParticleFXCount;
         uint32_t                    m_MaxParticleCount;
         uint32_t                    m_MaxSpineCount;
     };
 
+    struct TextureStreamerParams
+    {
+        TextureStreamerParams();
+
+        /// Memory in bytes the streamed mips of all textures should fit within
+        uint32_t m_Budget;
+        /// Textures are first loaded from the largest mip not wider or higher than this. Default 64
+        uint32_t m_InitialSize;
+        /// Textures that haven't been used for this many frames drop back to their initial mips. Default 300
+        uint32_t m_EvictFrames;
+        /// Maximum number of background loads in flight. Default 4
+        uint32_t m_MaxPendingLoads;
+        /// Optional, decodes the reloaded mips
+        HTextureDecoder m_Decoder;
+    };
+
+    struct TextureStreamerStats
+    {
+        /// Number of textures being streamed
+        uint32_t m_TextureCount;
+        /// Bytes of the currently uploaded mips of the streamed textures
+        uint32_t m_ResidentBytes;
+        /// Bytes of the mips the streamed textures should have uploaded, at most the budget
+        uint32_t m_WantedBytes;
+        /// Number of background loads not yet uploaded
+        uint32_t m_PendingLoads;
+    };
+
+    struct TextureContext
+    {
+        TextureContext()
+        {
+            memset(this, 0, sizeof(*this));
+        }
+        dmGraphics::HContext        m_GraphicsContext;
+        /// Optional, textures are loaded with all mips when not set
+        HTextureStreamer            m_Streamer;
+        /// Optional, compressed textures are decoded on the loading thread alone when not set
+        HTextureDecoder             m_Decoder;
+    };
+
     struct SpriteContext
     {
         SpriteContext()
@@ -118,6 +170,11 @@ namespace dmGameSystem
             memset(this, 0, sizeof(*this));
         }
         dmRender::HRenderContext    m_RenderContext;
+        /// Optional, receives the texel density sprites are drawn with
+        HTextureStreamer            m_TextureStreamer;
+        /// Helper threads shared by all sprite worlds. Started when first needed and stopped with the last world
+        struct SpriteWorkers*       m_Workers;
+        uint32_t                    m_WorldCount;
         uint32_t                    m_MaxSpriteCount;
         uint32_t                    m_Subpixels : 1;
     };
@@ -129,6 +186,8 @@ namespace dmGameSystem
             memset(this, 0, sizeof(*this));
         }
         dmRender::HRenderContext    m_RenderContext;
+        /// Optional, told which textures are drawn
+        HTextureStreamer            m_TextureStreamer;
         dmResource::HFactory        m_Factory;
         uint32_t                    m_MaxSpineModelCount;
     };
@@ -140,6 +199,8 @@ namespace dmGameSystem
             memset(this, 0, sizeof(*this));
         }
         dmRender::HRenderContext    m_RenderContext;
+        /// Optional, told which textures are drawn
+        HTextureStreamer            m_TextureStreamer;
         dmResource::HFactory        m_Factory;
         uint32_t                    m_MaxModelCount;
     };
@@ -160,6 +221,8 @@ namespace dmGameSystem
             memset(this, 0, sizeof(*this));
         }
         dmRender::HRenderContext    m_RenderContext;
+        /// Optional, told which textures are drawn
+        HTextureStreamer            m_TextureStreamer;
         dmResource::HFactory        m_Factory;
         uint32_t                    m_MaxMeshCount;
     };
@@ -211,7 +274,8 @@ namespace dmGameSystem
         dmRender::HRenderContext render_context,
         GuiContext* gui_context,
         dmInput::HContext input_context,
-        PhysicsContext* physics_context);
+        PhysicsContext* physics_context,
+        TextureContext* texture_context);
 
     dmGameObject::Result RegisterComponentTypes(dmResource::HFactory factory,
                                                   dmGameObject::HRegister regist,
@@ -230,6 +294,53 @@ namespace dmGameSystem
                                                   TilemapContext* tilemap_context,
                                                   SoundContext* sound_context);
 
+    /**
+     * Create a texture streamer. Textures with mips are first loaded from their smaller mips and larger mips
+     * are then loaded in the background, as usage reported by the render components asks for them and the
+     * budget allows. Pass the streamer in the TextureContext and SpriteContext to enable it.
+     * @param factory Factory to reload texture data from
+     * @param graphics_context Graphics context
+     * @param params Parameters
+     * @return Texture streamer handle
+     */
+    HTextureStreamer NewTextureStreamer(dmResource::HFactory factory, dmGraphics::HContext graphics_context, const TextureStreamerParams& params);
+
+    /**
+     * Delete a texture streamer. Streamed textures keep their current mips.
+     * Must be deleted before the factory, and removed from the contexts.
+     * @param streamer Texture streamer handle
+     */
+    void DeleteTextureStreamer(HTextureStreamer streamer);
+
+    /**
+     * Create a pool of helper threads shared by all texture loads. The mips of large WebP compressed
+     * textures are decoded and transcoded on the helper threads together with the loading thread.
+     * Pass the decoder in the TextureContext and TextureStreamerParams to enable it.
+     * @param thread_count Number of helper threads. No threads are started on platforms without thread support
+     * @return Texture decoder handle
+     */
+    HTextureDecoder NewTextureDecoder(uint32_t thread_count);
+
+    /**
+     * Delete a texture decoder. Must not be used by any load in progress.
+     * @param decoder Texture decoder handle
+     */
+    void DeleteTextureDecoder(HTextureDecoder decoder);
+
+    /**
+     * Decide which mips the streamed textures should have uploaded from the usage reported since the last call,
+     * upload finished background loads and start new ones. Call once per frame.
+     * @param streamer Texture streamer handle
+     */
+    void UpdateTextureStreamer(HTextureStreamer streamer);
+
+    /**
+     * Get texture streamer statistics
+     * @param streamer Texture streamer handle
+     * @param stats Statistics [out]
+     */
+    void GetTextureStreamerStats(HTextureStreamer streamer, TextureStreamerStats* stats);
+
     void GuiGetURLCallback(dmGui::HScene scene, dmMessage::URL* url);
     uintptr_t GuiGetUserDataCallback(dmGui::HScene scene);
     dmhash_t GuiResolvePathCallback(dmGui::HScene scene, const char* path, uint32_t path_size);
@@ -109,6 +109,7 @@ namespace dmGameSystem
             {
                 dmLogWarning("Reloading the material failed, some shaders might not have been correctly linked.");
             }
+            dmRender::ClearMaterialAttributeLocations(material);
         }
     }
 
@@ -234,6 +235,7 @@ namespace dmGameSystem
             dmResource::Release(params.m_Factory, (void*)dmRender::GetMaterialFragmentProgram(material));
             dmResource::Release(params.m_Factory, (void*)dmRender::GetMaterialVertexProgram(material));
             dmRender::ClearMaterialTags(material);
+            dmRender::ClearMaterialAttributeLocations(material);
             SetMaterial(material, ddf, &resources);
         }
         dmDDF::FreeMessage(ddf);
@@ -119,14 +119,19 @@ namespace dmGameSystem
         }
     }
 
+    static const char* WORLD_TRANSFORM_ATTRIBUTES[] = {"mtx_world_0", "mtx_world_1", "mtx_world_2", "mtx_world_3"};
+    static const uint32_t WORLD_TRANSFORM_STREAM_COUNT = sizeof(WORLD_TRANSFORM_ATTRIBUTES) / sizeof(WORLD_TRANSFORM_ATTRIBUTES[0]);
+
     bool BuildVertexDeclaration(BufferResource* buffer_resource,
         dmGraphics::HVertexDeclaration* out_vert_decl,
-        uint32_t* out_elem_count, uint32_t* out_vert_size)
+        uint32_t* out_elem_count, uint32_t* out_vert_size,
+        bool world_transform)
     {
         assert(buffer_resource);
 
         const uint32_t stream_count = buffer_resource->m_BufferDDF->m_Streams.m_Count;
-        dmGraphics::VertexElement* vert_decls = (dmGraphics::VertexElement*)malloc(stream_count * sizeof(dmGraphics::VertexElement));
+        const uint32_t extra_stream_count = world_transform ? WORLD_TRANSFORM_STREAM_COUNT : 0;
+        dmGraphics::VertexElement* vert_decls = (dmGraphics::VertexElement*)malloc((stream_count + extra_stream_count) * sizeof(dmGraphics::VertexElement));
 
         uint32_t vert_size = 0;
         for (uint32_t i = 0; i < stream_count; ++i)
@@ -149,11 +154,23 @@ namespace dmGameSystem
             vert_size += StreamTypeToSize(ddf_stream.m_ValueType) * ddf_stream.m_ValueCount;
         }
 
+        // The world transform columns follow the buffer data of each vertex
+        for (uint32_t i = 0; i < extra_stream_count; ++i)
+        {
+            dmGraphics::VertexElement& vert_decl = vert_decls[stream_count + i];
+            vert_decl.m_Name = WORLD_TRANSFORM_ATTRIBUTES[i];
+            vert_decl.m_Stream = stream_count + i;
+            vert_decl.m_Size = 4;
+            vert_decl.m_Type = dmGraphics::TYPE_FLOAT;
+            vert_decl.m_Normalize = false;
+        }
+
         // Get correct "struct stride/size", since dmBuffer might align the structs etc.
-        uint32_t stride = dmBuffer::GetStructSize(buffer_resource->m_Buffer);
+        uint32_t struct_size = dmBuffer::GetStructSize(buffer_resource->m_Buffer);
+        uint32_t stride = struct_size + extra_stream_count * 4 * sizeof(float);
 
         // Init vertex declaration
-        *out_vert_decl = dmGraphics::NewVertexDeclaration(g_GraphicsContext, vert_decls, stream_count, stride);
+        *out_vert_decl = dmGraphics::NewVertexDeclaration(g_GraphicsContext, vert_decls, stream_count + extra_stream_count, stride);
         free(vert_decls);
 
         // Update vertex declaration with exact offsets (since streams in buffers can be aligned).
@@ -166,6 +183,12 @@ namespace dmGameSystem
             bool b2 = dmGraphics::SetStreamOffset(*out_vert_decl, i, offset);
             assert(b2);
         }
+        for (uint32_t i = 0; i < extra_stream_count; ++i)
+        {
+            bool r = dmGraphics::SetStreamOffset(*out_vert_decl, stream_count + i, struct_size + i * 4 * sizeof(float));
+            assert(r);
+            (void) r;
+        }
 
         // We need to keep track of the exact vertex size (ie the "struct" size according to dmBuffer)
         // since for world space vertices we need to allocate a correct data buffer size for it.
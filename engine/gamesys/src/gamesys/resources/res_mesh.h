@@ -57,9 +57,14 @@ namespace dmGameSystem
 
     dmResource::Result ResMeshRecreate(const dmResource::ResourceRecreateParams& params);
 
+    /**
+     * Build a vertex declaration for the streams of a buffer resource
+     * @param world_transform also declare the world transform columns mtx_world_0 to mtx_world_3 after the buffer data of each vertex
+     */
     bool BuildVertexDeclaration(BufferResource* buffer_resource,
         dmGraphics::HVertexDeclaration* out_vert_decl,
-        uint32_t* out_elem_count, uint32_t* out_vert_size);
+        uint32_t* out_elem_count, uint32_t* out_vert_size,
+        bool world_transform = false);
 }
 
 #endif // DM_GAMESYS_RES_MESH_H
@@ -11,8 +11,17 @@
 // specific language governing permissions and limitations under the License.
 
 #include "res_texture.h"
-
+#include "../gamesys.h"
+#include "../texture_decoder.h"
+#include "../texture_streamer.h"
+#include "../texture_transcoder.h"
+
+#include <stdlib.h>
+#include <dlib/array.h>
+#include <dlib/atomic.h>
 #include <dlib/log.h>
+#include <dlib/math.h>
+#include <dlib/profile.h>
 #include <dlib/webp.h>
 #include <dlib/time.h>
 #include <graphics/graphics.h>
@@ -20,10 +29,19 @@
 namespace dmGameSystem
 {
     static const uint32_t m_MaxMipCount = 32;
+    // Textures with a smaller first mip are decoded on the loading thread only, handing the work over costs more than it saves
+    static const uint32_t m_ParallelDecodeMinSize = 64 * 1024;
+    // Rows of 4x4 blocks transcoded per task
+    static const uint32_t m_TranscodeBandBlockRows = 16;
     struct ImageDesc
     {
         dmGraphics::TextureImage* m_DDFImage;
+        // The alternative that is decoded, 0 if no format is supported
+        dmGraphics::TextureImage::Image* m_Image;
         uint8_t* m_DecompressedData[m_MaxMipCount];
+        uint32_t m_DecompressedDataSize[m_MaxMipCount];
+        // Mips before this one are neither decoded nor uploaded, see texture_streamer.h
+        uint32_t m_FirstMip;
         bool m_UseBlankTexture;
     };
 
@@ -37,6 +55,7 @@ namespace dmGameSystem
             case dmGraphics::TextureImage::TEXTURE_FORMAT_RGBA_PVRTC_4BPPV1:
                 return dmWebP::TEXTURE_ENCODE_FORMAT_PVRTC1;
             case dmGraphics::TextureImage::TEXTURE_FORMAT_RGB_ETC1:
+            case dmGraphics::TextureImage::TEXTURE_FORMAT_RGB_UNIVERSAL:
                 return dmWebP::TEXTURE_ENCODE_FORMAT_ETC1;
             case dmGraphics::TextureImage::TEXTURE_FORMAT_LUMINANCE:
                 return dmWebP::TEXTURE_ENCODE_FORMAT_L8;
@@ -52,7 +71,7 @@ namespace dmGameSystem
         }
     }
 
-    static dmGraphics::TextureFormat TextureImageToTextureFormat(dmGraphics::TextureImage::Image* image)
+    static dmGraphics::TextureFormat TextureImageToTextureFormat(dmGraphics::HContext context, dmGraphics::TextureImage::Image* image)
     {
         switch (image->m_Format)
         {
@@ -78,6 +97,8 @@ namespace dmGameSystem
                 return dmGraphics::TEXTURE_FORMAT_RGBA_16BPP;
             case dmGraphics::TextureImage::TEXTURE_FORMAT_LUMINANCE_ALPHA:
                 return dmGraphics::TEXTURE_FORMAT_LUMINANCE_ALPHA;
+            case dmGraphics::TextureImage::TEXTURE_FORMAT_RGB_UNIVERSAL:
+                return GetUniversalTranscodeFormat(context);
 
             /*
             JIRA issue: DEF-994
@@ -147,6 +168,7 @@ namespace dmGameSystem
             case dmGraphics::TextureImage::TEXTURE_FORMAT_RGBA_PVRTC_2BPPV1:
             case dmGraphics::TextureImage::TEXTURE_FORMAT_RGBA_PVRTC_4BPPV1:
             case dmGraphics::TextureImage::TEXTURE_FORMAT_RGB_ETC1:
+            case dmGraphics::TextureImage::TEXTURE_FORMAT_RGB_UNIVERSAL:
             case dmGraphics::TextureImage::TEXTURE_FORMAT_LUMINANCE:
             case dmGraphics::TextureImage::TEXTURE_FORMAT_RGB_16BPP:
             case dmGraphics::TextureImage::TEXTURE_FORMAT_RGBA_16BPP:
@@ -219,13 +241,81 @@ namespace dmGameSystem
         return true;
     }
 
-    dmResource::Result AcquireResources(dmResource::SResourceDescriptor* resource_desc, dmGraphics::HContext context, ImageDesc* image_desc, dmGraphics::HTexture texture, dmGraphics::HTexture* texture_out)
+    struct WebPDecodeJob
+    {
+        dmGraphics::TextureImage::Image* m_Image;
+        ImageDesc*                       m_ImageDesc;
+        int32_atomic_t                   m_Failed;
+    };
+
+    static void WebPDecodeMip(void* context, uint32_t task)
+    {
+        WebPDecodeJob* job = (WebPDecodeJob*) context;
+        if (job->m_Failed)
+            return;
+
+        dmGraphics::TextureImage::Image* image = job->m_Image;
+        uint32_t mip = job->m_ImageDesc->m_FirstMip + task;
+        uint32_t w = dmMath::Max(image->m_Width >> mip, 1U);
+        uint32_t h = dmMath::Max(image->m_Height >> mip, 1U);
+        uint8_t* decompressed_data;
+        uint32_t decompressed_data_size;
+        if (WebPDecodeTexture(mip, w, h, image, decompressed_data, decompressed_data_size))
+        {
+            job->m_ImageDesc->m_DecompressedData[mip] = decompressed_data;
+            job->m_ImageDesc->m_DecompressedDataSize[mip] = decompressed_data_size;
+        }
+        else
+        {
+            dmAtomicStore32(&job->m_Failed, 1);
+        }
+    }
+
+    // Decode all mips, those of the larger textures one per task on the decoder threads together with the calling thread.
+    // A WebP bitstream is decoded from start to end, so a single mip can't be split up
+    static bool WebPDecodeImage(HTextureDecoder decoder, dmGraphics::TextureImage::Image* image, ImageDesc* image_desc)
+    {
+        DM_PROFILE(Texture, "WebPDecode");
+        uint64_t start = dmTime::GetTime();
+
+        WebPDecodeJob job;
+        job.m_Image = image;
+        job.m_ImageDesc = image_desc;
+        job.m_Failed = 0;
+
+        uint32_t first_mip = image_desc->m_FirstMip;
+        uint32_t mip_count = image->m_MipMapOffset.m_Count - first_mip;
+        bool parallel = mip_count > 1 && image->m_MipMapSize[first_mip] >= m_ParallelDecodeMinSize;
+        // Mips are taken in order, the largest first
+        RunTextureDecodeTasks(parallel ? decoder : 0, WebPDecodeMip, &job, mip_count);
+
+        uint32_t elapsed = (uint32_t) (dmTime::GetTime() - start);
+        DM_COUNTER("Texture.WebPDecodes", 1);
+        DM_COUNTER("Texture.WebPDecodeTimeUs", elapsed);
+        dmLogDebug("Decoded %ux%u WebP texture with %u mips in %.2f ms%s", dmMath::Max(image->m_Width >> first_mip, 1U), dmMath::Max(image->m_Height >> first_mip, 1U), mip_count, elapsed / 1000.0f, parallel && decoder ? " (parallel)" : "");
+        return job.m_Failed == 0;
+    }
+
+    static dmGraphics::TextureImage::Image* GetSupportedImage(dmGraphics::HContext context, dmGraphics::TextureImage* texture_image)
+    {
+        for (uint32_t i = 0; i < texture_image->m_Alternatives.m_Count; ++i)
+        {
+            dmGraphics::TextureImage::Image* image = &texture_image->m_Alternatives[i];
+            if (dmGraphics::IsTextureFormatSupported(context, TextureImageToTextureFormat(context, image)))
+            {
+                return image;
+            }
+        }
+        return 0;
+    }
+
+    dmResource::Result AcquireResources(dmResource::SResourceDescriptor* resource_desc, dmGraphics::HContext context, ImageDesc* image_desc, bool async, dmGraphics::HTexture texture, dmGraphics::HTexture* texture_out)
     {
         dmResource::Result result = dmResource::RESULT_FORMAT_ERROR;
         for (uint32_t i = 0; i < image_desc->m_DDFImage->m_Alternatives.m_Count; ++i)
         {
             dmGraphics::TextureImage::Image* image = &image_desc->m_DDFImage->m_Alternatives[i];
-            dmGraphics::TextureFormat format = TextureImageToTextureFormat(image);
+            dmGraphics::TextureFormat format = TextureImageToTextureFormat(context, image);
 
             if (!dmGraphics::IsTextureFormatSupported(context, format))
             {
@@ -233,14 +323,16 @@ namespace dmGameSystem
             }
             result = dmResource::RESULT_OK;
 
+            assert(image->m_MipMapOffset.m_Count <= m_MaxMipCount);
+            uint32_t first_mip = dmMath::Min(image_desc->m_FirstMip, dmMath::Max(image->m_MipMapOffset.m_Count, 1U) - 1);
+            uint32_t mip_count = image->m_MipMapOffset.m_Count - first_mip;
+
             dmGraphics::TextureCreationParams creation_params;
             dmGraphics::TextureParams params;
             dmGraphics::GetDefaultTextureFilters(context, params.m_MinFilter, params.m_MagFilter);
             params.m_Format = format;
-            params.m_Width = image->m_Width;
-            params.m_Height = image->m_Height;
-
-            assert(image->m_MipMapOffset.m_Count <= m_MaxMipCount);
+            params.m_Width = dmMath::Max(image->m_Width >> first_mip, 1U);
+            params.m_Height = dmMath::Max(image->m_Height >> first_mip, 1U);
 
             if (image_desc->m_DDFImage->m_Type == dmGraphics::TextureImage::TYPE_2D) {
                 creation_params.m_Type = dmGraphics::TEXTURE_TYPE_2D;
@@ -249,17 +341,17 @@ namespace dmGameSystem
             } else {
                 assert(0);
             }
-            creation_params.m_Width = image->m_Width;
-            creation_params.m_Height = image->m_Height;
+            creation_params.m_Width = params.m_Width;
+            creation_params.m_Height = params.m_Height;
             creation_params.m_OriginalWidth = image->m_OriginalWidth;
             creation_params.m_OriginalHeight = image->m_OriginalHeight;
-            creation_params.m_MipMapCount = image->m_MipMapOffset.m_Count;
+            creation_params.m_MipMapCount = mip_count;
 
             if (!texture)
                 texture = dmGraphics::NewTexture(context, creation_params);
 
             // Need to revert to simple bilinear filtering if no mipmaps were supplied
-            if (image->m_MipMapOffset.m_Count <= 1) {
+            if (mip_count <= 1) {
                 if (params.m_MinFilter == dmGraphics::TEXTURE_FILTER_LINEAR_MIPMAP_NEAREST) {
                     params.m_MinFilter = dmGraphics::TEXTURE_FILTER_LINEAR;
                 } else if (params.m_MinFilter == dmGraphics::TEXTURE_FILTER_NEAREST_MIPMAP_NEAREST) {
@@ -281,12 +373,15 @@ namespace dmGameSystem
                 break;
             }
 
-            for (int i = 0; i < (int) image->m_MipMapOffset.m_Count; ++i)
+            for (int i = (int) first_mip; i < (int) image->m_MipMapOffset.m_Count; ++i)
             {
-                params.m_MipMap = i;
+                params.m_MipMap = i - first_mip;
                 params.m_Data = image_desc->m_DecompressedData[i] == 0 ? &image->m_Data[image->m_MipMapOffset[i]] : image_desc->m_DecompressedData[i];
-                params.m_DataSize = image->m_MipMapSize[i];
-                dmGraphics::SetTextureAsync(texture, params);
+                params.m_DataSize = image_desc->m_DecompressedData[i] == 0 ? image->m_MipMapSize[i] : image_desc->m_DecompressedDataSize[i];
+                if (async)
+                    dmGraphics::SetTextureAsync(texture, params);
+                else
+                    dmGraphics::SetTexture(texture, params);
 
                 params.m_Width >>= 1;
                 params.m_Height >>= 1;
@@ -308,42 +403,122 @@ namespace dmGameSystem
         return result;
     }
 
-    ImageDesc* CreateImage(dmGraphics::HContext context, dmGraphics::TextureImage* texture_image)
+    struct TranscodeBand
+    {
+        uint32_t m_Mip;
+        uint32_t m_FirstBlockRow;
+        uint32_t m_BlockRowCount;
+    };
+
+    struct TranscodeJob
+    {
+        dmGraphics::TextureImage::Image* m_Image;
+        dmGraphics::TextureFormat        m_Format;
+        // Per mip, indexed like the image mips
+        const uint8_t*                   m_Blocks[m_MaxMipCount];
+        uint8_t*                         m_Transcoded[m_MaxMipCount];
+        dmArray<TranscodeBand>           m_Bands;
+    };
+
+    static void TranscodeBlockRows(void* context, uint32_t task)
+    {
+        TranscodeJob* job = (TranscodeJob*) context;
+        const TranscodeBand& band = job->m_Bands[task];
+        uint32_t width = dmMath::Max(job->m_Image->m_Width >> band.m_Mip, 1U);
+        uint32_t height = dmMath::Max(job->m_Image->m_Height >> band.m_Mip, 1U);
+        uint32_t first_row = band.m_FirstBlockRow * 4;
+        uint32_t band_height = dmMath::Min(band.m_BlockRowCount * 4, height - first_row);
+        // The blocks are stored row by row and the bands start on whole block rows, in both formats
+        const uint8_t* blocks = job->m_Blocks[band.m_Mip] + GetTranscodedSize(dmGraphics::TEXTURE_FORMAT_RGB_ETC1, width, first_row);
+        uint8_t* out = job->m_Transcoded[band.m_Mip] + GetTranscodedSize(job->m_Format, width, first_row);
+        TranscodeETC1(blocks, width, band_height, job->m_Format, out);
+    }
+
+    // Transcode the ETC1 blocks of a universal image, either as stored or as decoded from WebP.
+    // The mips are split into bands of block rows, which are transcoded on the decoder threads for the larger textures
+    static bool TranscodeUniversalImage(dmGraphics::HContext context, HTextureDecoder decoder, dmGraphics::TextureImage::Image* image, ImageDesc* image_desc)
+    {
+        dmGraphics::TextureFormat format = GetUniversalTranscodeFormat(context);
+        if (format == dmGraphics::TEXTURE_FORMAT_RGB_ETC1)
+        {
+            return true;
+        }
+
+        DM_PROFILE(Texture, "Transcode");
+        TranscodeJob job;
+        job.m_Image = image;
+        job.m_Format = format;
+        memset(job.m_Transcoded, 0, sizeof(job.m_Transcoded));
+
+        uint32_t transcoded_size = 0;
+        for (uint32_t i = image_desc->m_FirstMip; i < image->m_MipMapOffset.m_Count; ++i)
+        {
+            uint32_t width = dmMath::Max(image->m_Width >> i, 1U);
+            uint32_t height = dmMath::Max(image->m_Height >> i, 1U);
+            uint8_t* blocks = image_desc->m_DecompressedData[i] == 0 ? &image->m_Data[image->m_MipMapOffset[i]] : image_desc->m_DecompressedData[i];
+            uint32_t blocks_size = image_desc->m_DecompressedData[i] == 0 ? image->m_MipMapSize[i] : image_desc->m_DecompressedDataSize[i];
+            if (blocks_size < GetTranscodedSize(dmGraphics::TEXTURE_FORMAT_RGB_ETC1, width, height))
+            {
+                dmLogError("Universal texture mip %u is too small (%u bytes). Using blank texture.", i, blocks_size);
+                for (uint32_t j = image_desc->m_FirstMip; j < i; ++j)
+                {
+                    delete[] job.m_Transcoded[j];
+                }
+                return false;
+            }
+
+            uint32_t size = GetTranscodedSize(format, width, height);
+            job.m_Blocks[i] = blocks;
+            job.m_Transcoded[i] = new uint8_t[size];
+            transcoded_size += size;
+
+            uint32_t block_rows = (height + 3) / 4;
+            for (uint32_t row = 0; row < block_rows; row += m_TranscodeBandBlockRows)
+            {
+                TranscodeBand band;
+                band.m_Mip = i;
+                band.m_FirstBlockRow = row;
+                band.m_BlockRowCount = dmMath::Min(m_TranscodeBandBlockRows, block_rows - row);
+                if (job.m_Bands.Full())
+                {
+                    job.m_Bands.OffsetCapacity(dmMath::Max(16U, job.m_Bands.Capacity()));
+                }
+                job.m_Bands.Push(band);
+            }
+        }
+
+        RunTextureDecodeTasks(transcoded_size >= m_ParallelDecodeMinSize ? decoder : 0, TranscodeBlockRows, &job, job.m_Bands.Size());
+
+        for (uint32_t i = image_desc->m_FirstMip; i < image->m_MipMapOffset.m_Count; ++i)
+        {
+            uint32_t width = dmMath::Max(image->m_Width >> i, 1U);
+            uint32_t height = dmMath::Max(image->m_Height >> i, 1U);
+            delete[] image_desc->m_DecompressedData[i];
+            image_desc->m_DecompressedData[i] = job.m_Transcoded[i];
+            image_desc->m_DecompressedDataSize[i] = GetTranscodedSize(format, width, height);
+        }
+        DM_COUNTER("Texture.Transcodes", 1);
+        return true;
+    }
+
+    ImageDesc* CreateImage(dmGraphics::HContext context, HTextureDecoder decoder, dmGraphics::TextureImage* texture_image, uint32_t first_mip)
     {
         ImageDesc* image_desc = new ImageDesc;
         memset(image_desc, 0x0, sizeof(ImageDesc));
         image_desc->m_DDFImage = texture_image;
-        for(uint32_t i = 0; i < texture_image->m_Alternatives.m_Count; ++i)
+        dmGraphics::TextureImage::Image* image = GetSupportedImage(context, texture_image);
+        image_desc->m_Image = image;
+        if (image)
         {
-            dmGraphics::TextureImage::Image* image = &texture_image->m_Alternatives[i];
-            if (!dmGraphics::IsTextureFormatSupported(context, TextureImageToTextureFormat(image)))
-            {
-                continue;
-            }
+            image_desc->m_FirstMip = dmMath::Min(first_mip, dmMath::Max(image->m_MipMapOffset.m_Count, 1U) - 1);
             switch(image->m_CompressionType)
             {
                 case dmGraphics::TextureImage::COMPRESSION_TYPE_WEBP:
                 case dmGraphics::TextureImage::COMPRESSION_TYPE_WEBP_LOSSY:
                 {
-                    uint32_t w = image->m_Width;
-                    uint32_t h = image->m_Height;
-                    for (int i = 0; i < (int) image->m_MipMapOffset.m_Count; ++i)
+                    if (!WebPDecodeImage(decoder, image, image_desc))
                     {
-                        uint8_t* decompressed_data;
-                        uint32_t decompressed_data_size;
-                        if(WebPDecodeTexture(i, w, h, image, decompressed_data, decompressed_data_size))
-                        {
-                            image_desc->m_DecompressedData[i] = decompressed_data;
-                        }
-                        else
-                        {
-                            image_desc->m_UseBlankTexture = true;
-                            break;
-                        }
-                        w >>= 1;
-                        h >>= 1;
-                        if (w == 0) w = 1;
-                        if (h == 0) h = 1;
+                        image_desc->m_UseBlankTexture = true;
                     }
                 }
                 break;
@@ -351,7 +526,14 @@ namespace dmGameSystem
                 default:
                 break;
             }
-            break;
+
+            if (image->m_Format == dmGraphics::TextureImage::TEXTURE_FORMAT_RGB_UNIVERSAL && !image_desc->m_UseBlankTexture)
+            {
+                if (!TranscodeUniversalImage(context, decoder, image, image_desc))
+                {
+                    image_desc->m_UseBlankTexture = true;
+                }
+            }
         }
         return image_desc;
     }
@@ -375,7 +557,17 @@ namespace dmGameSystem
             return dmResource::RESULT_FORMAT_ERROR;
         }
 
-        ImageDesc* image_desc = CreateImage((dmGraphics::HContext) params.m_Context, texture_image);
+        TextureContext* texture_context = (TextureContext*) params.m_Context;
+        uint32_t first_mip = 0;
+        dmGraphics::TextureImage::Image* image = GetSupportedImage(texture_context->m_GraphicsContext, texture_image);
+        if (texture_context->m_Streamer && image && texture_image->m_Type == dmGraphics::TextureImage::TYPE_2D
+            && image->m_Width <= dmGraphics::GetMaxTextureSize(texture_context->m_GraphicsContext)
+            && image->m_Height <= dmGraphics::GetMaxTextureSize(texture_context->m_GraphicsContext))
+        {
+            first_mip = GetInitialStreamingMip(texture_context->m_Streamer, image->m_Width, image->m_Height, image->m_MipMapOffset.m_Count);
+        }
+
+        ImageDesc* image_desc = CreateImage(texture_context->m_GraphicsContext, texture_context->m_Decoder, texture_image, first_mip);
         *params.m_PreloadData = image_desc;
         return dmResource::RESULT_OK;
     }
@@ -398,19 +590,44 @@ namespace dmGameSystem
 
     dmResource::Result ResTextureCreate(const dmResource::ResourceCreateParams& params)
     {
-        dmGraphics::HContext graphics_context = (dmGraphics::HContext) params.m_Context;
+        TextureContext* texture_context = (TextureContext*) params.m_Context;
+        ImageDesc* image_desc = (ImageDesc*) params.m_PreloadData;
         dmGraphics::HTexture texture;
-        dmResource::Result r = AcquireResources(params.m_Resource, graphics_context, (ImageDesc*) params.m_PreloadData, 0, &texture);
+        dmResource::Result r = AcquireResources(params.m_Resource, texture_context->m_GraphicsContext, image_desc, true, 0, &texture);
         if (r == dmResource::RESULT_OK)
         {
             params.m_Resource->m_Resource = (void*) texture;
+            if (image_desc->m_FirstMip > 0 && !image_desc->m_UseBlankTexture)
+            {
+                dmGraphics::TextureImage::Image* image = image_desc->m_Image;
+                const uint32_t* mip_sizes = image->m_MipMapSize.m_Data;
+                // Universal mips are resident in the format they are transcoded to, which may be several times the ETC1 size
+                uint32_t transcoded_sizes[m_MaxMipCount];
+                if (image->m_Format == dmGraphics::TextureImage::TEXTURE_FORMAT_RGB_UNIVERSAL)
+                {
+                    dmGraphics::TextureFormat format = GetUniversalTranscodeFormat(texture_context->m_GraphicsContext);
+                    for (uint32_t i = 0; i < image->m_MipMapSize.m_Count; ++i)
+                    {
+                        transcoded_sizes[i] = GetTranscodedSize(format, dmMath::Max(image->m_Width >> i, 1U), dmMath::Max(image->m_Height >> i, 1U));
+                    }
+                    mip_sizes = transcoded_sizes;
+                }
+                RegisterStreamingTexture(texture_context->m_Streamer, texture, params.m_Filename, image->m_Width, image->m_Height,
+                                         mip_sizes, image->m_MipMapSize.m_Count, image_desc->m_FirstMip);
+            }
         }
         return r;
     }
 
     dmResource::Result ResTextureDestroy(const dmResource::ResourceDestroyParams& params)
     {
-        dmGraphics::DeleteTexture((dmGraphics::HTexture) params.m_Resource->m_Resource);
+        TextureContext* texture_context = (TextureContext*) params.m_Context;
+        dmGraphics::HTexture texture = (dmGraphics::HTexture) params.m_Resource->m_Resource;
+        if (texture_context->m_Streamer)
+        {
+            UnregisterStreamingTexture(texture_context->m_Streamer, texture);
+        }
+        dmGraphics::DeleteTexture(texture);
         return dmResource::RESULT_OK;
     }
 
@@ -425,16 +642,23 @@ namespace dmGameSystem
                 return dmResource::RESULT_FORMAT_ERROR;
             }
         }
-        dmGraphics::HContext graphics_context = (dmGraphics::HContext) params.m_Context;
+        TextureContext* texture_context = (TextureContext*) params.m_Context;
+        dmGraphics::HContext graphics_context = texture_context->m_GraphicsContext;
         dmGraphics::HTexture texture = (dmGraphics::HTexture) params.m_Resource->m_Resource;
 
+        // The new image is uploaded in full, and is not streamed any longer
+        if (texture_context->m_Streamer)
+        {
+            UnregisterStreamingTexture(texture_context->m_Streamer, texture);
+        }
+
         // Create the image from the DDF data.
         // Note that the image desc for performance reasons keeps references to the DDF image, meaning they're invalid after the DDF message has been free'd!
-        ImageDesc* image_desc = CreateImage((dmGraphics::HContext) params.m_Context, texture_image);
+        ImageDesc* image_desc = CreateImage(graphics_context, texture_context->m_Decoder, texture_image, 0);
 
         // Set up the new texture (version), wait for it to finish before issuing new requests
         SynchronizeTexture(texture, true);
-        dmResource::Result r = AcquireResources(params.m_Resource, graphics_context, image_desc, texture, &texture);
+        dmResource::Result r = AcquireResources(params.m_Resource, graphics_context, image_desc, true, texture, &texture);
 
         // Wait for any async texture uploads
         SynchronizeTexture(texture, true);
@@ -451,4 +675,61 @@ namespace dmGameSystem
         }
         return r;
     }
+
+    ImageDesc* LoadTextureMips(dmResource::HFactory factory, dmGraphics::HContext context, HTextureDecoder decoder, const char* path, uint32_t first_mip)
+    {
+        void* buffer;
+        uint32_t buffer_size;
+        dmResource::Result r = dmResource::GetRaw(factory, path, &buffer, &buffer_size);
+        if (r != dmResource::RESULT_OK)
+        {
+            dmLogError("Unable to load texture '%s' (%d)", path, r);
+            return 0;
+        }
+
+        dmGraphics::TextureImage* texture_image;
+        dmDDF::Result e = dmDDF::LoadMessage<dmGraphics::TextureImage>(buffer, buffer_size, (&texture_image));
+        free(buffer);
+        if (e != dmDDF::RESULT_OK)
+        {
+            dmLogError("Unable to parse texture '%s' (%d)", path, e);
+            return 0;
+        }
+
+        ImageDesc* image_desc = CreateImage(context, decoder, texture_image, first_mip);
+        if (image_desc->m_UseBlankTexture)
+        {
+            FreeTextureMips(image_desc);
+            return 0;
+        }
+        return image_desc;
+    }
+
+    bool UploadTextureMips(dmGraphics::HContext context, ImageDesc* image_desc, dmGraphics::HTexture texture)
+    {
+        return AcquireResources(0, context, image_desc, false, texture, &texture) == dmResource::RESULT_OK;
+    }
+
+    const uint8_t* GetTextureMipData(ImageDesc* image_desc, uint32_t mip, uint32_t* size)
+    {
+        dmGraphics::TextureImage::Image* image = image_desc->m_Image;
+        if (image == 0 || mip < image_desc->m_FirstMip || mip >= image->m_MipMapOffset.m_Count)
+        {
+            *size = 0;
+            return 0;
+        }
+        if (image_desc->m_DecompressedData[mip] == 0)
+        {
+            *size = image->m_MipMapSize[mip];
+            return &image->m_Data[image->m_MipMapOffset[mip]];
+        }
+        *size = image_desc->m_DecompressedDataSize[mip];
+        return image_desc->m_DecompressedData[mip];
+    }
+
+    void FreeTextureMips(ImageDesc* image_desc)
+    {
+        dmDDF::FreeMessage(image_desc->m_DDFImage);
+        DestroyImage(image_desc);
+    }
 }
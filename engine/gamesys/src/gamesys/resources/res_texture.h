@@ -16,6 +16,9 @@
 #include <stdint.h>
 
 #include <resource/resource.h>
+#include <graphics/graphics.h>
+
+#include "../gamesys.h"
 
 namespace dmGameSystem
 {
@@ -28,6 +31,43 @@ namespace dmGameSystem
     dmResource::Result ResTextureDestroy(const dmResource::ResourceDestroyParams& params);
 
     dmResource::Result ResTextureRecreate(const dmResource::ResourceRecreateParams& params);
+
+    struct ImageDesc;
+
+    /**
+     * Load and decode the mips of a texture file, starting at first_mip. Safe to call from any thread.
+     * @param factory Factory handle
+     * @param context Graphics context, used to pick the image format
+     * @param decoder Texture decoder to decode large textures with, 0 to decode on the calling thread
+     * @param path Texture resource path
+     * @param first_mip First mip to load
+     * @return The loaded mips, or 0 on failure
+     */
+    ImageDesc* LoadTextureMips(dmResource::HFactory factory, dmGraphics::HContext context, HTextureDecoder decoder, const char* path, uint32_t first_mip);
+
+    /**
+     * Get the data of a mip loaded with LoadTextureMips, as it is uploaded
+     * @param image_desc Loaded mips
+     * @param mip Mip index in the file
+     * @param size Size in bytes [out]
+     * @return The mip data, or 0 if the mip isn't loaded
+     */
+    const uint8_t* GetTextureMipData(ImageDesc* image_desc, uint32_t mip, uint32_t* size);
+
+    /**
+     * Replace the mip chain of a texture with mips loaded with LoadTextureMips
+     * @param context Graphics context
+     * @param image_desc Loaded mips
+     * @param texture Texture to upload to
+     * @return true on success
+     */
+    bool UploadTextureMips(dmGraphics::HContext context, ImageDesc* image_desc, dmGraphics::HTexture texture);
+
+    /**
+     * Free mips loaded with LoadTextureMips
+     * @param image_desc Loaded mips
+     */
+    void FreeTextureMips(ImageDesc* image_desc);
 }
 
 #endif
@@ -14,6 +14,7 @@
 #include <stdio.h>
 #include <assert.h>
 
+#include <dlib/array.h>
 #include <dlib/hash.h>
 #include <dlib/log.h>
 #include <dlib/math.h>
@@ -370,9 +371,189 @@ namespace dmGameSystem
         return 1;
     }
 
+    /*# make a factory create several new game objects
+     *
+     * Creates one game object for each position in the supplied table. Each component of the prototype
+     * is created for all the new game objects before the next one, and none of the game objects is
+     * initialized until all components are created.
+     *
+     * The rotation, properties and scale are shared by all the new game objects.
+     *
+     * @name factory.create_many
+     * @param url [type:string|hash|url] the factory that should create the game objects.
+     * @param positions [type:table] array of [type:vector3] positions, one for each new game object.
+     * @param [rotation] [type:quaternion] the rotation of the new game objects, the rotation of the game object calling `factory.create_many()` is used by default, or if the value is `nil`.
+     * @param [properties] [type:table] the properties defined in a script attached to the new game objects.
+     * @param [scale] [type:number|vector3] the scale of the new game objects (must be greater than 0), the scale of the game object containing the factory is used by default, or if the value is `nil`
+     * @return ids [type:table] array with the global id of each spawned game object, `nil` entries for the game objects that could not be created
+     * @examples
+     *
+     * How to create a row of game objects:
+     *
+     * ```lua
+     * function init(self)
+     *     local positions = {}
+     *     for i = 1, 100 do
+     *         positions[i] = vmath.vector3(i * 10, 0, 0)
+     *     end
+     *     self.bullets = factory.create_many("#factory", positions)
+     * end
+     * ```
+     */
+    int FactoryComp_CreateMany(lua_State* L)
+    {
+        int top = lua_gettop(L);
+
+        dmGameObject::HInstance sender_instance = CheckGoInstance(L);
+        dmGameObject::HCollection collection = dmGameObject::GetCollection(sender_instance);
+
+        uintptr_t user_data;
+        dmMessage::URL receiver;
+        dmGameObject::GetComponentUserDataFromLua(L, 1, collection, FACTORY_EXT, &user_data, &receiver, 0);
+        FactoryComponent* component = (FactoryComponent*) user_data;
+
+        luaL_checktype(L, 2, LUA_TTABLE);
+        uint32_t count = (uint32_t)lua_objlen(L, 2);
+
+        Vectormath::Aos::Quat rotation;
+        if (top >= 3 && !lua_isnil(L, 3))
+        {
+            rotation = *dmScript::CheckQuat(L, 3);
+        }
+        else
+        {
+            rotation = dmGameObject::GetWorldRotation(sender_instance);
+        }
+        const uint32_t buffer_size = 512;
+        uint8_t DM_ALIGNED(16) buffer[buffer_size];
+        uint32_t actual_prop_buffer_size = 0;
+        uint8_t* prop_buffer = buffer;
+        uint32_t prop_buffer_size = buffer_size;
+        bool msg_passing = dmGameObject::GetInstanceFromLua(L) == 0x0;
+        if (msg_passing) {
+            const uint32_t msg_size = sizeof(dmGameSystemDDF::Create);
+            prop_buffer = &(buffer[msg_size]);
+            prop_buffer_size -= msg_size;
+        }
+        if (top >= 4 && !lua_isnil(L, 4))
+        {
+            actual_prop_buffer_size = dmScript::CheckTable(L, (char*)prop_buffer, prop_buffer_size, 4);
+            if (actual_prop_buffer_size > prop_buffer_size)
+                return luaL_error(L, "the properties supplied to factory.create_many are too many.");
+        }
+
+        Vector3 scale;
+        if (top >= 5 && !lua_isnil(L, 5))
+        {
+            // We check for zero in the ToTransform/ResetScale in transform.h
+            Vector3* v = dmScript::ToVector3(L, 5);
+            if (v != 0)
+            {
+                scale = *v;
+            }
+            else
+            {
+                float val = luaL_checknumber(L, 5);
+                scale = Vector3(val, val, val);
+            }
+        }
+        else
+        {
+            scale = dmGameObject::GetWorldScale(sender_instance);
+        }
+
+        // Everything that can raise a Lua error is checked before the arrays below are allocated, since they would leak
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            lua_rawgeti(L, 2, i + 1);
+            dmScript::CheckVector3(L, -1);
+            lua_pop(L, 1);
+        }
+
+        dmMessage::URL sender;
+        if (msg_passing && !dmScript::GetURL(L, &sender)) {
+            return luaL_error(L, "factory.create_many can not be called from this script type");
+        }
+
+        dmArray<Vectormath::Aos::Point3> positions;
+        positions.SetCapacity(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            lua_rawgeti(L, 2, i + 1);
+            positions.Push(Vectormath::Aos::Point3(*dmScript::ToVector3(L, -1)));
+            lua_pop(L, 1);
+        }
+
+        dmArray<uint32_t> indices;
+        dmArray<dmhash_t> ids;
+        indices.SetCapacity(count);
+        ids.SetCapacity(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t index = dmGameObject::AcquireInstanceIndex(collection);
+            if (index == dmGameObject::INVALID_INSTANCE_POOL_INDEX)
+            {
+                dmLogError("factory.create_many can only create %d of %d gameobjects since the buffer is full.", i, count);
+                break;
+            }
+            indices.Push(index);
+            ids.Push(dmGameObject::ConstructInstanceId(index));
+        }
+        uint32_t spawn_count = indices.Size();
+
+        lua_createtable(L, count, 0);
+
+        if (msg_passing) {
+            dmGameSystemDDF::Create* create_msg = (dmGameSystemDDF::Create*)buffer;
+            create_msg->m_Rotation = rotation;
+            create_msg->m_Scale3 = scale;
+            for (uint32_t i = 0; i < spawn_count; ++i)
+            {
+                create_msg->m_Id = ids[i];
+                create_msg->m_Index = indices[i];
+                create_msg->m_Position = positions[i];
+                dmMessage::Post(&sender, &receiver, dmGameSystemDDF::Create::m_DDFDescriptor->m_NameHash, (uintptr_t)sender_instance, (uintptr_t)dmGameSystemDDF::Create::m_DDFDescriptor, buffer, sizeof(dmGameSystemDDF::Create) + actual_prop_buffer_size, 0);
+                dmScript::PushHash(L, ids[i]);
+                lua_rawseti(L, -2, i + 1);
+            }
+        } else if (spawn_count > 0) {
+            dmArray<dmGameObject::HInstance> instances;
+            instances.SetCapacity(spawn_count);
+            instances.SetSize(spawn_count);
+
+            dmScript::GetInstance(L);
+            int ref = dmScript::Ref(L, LUA_REGISTRYINDEX);
+            dmGameObject::HPrototype prototype = CompFactoryGetPrototype(collection, component);
+            dmGameObject::SpawnMany(collection, prototype, component->m_Resource->m_FactoryDesc->m_Prototype,
+                spawn_count, ids.Begin(), buffer, actual_prop_buffer_size, positions.Begin(), rotation, scale, instances.Begin());
+
+            lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+            dmScript::SetInstance(L);
+            dmScript::Unref(L, LUA_REGISTRYINDEX, ref);
+
+            for (uint32_t i = 0; i < spawn_count; ++i)
+            {
+                if (instances[i] != 0x0)
+                {
+                    dmGameObject::AssignInstanceIndex(indices[i], instances[i]);
+                    dmScript::PushHash(L, ids[i]);
+                    lua_rawseti(L, -2, i + 1);
+                }
+                else
+                {
+                    dmGameObject::ReleaseInstanceIndex(indices[i], collection);
+                }
+            }
+        }
+
+        assert(top + 1 == lua_gettop(L));
+        return 1;
+    }
+
     static const luaL_reg FACTORY_COMP_FUNCTIONS[] =
     {
         {"create",            FactoryComp_Create},
+        {"create_many",       FactoryComp_CreateMany},
         {"load",              FactoryComp_Load},
         {"unload",            FactoryComp_Unload},
         {"get_status",        FactoryComp_GetStatus},
@@ -0,0 +1,8 @@
+components {
+  id: "script"
+  component: "/factory/create_many_test.script"
+}
+components {
+  id: "factory"
+  component: "/factory/factory_test.factory"
+}
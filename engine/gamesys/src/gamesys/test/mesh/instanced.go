@@ -0,0 +1,4 @@
+components {
+  id: "mesh"
+  component: "/mesh/instanced.meshc"
+}
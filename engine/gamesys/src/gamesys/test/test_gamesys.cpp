@@ -15,7 +15,10 @@
 #include "../../../../graphics/src/graphics_private.h"
 #include "../../../../resource/src/resource_private.h"
 
+#include "gamesys/resources/res_texture.h"
 #include "gamesys/resources/res_textureset.h"
+#include "gamesys/texture_streamer.h"
+#include "gamesys/texture_transcoder.h"
 
 #include <stdio.h>
 
@@ -161,6 +164,230 @@ TEST_F(ResourceTest, TestReloadTextureSet)
     dmResource::Release(m_Factory, (void**) resource);
 }
 
+// Runs the streamer for at least min_frames frames, and until it has uploaded the mips it wants
+// The render object, if any, is reported too, like components that don't know the texel density do
+static void RunTextureStreamer(dmGameSystem::HTextureStreamer streamer, dmGraphics::HTexture texture, float texel_scale, uint32_t min_frames, const dmRender::RenderObject* ro = 0)
+{
+    dmGameSystem::TextureStreamerStats stats;
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        if (texel_scale > 0.0f)
+            dmGameSystem::ReportTextureUsage(streamer, texture, texel_scale);
+        if (ro)
+            dmGameSystem::ReportTextureUsage(streamer, *ro);
+        dmGameSystem::UpdateTextureStreamer(streamer);
+        dmGameSystem::GetTextureStreamerStats(streamer, &stats);
+        if (i >= min_frames && stats.m_PendingLoads == 0 && stats.m_ResidentBytes == stats.m_WantedBytes)
+            break;
+        dmTime::Sleep(1000);
+    }
+}
+
+TEST_F(ResourceTest, TextureStreaming)
+{
+    dmGameSystem::TextureStreamerParams params;
+    params.m_Budget = 32 * 1024;
+    params.m_InitialSize = 32;
+    params.m_EvictFrames = 4;
+    dmGameSystem::HTextureStreamer streamer = dmGameSystem::NewTextureStreamer(m_Factory, m_GraphicsContext, params);
+    m_TextureContext.m_Streamer = streamer;
+
+    dmGraphics::HTexture texture = 0;
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(m_Factory, "/texture/valid_png_128.texturec", (void**) &texture));
+
+    // Only the mips up to the initial size are loaded at first
+    ASSERT_EQ(32, dmGraphics::GetTextureWidth(texture));
+    ASSERT_EQ(32, dmGraphics::GetTextureHeight(texture));
+    ASSERT_EQ(128, dmGraphics::GetOriginalTextureWidth(texture));
+    ASSERT_EQ(2u, dmGameSystem::GetStreamingTextureMip(streamer, texture));
+
+    // Without usage reports the texture gets the best resolution the budget allows, all mips don't fit
+    RunTextureStreamer(streamer, texture, 0.0f, 1);
+    ASSERT_EQ(64, dmGraphics::GetTextureWidth(texture));
+    ASSERT_EQ(1u, dmGameSystem::GetStreamingTextureMip(streamer, texture));
+
+    dmGameSystem::TextureStreamerStats stats;
+    dmGameSystem::GetTextureStreamerStats(streamer, &stats);
+    ASSERT_EQ(1u, stats.m_TextureCount);
+    ASSERT_GE(params.m_Budget, stats.m_ResidentBytes);
+
+    // Drawn at a quarter of the size
+    RunTextureStreamer(streamer, texture, 0.25f, params.m_EvictFrames + 2);
+    ASSERT_EQ(32, dmGraphics::GetTextureWidth(texture));
+    ASSERT_EQ(2u, dmGameSystem::GetStreamingTextureMip(streamer, texture));
+
+    // Drawn at full size, still limited by the budget
+    RunTextureStreamer(streamer, texture, 1.0f, 1);
+    ASSERT_EQ(64, dmGraphics::GetTextureWidth(texture));
+
+    // Not drawn for a while
+    RunTextureStreamer(streamer, texture, 0.0f, params.m_EvictFrames + 2);
+    ASSERT_EQ(32, dmGraphics::GetTextureWidth(texture));
+    ASSERT_EQ(2u, dmGameSystem::GetStreamingTextureMip(streamer, texture));
+
+    // Drawn small by one component and by another that doesn't know the size it's drawn at
+    dmRender::RenderObject ro;
+    ro.m_Textures[0] = texture;
+    RunTextureStreamer(streamer, texture, 0.25f, params.m_EvictFrames + 2, &ro);
+    ASSERT_EQ(64, dmGraphics::GetTextureWidth(texture));
+    ASSERT_EQ(1u, dmGameSystem::GetStreamingTextureMip(streamer, texture));
+
+    dmResource::Release(m_Factory, (void*) texture);
+    dmGameSystem::GetTextureStreamerStats(streamer, &stats);
+    ASSERT_EQ(0u, stats.m_TextureCount);
+
+    // A universal texture transcoded to RGB takes six times the ETC1 size, the budget is kept by the transcoded sizes
+    dmGraphics::SetTextureFormatSupport(m_GraphicsContext, dmGraphics::TEXTURE_FORMAT_RGB_ETC1, false);
+    dmGraphics::SetTextureFormatSupport(m_GraphicsContext, dmGraphics::TEXTURE_FORMAT_RGB_DXT1, false);
+    dmGraphics::SetTextureFormatSupport(m_GraphicsContext, dmGraphics::TEXTURE_FORMAT_RGB_16BPP, false);
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(m_Factory, "/texture/universal_webp_512.texturec", (void**) &texture));
+    ASSERT_EQ(dmGraphics::TEXTURE_FORMAT_RGB, dmGraphics::GetTextureFormat(texture));
+    ASSERT_EQ(32, dmGraphics::GetTextureWidth(texture));
+    ASSERT_EQ(4u, dmGameSystem::GetStreamingTextureMip(streamer, texture));
+
+    // 128x128 fits as ETC1 but not as RGB
+    RunTextureStreamer(streamer, texture, 1.0f, 1);
+    ASSERT_EQ(64, dmGraphics::GetTextureWidth(texture));
+    ASSERT_EQ(3u, dmGameSystem::GetStreamingTextureMip(streamer, texture));
+    ASSERT_EQ(dmGraphics::TEXTURE_FORMAT_RGB, dmGraphics::GetTextureFormat(texture));
+
+    uint32_t resident_bytes = 0;
+    for (uint32_t size = 64; size > 0; size >>= 1)
+        resident_bytes += dmGameSystem::GetTranscodedSize(dmGraphics::TEXTURE_FORMAT_RGB, size, size);
+    dmGameSystem::GetTextureStreamerStats(streamer, &stats);
+    ASSERT_EQ(resident_bytes, stats.m_ResidentBytes);
+    ASSERT_GE(params.m_Budget, stats.m_ResidentBytes);
+
+    dmResource::Release(m_Factory, (void*) texture);
+    dmGraphics::SetTextureFormatSupport(m_GraphicsContext, dmGraphics::TEXTURE_FORMAT_RGB_ETC1, true);
+    dmGraphics::SetTextureFormatSupport(m_GraphicsContext, dmGraphics::TEXTURE_FORMAT_RGB_DXT1, true);
+    dmGraphics::SetTextureFormatSupport(m_GraphicsContext, dmGraphics::TEXTURE_FORMAT_RGB_16BPP, true);
+
+    dmGameSystem::DeleteTextureStreamer(streamer);
+    m_TextureContext.m_Streamer = 0;
+}
+
+TEST_F(ResourceTest, TextureTranscodeUniversal)
+{
+    // The null device supports every format, ETC1 blocks are uploaded as is
+    ASSERT_EQ(dmGraphics::TEXTURE_FORMAT_RGB_ETC1, dmGameSystem::GetUniversalTranscodeFormat(m_GraphicsContext));
+    dmGraphics::SetTextureFormatSupport(m_GraphicsContext, dmGraphics::TEXTURE_FORMAT_RGB_ETC1, false);
+    ASSERT_EQ(dmGraphics::TEXTURE_FORMAT_RGB_DXT1, dmGameSystem::GetUniversalTranscodeFormat(m_GraphicsContext));
+    dmGraphics::SetTextureFormatSupport(m_GraphicsContext, dmGraphics::TEXTURE_FORMAT_RGB_DXT1, false);
+    ASSERT_EQ(dmGraphics::TEXTURE_FORMAT_RGB_16BPP, dmGameSystem::GetUniversalTranscodeFormat(m_GraphicsContext));
+    dmGraphics::SetTextureFormatSupport(m_GraphicsContext, dmGraphics::TEXTURE_FORMAT_RGB_16BPP, false);
+    ASSERT_EQ(dmGraphics::TEXTURE_FORMAT_RGB, dmGameSystem::GetUniversalTranscodeFormat(m_GraphicsContext));
+    dmGraphics::SetTextureFormatSupport(m_GraphicsContext, dmGraphics::TEXTURE_FORMAT_RGB_ETC1, true);
+    dmGraphics::SetTextureFormatSupport(m_GraphicsContext, dmGraphics::TEXTURE_FORMAT_RGB_DXT1, true);
+    dmGraphics::SetTextureFormatSupport(m_GraphicsContext, dmGraphics::TEXTURE_FORMAT_RGB_16BPP, true);
+
+    // Individual mode, base color 0xff0000, first modifier table, all texels +2
+    const uint8_t block[8] = { 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    uint8_t blocks[4 * 8];
+    for (uint32_t i = 0; i < 4; ++i)
+        memcpy(blocks + i * 8, block, 8);
+
+    ASSERT_EQ(8u * 8u * 3u, dmGameSystem::GetTranscodedSize(dmGraphics::TEXTURE_FORMAT_RGB, 8, 8));
+    uint8_t rgb[8 * 8 * 3];
+    ASSERT_TRUE(dmGameSystem::TranscodeETC1(blocks, 8, 8, dmGraphics::TEXTURE_FORMAT_RGB, rgb));
+    for (uint32_t i = 0; i < 8 * 8; ++i)
+    {
+        ASSERT_EQ(255, rgb[i * 3 + 0]);
+        ASSERT_EQ(2, rgb[i * 3 + 1]);
+        ASSERT_EQ(2, rgb[i * 3 + 2]);
+    }
+
+    // Mips smaller than a block only get the texels they cover
+    ASSERT_EQ(2u * 2u * 2u, dmGameSystem::GetTranscodedSize(dmGraphics::TEXTURE_FORMAT_RGB_16BPP, 2, 2));
+    uint16_t rgb16[2 * 2 + 1];
+    rgb16[4] = 0xabcd;
+    ASSERT_TRUE(dmGameSystem::TranscodeETC1(blocks, 2, 2, dmGraphics::TEXTURE_FORMAT_RGB_16BPP, (uint8_t*) rgb16));
+    for (uint32_t i = 0; i < 2 * 2; ++i)
+        ASSERT_EQ(0xf800, rgb16[i]);
+    ASSERT_EQ(0xabcd, rgb16[4]);
+
+    ASSERT_EQ(4u * 8u, dmGameSystem::GetTranscodedSize(dmGraphics::TEXTURE_FORMAT_RGB_DXT1, 8, 8));
+    uint8_t dxt1[4 * 8];
+    ASSERT_TRUE(dmGameSystem::TranscodeETC1(blocks, 8, 8, dmGraphics::TEXTURE_FORMAT_RGB_DXT1, dxt1));
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        uint16_t color0 = dxt1[i * 8 + 0] | (dxt1[i * 8 + 1] << 8);
+        ASSERT_EQ(0xf800, color0);
+    }
+
+    ASSERT_FALSE(dmGameSystem::TranscodeETC1(blocks, 8, 8, dmGraphics::TEXTURE_FORMAT_RGBA, rgb));
+}
+
+TEST_F(ResourceTest, TextureLoadUniversal)
+{
+    // 8x8 with the ETC1 blocks as is, 16x16 with the first mip WebP compressed
+    const char* paths[] = {"/texture/universal.texturec", "/texture/universal_webp.texturec"};
+    const uint32_t sizes[] = {8, 16};
+    const dmGraphics::TextureFormat formats[] = {dmGraphics::TEXTURE_FORMAT_RGB_ETC1, dmGraphics::TEXTURE_FORMAT_RGB_DXT1, dmGraphics::TEXTURE_FORMAT_RGB_16BPP};
+
+    for (uint32_t f = 0; f < sizeof(formats)/sizeof(formats[0]); ++f)
+    {
+        ASSERT_EQ(formats[f], dmGameSystem::GetUniversalTranscodeFormat(m_GraphicsContext));
+        for (uint32_t i = 0; i < sizeof(paths)/sizeof(paths[0]); ++i)
+        {
+            dmGraphics::HTexture texture = 0;
+            ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(m_Factory, paths[i], (void**) &texture));
+            ASSERT_EQ(sizes[i], dmGraphics::GetTextureWidth(texture));
+            ASSERT_EQ(formats[f], dmGraphics::GetTextureFormat(texture));
+
+            // Every mip is uploaded in the transcoded format, not as a blank texture
+            uint32_t data_size = 0;
+            for (uint32_t size = sizes[i]; size > 0; size >>= 1)
+                data_size += dmGameSystem::GetTranscodedSize(formats[f], size, size);
+            ASSERT_EQ(data_size, dmGraphics::GetTextureMipMapDataSize(texture));
+
+            dmResource::Release(m_Factory, (void*) texture);
+        }
+        dmGraphics::SetTextureFormatSupport(m_GraphicsContext, formats[f], false);
+    }
+
+    for (uint32_t f = 0; f < sizeof(formats)/sizeof(formats[0]); ++f)
+        dmGraphics::SetTextureFormatSupport(m_GraphicsContext, formats[f], true);
+}
+
+TEST_F(ResourceTest, TextureDecodeParallel)
+{
+    // 256x256 RGBA with every mip WebP compressed, and 512x512 universal with the ETC1 blocks transcoded to DXT1 in bands
+    const char* paths[] = {"/texture/webp_rgba_256.texturec", "/texture/universal_webp_512.texturec"};
+    const uint32_t mip_counts[] = {9, 10};
+    const uint32_t mip0_sizes[] = {256 * 256 * 4, dmGameSystem::GetTranscodedSize(dmGraphics::TEXTURE_FORMAT_RGB_DXT1, 512, 512)};
+    dmGraphics::SetTextureFormatSupport(m_GraphicsContext, dmGraphics::TEXTURE_FORMAT_RGB_ETC1, false);
+    dmGameSystem::HTextureDecoder decoder = dmGameSystem::NewTextureDecoder(2);
+
+    for (uint32_t i = 0; i < sizeof(paths)/sizeof(paths[0]); ++i)
+    {
+        dmGameSystem::ImageDesc* serial = dmGameSystem::LoadTextureMips(m_Factory, m_GraphicsContext, 0, paths[i], 0);
+        dmGameSystem::ImageDesc* parallel = dmGameSystem::LoadTextureMips(m_Factory, m_GraphicsContext, decoder, paths[i], 0);
+        ASSERT_NE((void*) 0, serial);
+        ASSERT_NE((void*) 0, parallel);
+
+        for (uint32_t mip = 0; mip < mip_counts[i]; ++mip)
+        {
+            uint32_t serial_size = 0;
+            uint32_t parallel_size = 0;
+            const uint8_t* serial_data = dmGameSystem::GetTextureMipData(serial, mip, &serial_size);
+            const uint8_t* parallel_data = dmGameSystem::GetTextureMipData(parallel, mip, &parallel_size);
+            ASSERT_NE((const uint8_t*) 0, serial_data);
+            ASSERT_NE((const uint8_t*) 0, parallel_data);
+            if (mip == 0)
+                ASSERT_EQ(mip0_sizes[i], serial_size);
+            ASSERT_EQ(serial_size, parallel_size);
+            ASSERT_EQ(0, memcmp(serial_data, parallel_data, serial_size));
+        }
+
+        dmGameSystem::FreeTextureMips(serial);
+        dmGameSystem::FreeTextureMips(parallel);
+    }
+
+    dmGameSystem::DeleteTextureDecoder(decoder);
+    dmGraphics::SetTextureFormatSupport(m_GraphicsContext, dmGraphics::TEXTURE_FORMAT_RGB_ETC1, true);
+}
+
 TEST_P(ResourceFailTest, Test)
 {
     const ResourceFailParams& p = GetParam();
@@ -558,6 +785,45 @@ TEST_F(SpriteAnimTest, GoDeletion)
     ASSERT_TRUE(dmGameObject::Final(m_Collection));
 }
 
+// Measures the cost of the sprite transform and vertex generation for a large number of sprites
+TEST_F(SpriteAnimTest, RenderThroughput)
+{
+    const uint32_t sprite_count = 16384;
+    const uint32_t frame_count = 10;
+
+    // The sprite world capacity is read from the context when the collection is created
+    m_SpriteContext.m_MaxSpriteCount = sprite_count;
+    dmGameObject::HCollection collection = dmGameObject::NewCollection("sprite_bench", m_Factory, m_Register, sprite_count);
+    ASSERT_TRUE(dmGameObject::Init(collection));
+
+    for (uint32_t i = 0; i < sprite_count; ++i)
+    {
+        Point3 position((float)(i % 128) * 8.0f, (float)(i / 128) * 8.0f, 0.0f);
+        dmGameObject::HInstance go = Spawn(m_Factory, collection, "/sprite/valid_sprite.goc", dmGameObject::ConstructInstanceId(i), 0, 0, position, Quat(0, 0, 0, 1), Vector3(1, 1, 1));
+        ASSERT_NE((void*)0, go);
+    }
+
+    ASSERT_TRUE(dmGameObject::Update(collection, &m_UpdateContext));
+
+    uint64_t start = dmTime::GetTime();
+    for (uint32_t frame = 0; frame < frame_count; ++frame)
+    {
+        dmRender::NewFrame(m_RenderContext);
+        dmRender::RenderListBegin(m_RenderContext);
+        dmGameObject::Render(collection);
+        dmRender::RenderListEnd(m_RenderContext);
+        dmRender::DrawRenderList(m_RenderContext, 0x0, 0x0);
+        dmGraphics::Flip(m_GraphicsContext);
+    }
+    uint64_t elapsed = dmTime::GetTime() - start;
+
+    printf("%u sprites: %.3f ms/frame\n", sprite_count, elapsed / (1000.0 * frame_count));
+
+    ASSERT_TRUE(dmGameObject::Final(collection));
+    dmGameObject::DeleteCollection(collection);
+    dmGameObject::PostUpdate(m_Register);
+}
+
 static float GetFloatProperty(dmGameObject::HInstance go, dmhash_t component_id, dmhash_t property_id)
 {
     dmGameObject::PropertyDesc property_desc;
@@ -1288,6 +1554,43 @@ TEST_F(ComponentTest, JointTest)
 
 }
 
+/* Factory create_many */
+TEST_F(ComponentTest, FactoryCreateManyTest)
+{
+    /* Setup:
+    ** create_many_test
+    ** - [script] factory/create_many_test.script
+    ** - [factory] factory/factory_test.factory
+    */
+
+    dmHashEnableReverseHash(true);
+    lua_State* L = dmScript::GetLuaState(m_ScriptContext);
+
+    dmGameSystem::ScriptLibContext scriptlibcontext;
+    scriptlibcontext.m_Factory = m_Factory;
+    scriptlibcontext.m_Register = m_Register;
+    scriptlibcontext.m_LuaState = L;
+    dmGameSystem::InitializeScriptLibs(scriptlibcontext);
+
+    dmGameObject::HInstance go = Spawn(m_Factory, m_Collection, "/factory/create_many_test.goc", dmHashString64("/create_many_test"), 0, 0, Point3(0, 0, 0), Quat(0, 0, 0, 1), Vector3(1, 1, 1));
+    ASSERT_NE((void*)0, go);
+
+    bool tests_done = false;
+    while (!tests_done)
+    {
+        ASSERT_TRUE(dmGameObject::Update(m_Collection, &m_UpdateContext));
+        ASSERT_TRUE(dmGameObject::PostUpdate(m_Collection));
+
+        lua_getglobal(L, "tests_done");
+        tests_done = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+    }
+
+    ASSERT_TRUE(dmGameObject::Final(m_Collection));
+
+    dmGameSystem::FinalizeScriptLibs(scriptlibcontext);
+}
+
 /* Camera */
 
 const char* valid_camera_resources[] = {"/camera/valid.camerac"};
@@ -1471,6 +1774,45 @@ INSTANTIATE_TEST_CASE_P(Buffer, ResourceTest, jc_test_values_in(valid_buffer_res
 const char* valid_mesh_resources[] = {"/mesh/no_data.meshc", "/mesh/triangle.meshc"};
 INSTANTIATE_TEST_CASE_P(Mesh, ResourceTest, jc_test_values_in(valid_mesh_resources));
 
+static void RenderMeshes(dmRender::HRenderContext render_context, dmGameObject::HCollection collection)
+{
+    dmRender::NewFrame(render_context);
+    dmRender::RenderListBegin(render_context);
+    dmGameObject::Render(collection);
+    dmRender::RenderListEnd(render_context);
+    dmRender::DrawRenderList(render_context, 0x0, 0x0);
+}
+
+TEST_F(ComponentTest, InstancedMesh)
+{
+    const uint32_t mesh_count = 8;
+
+    ASSERT_TRUE(dmGameObject::Init(m_Collection));
+    for (uint32_t i = 0; i < mesh_count; ++i)
+    {
+        dmGameObject::HInstance go = Spawn(m_Factory, m_Collection, "/mesh/instanced.goc", dmGameObject::ConstructInstanceId(i), 0, 0, Point3((float) i, 0, 0), Quat(0, 0, 0, 1), Vector3(1, 1, 1));
+        ASSERT_NE((void*)0, go);
+    }
+    ASSERT_TRUE(dmGameObject::Update(m_Collection, &m_UpdateContext));
+    dmGraphics::Flip(m_GraphicsContext);
+
+    // The meshes share vertices and a material with the mtx_world_* attributes, and are drawn as instances
+    RenderMeshes(m_RenderContext, m_Collection);
+    ASSERT_EQ(1u, dmGraphics::GetDrawCount());
+    ASSERT_EQ(mesh_count, dmGraphics::GetInstanceCount());
+    dmGraphics::Flip(m_GraphicsContext);
+
+    // Without instancing, each mesh is drawn with the world transform stored in its vertices
+    dmGraphics::SetInstancingSupport(m_GraphicsContext, false);
+    RenderMeshes(m_RenderContext, m_Collection);
+    ASSERT_EQ(mesh_count, dmGraphics::GetDrawCount());
+    ASSERT_EQ(0u, dmGraphics::GetInstanceCount());
+    dmGraphics::Flip(m_GraphicsContext);
+    dmGraphics::SetInstancingSupport(m_GraphicsContext, true);
+
+    ASSERT_TRUE(dmGameObject::Final(m_Collection));
+}
+
 /* MeshSet */
 
 const char* valid_meshset_resources[] = {"/meshset/valid.meshsetc", "/meshset/valid.skeletonc", "/meshset/valid.animationsetc"};
@@ -54,6 +54,7 @@ protected:
     dmHID::HContext m_HidContext;
     dmInput::HContext m_InputContext;
     dmInputDDF::GamepadMaps* m_GamepadMapsDDF;
+    dmGameSystem::TextureContext m_TextureContext;
     dmGameSystem::SpriteContext m_SpriteContext;
     dmGameSystem::CollectionProxyContext m_CollectionProxyContext;
     dmGameSystem::FactoryContext m_FactoryContext;
@@ -294,6 +295,8 @@ void GamesysTest<T>::SetUp()
     m_ParticleFXContext.m_MaxParticleFXCount = 64;
     m_ParticleFXContext.m_MaxParticleCount = 256;
 
+    m_TextureContext.m_GraphicsContext = m_GraphicsContext;
+
     m_SpriteContext.m_RenderContext = m_RenderContext;
     m_SpriteContext.m_MaxSpriteCount = 32;
 
@@ -329,7 +332,7 @@ void GamesysTest<T>::SetUp()
 
     m_SoundContext.m_MaxComponentCount = 32;
 
-    dmResource::Result r = dmGameSystem::RegisterResourceTypes(m_Factory, m_RenderContext, &m_GuiContext, m_InputContext, &m_PhysicsContext);
+    dmResource::Result r = dmGameSystem::RegisterResourceTypes(m_Factory, m_RenderContext, &m_GuiContext, m_InputContext, &m_PhysicsContext, &m_TextureContext);
     assert(dmResource::RESULT_OK == r);
 
     dmResource::Get(m_Factory, "/input/valid.gamepadsc", (void**)&m_GamepadMapsDDF);
@@ -0,0 +1,165 @@
+// Copyright 2020 The Defold Foundation
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "texture_decoder.h"
+
+#include <dlib/array.h>
+#include <dlib/condition_variable.h>
+#include <dlib/dlib.h>
+#include <dlib/math.h>
+#include <dlib/mutex.h>
+#include <dlib/thread.h>
+
+namespace dmGameSystem
+{
+    static const uint32_t m_MaxDecoderThreads = 8;
+    static const uint32_t m_DecoderThreadStackSize = 0x10000;
+
+    // The tasks of one RunTextureDecodeTasks call
+    struct TextureDecodeBatch
+    {
+        TextureDecodeFunction   m_Function;
+        void*                   m_Context;
+        uint32_t                m_Count;
+        uint32_t                m_Next;
+        uint32_t                m_Remaining;
+    };
+
+    struct TextureDecoder
+    {
+        dmMutex::HMutex                         m_Mutex;
+        dmConditionVariable::HConditionVariable m_WorkAdded;
+        dmConditionVariable::HConditionVariable m_WorkDone;
+        // Batches with tasks not yet taken. Protected by m_Mutex
+        dmArray<TextureDecodeBatch*>            m_Batches;
+        dmThread::Thread                        m_Threads[m_MaxDecoderThreads];
+        uint32_t                                m_ThreadCount;
+        bool                                    m_Quit;
+    };
+
+    // Must be called with the mutex locked
+    static void RunTask(TextureDecoder* decoder, TextureDecodeBatch* batch)
+    {
+        uint32_t task = batch->m_Next++;
+        if (batch->m_Next == batch->m_Count)
+        {
+            for (uint32_t i = 0; i < decoder->m_Batches.Size(); ++i)
+            {
+                if (decoder->m_Batches[i] == batch)
+                {
+                    decoder->m_Batches.EraseSwap(i);
+                    break;
+                }
+            }
+        }
+        dmMutex::Unlock(decoder->m_Mutex);
+
+        batch->m_Function(batch->m_Context, task);
+
+        dmMutex::Lock(decoder->m_Mutex);
+        if (--batch->m_Remaining == 0)
+        {
+            dmConditionVariable::Broadcast(decoder->m_WorkDone);
+        }
+    }
+
+    static void DecoderThread(void* context)
+    {
+        TextureDecoder* decoder = (TextureDecoder*) context;
+        dmMutex::ScopedLock lk(decoder->m_Mutex);
+        while (!decoder->m_Quit)
+        {
+            if (decoder->m_Batches.Empty())
+            {
+                dmConditionVariable::Wait(decoder->m_WorkAdded, decoder->m_Mutex);
+                continue;
+            }
+            RunTask(decoder, decoder->m_Batches[0]);
+        }
+    }
+
+    HTextureDecoder NewTextureDecoder(uint32_t thread_count)
+    {
+        TextureDecoder* decoder = new TextureDecoder;
+        decoder->m_Mutex = dmMutex::New();
+        decoder->m_WorkAdded = dmConditionVariable::New();
+        decoder->m_WorkDone = dmConditionVariable::New();
+        decoder->m_Batches.SetCapacity(8);
+        decoder->m_ThreadCount = 0;
+        decoder->m_Quit = false;
+        if (dLib::FeaturesSupported(DM_FEATURE_BIT_THREADS))
+        {
+            thread_count = dmMath::Min(thread_count, m_MaxDecoderThreads);
+            for (uint32_t i = 0; i < thread_count; ++i)
+            {
+                decoder->m_Threads[decoder->m_ThreadCount++] = dmThread::New(DecoderThread, m_DecoderThreadStackSize, decoder, "texdecode");
+            }
+        }
+        return decoder;
+    }
+
+    void DeleteTextureDecoder(HTextureDecoder decoder)
+    {
+        dmMutex::Lock(decoder->m_Mutex);
+        decoder->m_Quit = true;
+        dmConditionVariable::Broadcast(decoder->m_WorkAdded);
+        dmMutex::Unlock(decoder->m_Mutex);
+        for (uint32_t i = 0; i < decoder->m_ThreadCount; ++i)
+        {
+            dmThread::Join(decoder->m_Threads[i]);
+        }
+        dmConditionVariable::Delete(decoder->m_WorkDone);
+        dmConditionVariable::Delete(decoder->m_WorkAdded);
+        dmMutex::Delete(decoder->m_Mutex);
+        delete decoder;
+    }
+
+    void RunTextureDecodeTasks(HTextureDecoder decoder, TextureDecodeFunction function, void* context, uint32_t task_count)
+    {
+        if (decoder == 0 || decoder->m_ThreadCount == 0 || task_count < 2)
+        {
+            for (uint32_t i = 0; i < task_count; ++i)
+            {
+                function(context, i);
+            }
+            return;
+        }
+
+        TextureDecodeBatch batch;
+        batch.m_Function = function;
+        batch.m_Context = context;
+        batch.m_Count = task_count;
+        batch.m_Next = 0;
+        batch.m_Remaining = task_count;
+
+        dmMutex::ScopedLock lk(decoder->m_Mutex);
+        if (decoder->m_Batches.Full())
+        {
+            decoder->m_Batches.OffsetCapacity(8);
+        }
+        decoder->m_Batches.Push(&batch);
+        dmConditionVariable::Broadcast(decoder->m_WorkAdded);
+
+        // Only this batch's tasks are run here, so that the caller isn't held up by other loads
+        while (batch.m_Remaining > 0)
+        {
+            if (batch.m_Next < batch.m_Count)
+            {
+                RunTask(decoder, &batch);
+            }
+            else
+            {
+                dmConditionVariable::Wait(decoder->m_WorkDone, decoder->m_Mutex);
+            }
+        }
+    }
+}
@@ -0,0 +1,35 @@
+// Copyright 2020 The Defold Foundation
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef DM_GAMESYS_TEXTURE_DECODER_H
+#define DM_GAMESYS_TEXTURE_DECODER_H
+
+#include <stdint.h>
+
+#include "gamesys.h"
+
+namespace dmGameSystem
+{
+    typedef void (*TextureDecodeFunction)(void* context, uint32_t task);
+
+    /**
+     * Run the tasks [0, task_count) and return when all are done. The calling thread runs tasks too,
+     * the helper threads take the tasks of any load in progress. Safe to call from any thread.
+     * @param decoder Texture decoder handle, the tasks are run on the calling thread alone when 0
+     * @param function Function called once per task
+     * @param context Passed to the function
+     * @param task_count Number of tasks
+     */
+    void RunTextureDecodeTasks(HTextureDecoder decoder, TextureDecodeFunction function, void* context, uint32_t task_count);
+}
+
+#endif // DM_GAMESYS_TEXTURE_DECODER_H
@@ -0,0 +1,513 @@
+// Copyright 2020 The Defold Foundation
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "texture_streamer.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include <dlib/array.h>
+#include <dlib/condition_variable.h>
+#include <dlib/hashtable.h>
+#include <dlib/log.h>
+#include <dlib/math.h>
+#include <dlib/mutex.h>
+#include <dlib/profile.h>
+#include <dlib/thread.h>
+
+#include "resources/res_texture.h"
+
+namespace dmGameSystem
+{
+    static const uint32_t m_MaxStreamingMips = 32;
+    static const uint32_t m_StreamerThreadStackSize = 0x10000;
+
+    struct StreamingTexture
+    {
+        dmGraphics::HTexture    m_Texture;
+        char*                   m_Path;
+        // Tells loads apart from those of an earlier texture with the same handle
+        uint32_t                m_Id;
+        // Size in bytes of the mip chain starting at each mip
+        uint32_t                m_ChainSizes[m_MaxStreamingMips];
+        uint32_t                m_MipCount;
+        // The mip the texture was first loaded from, it is never streamed out further than this
+        uint32_t                m_MinMip;
+        uint32_t                m_ResidentMip;
+        uint32_t                m_WantedMip;
+        uint32_t                m_LastUsedFrame;
+        // Largest texel scale reported within the last m_EvictFrames frames, and when it was reported
+        float                   m_Scale;
+        uint32_t                m_ScaleFrame;
+        uint8_t                 m_Reported : 1;
+        uint8_t                 m_Loading : 1;
+        uint8_t                 m_Failed : 1;
+    };
+
+    struct StreamingLoad
+    {
+        dmGraphics::HTexture    m_Texture;
+        uint32_t                m_Id;
+        uint32_t                m_FirstMip;
+        char*                   m_Path;
+        // Set by the loading thread, 0 if the load failed
+        ImageDesc*              m_Mips;
+    };
+
+    struct TextureStreamer
+    {
+        TextureStreamerParams                   m_Params;
+        dmResource::HFactory                    m_Factory;
+        dmGraphics::HContext                    m_GraphicsContext;
+        dmArray<StreamingTexture>               m_Textures;
+        // Texture handle to index in m_Textures
+        dmHashTable64<uint32_t>                 m_TextureIndices;
+        // Texture indices, least important first. Rebuilt every update
+        dmArray<uint32_t>                       m_Order;
+        // Finished loads waiting for their texture to be idle
+        dmArray<StreamingLoad>                  m_Uploads;
+        uint32_t                                m_Frame;
+        uint32_t                                m_NextId;
+        uint32_t                                m_PendingLoads;
+        uint32_t                                m_WantedBytes;
+
+        // Shared with the loading thread, protected by m_Mutex
+        dmArray<StreamingLoad>                  m_Loads;
+        dmArray<StreamingLoad>                  m_Done;
+        dmMutex::HMutex                         m_Mutex;
+        dmConditionVariable::HConditionVariable m_LoadAdded;
+        dmThread::Thread                        m_Thread;
+        bool                                    m_HasThread;
+        bool                                    m_Quit;
+    };
+
+    TextureStreamerParams::TextureStreamerParams()
+    : m_Budget(32 * 1024 * 1024)
+    , m_InitialSize(64)
+    , m_EvictFrames(300)
+    , m_MaxPendingLoads(4)
+    , m_Decoder(0)
+    {
+    }
+
+    // Must be called with the mutex locked. Returns false when there are no loads waiting
+    static bool ProcessLoad(TextureStreamer* streamer)
+    {
+        if (streamer->m_Loads.Empty())
+            return false;
+
+        StreamingLoad load = streamer->m_Loads.Back();
+        streamer->m_Loads.Pop();
+        dmMutex::Unlock(streamer->m_Mutex);
+
+        {
+            DM_PROFILE(Texture, "StreamMips");
+            load.m_Mips = LoadTextureMips(streamer->m_Factory, streamer->m_GraphicsContext, streamer->m_Params.m_Decoder, load.m_Path, load.m_FirstMip);
+        }
+
+        dmMutex::Lock(streamer->m_Mutex);
+        if (streamer->m_Done.Full())
+        {
+            streamer->m_Done.OffsetCapacity(dmMath::Max(16U, streamer->m_Done.Capacity()));
+        }
+        streamer->m_Done.Push(load);
+        return true;
+    }
+
+    static void StreamerThread(void* context)
+    {
+        TextureStreamer* streamer = (TextureStreamer*)context;
+        dmMutex::ScopedLock lk(streamer->m_Mutex);
+        while (!streamer->m_Quit)
+        {
+            if (!ProcessLoad(streamer))
+            {
+                dmConditionVariable::Wait(streamer->m_LoadAdded, streamer->m_Mutex);
+            }
+        }
+    }
+
+    static void FreeLoad(StreamingLoad* load)
+    {
+        if (load->m_Mips)
+        {
+            FreeTextureMips(load->m_Mips);
+        }
+        free(load->m_Path);
+    }
+
+    static StreamingTexture* GetStreamingTexture(TextureStreamer* streamer, dmGraphics::HTexture texture)
+    {
+        uint32_t* index = streamer->m_TextureIndices.Get((uint64_t)(uintptr_t)texture);
+        return index ? &streamer->m_Textures[*index] : 0;
+    }
+
+    HTextureStreamer NewTextureStreamer(dmResource::HFactory factory, dmGraphics::HContext graphics_context, const TextureStreamerParams& params)
+    {
+        TextureStreamer* streamer = new TextureStreamer;
+        streamer->m_Params = params;
+        streamer->m_Factory = factory;
+        streamer->m_GraphicsContext = graphics_context;
+        streamer->m_Frame = 0;
+        streamer->m_NextId = 0;
+        streamer->m_PendingLoads = 0;
+        streamer->m_WantedBytes = 0;
+        streamer->m_Mutex = dmMutex::New();
+        streamer->m_LoadAdded = dmConditionVariable::New();
+        streamer->m_HasThread = false;
+        streamer->m_Quit = false;
+#if !defined(__EMSCRIPTEN__)
+        streamer->m_Thread = dmThread::New(StreamerThread, m_StreamerThreadStackSize, streamer, "texstream");
+        streamer->m_HasThread = true;
+#endif
+        return streamer;
+    }
+
+    void DeleteTextureStreamer(HTextureStreamer streamer)
+    {
+        dmMutex::Lock(streamer->m_Mutex);
+        streamer->m_Quit = true;
+        dmConditionVariable::Broadcast(streamer->m_LoadAdded);
+        dmMutex::Unlock(streamer->m_Mutex);
+        if (streamer->m_HasThread)
+        {
+            dmThread::Join(streamer->m_Thread);
+        }
+
+        for (uint32_t i = 0; i < streamer->m_Loads.Size(); ++i)
+        {
+            FreeLoad(&streamer->m_Loads[i]);
+        }
+        for (uint32_t i = 0; i < streamer->m_Done.Size(); ++i)
+        {
+            FreeLoad(&streamer->m_Done[i]);
+        }
+        for (uint32_t i = 0; i < streamer->m_Uploads.Size(); ++i)
+        {
+            FreeLoad(&streamer->m_Uploads[i]);
+        }
+        for (uint32_t i = 0; i < streamer->m_Textures.Size(); ++i)
+        {
+            free(streamer->m_Textures[i].m_Path);
+        }
+        dmConditionVariable::Delete(streamer->m_LoadAdded);
+        dmMutex::Delete(streamer->m_Mutex);
+        delete streamer;
+    }
+
+    uint32_t GetInitialStreamingMip(HTextureStreamer streamer, uint32_t width, uint32_t height, uint32_t mip_count)
+    {
+        uint32_t initial_size = streamer->m_Params.m_InitialSize;
+        uint32_t mip = 0;
+        while (mip + 1 < mip_count && mip + 1 < m_MaxStreamingMips && dmMath::Max(width >> mip, height >> mip) > initial_size)
+        {
+            ++mip;
+        }
+        return mip;
+    }
+
+    void RegisterStreamingTexture(HTextureStreamer streamer, dmGraphics::HTexture texture, const char* path, uint32_t width, uint32_t height, const uint32_t* mip_sizes, uint32_t mip_count, uint32_t first_mip)
+    {
+        assert(!GetStreamingTexture(streamer, texture));
+        if (mip_count > m_MaxStreamingMips)
+        {
+            return;
+        }
+
+        if (streamer->m_Textures.Full())
+        {
+            streamer->m_Textures.OffsetCapacity(64);
+        }
+        if (streamer->m_TextureIndices.Full())
+        {
+            uint32_t capacity = streamer->m_TextureIndices.Capacity() + 64;
+            streamer->m_TextureIndices.SetCapacity(capacity * 2, capacity);
+        }
+
+        StreamingTexture t;
+        memset(&t, 0, sizeof(t));
+        t.m_Texture = texture;
+        t.m_Path = strdup(path);
+        t.m_Id = streamer->m_NextId++;
+        t.m_MipCount = mip_count;
+        uint32_t chain_size = 0;
+        for (int32_t i = (int32_t)mip_count - 1; i >= 0; --i)
+        {
+            chain_size += mip_sizes[i];
+            t.m_ChainSizes[i] = chain_size;
+        }
+        t.m_MinMip = first_mip;
+        t.m_ResidentMip = first_mip;
+        t.m_WantedMip = first_mip;
+        t.m_LastUsedFrame = streamer->m_Frame;
+        t.m_Scale = 1.0f;
+        t.m_ScaleFrame = streamer->m_Frame;
+
+        streamer->m_TextureIndices.Put((uint64_t)(uintptr_t)texture, streamer->m_Textures.Size());
+        streamer->m_Textures.Push(t);
+        dmLogDebug("Streaming %ux%u texture '%s' from mip %u", width, height, path, first_mip);
+    }
+
+    void UnregisterStreamingTexture(HTextureStreamer streamer, dmGraphics::HTexture texture)
+    {
+        uint64_t key = (uint64_t)(uintptr_t)texture;
+        uint32_t* index_ptr = streamer->m_TextureIndices.Get(key);
+        if (!index_ptr)
+        {
+            return;
+        }
+        uint32_t index = *index_ptr;
+        streamer->m_TextureIndices.Erase(key);
+        free(streamer->m_Textures[index].m_Path);
+        streamer->m_Textures.EraseSwap(index);
+        if (index < streamer->m_Textures.Size())
+        {
+            streamer->m_TextureIndices.Put((uint64_t)(uintptr_t)streamer->m_Textures[index].m_Texture, index);
+        }
+    }
+
+    void ReportTextureUsage(HTextureStreamer streamer, dmGraphics::HTexture texture, float texel_scale)
+    {
+        StreamingTexture* t = GetStreamingTexture(streamer, texture);
+        if (!t)
+        {
+            return;
+        }
+        uint32_t frame = streamer->m_Frame;
+        // Keep the largest scale for a while, so that the resolution doesn't go back and forth with the scale
+        if (!t->m_Reported || texel_scale >= t->m_Scale || frame - t->m_ScaleFrame > streamer->m_Params.m_EvictFrames)
+        {
+            t->m_Scale = texel_scale;
+            t->m_ScaleFrame = frame;
+        }
+        t->m_LastUsedFrame = frame;
+        t->m_Reported = 1;
+    }
+
+    void ReportTextureUsage(HTextureStreamer streamer, const dmRender::RenderObject& ro)
+    {
+        for (uint32_t i = 0; i < dmRender::RenderObject::MAX_TEXTURE_COUNT; ++i)
+        {
+            if (ro.m_Textures[i])
+            {
+                ReportTextureUsage(streamer, ro.m_Textures[i], 1.0f);
+            }
+        }
+    }
+
+    uint32_t GetStreamingTextureMip(HTextureStreamer streamer, dmGraphics::HTexture texture)
+    {
+        StreamingTexture* t = GetStreamingTexture(streamer, texture);
+        return t ? t->m_ResidentMip : 0;
+    }
+
+    static uint32_t GetWantedMip(float texel_scale, uint32_t min_mip)
+    {
+        uint32_t mip = 0;
+        while (mip < min_mip && texel_scale <= 0.5f)
+        {
+            texel_scale *= 2.0f;
+            ++mip;
+        }
+        return mip;
+    }
+
+    struct StreamingPriorityPred
+    {
+        const StreamingTexture* m_Textures;
+        bool operator()(uint32_t a, uint32_t b) const
+        {
+            const StreamingTexture& ta = m_Textures[a];
+            const StreamingTexture& tb = m_Textures[b];
+            if (ta.m_LastUsedFrame != tb.m_LastUsedFrame)
+                return ta.m_LastUsedFrame < tb.m_LastUsedFrame;
+            return ta.m_Scale < tb.m_Scale;
+        }
+    };
+
+    static void UploadFinishedLoads(TextureStreamer* streamer)
+    {
+        {
+            dmMutex::ScopedLock lk(streamer->m_Mutex);
+            if (!streamer->m_HasThread)
+            {
+                while (ProcessLoad(streamer))
+                {
+                }
+            }
+            uint32_t count = streamer->m_Done.Size();
+            if (streamer->m_Uploads.Remaining() < count)
+            {
+                streamer->m_Uploads.OffsetCapacity(count - streamer->m_Uploads.Remaining());
+            }
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                streamer->m_Uploads.Push(streamer->m_Done[i]);
+            }
+            streamer->m_Done.SetSize(0);
+        }
+
+        uint32_t i = 0;
+        while (i < streamer->m_Uploads.Size())
+        {
+            StreamingLoad* load = &streamer->m_Uploads[i];
+            StreamingTexture* t = GetStreamingTexture(streamer, load->m_Texture);
+            if (t && t->m_Id == load->m_Id)
+            {
+                // Wait for the initial upload to finish before replacing the mips
+                if (dmGraphics::GetTextureStatusFlags(t->m_Texture) & dmGraphics::TEXTURE_STATUS_DATA_PENDING)
+                {
+                    ++i;
+                    continue;
+                }
+                if (load->m_Mips && UploadTextureMips(streamer->m_GraphicsContext, load->m_Mips, t->m_Texture))
+                {
+                    t->m_ResidentMip = load->m_FirstMip;
+                }
+                else
+                {
+                    dmLogWarning("Unable to stream mip %u of texture '%s', it keeps mip %u", load->m_FirstMip, t->m_Path, t->m_ResidentMip);
+                    t->m_Failed = 1;
+                }
+                t->m_Loading = 0;
+            }
+            FreeLoad(load);
+            streamer->m_Uploads.EraseSwap(i);
+            streamer->m_PendingLoads--;
+        }
+    }
+
+    static void StartLoad(TextureStreamer* streamer, StreamingTexture* t)
+    {
+        StreamingLoad load;
+        load.m_Texture = t->m_Texture;
+        load.m_Id = t->m_Id;
+        load.m_FirstMip = t->m_WantedMip;
+        load.m_Path = strdup(t->m_Path);
+        load.m_Mips = 0;
+        t->m_Loading = 1;
+        streamer->m_PendingLoads++;
+
+        dmMutex::ScopedLock lk(streamer->m_Mutex);
+        if (streamer->m_Loads.Full())
+        {
+            streamer->m_Loads.OffsetCapacity(dmMath::Max(16U, streamer->m_Loads.Capacity()));
+        }
+        streamer->m_Loads.Push(load);
+        dmConditionVariable::Signal(streamer->m_LoadAdded);
+    }
+
+    void UpdateTextureStreamer(HTextureStreamer streamer)
+    {
+        DM_PROFILE(Texture, "UpdateStreamer");
+
+        streamer->m_Frame++;
+        UploadFinishedLoads(streamer);
+
+        uint32_t frame = streamer->m_Frame;
+        uint32_t evict_frames = streamer->m_Params.m_EvictFrames;
+        uint32_t texture_count = streamer->m_Textures.Size();
+        uint32_t wanted_bytes = 0;
+        uint32_t resident_bytes = 0;
+        for (uint32_t i = 0; i < texture_count; ++i)
+        {
+            StreamingTexture& t = streamer->m_Textures[i];
+            if (!t.m_Reported)
+            {
+                // No component reports its usage, keep the best resolution the budget allows
+                t.m_LastUsedFrame = frame;
+                t.m_Scale = 1.0f;
+            }
+
+            if (t.m_Failed)
+                t.m_WantedMip = t.m_ResidentMip;
+            else if (frame - t.m_LastUsedFrame > evict_frames)
+                t.m_WantedMip = t.m_MinMip;
+            else
+                t.m_WantedMip = GetWantedMip(t.m_Scale, t.m_MinMip);
+
+            wanted_bytes += t.m_ChainSizes[t.m_WantedMip];
+            resident_bytes += t.m_ChainSizes[t.m_ResidentMip];
+        }
+
+        if (streamer->m_Order.Capacity() < texture_count)
+        {
+            streamer->m_Order.SetCapacity(texture_count);
+        }
+        streamer->m_Order.SetSize(texture_count);
+        for (uint32_t i = 0; i < texture_count; ++i)
+        {
+            streamer->m_Order[i] = i;
+        }
+        StreamingPriorityPred pred;
+        pred.m_Textures = streamer->m_Textures.Begin();
+        std::sort(streamer->m_Order.Begin(), streamer->m_Order.End(), pred);
+
+        // Over budget, drop mips from the least recently used and smallest on screen textures first
+        uint32_t budget = streamer->m_Params.m_Budget;
+        for (uint32_t i = 0; i < texture_count && wanted_bytes > budget; ++i)
+        {
+            StreamingTexture& t = streamer->m_Textures[streamer->m_Order[i]];
+            if (t.m_Failed)
+                continue;
+            while (t.m_WantedMip < t.m_MinMip && wanted_bytes > budget)
+            {
+                wanted_bytes -= t.m_ChainSizes[t.m_WantedMip] - t.m_ChainSizes[t.m_WantedMip + 1];
+                t.m_WantedMip++;
+            }
+        }
+        streamer->m_WantedBytes = wanted_bytes;
+
+        // Dropping mips frees memory for the textures that need more, so those loads start first
+        uint32_t started = 0;
+        uint32_t max_pending = streamer->m_Params.m_MaxPendingLoads;
+        for (uint32_t i = 0; i < texture_count && streamer->m_PendingLoads < max_pending; ++i)
+        {
+            StreamingTexture& t = streamer->m_Textures[streamer->m_Order[i]];
+            if (!t.m_Loading && t.m_WantedMip > t.m_ResidentMip)
+            {
+                StartLoad(streamer, &t);
+                ++started;
+            }
+        }
+        for (uint32_t i = texture_count; i > 0 && streamer->m_PendingLoads < max_pending; --i)
+        {
+            StreamingTexture& t = streamer->m_Textures[streamer->m_Order[i - 1]];
+            if (!t.m_Loading && t.m_WantedMip < t.m_ResidentMip)
+            {
+                StartLoad(streamer, &t);
+                ++started;
+            }
+        }
+
+        DM_COUNTER("Texture.StreamingBudgetKb", budget / 1024);
+        DM_COUNTER("Texture.StreamingResidentKb", resident_bytes / 1024);
+        DM_COUNTER("Texture.StreamingWantedKb", wanted_bytes / 1024);
+        DM_COUNTER("Texture.StreamingTextures", texture_count);
+        DM_COUNTER("Texture.StreamingLoads", started);
+    }
+
+    void GetTextureStreamerStats(HTextureStreamer streamer, TextureStreamerStats* stats)
+    {
+        stats->m_TextureCount = streamer->m_Textures.Size();
+        stats->m_ResidentBytes = 0;
+        for (uint32_t i = 0; i < stats->m_TextureCount; ++i)
+        {
+            const StreamingTexture& t = streamer->m_Textures[i];
+            stats->m_ResidentBytes += t.m_ChainSizes[t.m_ResidentMip];
+        }
+        stats->m_WantedBytes = streamer->m_WantedBytes;
+        stats->m_PendingLoads = streamer->m_PendingLoads;
+    }
+}
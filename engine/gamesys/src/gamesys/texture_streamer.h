@@ -0,0 +1,80 @@
+// Copyright 2020 The Defold Foundation
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef DM_GAMESYS_TEXTURE_STREAMER_H
+#define DM_GAMESYS_TEXTURE_STREAMER_H
+
+#include <stdint.h>
+#include <graphics/graphics.h>
+#include <render/render.h>
+
+#include "gamesys.h"
+
+namespace dmGameSystem
+{
+    /**
+     * Get the mip a texture should first be loaded from. Safe to call from any thread.
+     * @param streamer Texture streamer handle
+     * @param width Width of the first mip
+     * @param height Height of the first mip
+     * @param mip_count Number of mips in the texture file
+     * @return First mip to load
+     */
+    uint32_t GetInitialStreamingMip(HTextureStreamer streamer, uint32_t width, uint32_t height, uint32_t mip_count);
+
+    /**
+     * Start streaming a texture which has been uploaded from first_mip
+     * @param streamer Texture streamer handle
+     * @param texture Texture
+     * @param path Texture resource path, reloaded when other mips are needed
+     * @param width Width of the first mip in the file
+     * @param height Height of the first mip in the file
+     * @param mip_sizes Size in bytes of each mip in the file
+     * @param mip_count Number of mips in the file
+     * @param first_mip The first uploaded mip
+     */
+    void RegisterStreamingTexture(HTextureStreamer streamer, dmGraphics::HTexture texture, const char* path, uint32_t width, uint32_t height, const uint32_t* mip_sizes, uint32_t mip_count, uint32_t first_mip);
+
+    /**
+     * Stop streaming a texture. Any load in flight is discarded. Does nothing if the texture isn't streamed.
+     * @param streamer Texture streamer handle
+     * @param texture Texture
+     */
+    void UnregisterStreamingTexture(HTextureStreamer streamer, dmGraphics::HTexture texture);
+
+    /**
+     * Report that a texture is drawn this frame. Textures that have never been reported
+     * are kept at the best resolution the budget allows.
+     * @param streamer Texture streamer handle
+     * @param texture Texture
+     * @param texel_scale Screen pixels per texel of the first mip in the file, 1 or more needs the full resolution
+     */
+    void ReportTextureUsage(HTextureStreamer streamer, dmGraphics::HTexture texture, float texel_scale);
+
+    /**
+     * Report that the textures of a render object are drawn this frame, for components that
+     * don't know the texel density they draw with. The textures are kept at full resolution.
+     * @param streamer Texture streamer handle
+     * @param ro Render object
+     */
+    void ReportTextureUsage(HTextureStreamer streamer, const dmRender::RenderObject& ro);
+
+    /**
+     * Get the first mip in the file that is currently uploaded
+     * @param streamer Texture streamer handle
+     * @param texture Texture
+     * @return First uploaded mip, 0 if the texture isn't streamed
+     */
+    uint32_t GetStreamingTextureMip(HTextureStreamer streamer, dmGraphics::HTexture texture);
+}
+
+#endif // DM_GAMESYS_TEXTURE_STREAMER_H
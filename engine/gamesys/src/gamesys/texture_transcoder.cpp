@@ -0,0 +1,262 @@
+// Copyright 2020 The Defold Foundation
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "texture_transcoder.h"
+
+#include <string.h>
+#include <dlib/math.h>
+
+namespace dmGameSystem
+{
+    static const int32_t ETC1_MODIFIERS[8][4] =
+    {
+        {  2,   8,  -2,   -8 },
+        {  5,  17,  -5,  -17 },
+        {  9,  29,  -9,  -29 },
+        { 13,  42, -13,  -42 },
+        { 18,  60, -18,  -60 },
+        { 24,  80, -24,  -80 },
+        { 33, 106, -33, -106 },
+        { 47, 183, -47, -183 },
+    };
+
+    static inline uint8_t ClampColor(int32_t c)
+    {
+        return (uint8_t) dmMath::Clamp(c, 0, 255);
+    }
+
+    static inline int32_t Extend5(uint32_t c)
+    {
+        return (int32_t) ((c << 3) | (c >> 2));
+    }
+
+    // Decodes an ETC1 block into 4x4 RGB texels, row by row
+    static void DecodeETC1Block(const uint8_t* block, uint8_t* rgb)
+    {
+        uint32_t high = (block[0] << 24) | (block[1] << 16) | (block[2] << 8) | block[3];
+        uint32_t low = (block[4] << 24) | (block[5] << 16) | (block[6] << 8) | block[7];
+
+        int32_t base[2][3];
+        if (high & 2)
+        {
+            // Differential mode, 5 bit base color and a 3 bit signed delta for the second sub block
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                uint32_t shift = 27 - c * 8;
+                uint32_t c0 = (high >> shift) & 31;
+                int32_t delta = (int32_t) ((high >> (shift - 3)) & 7);
+                delta = delta >= 4 ? delta - 8 : delta;
+                base[0][c] = Extend5(c0);
+                base[1][c] = Extend5((uint32_t) ((int32_t) c0 + delta) & 31);
+            }
+        }
+        else
+        {
+            // Individual mode, two 4 bit base colors
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                uint32_t shift = 28 - c * 8;
+                base[0][c] = ((high >> shift) & 15) * 17;
+                base[1][c] = ((high >> (shift - 4)) & 15) * 17;
+            }
+        }
+
+        const int32_t* modifiers[2] = { ETC1_MODIFIERS[(high >> 5) & 7], ETC1_MODIFIERS[(high >> 2) & 7] };
+        bool flip = (high & 1) != 0;
+        for (uint32_t y = 0; y < 4; ++y)
+        {
+            for (uint32_t x = 0; x < 4; ++x)
+            {
+                // Texel indices are stored column by column
+                uint32_t i = x * 4 + y;
+                uint32_t index = (((low >> (i + 16)) & 1) << 1) | ((low >> i) & 1);
+                uint32_t sub_block = flip ? (y >> 1) : (x >> 1);
+                int32_t modifier = modifiers[sub_block][index];
+                uint8_t* out = rgb + (y * 4 + x) * 3;
+                out[0] = ClampColor(base[sub_block][0] + modifier);
+                out[1] = ClampColor(base[sub_block][1] + modifier);
+                out[2] = ClampColor(base[sub_block][2] + modifier);
+            }
+        }
+    }
+
+    static inline uint16_t ToRGB565(uint32_t r, uint32_t g, uint32_t b)
+    {
+        return (uint16_t) (((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+    }
+
+    // Bounding box DXT1 encoder, fast enough to run at load time. The four colors of an ETC1
+    // sub block lie on a line parallel to the gray axis, so the box diagonal is a good fit.
+    static void EncodeDXT1Block(const uint8_t* rgb, uint8_t* block)
+    {
+        uint32_t min[3] = { 255, 255, 255 };
+        uint32_t max[3] = { 0, 0, 0 };
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                min[c] = dmMath::Min(min[c], (uint32_t) rgb[i * 3 + c]);
+                max[c] = dmMath::Max(max[c], (uint32_t) rgb[i * 3 + c]);
+            }
+        }
+
+        // Inset the box slightly to reduce the error of the quantized end points
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            uint32_t inset = (max[c] - min[c]) >> 4;
+            min[c] += inset;
+            max[c] -= inset;
+        }
+
+        uint16_t color0 = ToRGB565(max[0], max[1], max[2]);
+        uint16_t color1 = ToRGB565(min[0], min[1], min[2]);
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            if (color0 < color1)
+            {
+                uint16_t tmp = color0; color0 = color1; color1 = tmp;
+            }
+
+            // Palette as the hardware decodes it, in four color mode since color0 > color1
+            int32_t palette[4][3];
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                uint32_t bits = c == 1 ? 6 : 5;
+                uint32_t shift = c == 0 ? 11 : (c == 1 ? 5 : 0);
+                uint32_t mask = (1 << bits) - 1;
+                uint32_t c0 = (color0 >> shift) & mask;
+                uint32_t c1 = (color1 >> shift) & mask;
+                palette[0][c] = bits == 6 ? (int32_t) ((c0 << 2) | (c0 >> 4)) : Extend5(c0);
+                palette[1][c] = bits == 6 ? (int32_t) ((c1 << 2) | (c1 >> 4)) : Extend5(c1);
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                uint32_t best = 0;
+                int32_t best_error = 0x7fffffff;
+                for (uint32_t p = 0; p < 4; ++p)
+                {
+                    int32_t dr = rgb[i * 3 + 0] - palette[p][0];
+                    int32_t dg = rgb[i * 3 + 1] - palette[p][1];
+                    int32_t db = rgb[i * 3 + 2] - palette[p][2];
+                    int32_t error = dr * dr + dg * dg + db * db;
+                    if (error < best_error)
+                    {
+                        best_error = error;
+                        best = p;
+                    }
+                }
+                indices |= best << (i * 2);
+            }
+        }
+
+        block[0] = color0 & 0xff;
+        block[1] = color0 >> 8;
+        block[2] = color1 & 0xff;
+        block[3] = color1 >> 8;
+        block[4] = indices & 0xff;
+        block[5] = (indices >> 8) & 0xff;
+        block[6] = (indices >> 16) & 0xff;
+        block[7] = indices >> 24;
+    }
+
+    dmGraphics::TextureFormat GetUniversalTranscodeFormat(dmGraphics::HContext context)
+    {
+        const dmGraphics::TextureFormat formats[] =
+        {
+            dmGraphics::TEXTURE_FORMAT_RGB_ETC1,
+            dmGraphics::TEXTURE_FORMAT_RGB_DXT1,
+            dmGraphics::TEXTURE_FORMAT_RGB_16BPP,
+        };
+        for (uint32_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i)
+        {
+            if (dmGraphics::IsTextureFormatSupported(context, formats[i]))
+            {
+                return formats[i];
+            }
+        }
+        return dmGraphics::TEXTURE_FORMAT_RGB;
+    }
+
+    uint32_t GetTranscodedSize(dmGraphics::TextureFormat format, uint32_t width, uint32_t height)
+    {
+        switch (format)
+        {
+            case dmGraphics::TEXTURE_FORMAT_RGB_ETC1:
+            case dmGraphics::TEXTURE_FORMAT_RGB_DXT1:
+                return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+            case dmGraphics::TEXTURE_FORMAT_RGB_16BPP:
+                return width * height * 2;
+            case dmGraphics::TEXTURE_FORMAT_RGB:
+                return width * height * 3;
+            default:
+                return 0;
+        }
+    }
+
+    bool TranscodeETC1(const uint8_t* blocks, uint32_t width, uint32_t height, dmGraphics::TextureFormat format, uint8_t* out)
+    {
+        uint32_t blocks_x = (width + 3) / 4;
+        uint32_t blocks_y = (height + 3) / 4;
+        switch (format)
+        {
+            case dmGraphics::TEXTURE_FORMAT_RGB_ETC1:
+                memcpy(out, blocks, blocks_x * blocks_y * 8);
+                return true;
+            case dmGraphics::TEXTURE_FORMAT_RGB_DXT1:
+            case dmGraphics::TEXTURE_FORMAT_RGB_16BPP:
+            case dmGraphics::TEXTURE_FORMAT_RGB:
+                break;
+            default:
+                return false;
+        }
+
+        uint8_t rgb[16 * 3];
+        for (uint32_t by = 0; by < blocks_y; ++by)
+        {
+            for (uint32_t bx = 0; bx < blocks_x; ++bx)
+            {
+                uint32_t block_index = by * blocks_x + bx;
+                DecodeETC1Block(blocks + block_index * 8, rgb);
+                if (format == dmGraphics::TEXTURE_FORMAT_RGB_DXT1)
+                {
+                    EncodeDXT1Block(rgb, out + block_index * 8);
+                    continue;
+                }
+
+                // Blocks cover whole 4x4 texels, skip the ones outside of small mips
+                uint32_t block_width = dmMath::Min(4U, width - bx * 4);
+                uint32_t block_height = dmMath::Min(4U, height - by * 4);
+                for (uint32_t y = 0; y < block_height; ++y)
+                {
+                    uint32_t row = (by * 4 + y) * width + bx * 4;
+                    for (uint32_t x = 0; x < block_width; ++x)
+                    {
+                        const uint8_t* texel = rgb + (y * 4 + x) * 3;
+                        if (format == dmGraphics::TEXTURE_FORMAT_RGB_16BPP)
+                        {
+                            ((uint16_t*) out)[row + x] = ToRGB565(texel[0], texel[1], texel[2]);
+                        }
+                        else
+                        {
+                            memcpy(out + (row + x) * 3, texel, 3);
+                        }
+                    }
+                }
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,51 @@
+// Copyright 2020 The Defold Foundation
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef DM_GAMESYS_TEXTURE_TRANSCODER_H
+#define DM_GAMESYS_TEXTURE_TRANSCODER_H
+
+#include <stdint.h>
+#include <graphics/graphics.h>
+
+namespace dmGameSystem
+{
+    /**
+     * Get the format universal textures are transcoded to on this device. The universal
+     * format is stored as ETC1 blocks, which are kept as is when ETC1 is supported, transcoded
+     * to DXT1 when that is supported and decoded to RGB 16bpp or RGB otherwise.
+     * @param context Graphics context
+     * @return Texture format to upload universal textures as
+     */
+    dmGraphics::TextureFormat GetUniversalTranscodeFormat(dmGraphics::HContext context);
+
+    /**
+     * Get the size of a transcoded mip
+     * @param format Format returned by GetUniversalTranscodeFormat
+     * @param width Mip width
+     * @param height Mip height
+     * @return Size in bytes
+     */
+    uint32_t GetTranscodedSize(dmGraphics::TextureFormat format, uint32_t width, uint32_t height);
+
+    /**
+     * Transcode a mip of ETC1 blocks
+     * @param blocks ETC1 blocks, row by row
+     * @param width Mip width
+     * @param height Mip height
+     * @param format Format returned by GetUniversalTranscodeFormat
+     * @param out Buffer of GetTranscodedSize bytes
+     * @return false if format isn't a transcode target
+     */
+    bool TranscodeETC1(const uint8_t* blocks, uint32_t width, uint32_t height, dmGraphics::TextureFormat format, uint8_t* out);
+}
+
+#endif // DM_GAMESYS_TEXTURE_TRANSCODER_H
@@ -343,6 +343,26 @@ namespace dmGraphics
     {
         g_functions.m_Draw(context, prim_type, first, count);
     }
+    bool IsInstancingSupported(HContext context)
+    {
+        return g_functions.m_IsInstancingSupported(context);
+    }
+    void EnableInstanceVertexDeclaration(HContext context, HVertexDeclaration vertex_declaration, HVertexBuffer vertex_buffer, HProgram program)
+    {
+        g_functions.m_EnableInstanceVertexDeclaration(context, vertex_declaration, vertex_buffer, program);
+    }
+    void DisableInstanceVertexDeclaration(HContext context, HVertexDeclaration vertex_declaration)
+    {
+        g_functions.m_DisableInstanceVertexDeclaration(context, vertex_declaration);
+    }
+    void DrawElementsInstanced(HContext context, PrimitiveType prim_type, uint32_t first, uint32_t count, Type type, HIndexBuffer index_buffer, uint32_t instance_count)
+    {
+        g_functions.m_DrawElementsInstanced(context, prim_type, first, count, type, index_buffer, instance_count);
+    }
+    void DrawInstanced(HContext context, PrimitiveType prim_type, uint32_t first, uint32_t count, uint32_t instance_count)
+    {
+        g_functions.m_DrawInstanced(context, prim_type, first, count, instance_count);
+    }
     HVertexProgram NewVertexProgram(HContext context, ShaderDesc::Shader* ddf)
     {
         return g_functions.m_NewVertexProgram(context, ddf);
@@ -403,6 +423,10 @@ namespace dmGraphics
     {
         return g_functions.m_GetUniformLocation(prog, name);
     }
+    int32_t GetAttributeLocation(HProgram prog, const char* name)
+    {
+        return g_functions.m_GetAttributeLocation(prog, name);
+    }
     void SetConstantV4(HContext context, const Vectormath::Aos::Vector4* data, int base_register)
     {
         g_functions.m_SetConstantV4(context, data, base_register);
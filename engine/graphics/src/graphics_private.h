@@ -19,8 +19,15 @@
 namespace dmGraphics
 {
     uint64_t GetDrawCount();
+    uint64_t GetStateChangeCount();
+    uint64_t GetInstanceCount();
     void SetForceFragmentReloadFail(bool should_fail);
     void SetForceVertexReloadFail(bool should_fail);
+    void SetTextureFormatSupport(HContext context, TextureFormat format, bool supported);
+    void SetInstancingSupport(HContext context, bool supported);
+    TextureFormat GetTextureFormat(HTexture texture);
+    // Bytes uploaded for the current mip chain of the texture
+    uint32_t GetTextureMipMapDataSize(HTexture texture);
     uint32_t GetTextureFormatBPP(TextureFormat format);
 }
 
@@ -20,7 +20,10 @@ namespace dmGraphics
 {
     typedef void (*UniformCallback)(const char* name, uint32_t name_length, Type type, uintptr_t userdata);
 
+    typedef void (*AttributeCallback)(const char* name, uint32_t name_length, uintptr_t userdata);
+
     bool GLSLUniformParse(const char* buffer, UniformCallback cb, uintptr_t userdata);
+    bool GLSLAttributeParse(const char* buffer, AttributeCallback cb, uintptr_t userdata);
 }
 
 #endif // DMGRAPHICS_GLSL_UNIFORM_PARSER_H
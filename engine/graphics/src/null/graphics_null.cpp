@@ -28,6 +28,8 @@
 using namespace Vectormath::Aos;
 
 uint64_t g_DrawCount = 0;
+uint64_t g_StateChangeCount = 0;
+uint64_t g_InstanceCount = 0;
 uint64_t g_Flipped = 0;
 
 // Used only for tests
@@ -56,6 +58,24 @@ namespace dmGraphics
 
     DM_REGISTER_GRAPHICS_ADAPTER(GraphicsAdapterNull, &g_null_adapter, NullIsSupported, NullRegisterFunctionTable, g_null_adapter_priority);
 
+    // The draw and state change counters are reset by the first call after a flip
+    static void ResetCountersIfFlipped()
+    {
+        if (g_Flipped)
+        {
+            g_Flipped = 0;
+            g_DrawCount = 0;
+            g_StateChangeCount = 0;
+            g_InstanceCount = 0;
+        }
+    }
+
+    static inline void CountStateChange()
+    {
+        ResetCountersIfFlipped();
+        g_StateChangeCount++;
+    }
+
     static bool NullInitialize()
     {
         return true;
@@ -78,6 +98,7 @@ namespace dmGraphics
         m_TextureFormatSupport |= 1 << TEXTURE_FORMAT_RGB_16BPP;
         m_TextureFormatSupport |= 1 << TEXTURE_FORMAT_RGBA_16BPP;
         m_TextureFormatSupport |= 1 << TEXTURE_FORMAT_RGB_ETC1;
+        m_InstancingSupport = 1;
     }
 
     static HContext NullNewContext(const ContextParams& params)
@@ -514,6 +535,7 @@ namespace dmGraphics
     static void NullEnableVertexDeclaration(HContext context, HVertexDeclaration vertex_declaration, HVertexBuffer vertex_buffer)
     {
         assert(context);
+        CountStateChange();
         assert(vertex_declaration);
         assert(vertex_buffer);
         VertexBuffer* vb = (VertexBuffer*)vertex_buffer;
@@ -540,6 +562,7 @@ namespace dmGraphics
     static void NullDisableVertexDeclaration(HContext context, HVertexDeclaration vertex_declaration)
     {
         assert(context);
+        CountStateChange();
         assert(vertex_declaration);
         for (uint32_t i = 0; i < vertex_declaration->m_Count; ++i)
             if (vertex_declaration->m_Elements[i].m_Size > 0)
@@ -606,6 +629,8 @@ namespace dmGraphics
             VertexStream& vs = context->m_VertexStreams[i];
             if (vs.m_Size > 0)
             {
+                // The stream may stay enabled for several draw calls
+                delete [] (char*)vs.m_Buffer;
                 vs.m_Buffer = new char[vs.m_Size * count];
             }
         }
@@ -620,11 +645,7 @@ namespace dmGraphics
             }
         }
 
-        if (g_Flipped)
-        {
-            g_Flipped = 0;
-            g_DrawCount = 0;
-        }
+        ResetCountersIfFlipped();
         g_DrawCount++;
     }
 
@@ -632,20 +653,64 @@ namespace dmGraphics
     {
         assert(context);
 
-        if (g_Flipped)
-        {
-            g_Flipped = 0;
-            g_DrawCount = 0;
-        }
+        ResetCountersIfFlipped();
         g_DrawCount++;
     }
 
+    static bool NullIsInstancingSupported(HContext context)
+    {
+        return context->m_InstancingSupport;
+    }
+
+    static void NullEnableInstanceVertexDeclaration(HContext context, HVertexDeclaration vertex_declaration, HVertexBuffer vertex_buffer, HProgram program)
+    {
+        assert(context);
+        assert(vertex_declaration);
+        assert(vertex_buffer);
+        assert(context->m_InstancingSupport);
+        assert(context->m_InstanceVertexDeclaration == 0x0);
+        CountStateChange();
+        context->m_InstanceVertexDeclaration = vertex_declaration;
+        context->m_InstanceVertexBuffer = vertex_buffer;
+    }
+
+    static void NullDisableInstanceVertexDeclaration(HContext context, HVertexDeclaration vertex_declaration)
+    {
+        assert(context);
+        assert(context->m_InstanceVertexDeclaration == vertex_declaration);
+        CountStateChange();
+        context->m_InstanceVertexDeclaration = 0x0;
+        context->m_InstanceVertexBuffer = 0;
+    }
+
+    static void NullDrawElementsInstanced(HContext context, PrimitiveType prim_type, uint32_t first, uint32_t count, Type type, HIndexBuffer index_buffer, uint32_t instance_count)
+    {
+        NullDrawElements(context, prim_type, first, count, type, index_buffer);
+        g_InstanceCount += instance_count;
+    }
+
+    static void NullDrawInstanced(HContext context, PrimitiveType prim_type, uint32_t first, uint32_t count, uint32_t instance_count)
+    {
+        NullDraw(context, prim_type, first, count);
+        g_InstanceCount += instance_count;
+    }
+
     // For tests
     uint64_t GetDrawCount()
     {
         return g_DrawCount;
     }
 
+    uint64_t GetStateChangeCount()
+    {
+        return g_StateChangeCount;
+    }
+
+    uint64_t GetInstanceCount()
+    {
+        return g_InstanceCount;
+    }
+
     struct VertexProgram
     {
         char* m_Data;
@@ -657,6 +722,7 @@ namespace dmGraphics
     };
 
     static void NullUniformCallback(const char* name, uint32_t name_length, dmGraphics::Type type, uintptr_t userdata);
+    static void NullAttributeCallback(const char* name, uint32_t name_length, uintptr_t userdata);
 
     struct Uniform
     {
@@ -674,7 +740,10 @@ namespace dmGraphics
             m_VP = vp;
             m_FP = fp;
             if (m_VP != 0x0)
+            {
                 GLSLUniformParse(m_VP->m_Data, NullUniformCallback, (uintptr_t)this);
+                GLSLAttributeParse(m_VP->m_Data, NullAttributeCallback, (uintptr_t)this);
+            }
             if (m_FP != 0x0)
                 GLSLUniformParse(m_FP->m_Data, NullUniformCallback, (uintptr_t)this);
         }
@@ -683,11 +752,14 @@ namespace dmGraphics
         {
             for(uint32_t i = 0; i < m_Uniforms.Size(); ++i)
                 delete[] m_Uniforms[i].m_Name;
+            for(uint32_t i = 0; i < m_Attributes.Size(); ++i)
+                delete[] m_Attributes[i];
         }
 
         VertexProgram* m_VP;
         FragmentProgram* m_FP;
         dmArray<Uniform> m_Uniforms;
+        dmArray<char*> m_Attributes;
     };
 
     static void NullUniformCallback(const char* name, uint32_t name_length, dmGraphics::Type type, uintptr_t userdata)
@@ -704,6 +776,17 @@ namespace dmGraphics
         program->m_Uniforms.Push(uniform);
     }
 
+    static void NullAttributeCallback(const char* name, uint32_t name_length, uintptr_t userdata)
+    {
+        Program* program = (Program*) userdata;
+        if(program->m_Attributes.Full())
+            program->m_Attributes.OffsetCapacity(8);
+        name_length++;
+        char* attribute_name = new char[name_length];
+        dmStrlCpy(attribute_name, name, name_length);
+        program->m_Attributes.Push(attribute_name);
+    }
+
     static HProgram NullNewProgram(HContext context, HVertexProgram vertex_program, HFragmentProgram fragment_program)
     {
         VertexProgram* vertex = 0x0;
@@ -786,12 +869,14 @@ namespace dmGraphics
     static void NullEnableProgram(HContext context, HProgram program)
     {
         assert(context);
+        CountStateChange();
         context->m_Program = (void*)program;
     }
 
     static void NullDisableProgram(HContext context)
     {
         assert(context);
+        CountStateChange();
         context->m_Program = 0x0;
     }
 
@@ -834,6 +919,20 @@ namespace dmGraphics
         return -1;
     }
 
+    static int32_t NullGetAttributeLocation(HProgram prog, const char* name)
+    {
+        Program* program = (Program*)prog;
+        uint32_t count = program->m_Attributes.Size();
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (strcmp(program->m_Attributes[i], name) == 0)
+            {
+                return (int32_t)i;
+            }
+        }
+        return -1;
+    }
+
     static void NullSetViewport(HContext context, int32_t x, int32_t y, int32_t width, int32_t height)
     {
         assert(context);
@@ -850,6 +949,7 @@ namespace dmGraphics
     static void NullSetConstantV4(HContext context, const Vector4* data, int base_register)
     {
         assert(context);
+        CountStateChange();
         assert(context->m_Program != 0x0);
         memcpy(&context->m_ProgramRegisters[base_register], data, sizeof(Vector4));
     }
@@ -857,12 +957,14 @@ namespace dmGraphics
     static void NullSetConstantM4(HContext context, const Vector4* data, int base_register)
     {
         assert(context);
+        CountStateChange();
         assert(context->m_Program != 0x0);
         memcpy(&context->m_ProgramRegisters[base_register], data, sizeof(Vector4) * 4);
     }
 
     static void NullSetSampler(HContext context, int32_t location, int32_t unit)
     {
+        CountStateChange();
     }
 
     static HRenderTarget NullNewRenderTarget(HContext context, uint32_t buffer_type_flags, const TextureCreationParams creation_params[MAX_BUFFER_TYPE_COUNT], const TextureParams params[MAX_BUFFER_TYPE_COUNT])
@@ -974,6 +1076,7 @@ namespace dmGraphics
         tex->m_Width = params.m_Width;
         tex->m_Height = params.m_Height;
         tex->m_MipMapCount = 0;
+        tex->m_MipMapDataSize = 0;
         tex->m_Data = 0;
 
         if (params.m_OriginalWidth == 0) {
@@ -1011,6 +1114,7 @@ namespace dmGraphics
     static void NullSetTextureParams(HTexture texture, TextureFilter minfilter, TextureFilter magfilter, TextureWrap uwrap, TextureWrap vwrap)
     {
         assert(texture);
+        CountStateChange();
     }
 
     static void NullSetTexture(HTexture texture, const TextureParams& params)
@@ -1026,7 +1130,16 @@ namespace dmGraphics
         texture->m_Data = new char[params.m_DataSize];
         if (params.m_Data != 0x0)
             memcpy(texture->m_Data, params.m_Data, params.m_DataSize);
+        if (!params.m_SubUpdate && params.m_MipMap == 0)
+        {
+            // A new first mip starts a new mip chain, possibly of another size
+            texture->m_Width = params.m_Width;
+            texture->m_Height = params.m_Height;
+            texture->m_MipMapCount = 0;
+            texture->m_MipMapDataSize = 0;
+        }
         texture->m_MipMapCount = dmMath::Max(texture->m_MipMapCount, (uint16_t)(params.m_MipMap+1));
+        texture->m_MipMapDataSize += params.m_DataSize;
     }
 
     // Not used?
@@ -1070,6 +1183,7 @@ namespace dmGraphics
     static void NullEnableTexture(HContext context, uint32_t unit, HTexture texture)
     {
         assert(context);
+        CountStateChange();
         assert(unit < MAX_TEXTURE_COUNT);
         assert(texture);
         assert(texture->m_Data);
@@ -1079,6 +1193,7 @@ namespace dmGraphics
     static void NullDisableTexture(HContext context, uint32_t unit, HTexture texture)
     {
         assert(context);
+        CountStateChange();
         assert(unit < MAX_TEXTURE_COUNT);
         context->m_Textures[unit] = 0;
     }
@@ -1094,21 +1209,25 @@ namespace dmGraphics
     static void NullEnableState(HContext context, State state)
     {
         assert(context);
+        CountStateChange();
     }
 
     static void NullDisableState(HContext context, State state)
     {
         assert(context);
+        CountStateChange();
     }
 
     static void NullSetBlendFunc(HContext context, BlendFactor source_factor, BlendFactor destinaton_factor)
     {
         assert(context);
+        CountStateChange();
     }
 
     static void NullSetColorMask(HContext context, bool red, bool green, bool blue, bool alpha)
     {
         assert(context);
+        CountStateChange();
         context->m_RedMask = red;
         context->m_GreenMask = green;
         context->m_BlueMask = blue;
@@ -1139,12 +1258,14 @@ namespace dmGraphics
     static void NullSetStencilMask(HContext context, uint32_t mask)
     {
         assert(context);
+        CountStateChange();
         context->m_StencilMask = mask;
     }
 
     static void NullSetStencilFunc(HContext context, CompareFunc func, uint32_t ref, uint32_t mask)
     {
         assert(context);
+        CountStateChange();
         context->m_StencilFunc = func;
         context->m_StencilFuncRef = ref;
         context->m_StencilFuncMask = mask;
@@ -1153,6 +1274,7 @@ namespace dmGraphics
     static void NullSetStencilOp(HContext context, StencilOp sfail, StencilOp dpfail, StencilOp dppass)
     {
         assert(context);
+        CountStateChange();
         context->m_StencilOpSFail = sfail;
         context->m_StencilOpDPFail = dpfail;
         context->m_StencilOpDPPass = dppass;
@@ -1202,6 +1324,31 @@ namespace dmGraphics
         g_ForceVertexReloadFail = should_fail;
     }
 
+    // Tests only
+    void SetTextureFormatSupport(HContext context, TextureFormat format, bool supported)
+    {
+        if (supported)
+            context->m_TextureFormatSupport |= 1 << format;
+        else
+            context->m_TextureFormatSupport &= ~(1 << format);
+    }
+
+    void SetInstancingSupport(HContext context, bool supported)
+    {
+        context->m_InstancingSupport = supported;
+    }
+
+    // Tests only
+    TextureFormat GetTextureFormat(HTexture texture)
+    {
+        return texture->m_Format;
+    }
+
+    uint32_t GetTextureMipMapDataSize(HTexture texture)
+    {
+        return texture->m_MipMapDataSize;
+    }
+
     static GraphicsAdapterFunctionTable NullRegisterFunctionTable()
     {
         GraphicsAdapterFunctionTable fn_table;
@@ -1251,6 +1398,11 @@ namespace dmGraphics
         fn_table.m_HashVertexDeclaration = NullHashVertexDeclaration;
         fn_table.m_DrawElements = NullDrawElements;
         fn_table.m_Draw = NullDraw;
+        fn_table.m_IsInstancingSupported = NullIsInstancingSupported;
+        fn_table.m_EnableInstanceVertexDeclaration = NullEnableInstanceVertexDeclaration;
+        fn_table.m_DisableInstanceVertexDeclaration = NullDisableInstanceVertexDeclaration;
+        fn_table.m_DrawElementsInstanced = NullDrawElementsInstanced;
+        fn_table.m_DrawInstanced = NullDrawInstanced;
         fn_table.m_NewVertexProgram = NullNewVertexProgram;
         fn_table.m_NewFragmentProgram = NullNewFragmentProgram;
         fn_table.m_NewProgram = NullNewProgram;
@@ -1266,6 +1418,7 @@ namespace dmGraphics
         fn_table.m_GetUniformName = NullGetUniformName;
         fn_table.m_GetUniformCount = NullGetUniformCount;
         fn_table.m_GetUniformLocation = NullGetUniformLocation;
+        fn_table.m_GetAttributeLocation = NullGetAttributeLocation;
         fn_table.m_SetConstantV4 = NullSetConstantV4;
         fn_table.m_SetConstantM4 = NullSetConstantM4;
         fn_table.m_SetSampler = NullSetSampler;
@@ -23,6 +23,7 @@ namespace dmGraphics
         uint32_t m_Height;
         uint32_t m_OriginalWidth;
         uint32_t m_OriginalHeight;
+        uint32_t m_MipMapDataSize;
         uint16_t m_MipMapCount;
     };
 
@@ -85,6 +86,8 @@ namespace dmGraphics
         FrameBuffer                 m_MainFrameBuffer;
         FrameBuffer*                m_CurrentFrameBuffer;
         void*                       m_Program;
+        HVertexDeclaration          m_InstanceVertexDeclaration;
+        HVertexBuffer               m_InstanceVertexBuffer;
         WindowResizeCallback        m_WindowResizeCallback;
         void*                       m_WindowResizeCallbackUserData;
         WindowCloseCallback         m_WindowCloseCallback;
@@ -114,6 +117,7 @@ namespace dmGraphics
         uint32_t                    m_BlueMask : 1;
         uint32_t                    m_AlphaMask : 1;
         uint32_t                    m_DepthMask : 1;
+        uint32_t                    m_InstancingSupport : 1;
         // Only use for testing
         uint32_t                    m_RequestWindowClose : 1;
     };
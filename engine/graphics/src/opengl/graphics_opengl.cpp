@@ -331,6 +331,12 @@ static void LogFrameBufferError(GLenum status)
     // The alternative is a matrix of conditional typedefs, linked statically/dynamically or core. OpenGL function prototypes does not change, so this is safe.
     typedef void (* DM_PFNGLINVALIDATEFRAMEBUFFERPROC) (GLenum target, GLsizei numAttachments, const GLenum *attachments);
     DM_PFNGLINVALIDATEFRAMEBUFFERPROC PFN_glInvalidateFramebuffer = NULL;
+    typedef void (* DM_PFNGLVERTEXATTRIBDIVISORPROC) (GLuint index, GLuint divisor);
+    DM_PFNGLVERTEXATTRIBDIVISORPROC PFN_glVertexAttribDivisor = NULL;
+    typedef void (* DM_PFNGLDRAWELEMENTSINSTANCEDPROC) (GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount);
+    DM_PFNGLDRAWELEMENTSINSTANCEDPROC PFN_glDrawElementsInstanced = NULL;
+    typedef void (* DM_PFNGLDRAWARRAYSINSTANCEDPROC) (GLenum mode, GLint first, GLsizei count, GLsizei instancecount);
+    DM_PFNGLDRAWARRAYSINSTANCEDPROC PFN_glDrawArraysInstanced = NULL;
 
     Context* g_Context = 0x0;
 
@@ -871,6 +877,10 @@ static uintptr_t GetExtProcAddress(const char* name, const char* extension_name,
 #endif
 
         DMGRAPHICS_GET_PROC_ADDRESS_EXT(PFN_glInvalidateFramebuffer, "glDiscardFramebuffer", "discard_framebuffer", "glInvalidateFramebuffer", DM_PFNGLINVALIDATEFRAMEBUFFERPROC, extensions);
+        DMGRAPHICS_GET_PROC_ADDRESS_EXT(PFN_glVertexAttribDivisor, "glVertexAttribDivisor", "instanced_arrays", "glVertexAttribDivisor", DM_PFNGLVERTEXATTRIBDIVISORPROC, extensions);
+        DMGRAPHICS_GET_PROC_ADDRESS_EXT(PFN_glDrawElementsInstanced, "glDrawElementsInstanced", "draw_instanced", "glDrawElementsInstanced", DM_PFNGLDRAWELEMENTSINSTANCEDPROC, extensions);
+        DMGRAPHICS_GET_PROC_ADDRESS_EXT(PFN_glDrawArraysInstanced, "glDrawArraysInstanced", "draw_instanced", "glDrawArraysInstanced", DM_PFNGLDRAWARRAYSINSTANCEDPROC, extensions);
+        context->m_InstancingSupport = PFN_glVertexAttribDivisor != 0x0 && PFN_glDrawElementsInstanced != 0x0 && PFN_glDrawArraysInstanced != 0x0;
 
         if (IsExtensionSupported("GL_IMG_texture_compression_pvrtc", extensions))
         {
@@ -1435,6 +1445,70 @@ static uintptr_t GetExtProcAddress(const char* name, const char* extension_name,
         CHECK_GL_ERROR;
     }
 
+    static bool OpenGLIsInstancingSupported(HContext context)
+    {
+        assert(context);
+        return context->m_InstancingSupport;
+    }
+
+    static void OpenGLEnableInstanceVertexDeclaration(HContext context, HVertexDeclaration vertex_declaration, HVertexBuffer vertex_buffer, HProgram program)
+    {
+        assert(context);
+        assert(context->m_InstancingSupport);
+        assert(vertex_buffer);
+        assert(vertex_declaration);
+
+        if (!(context->m_ModificationVersion == vertex_declaration->m_ModificationVersion && vertex_declaration->m_BoundForProgram == program))
+        {
+            BindVertexDeclarationProgram(context, vertex_declaration, program);
+        }
+
+        #define BUFFER_OFFSET(i) ((char*)0x0 + (i))
+
+        glBindBufferARB(GL_ARRAY_BUFFER, vertex_buffer);
+        CHECK_GL_ERROR;
+
+        for (uint32_t i=0; i<vertex_declaration->m_StreamCount; i++)
+        {
+            if (vertex_declaration->m_Streams[i].m_PhysicalIndex != -1)
+            {
+                glEnableVertexAttribArray(vertex_declaration->m_Streams[i].m_PhysicalIndex);
+                CHECK_GL_ERROR;
+                glVertexAttribPointer(
+                        vertex_declaration->m_Streams[i].m_PhysicalIndex,
+                        vertex_declaration->m_Streams[i].m_Size,
+                        GetOpenGLType(vertex_declaration->m_Streams[i].m_Type),
+                        vertex_declaration->m_Streams[i].m_Normalize,
+                        vertex_declaration->m_Stride,
+                BUFFER_OFFSET(vertex_declaration->m_Streams[i].m_Offset) );
+                CHECK_GL_ERROR;
+                // Advance the stream once per instance rather than once per vertex
+                PFN_glVertexAttribDivisor(vertex_declaration->m_Streams[i].m_PhysicalIndex, 1);
+                CHECK_GL_ERROR;
+            }
+        }
+
+        #undef BUFFER_OFFSET
+    }
+
+    static void OpenGLDisableInstanceVertexDeclaration(HContext context, HVertexDeclaration vertex_declaration)
+    {
+        assert(context);
+        assert(vertex_declaration);
+
+        // The attribute locations are shared with regular vertex streams, so the divisor must be reset
+        for (uint32_t i=0; i<vertex_declaration->m_StreamCount; i++)
+        {
+            if (vertex_declaration->m_Streams[i].m_PhysicalIndex != -1)
+            {
+                PFN_glVertexAttribDivisor(vertex_declaration->m_Streams[i].m_PhysicalIndex, 0);
+                CHECK_GL_ERROR;
+                glDisableVertexAttribArray(vertex_declaration->m_Streams[i].m_PhysicalIndex);
+                CHECK_GL_ERROR;
+            }
+        }
+    }
+
     void OpenGLHashVertexDeclaration(HashState32 *state, HVertexDeclaration vertex_declaration)
     {
         uint16_t stream_count = vertex_declaration->m_StreamCount;
@@ -1477,6 +1551,31 @@ static uintptr_t GetExtProcAddress(const char* name, const char* extension_name,
         CHECK_GL_ERROR
     }
 
+    static void OpenGLDrawElementsInstanced(HContext context, PrimitiveType prim_type, uint32_t first, uint32_t count, Type type, HIndexBuffer index_buffer, uint32_t instance_count)
+    {
+        assert(context);
+        assert(context->m_InstancingSupport);
+        assert(index_buffer);
+        DM_PROFILE(Graphics, "DrawElementsInstanced");
+        DM_COUNTER("DrawCalls", 1);
+
+        glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+        CHECK_GL_ERROR;
+
+        PFN_glDrawElementsInstanced(GetOpenGLPrimitiveType(prim_type), count, GetOpenGLType(type), (GLvoid*)(uintptr_t) first, instance_count);
+        CHECK_GL_ERROR
+    }
+
+    static void OpenGLDrawInstanced(HContext context, PrimitiveType prim_type, uint32_t first, uint32_t count, uint32_t instance_count)
+    {
+        assert(context);
+        assert(context->m_InstancingSupport);
+        DM_PROFILE(Graphics, "DrawInstanced");
+        DM_COUNTER("DrawCalls", 1);
+        PFN_glDrawArraysInstanced(GetOpenGLPrimitiveType(prim_type), first, count, instance_count);
+        CHECK_GL_ERROR
+    }
+
     static uint32_t CreateShader(GLenum type, const void* program, uint32_t program_size)
     {
         GLuint s = glCreateShader(type);
@@ -1732,6 +1831,17 @@ static uintptr_t GetExtProcAddress(const char* name, const char* extension_name,
         return (uint32_t)uniform_name_length;
     }
 
+    static int32_t OpenGLGetAttributeLocation(HProgram prog, const char* name)
+    {
+        GLint location = glGetAttribLocation(prog, name);
+        if (location == -1)
+        {
+            // Clear error if attribute isn't found
+            CLEAR_GL_ERROR
+        }
+        return (int32_t) location;
+    }
+
     static int32_t OpenGLGetUniformLocation(HProgram prog, const char* name)
     {
         GLint location = glGetUniformLocation(prog, name);
@@ -2250,6 +2360,11 @@ static uintptr_t GetExtProcAddress(const char* name, const char* extension_name,
             glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
             CHECK_GL_ERROR;
         }
+        // A new first mip starts a new mip chain, possibly of another size
+        if (!params.m_SubUpdate && params.m_MipMap == 0)
+        {
+            texture->m_MipMapCount = 0;
+        }
         texture->m_MipMapCount = dmMath::Max(texture->m_MipMapCount, (uint16_t)(params.m_MipMap+1));
 
         GLenum type = GetOpenGLTextureType(texture->m_Type);
@@ -2829,6 +2944,11 @@ static uintptr_t GetExtProcAddress(const char* name, const char* extension_name,
         fn_table.m_HashVertexDeclaration = OpenGLHashVertexDeclaration;
         fn_table.m_DrawElements = OpenGLDrawElements;
         fn_table.m_Draw = OpenGLDraw;
+        fn_table.m_IsInstancingSupported = OpenGLIsInstancingSupported;
+        fn_table.m_EnableInstanceVertexDeclaration = OpenGLEnableInstanceVertexDeclaration;
+        fn_table.m_DisableInstanceVertexDeclaration = OpenGLDisableInstanceVertexDeclaration;
+        fn_table.m_DrawElementsInstanced = OpenGLDrawElementsInstanced;
+        fn_table.m_DrawInstanced = OpenGLDrawInstanced;
         fn_table.m_NewVertexProgram = OpenGLNewVertexProgram;
         fn_table.m_NewFragmentProgram = OpenGLNewFragmentProgram;
         fn_table.m_NewProgram = OpenGLNewProgram;
@@ -2844,6 +2964,7 @@ static uintptr_t GetExtProcAddress(const char* name, const char* extension_name,
         fn_table.m_GetUniformName = OpenGLGetUniformName;
         fn_table.m_GetUniformCount = OpenGLGetUniformCount;
         fn_table.m_GetUniformLocation = OpenGLGetUniformLocation;
+        fn_table.m_GetAttributeLocation = OpenGLGetAttributeLocation;
         fn_table.m_SetConstantV4 = OpenGLSetConstantV4;
         fn_table.m_SetConstantM4 = OpenGLSetConstantM4;
         fn_table.m_SetSampler = OpenGLSetSampler;
@@ -1266,13 +1266,17 @@ bail:
 
     static Pipeline* GetOrCreatePipeline(VkDevice vk_device, VkSampleCountFlagBits vk_sample_count,
         const PipelineState pipelineState, PipelineCache& pipelineCache,
-        Program* program, RenderTarget* rt, DeviceBuffer* vertexBuffer, HVertexDeclaration vertexDeclaration)
+        Program* program, RenderTarget* rt, DeviceBuffer* vertexBuffer, HVertexDeclaration vertexDeclaration, HVertexDeclaration instanceDeclaration)
     {
         HashState64 pipeline_hash_state;
         dmHashInit64(&pipeline_hash_state, false);
         dmHashUpdateBuffer64(&pipeline_hash_state, &program->m_Hash, sizeof(program->m_Hash));
         dmHashUpdateBuffer64(&pipeline_hash_state, &pipelineState, sizeof(pipelineState));
         dmHashUpdateBuffer64(&pipeline_hash_state, &vertexDeclaration->m_Hash, sizeof(vertexDeclaration->m_Hash));
+        if (instanceDeclaration)
+        {
+            dmHashUpdateBuffer64(&pipeline_hash_state, &instanceDeclaration->m_Hash, sizeof(instanceDeclaration->m_Hash));
+        }
         dmHashUpdateBuffer64(&pipeline_hash_state, &rt->m_Id, sizeof(rt->m_Id));
         dmHashUpdateBuffer64(&pipeline_hash_state, &vk_sample_count, sizeof(vk_sample_count));
         uint64_t pipeline_hash = dmHashFinal64(&pipeline_hash_state);
@@ -1289,7 +1293,7 @@ bail:
             vk_scissor.offset.x = 0;
             vk_scissor.offset.y = 0;
 
-            VkResult res = CreatePipeline(vk_device, vk_scissor, vk_sample_count, pipelineState, program, vertexBuffer, vertexDeclaration, rt->m_RenderPass, &new_pipeline);
+            VkResult res = CreatePipeline(vk_device, vk_scissor, vk_sample_count, pipelineState, program, vertexBuffer, vertexDeclaration, instanceDeclaration, rt->m_RenderPass, &new_pipeline);
             CHECK_VK_ERROR(res);
 
             if (pipelineCache.Full())
@@ -1574,11 +1578,8 @@ bail:
         context->m_CurrentVertexDeclaration = (VertexDeclaration*) vertex_declaration;
     }
 
-    static void VulkanEnableVertexDeclarationProgram(HContext context, HVertexDeclaration vertex_declaration, HVertexBuffer vertex_buffer, HProgram program)
+    static void MapVertexDeclarationLocations(HVertexDeclaration vertex_declaration, Program* program_ptr)
     {
-        Program* program_ptr = (Program*) program;
-        VulkanEnableVertexDeclaration(context, vertex_declaration, vertex_buffer);
-
         for (uint32_t i=0; i < vertex_declaration->m_StreamCount; i++)
         {
             VertexDeclaration::Stream& stream = vertex_declaration->m_Streams[i];
@@ -1598,11 +1599,35 @@ bail:
         }
     }
 
+    static void VulkanEnableVertexDeclarationProgram(HContext context, HVertexDeclaration vertex_declaration, HVertexBuffer vertex_buffer, HProgram program)
+    {
+        VulkanEnableVertexDeclaration(context, vertex_declaration, vertex_buffer);
+        MapVertexDeclarationLocations(vertex_declaration, (Program*) program);
+    }
+
     static void VulkanDisableVertexDeclaration(HContext context, HVertexDeclaration vertex_declaration)
     {
         context->m_CurrentVertexDeclaration = 0;
     }
 
+    static bool VulkanIsInstancingSupported(HContext context)
+    {
+        return true;
+    }
+
+    static void VulkanEnableInstanceVertexDeclaration(HContext context, HVertexDeclaration vertex_declaration, HVertexBuffer vertex_buffer, HProgram program)
+    {
+        context->m_CurrentInstanceVertexBuffer      = (DeviceBuffer*) vertex_buffer;
+        context->m_CurrentInstanceVertexDeclaration = (VertexDeclaration*) vertex_declaration;
+        MapVertexDeclarationLocations(vertex_declaration, (Program*) program);
+    }
+
+    static void VulkanDisableInstanceVertexDeclaration(HContext context, HVertexDeclaration vertex_declaration)
+    {
+        context->m_CurrentInstanceVertexBuffer      = 0;
+        context->m_CurrentInstanceVertexDeclaration = 0;
+    }
+
     static inline bool IsUniformTextureSampler(ShaderResourceBinding uniform)
     {
         return uniform.m_Type == ShaderDesc::SHADER_TYPE_SAMPLER2D ||
@@ -1878,7 +1903,7 @@ bail:
         Pipeline* pipeline = GetOrCreatePipeline(vk_device, vk_sample_count,
             context->m_PipelineState, context->m_PipelineCache,
             program_ptr, context->m_CurrentRenderTarget,
-            vertex_buffer, context->m_CurrentVertexDeclaration);
+            vertex_buffer, context->m_CurrentVertexDeclaration, context->m_CurrentInstanceVertexDeclaration);
         vkCmdBindPipeline(vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *pipeline);
 
 
@@ -1900,6 +1925,12 @@ bail:
         VkBuffer vk_vertex_buffer             = vertex_buffer->m_Handle.m_Buffer;
         VkDeviceSize vk_vertex_buffer_offsets = 0;
         vkCmdBindVertexBuffers(vk_command_buffer, 0, 1, &vk_vertex_buffer, &vk_vertex_buffer_offsets);
+
+        if (context->m_CurrentInstanceVertexDeclaration)
+        {
+            VkBuffer vk_instance_buffer = context->m_CurrentInstanceVertexBuffer->m_Handle.m_Buffer;
+            vkCmdBindVertexBuffers(vk_command_buffer, 1, 1, &vk_instance_buffer, &vk_vertex_buffer_offsets);
+        }
     }
 
     void VulkanHashVertexDeclaration(HashState32 *state, HVertexDeclaration vertex_declaration)
@@ -1931,6 +1962,32 @@ bail:
         vkCmdDrawIndexed(vk_command_buffer, count, 1, index_offset, 0, 0);
     }
 
+    static void VulkanDrawElementsInstanced(HContext context, PrimitiveType prim_type, uint32_t first, uint32_t count, Type type, HIndexBuffer index_buffer, uint32_t instance_count)
+    {
+        assert(context->m_FrameBegun);
+        DM_PROFILE(Graphics, "DrawElementsInstanced");
+        DM_COUNTER("DrawCalls", 1);
+        const uint8_t image_ix = context->m_SwapChain->m_ImageIndex;
+        VkCommandBuffer vk_command_buffer = context->m_MainCommandBuffers[image_ix];
+        context->m_PipelineState.m_PrimtiveType = prim_type;
+        DrawSetup(context, vk_command_buffer, &context->m_MainScratchBuffers[image_ix], (DeviceBuffer*) index_buffer, type);
+
+        uint32_t index_offset = first / (type == TYPE_UNSIGNED_SHORT ? 2 : 4);
+        vkCmdDrawIndexed(vk_command_buffer, count, instance_count, index_offset, 0, 0);
+    }
+
+    static void VulkanDrawInstanced(HContext context, PrimitiveType prim_type, uint32_t first, uint32_t count, uint32_t instance_count)
+    {
+        assert(context->m_FrameBegun);
+        DM_PROFILE(Graphics, "DrawInstanced");
+        DM_COUNTER("DrawCalls", 1);
+        const uint8_t image_ix = context->m_SwapChain->m_ImageIndex;
+        VkCommandBuffer vk_command_buffer = context->m_MainCommandBuffers[image_ix];
+        context->m_PipelineState.m_PrimtiveType = prim_type;
+        DrawSetup(context, vk_command_buffer, &context->m_MainScratchBuffers[image_ix], 0, TYPE_BYTE);
+        vkCmdDraw(vk_command_buffer, count, instance_count, first, 0);
+    }
+
     static void VulkanDraw(HContext context, PrimitiveType prim_type, uint32_t first, uint32_t count)
     {
         assert(context->m_FrameBegun);
@@ -2369,6 +2426,21 @@ bail:
         return false;
     }
 
+    static int32_t VulkanGetAttributeLocation(HProgram prog, const char* name)
+    {
+        assert(prog);
+        ShaderModule* vs = ((Program*) prog)->m_VertexModule;
+        dmhash_t name_hash = dmHashString64(name);
+        for (uint32_t i=0; i < vs->m_AttributeCount; i++)
+        {
+            if (vs->m_Attributes[i].m_NameHash == name_hash)
+            {
+                return (int32_t) vs->m_Attributes[i].m_Binding;
+            }
+        }
+        return -1;
+    }
+
     static int32_t VulkanGetUniformLocation(HProgram prog, const char* name)
     {
         assert(prog);
@@ -3115,6 +3187,23 @@ bail:
             tex_bpp       = bpp_new;
         }
 
+        // A first mip of another size starts a new mip chain, e.g. when texture streaming changes the resolution.
+        // Vulkan images can't grow more mips later, so the image is recreated with a full chain for the new size
+        // (or a single mip if the texture has no mipmaps)
+        bool new_mip_chain = !params.m_SubUpdate && params.m_MipMap == 0 &&
+            (texture->m_Width != params.m_Width || texture->m_Height != params.m_Height);
+        if (new_mip_chain && texture->m_MipMapCount > 1)
+        {
+            uint32_t size = dmMath::Max(params.m_Width, params.m_Height);
+            uint16_t mipmap_count = 1;
+            while (size > 1)
+            {
+                size >>= 1;
+                mipmap_count++;
+            }
+            texture->m_MipMapCount = mipmap_count;
+        }
+
         tex_data_size             = tex_bpp * params.m_Width * params.m_Height * tex_layer_count;
         texture->m_GraphicsFormat = params.m_Format;
         texture->m_MipMapCount    = dmMath::Max(texture->m_MipMapCount, (uint16_t)(params.m_MipMap+1));
@@ -3128,10 +3217,12 @@ bail:
         }
         else if (params.m_MipMap == 0)
         {
-            if (texture->m_Format != vk_format || texture->m_Width != params.m_Width || texture->m_Height != params.m_Height)
+            if (texture->m_Format != vk_format || new_mip_chain)
             {
                 DestroyResourceDeferred(g_VulkanContext->m_MainResourcesToDestroy[g_VulkanContext->m_SwapChain->m_ImageIndex], texture);
                 texture->m_Format = vk_format;
+                texture->m_Width  = params.m_Width;
+                texture->m_Height = params.m_Height;
             }
         }
 
@@ -3333,6 +3424,11 @@ bail:
         fn_table.m_HashVertexDeclaration = VulkanHashVertexDeclaration;
         fn_table.m_DrawElements = VulkanDrawElements;
         fn_table.m_Draw = VulkanDraw;
+        fn_table.m_IsInstancingSupported = VulkanIsInstancingSupported;
+        fn_table.m_EnableInstanceVertexDeclaration = VulkanEnableInstanceVertexDeclaration;
+        fn_table.m_DisableInstanceVertexDeclaration = VulkanDisableInstanceVertexDeclaration;
+        fn_table.m_DrawElementsInstanced = VulkanDrawElementsInstanced;
+        fn_table.m_DrawInstanced = VulkanDrawInstanced;
         fn_table.m_NewVertexProgram = VulkanNewVertexProgram;
         fn_table.m_NewFragmentProgram = VulkanNewFragmentProgram;
         fn_table.m_NewProgram = VulkanNewProgram;
@@ -3348,6 +3444,7 @@ bail:
         fn_table.m_GetUniformName = VulkanGetUniformName;
         fn_table.m_GetUniformCount = VulkanGetUniformCount;
         fn_table.m_GetUniformLocation = VulkanGetUniformLocation;
+        fn_table.m_GetAttributeLocation = VulkanGetAttributeLocation;
         fn_table.m_SetConstantV4 = VulkanSetConstantV4;
         fn_table.m_SetConstantM4 = VulkanSetConstantM4;
         fn_table.m_SetSampler = VulkanSetSampler;
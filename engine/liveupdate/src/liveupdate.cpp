@@ -154,7 +154,12 @@ namespace dmLiveUpdate
 
         CreateResourceHash(algorithm, data, data_length, digest);
 
-        uint32_t hexDigestLength = digestLength * 2 + 1;
+        return VerifyResourceDigest(algorithm, digest, expected, expected_length);
+    }
+
+    Result VerifyResourceDigest(dmLiveUpdateDDF::HashAlgorithm algorithm, const uint8_t* digest, const char* expected, uint32_t expected_length)
+    {
+        uint32_t hexDigestLength = dmResource::HashLength(algorithm) * 2 + 1;
         char* hexDigest = (char*) alloca(hexDigestLength * sizeof(char));
 
         dmResource::BytesToHexString(digest, dmResource::HashLength(algorithm), hexDigest, hexDigestLength);
@@ -163,6 +168,36 @@ namespace dmLiveUpdate
         return comp ? RESULT_OK : RESULT_INVALID_RESOURCE;
     }
 
+    void VerifyResources(const dmResource::Manifest* manifest, ResourceVerification* verifications, uint32_t count)
+    {
+        if (count == 0)
+            return;
+
+        if (manifest == 0x0)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                verifications[i].m_Result = RESULT_INVALID_RESOURCE;
+            }
+            return;
+        }
+
+        // The calling thread hashes as well
+        dmLiveUpdateDDF::HashAlgorithm algorithm = manifest->m_DDFData->m_Header.m_ResourceHashAlgorithm;
+        HResourceVerifier verifier = NewResourceVerifier(algorithm, count - 1);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            ResourceVerification& v = verifications[i];
+            if (v.m_Resource->m_Data == 0x0)
+            {
+                v.m_Result = RESULT_INVALID_RESOURCE;
+                continue;
+            }
+            AddResourceVerification(verifier, v.m_ExpectedDigest, v.m_ExpectedDigestLength, v.m_Resource->m_Data, v.m_Resource->m_Count, 0, v.m_Digest, &v.m_Result);
+        }
+        DeleteResourceVerifier(verifier);
+    }
+
     static bool VerifyManifestSupportedEngineVersion(const dmResource::Manifest* manifest)
     {
         // Calculate running dmengine version SHA1 hash
@@ -392,16 +427,9 @@ namespace dmLiveUpdate
         }
     }
 
-    Result NewArchiveIndexWithResource(const dmResource::Manifest* manifest, const char* expected_digest, const uint32_t expected_digest_length, const dmResourceArchive::LiveUpdateResource* resource, dmResourceArchive::HArchiveIndex& out_new_index)
+    Result NewArchiveIndexBatch(const dmResource::Manifest* manifest, dmResourceArchive::HArchiveIndexBatch* out_batch)
     {
-        out_new_index = 0x0;
-        Result result = VerifyResource(manifest, expected_digest, expected_digest_length, (const char*)resource->m_Data, resource->m_Count);
-        if(RESULT_OK != result)
-        {
-            dmLogError("Verification failure for Liveupdate archive for resource: %s", expected_digest);
-            return result;
-        }
-
+        *out_batch = 0x0;
         char app_support_path[DMPATH_MAX_PATH];
         if (dmResource::RESULT_OK != dmResource::GetApplicationSupportPath(manifest, app_support_path, (uint32_t)sizeof(app_support_path)))
         {
@@ -412,20 +440,40 @@ namespace dmLiveUpdate
         // this call might occur before StoreManifest
         CreateFilesIfNotExists(manifest->m_ArchiveIndex, app_support_path, LIVEUPDATE_INDEX_FILENAME, LIVEUPDATE_DATA_FILENAME);
 
+        *out_batch = dmResourceArchive::NewArchiveIndexBatch(manifest->m_ArchiveIndex);
+        return RESULT_OK;
+    }
+
+    Result AddResourceToBatch(const dmResource::Manifest* manifest, dmResourceArchive::HArchiveIndexBatch batch, const uint8_t* digest, const dmResourceArchive::LiveUpdateResource* resource)
+    {
         dmLiveUpdateDDF::HashAlgorithm algorithm = manifest->m_DDFData->m_Header.m_ResourceHashAlgorithm;
         uint32_t digestLength = dmResource::HashLength(algorithm);
-        uint8_t* digest = (uint8_t*) alloca(digestLength);
 
-        CreateResourceHash(algorithm, (const char*)resource->m_Data, resource->m_Count, digest);
+        dmResourceArchive::Result res = dmResourceArchive::AddResourceToBatch(batch, digest, digestLength, resource);
+        return (res == dmResourceArchive::RESULT_OK) ? RESULT_OK : RESULT_INVALID_RESOURCE;
+    }
+
+    Result CommitArchiveIndexBatch(const dmResource::Manifest* manifest, dmResourceArchive::HArchiveIndexBatch batch, dmResourceArchive::HArchiveIndex& out_new_index)
+    {
+        out_new_index = 0x0;
+        char app_support_path[DMPATH_MAX_PATH];
+        if (dmResource::RESULT_OK != dmResource::GetApplicationSupportPath(manifest, app_support_path, (uint32_t)sizeof(app_support_path)))
+        {
+            return RESULT_IO_ERROR;
+        }
 
         char index_tmp_path[DMPATH_MAX_PATH];
         dmPath::Concat(app_support_path, LIVEUPDATE_INDEX_TMP_FILENAME, index_tmp_path, DMPATH_MAX_PATH);
 
-        dmResourceArchive::Result res = dmResourceArchive::NewArchiveIndexWithResource(manifest->m_ArchiveIndex, index_tmp_path, digest, digestLength, resource, app_support_path, out_new_index);
-
+        dmResourceArchive::Result res = dmResourceArchive::CommitArchiveIndexBatch(batch, index_tmp_path, out_new_index);
         return (res == dmResourceArchive::RESULT_OK) ? RESULT_OK : RESULT_INVALID_RESOURCE;
     }
 
+    void DeleteArchiveIndexBatch(dmResourceArchive::HArchiveIndexBatch batch)
+    {
+        dmResourceArchive::DeleteArchiveIndexBatch(batch);
+    }
+
     void SetNewArchiveIndex(dmResourceArchive::HArchiveIndexContainer archive_container, dmResourceArchive::HArchiveIndex new_index, bool mem_mapped)
     {
         dmResourceArchive::SetNewArchiveIndex(archive_container, new_index, mem_mapped);
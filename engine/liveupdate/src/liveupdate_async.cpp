@@ -19,6 +19,7 @@
 #include <dlib/mutex.h>
 #include <dlib/condition_variable.h>
 #include <dlib/array.h>
+#include <string.h>
 
 
 namespace dmLiveUpdate
@@ -38,46 +39,147 @@ namespace dmLiveUpdate
     /// job input and output queues
     static dmArray<AsyncResourceRequest> m_JobQueue;
     static dmArray<AsyncResourceRequest> m_ThreadJobQueue;
-    static AsyncResourceRequest m_TreadJob;
-    static ResourceRequestCallbackData m_JobCompleteData;
+    static dmArray<AsyncResourceRequest> m_ThreadJobs;
+    static ResourceRequestBatchData m_JobCompleteData;
+    static dmArray<ResourceVerification> m_Verifications;
 
 
-    static void ProcessRequest(AsyncResourceRequest &request)
+    // Moves the oldest requests that can be processed as one batch from the queue to the batch.
+    // A zip archive request is always processed on its own, resource requests are batched while they target the same manifest
+    static void TakeRequests(dmArray<AsyncResourceRequest>& queue, dmArray<AsyncResourceRequest>& batch)
     {
-        m_JobCompleteData.m_CallbackData = request.m_CallbackData;
-        m_JobCompleteData.m_Callback = request.m_Callback;
-        m_JobCompleteData.m_Status = false;
-        Result res = dmLiveUpdate::RESULT_OK;
-        if (request.m_IsArchive)
+        uint32_t count = 1;
+        if (!queue[0].m_IsArchive)
         {
-            // Stores/stages a zip archive for loading after next reboot
-            res = dmLiveUpdate::StoreZipArchive(request.m_Path);
-            m_JobCompleteData.m_Manifest = 0;
+            while (count < queue.Size() && !queue[count].m_IsArchive && queue[count].m_Manifest == queue[0].m_Manifest)
+                ++count;
         }
-        else if (request.m_Resource.m_Header != 0x0)
+        batch.SetSize(0);
+        if (batch.Capacity() < count)
         {
-            // Add a resource to the currently created live update archive
-            res = dmLiveUpdate::NewArchiveIndexWithResource(request.m_Manifest, request.m_ExpectedResourceDigest, request.m_ExpectedResourceDigestLength, &request.m_Resource, m_JobCompleteData.m_NewArchiveIndex);
-            m_JobCompleteData.m_Manifest = request.m_Manifest;
+            batch.SetCapacity(count);
         }
-        else
+        batch.PushArray(queue.Begin(), count);
+        memmove(queue.Begin(), queue.Begin() + count, (queue.Size() - count) * sizeof(AsyncResourceRequest));
+        queue.SetSize(queue.Size() - count);
+    }
+
+    static void ProcessRequests(dmArray<AsyncResourceRequest>& requests)
+    {
+        uint32_t count = requests.Size();
+        m_JobCompleteData.m_Callbacks.SetSize(0);
+        if (m_JobCompleteData.m_Callbacks.Capacity() < count)
+        {
+            m_JobCompleteData.m_Callbacks.SetCapacity(count);
+        }
+        m_JobCompleteData.m_Callbacks.SetSize(count);
+        m_JobCompleteData.m_NewArchiveIndex = 0x0;
+        m_JobCompleteData.m_Manifest = 0;
+
+        // Verify all resources up front, so they are hashed in parallel
+        m_Verifications.SetSize(0);
+        if (m_Verifications.Capacity() < count)
+        {
+            m_Verifications.SetCapacity(count);
+        }
+        dmResource::Manifest* manifest = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            AsyncResourceRequest& request = requests[i];
+            if (!request.m_IsArchive && request.m_Resource.m_Header != 0x0)
+            {
+                ResourceVerification v;
+                v.m_Resource = &request.m_Resource;
+                v.m_ExpectedDigest = request.m_ExpectedResourceDigest;
+                v.m_ExpectedDigestLength = request.m_ExpectedResourceDigestLength;
+                v.m_Result = dmLiveUpdate::RESULT_OK;
+                m_Verifications.Push(v);
+                manifest = request.m_Manifest;
+            }
+        }
+        dmLiveUpdate::VerifyResources(manifest, m_Verifications.Begin(), m_Verifications.Size());
+
+        dmResourceArchive::HArchiveIndexBatch batch = 0x0;
+        uint32_t batch_count = 0;
+        uint32_t verification_index = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            AsyncResourceRequest& request = requests[i];
+            ResourceRequestCallbackData& callback = m_JobCompleteData.m_Callbacks[i];
+            callback.m_CallbackData = request.m_CallbackData;
+            callback.m_Callback = request.m_Callback;
+
+            Result res = dmLiveUpdate::RESULT_OK;
+            if (request.m_IsArchive)
+            {
+                // Stores/stages a zip archive for loading after next reboot
+                res = dmLiveUpdate::StoreZipArchive(request.m_Path);
+            }
+            else if (request.m_Resource.m_Header != 0x0)
+            {
+                // Add a resource to the currently created live update archive. The archive index is only rebuilt once for the whole batch
+                ResourceVerification& v = m_Verifications[verification_index++];
+                res = v.m_Result;
+                if (res == dmLiveUpdate::RESULT_OK && !batch)
+                {
+                    res = dmLiveUpdate::NewArchiveIndexBatch(request.m_Manifest, &batch);
+                }
+                if (res == dmLiveUpdate::RESULT_OK)
+                {
+                    res = dmLiveUpdate::AddResourceToBatch(request.m_Manifest, batch, v.m_Digest, &request.m_Resource);
+                }
+                if (res == dmLiveUpdate::RESULT_OK)
+                {
+                    m_JobCompleteData.m_Manifest = request.m_Manifest;
+                    ++batch_count;
+                }
+            }
+            else
+            {
+                res = dmLiveUpdate::RESULT_INVALID_HEADER;
+            }
+            callback.m_Status = res == dmLiveUpdate::RESULT_OK ? true : false;
+        }
+
+        if (batch)
         {
-            res = dmLiveUpdate::RESULT_INVALID_HEADER;
+            Result res = dmLiveUpdate::RESULT_OK;
+            if (batch_count > 0)
+            {
+                res = dmLiveUpdate::CommitArchiveIndexBatch(m_JobCompleteData.m_Manifest, batch, m_JobCompleteData.m_NewArchiveIndex);
+            }
+            dmLiveUpdate::DeleteArchiveIndexBatch(batch);
+
+            if (res != dmLiveUpdate::RESULT_OK)
+            {
+                // None of the resources made it into an archive index
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    if (!requests[i].m_IsArchive)
+                        m_JobCompleteData.m_Callbacks[i].m_Status = false;
+                }
+                m_JobCompleteData.m_NewArchiveIndex = 0x0;
+                m_JobCompleteData.m_Manifest = 0;
+            }
         }
-        m_JobCompleteData.m_Status = res == dmLiveUpdate::RESULT_OK ? true : false;
     }
 
     // Must be called on the Lua main thread
     static void ProcessRequestComplete()
     {
-        if(m_JobCompleteData.m_Manifest && m_JobCompleteData.m_Status)
+        if(m_JobCompleteData.m_Manifest && m_JobCompleteData.m_NewArchiveIndex)
         {
             // If we have a new archive, then we've also created a new manifest, so let's use it
             dmLiveUpdate::SetNewManifest(m_JobCompleteData.m_Manifest);
 
             dmLiveUpdate::SetNewArchiveIndex(m_JobCompleteData.m_Manifest->m_ArchiveIndex, m_JobCompleteData.m_NewArchiveIndex, true);
         }
-        m_JobCompleteData.m_Callback(m_JobCompleteData.m_Status, m_JobCompleteData.m_CallbackData);
+        for (uint32_t i = 0; i < m_JobCompleteData.m_Callbacks.Size(); ++i)
+        {
+            ResourceRequestCallbackData& callback = m_JobCompleteData.m_Callbacks[i];
+            callback.m_Callback(callback.m_Status, callback.m_CallbackData);
+        }
+        m_JobCompleteData.m_Callbacks.SetSize(0);
     }
 
 
@@ -87,7 +189,6 @@ namespace dmLiveUpdate
         (void)args;
 
         // Liveupdate async thread batch processing requested liveupdate tasks
-        AsyncResourceRequest request;
         while (m_Active)
         {
             // Lock and sleep until signaled there is requests queued up
@@ -97,10 +198,9 @@ namespace dmLiveUpdate
                     dmConditionVariable::Wait(m_ConsumerThreadCondition, m_ConsumerThreadMutex);
                 if((m_ThreadJobComplete) || (!m_Active))
                     continue;
-                request = m_ThreadJobQueue.Back();
-                m_ThreadJobQueue.Pop();
+                TakeRequests(m_ThreadJobQueue, m_ThreadJobs);
             }
-            ProcessRequest(request);
+            ProcessRequests(m_ThreadJobs);
             m_ThreadJobComplete = true;
         }
     }
@@ -186,8 +286,8 @@ namespace dmLiveUpdate
     {
         if(!m_JobQueue.Empty())
         {
-            ProcessRequest(m_JobQueue.Back());
-            m_JobQueue.Pop();
+            TakeRequests(m_JobQueue, m_ThreadJobs);
+            ProcessRequests(m_ThreadJobs);
             ProcessRequestComplete();
         }
     }
@@ -104,6 +104,20 @@ namespace dmLiveUpdate
         }
     }
 
+    dmCrypt::HHashState NewResourceHash(dmLiveUpdateDDF::HashAlgorithm algorithm)
+    {
+        if (algorithm == dmLiveUpdateDDF::HASH_MD5)
+        {
+            return dmCrypt::NewHash(dmCrypt::HASH_ALGORITHM_MD5);
+        }
+        else if (algorithm == dmLiveUpdateDDF::HASH_SHA1)
+        {
+            return dmCrypt::NewHash(dmCrypt::HASH_ALGORITHM_SHA1);
+        }
+        dmLogError("The algorithm specified for manifest verification hashing is not supported (%i)", algorithm);
+        return 0;
+    }
+
     void CreateManifestHash(dmLiveUpdateDDF::HashAlgorithm algorithm, const uint8_t* buf, size_t buflen, uint8_t* digest)
     {
         if (algorithm == dmLiveUpdateDDF::HASH_SHA1)
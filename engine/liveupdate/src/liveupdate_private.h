@@ -17,6 +17,8 @@
 #include <ddf/ddf.h>
 #include <resource/liveupdate_ddf.h>
 #include <resource/resource_archive.h>
+#include <dlib/array.h>
+#include <dlib/crypt.h>
 #include <dlib/hash.h>
 
 extern "C"
@@ -56,10 +58,15 @@ namespace dmLiveUpdate
     {
         void* m_CallbackData;
         void (*m_Callback)(bool, void*);
-        dmResourceArchive::HArchiveIndexContainer m_ArchiveIndexContainer;
+        bool m_Status;
+    };
+
+    // The outcome of a batch of requests processed together by the async worker
+    struct ResourceRequestBatchData
+    {
+        dmArray<ResourceRequestCallbackData>      m_Callbacks;
         dmResourceArchive::HArchiveIndex          m_NewArchiveIndex;
         dmResource::Manifest*                     m_Manifest;
-        bool m_Status;
     };
 
     typedef dmLiveUpdateDDF::ManifestFile* HManifestFile;
@@ -72,9 +79,41 @@ namespace dmLiveUpdate
     uint32_t MissingResources(dmResource::Manifest* manifest, const dmhash_t urlHash, uint8_t* entries[], uint32_t entries_size);
 
     void CreateResourceHash(dmLiveUpdateDDF::HashAlgorithm algorithm, const char* buf, size_t buflen, uint8_t* digest);
+    // Incremental version of CreateResourceHash. Returns 0 if the algorithm isn't supported
+    dmCrypt::HHashState NewResourceHash(dmLiveUpdateDDF::HashAlgorithm algorithm);
+    // Compares a resource digest with the expected hex digest
+    Result VerifyResourceDigest(dmLiveUpdateDDF::HashAlgorithm algorithm, const uint8_t* digest, const char* expected, uint32_t expected_length);
     void CreateManifestHash(dmLiveUpdateDDF::HashAlgorithm algorithm, const uint8_t* buf, size_t buflen, uint8_t* digest);
 
-    Result NewArchiveIndexWithResource(const dmResource::Manifest* manifest, const char* expected_digest, const uint32_t expected_digest_length, const dmResourceArchive::LiveUpdateResource* resource, dmResourceArchive::HArchiveIndex& out_new_index);
+    struct ResourceVerification
+    {
+        const dmResourceArchive::LiveUpdateResource* m_Resource;
+        const char*                 m_ExpectedDigest;
+        uint32_t                    m_ExpectedDigestLength;
+        uint8_t                     m_Digest[dmResourceArchive::MAX_HASH];
+        Result                      m_Result;
+    };
+
+    // Hashes the resources on the verification worker threads and compares them with the expected digests.
+    // The digest and result of each resource is written to its ResourceVerification
+    void VerifyResources(const dmResource::Manifest* manifest, ResourceVerification* verifications, uint32_t count);
+
+    // Resource verification worker threads. Hashing is done on the helper threads and on the threads
+    // that add or wait for verifications. With thread_count 0 every resource is verified when added
+    typedef struct ResourceVerifier* HResourceVerifier;
+    HResourceVerifier NewResourceVerifier(dmLiveUpdateDDF::HashAlgorithm algorithm, uint32_t thread_count);
+    // free_data is free()'d once the data is hashed. out_digest and out_result are optional
+    void AddResourceVerification(HResourceVerifier verifier, const char* expected, uint32_t expected_length, const uint8_t* data, uint32_t data_length, void* free_data, uint8_t* out_digest, Result* out_result);
+    // Returns RESULT_OK if all resources added so far were verified
+    Result WaitResourceVerifier(HResourceVerifier verifier);
+    void DeleteResourceVerifier(HResourceVerifier verifier);
+
+    // Resources added to a batch must already be verified. Their data is written to the live update archive,
+    // but they are only part of the archive index returned when the batch is committed
+    Result NewArchiveIndexBatch(const dmResource::Manifest* manifest, dmResourceArchive::HArchiveIndexBatch* out_batch);
+    Result AddResourceToBatch(const dmResource::Manifest* manifest, dmResourceArchive::HArchiveIndexBatch batch, const uint8_t* digest, const dmResourceArchive::LiveUpdateResource* resource);
+    Result CommitArchiveIndexBatch(const dmResource::Manifest* manifest, dmResourceArchive::HArchiveIndexBatch batch, dmResourceArchive::HArchiveIndex& out_new_index);
+    void DeleteArchiveIndexBatch(dmResourceArchive::HArchiveIndexBatch batch);
     void SetNewArchiveIndex(dmResourceArchive::HArchiveIndexContainer archive_container, dmResourceArchive::HArchiveIndex new_index, bool mem_mapped);
     void SetNewManifest(dmResource::Manifest* manifest);
 
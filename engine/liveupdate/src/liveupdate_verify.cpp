@@ -0,0 +1,219 @@
+// Copyright 2020 The Defold Foundation
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "liveupdate.h"
+#include "liveupdate_private.h"
+
+#include <resource/resource.h>
+
+#include <dlib/array.h>
+#include <dlib/condition_variable.h>
+#include <dlib/log.h>
+#include <dlib/math.h>
+#include <dlib/mutex.h>
+#include <dlib/profile.h>
+#include <dlib/thread.h>
+
+namespace dmLiveUpdate
+{
+    /// Maximum number of helper threads hashing resources besides the thread waiting for the result
+    static const uint32_t m_MaxVerifyThreads = 3;
+    static const uint32_t m_VerifyThreadStackSize = 0x10000;
+    /// Queued resource data is limited to this many bytes, AddResourceVerification blocks until there is room
+    static const uint32_t m_MaxPendingBytes = 64 * 1024 * 1024;
+
+    struct VerifyJob
+    {
+        const uint8_t*  m_Data;
+        uint32_t        m_DataLength;
+        void*           m_FreeData;
+        uint8_t*        m_Digest;
+        Result*         m_Result;
+        uint32_t        m_ExpectedLength;
+        char            m_Expected[dmResourceArchive::MAX_HASH * 2 + 1];
+    };
+
+    struct ResourceVerifier
+    {
+        dmLiveUpdateDDF::HashAlgorithm          m_Algorithm;
+        dmArray<VerifyJob>                      m_Jobs;
+        uint32_t                                m_NextJob;
+        uint32_t                                m_ActiveJobs;
+        uint32_t                                m_PendingBytes;
+        dmMutex::HMutex                         m_Mutex;
+        dmConditionVariable::HConditionVariable m_JobAdded;
+        dmConditionVariable::HConditionVariable m_JobDone;
+        dmThread::Thread                        m_Threads[m_MaxVerifyThreads];
+        uint32_t                                m_ThreadCount;
+        Result                                  m_Result;
+        bool                                    m_Quit;
+    };
+
+    static Result ExecuteJob(dmLiveUpdateDDF::HashAlgorithm algorithm, VerifyJob* job)
+    {
+        DM_PROFILE(LiveUpdate, "VerifyResource");
+        uint8_t digest[dmResourceArchive::MAX_HASH];
+        CreateResourceHash(algorithm, (const char*)job->m_Data, job->m_DataLength, digest);
+        Result result = VerifyResourceDigest(algorithm, digest, job->m_Expected, job->m_ExpectedLength);
+        if (result != RESULT_OK)
+        {
+            dmLogError("Verification failure for resource: %s", job->m_Expected);
+        }
+        if (job->m_Digest)
+        {
+            memcpy(job->m_Digest, digest, dmResource::HashLength(algorithm));
+        }
+        if (job->m_Result)
+        {
+            *job->m_Result = result;
+        }
+        free(job->m_FreeData);
+        return result;
+    }
+
+    // Must be called with the mutex locked. Returns false when there are no jobs waiting
+    static bool ProcessJob(ResourceVerifier* verifier)
+    {
+        if (verifier->m_NextJob == verifier->m_Jobs.Size())
+            return false;
+
+        VerifyJob job = verifier->m_Jobs[verifier->m_NextJob++];
+        verifier->m_ActiveJobs++;
+        dmMutex::Unlock(verifier->m_Mutex);
+
+        Result result = ExecuteJob(verifier->m_Algorithm, &job);
+
+        dmMutex::Lock(verifier->m_Mutex);
+        verifier->m_ActiveJobs--;
+        verifier->m_PendingBytes -= job.m_DataLength;
+        if (result != RESULT_OK && verifier->m_Result == RESULT_OK)
+        {
+            verifier->m_Result = result;
+        }
+        if (verifier->m_NextJob == verifier->m_Jobs.Size() && verifier->m_ActiveJobs == 0)
+        {
+            verifier->m_Jobs.SetSize(0);
+            verifier->m_NextJob = 0;
+        }
+        dmConditionVariable::Broadcast(verifier->m_JobDone);
+        return true;
+    }
+
+    static void VerifyThread(void* context)
+    {
+        ResourceVerifier* verifier = (ResourceVerifier*)context;
+        dmMutex::ScopedLock lk(verifier->m_Mutex);
+        while (!verifier->m_Quit)
+        {
+            if (!ProcessJob(verifier))
+            {
+                dmConditionVariable::Wait(verifier->m_JobAdded, verifier->m_Mutex);
+            }
+        }
+    }
+
+    HResourceVerifier NewResourceVerifier(dmLiveUpdateDDF::HashAlgorithm algorithm, uint32_t thread_count)
+    {
+        ResourceVerifier* verifier = new ResourceVerifier;
+        verifier->m_Algorithm = algorithm;
+        verifier->m_NextJob = 0;
+        verifier->m_ActiveJobs = 0;
+        verifier->m_PendingBytes = 0;
+        verifier->m_Result = RESULT_OK;
+        verifier->m_Quit = false;
+        verifier->m_ThreadCount = 0;
+        verifier->m_Mutex = dmMutex::New();
+        verifier->m_JobAdded = dmConditionVariable::New();
+        verifier->m_JobDone = dmConditionVariable::New();
+#if !defined(__EMSCRIPTEN__)
+        thread_count = dmMath::Min(thread_count, m_MaxVerifyThreads);
+        for (uint32_t i = 0; i < thread_count; ++i)
+        {
+            verifier->m_Threads[verifier->m_ThreadCount++] = dmThread::New(VerifyThread, m_VerifyThreadStackSize, verifier, "liveupdate_verify");
+        }
+#endif
+        return verifier;
+    }
+
+    void AddResourceVerification(HResourceVerifier verifier, const char* expected, uint32_t expected_length, const uint8_t* data, uint32_t data_length, void* free_data, uint8_t* out_digest, Result* out_result)
+    {
+        VerifyJob job;
+        job.m_Data = data;
+        job.m_DataLength = data_length;
+        job.m_FreeData = free_data;
+        job.m_Digest = out_digest;
+        job.m_Result = out_result;
+        job.m_ExpectedLength = dmMath::Min(expected_length, (uint32_t)sizeof(job.m_Expected) - 1);
+        memcpy(job.m_Expected, expected, job.m_ExpectedLength);
+        job.m_Expected[job.m_ExpectedLength] = 0;
+
+        if (verifier->m_ThreadCount == 0)
+        {
+            Result result = ExecuteJob(verifier->m_Algorithm, &job);
+            if (result != RESULT_OK && verifier->m_Result == RESULT_OK)
+            {
+                verifier->m_Result = result;
+            }
+            return;
+        }
+
+        dmMutex::ScopedLock lk(verifier->m_Mutex);
+        // Help out rather than queueing up more data than we can hold
+        while (verifier->m_PendingBytes > 0 && verifier->m_PendingBytes + data_length > m_MaxPendingBytes)
+        {
+            if (!ProcessJob(verifier))
+            {
+                dmConditionVariable::Wait(verifier->m_JobDone, verifier->m_Mutex);
+            }
+        }
+        if (verifier->m_Jobs.Full())
+        {
+            verifier->m_Jobs.OffsetCapacity(dmMath::Max(16U, verifier->m_Jobs.Capacity()));
+        }
+        verifier->m_Jobs.Push(job);
+        verifier->m_PendingBytes += data_length;
+        dmConditionVariable::Signal(verifier->m_JobAdded);
+    }
+
+    Result WaitResourceVerifier(HResourceVerifier verifier)
+    {
+        dmMutex::ScopedLock lk(verifier->m_Mutex);
+        while (verifier->m_NextJob != verifier->m_Jobs.Size() || verifier->m_ActiveJobs > 0)
+        {
+            if (!ProcessJob(verifier))
+            {
+                dmConditionVariable::Wait(verifier->m_JobDone, verifier->m_Mutex);
+            }
+        }
+        return verifier->m_Result;
+    }
+
+    void DeleteResourceVerifier(HResourceVerifier verifier)
+    {
+        WaitResourceVerifier(verifier);
+        dmMutex::Lock(verifier->m_Mutex);
+        verifier->m_Quit = true;
+        dmConditionVariable::Broadcast(verifier->m_JobAdded);
+        dmMutex::Unlock(verifier->m_Mutex);
+        for (uint32_t i = 0; i < verifier->m_ThreadCount; ++i)
+        {
+            dmThread::Join(verifier->m_Threads[i]);
+        }
+        dmConditionVariable::Delete(verifier->m_JobDone);
+        dmConditionVariable::Delete(verifier->m_JobAdded);
+        dmMutex::Delete(verifier->m_Mutex);
+        delete verifier;
+    }
+}
@@ -24,6 +24,8 @@
 #include <dlib/sys.h>
 #include <dlib/zip.h>
 #include <dlib/memory.h>
+#include <dlib/math.h>
+#include <dlib/crypt.h>
 
 namespace dmLiveUpdate
 {
@@ -63,6 +65,53 @@ namespace dmLiveUpdate
         return data;
     }
 
+    /// Zip entries this large are hashed in chunks as they are decompressed
+    static const uint32_t m_StreamVerifyMinSize = 4 * 1024 * 1024;
+
+    struct ZipEntryHashContext
+    {
+        dmCrypt::HHashState m_Hash;
+    };
+
+    static bool HashZipEntryData(void* ctx, uint32_t offset, const void* data, uint32_t size)
+    {
+        ZipEntryHashContext* context = (ZipEntryHashContext*)ctx;
+        // The resource header isn't part of the resource hash
+        const uint32_t header_size = sizeof(dmResourceArchive::LiveUpdateResourceHeader);
+        if (offset < header_size)
+        {
+            uint32_t skip = dmMath::Min(header_size - offset, size);
+            data = (const uint8_t*)data + skip;
+            size -= skip;
+        }
+        if (size > 0)
+        {
+            dmCrypt::UpdateHash(context->m_Hash, (const uint8_t*)data, size);
+        }
+        return true;
+    }
+
+    static Result VerifyZipEntryStream(dmZip::HZip zip, dmLiveUpdateDDF::HashAlgorithm algorithm, const char* entry_name)
+    {
+        ZipEntryHashContext context;
+        context.m_Hash = NewResourceHash(algorithm);
+        if (!context.m_Hash)
+        {
+            return RESULT_INVALID_RESOURCE;
+        }
+
+        dmZip::Result zr = dmZip::GetEntryDataStream(zip, HashZipEntryData, &context);
+
+        uint8_t digest[dmResourceArchive::MAX_HASH];
+        dmCrypt::FinalizeHash(context.m_Hash, digest);
+        if (dmZip::RESULT_OK != zr)
+        {
+            dmLogError("Could not read entry '%s'", entry_name);
+            return RESULT_INVALID_RESOURCE;
+        }
+        return VerifyResourceDigest(algorithm, digest, entry_name, strlen(entry_name));
+    }
+
     static Result VerifyZipArchive(const char* path, char* application_support_path, uint32_t application_support_path_len)
     {
         dmLogInfo("Verifying archive '%s'", path);
@@ -112,9 +161,10 @@ namespace dmLiveUpdate
             // Verify the resources in the zip file
             if (RESULT_OK == result)
             {
+                dmLiveUpdateDDF::HashAlgorithm algorithm = manifest->m_DDFData->m_Header.m_ResourceHashAlgorithm;
                 uint32_t num_entries = dmZip::GetNumEntries(zip);
-                uint8_t* entry_data = 0;
-                uint32_t entry_data_capacity = 0;
+                // Entries are decompressed on this thread and hashed on the verifier threads
+                HResourceVerifier verifier = NewResourceVerifier(algorithm, num_entries);
                 for( uint32_t i = 0; i < num_entries && RESULT_OK == result; ++i)
                 {
                     zr = dmZip::OpenEntry(zip, i);
@@ -128,38 +178,53 @@ namespace dmLiveUpdate
                         if (dmZip::RESULT_OK != zr)
                         {
                             dmLogError("Could not get entry size '%s'", entry_name);
+                            DeleteResourceVerifier(verifier);
                             dmZip::Close(zip);
                             return RESULT_INVALID_RESOURCE;
                         }
 
-                        if (entry_data_capacity < entry_size)
+                        if (entry_size < sizeof(dmResourceArchive::LiveUpdateResourceHeader))
                         {
-                            entry_data = (uint8_t*)realloc(entry_data, entry_size);
-                            entry_data_capacity = entry_size;
+                            dmLogError("Skipping resource %s from archive %s", entry_name, path);
                         }
-
-                        zr = dmZip::GetEntryData(zip, entry_data, entry_size);
-
-                        dmResourceArchive::LiveUpdateResource resource(entry_data, entry_size);
-                        if (entry_size >= sizeof(dmResourceArchive::LiveUpdateResourceHeader))
+                        else if (entry_size >= m_StreamVerifyMinSize)
                         {
-                            result = dmLiveUpdate::VerifyResource(manifest, entry_name, strlen(entry_name), (const char*)resource.m_Data, resource.m_Count);
-
-                            if (RESULT_OK != result)
+                            // Hash large entries while they are decompressed, instead of buffering them
+                            result = VerifyZipEntryStream(zip, algorithm, entry_name);
+                        }
+                        else
+                        {
+                            uint8_t* entry_data = (uint8_t*)malloc(entry_size);
+                            zr = dmZip::GetEntryData(zip, entry_data, entry_size);
+                            if (dmZip::RESULT_OK != zr)
                             {
-                                dmLogError("Failed to verify resource '%s' in archive %s", entry_name, path);
+                                dmLogError("Could not read entry '%s'", entry_name);
+                                free(entry_data);
+                                result = RESULT_INVALID_RESOURCE;
+                            }
+                            else
+                            {
+                                dmResourceArchive::LiveUpdateResource resource(entry_data, entry_size);
+                                AddResourceVerification(verifier, entry_name, strlen(entry_name), resource.m_Data, resource.m_Count, entry_data, 0, 0);
                             }
-                        }
-                        else {
-                            dmLogError("Skipping resource %s from archive %s", entry_name, path);
                         }
 
+                        if (RESULT_OK != result)
+                        {
+                            dmLogError("Failed to verify resource '%s' in archive %s", entry_name, path);
+                        }
                     }
 
                     dmZip::CloseEntry(zip);
                 }
 
-                free(entry_data);
+                Result verify_result = WaitResourceVerifier(verifier);
+                DeleteResourceVerifier(verifier);
+                if (RESULT_OK == result && RESULT_OK != verify_result)
+                {
+                    dmLogError("Failed to verify resources in archive %s", path);
+                    result = verify_result;
+                }
             }
             dmDDF::FreeMessage(manifest->m_DDFData);
             dmDDF::FreeMessage(manifest->m_DDF);
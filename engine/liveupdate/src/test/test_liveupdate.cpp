@@ -12,6 +12,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #define JC_TEST_IMPLEMENTATION
 #include <jc_test/jc_test.h>
 #include <resource/resource.h>
@@ -52,6 +53,51 @@ TEST(dmLiveUpdate, BytesToHexString)
     ASSERT_STREQ("000102030405060708090a0b0c0d0e0f", buffer_long);
 }
 
+TEST(dmLiveUpdate, ResourceVerifier)
+{
+    const uint32_t resource_count = 64;
+    const uint32_t resource_size = 64 * 1024;
+    const dmLiveUpdateDDF::HashAlgorithm algorithm = dmLiveUpdateDDF::HASH_SHA1;
+    const uint32_t hash_length = dmResource::HashLength(algorithm);
+
+    uint8_t* data = (uint8_t*)malloc(resource_count * resource_size);
+    for (uint32_t i = 0; i < resource_count * resource_size; ++i)
+    {
+        data[i] = (uint8_t)(rand() & 0xff);
+    }
+
+    char expected[resource_count][dmResourceArchive::MAX_HASH * 2 + 1];
+    uint8_t expected_digests[resource_count][dmResourceArchive::MAX_HASH];
+    for (uint32_t i = 0; i < resource_count; ++i)
+    {
+        dmLiveUpdate::CreateResourceHash(algorithm, (const char*)data + i * resource_size, resource_size, expected_digests[i]);
+        dmResource::BytesToHexString(expected_digests[i], hash_length, expected[i], sizeof(expected[i]));
+    }
+    // Make one resource fail
+    expected[7][0] = expected[7][0] == '0' ? '1' : '0';
+
+    for (uint32_t thread_count = 0; thread_count < 4; thread_count += 3)
+    {
+        uint8_t digests[resource_count][dmResourceArchive::MAX_HASH];
+        dmLiveUpdate::Result results[resource_count];
+        dmLiveUpdate::HResourceVerifier verifier = dmLiveUpdate::NewResourceVerifier(algorithm, thread_count);
+        for (uint32_t i = 0; i < resource_count; ++i)
+        {
+            dmLiveUpdate::AddResourceVerification(verifier, expected[i], strlen(expected[i]), data + i * resource_size, resource_size, 0, digests[i], &results[i]);
+        }
+        ASSERT_EQ(dmLiveUpdate::RESULT_INVALID_RESOURCE, dmLiveUpdate::WaitResourceVerifier(verifier));
+        dmLiveUpdate::DeleteResourceVerifier(verifier);
+
+        for (uint32_t i = 0; i < resource_count; ++i)
+        {
+            ASSERT_EQ(i == 7 ? dmLiveUpdate::RESULT_INVALID_RESOURCE : dmLiveUpdate::RESULT_OK, results[i]);
+            ASSERT_EQ(0, memcmp(expected_digests[i], digests[i], hash_length));
+        }
+    }
+
+    free(data);
+}
+
 int main(int argc, char **argv)
 {
     jc_test_init(&argc, argv);
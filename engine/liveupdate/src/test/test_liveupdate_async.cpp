@@ -22,6 +22,9 @@
 
 
 static volatile bool g_TestAsyncCallbackComplete = false;
+static volatile uint32_t g_TestAsyncCallbackCount = 0;
+static uint32_t g_TestBatchCommitCount = 0;
+static uint32_t g_TestBatchResourceCount = 0;
 static dmResource::HFactory g_ResourceFactory = 0x0;
 
 class LiveUpdate : public jc_test_base_class
@@ -60,16 +63,50 @@ namespace dmLiveUpdate
         return dmLiveUpdate::RESULT_OK;
     }
 
-    dmLiveUpdate::Result NewArchiveIndexWithResource(const dmResource::Manifest* manifest, const char* expected_digest, const uint32_t expected_digest_length, const dmResourceArchive::LiveUpdateResource* resource, dmResourceArchive::HArchiveIndex& out_new_index)
+    dmLiveUpdate::Result NewArchiveIndexBatch(const dmResource::Manifest* manifest, dmResourceArchive::HArchiveIndexBatch* out_batch)
+    {
+        assert(manifest->m_ArchiveIndex == (dmResourceArchive::HArchiveIndexContainer) 0x1234);
+        *out_batch = (dmResourceArchive::HArchiveIndexBatch) 0x9abc;
+        return dmLiveUpdate::RESULT_OK;
+    }
+
+    void VerifyResources(const dmResource::Manifest* manifest, ResourceVerification* verifications, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            ResourceVerification& v = verifications[i];
+            assert(manifest->m_ArchiveIndex == (dmResourceArchive::HArchiveIndexContainer) 0x1234);
+            assert(strcmp("DUMMY2", v.m_ExpectedDigest)==0);
+            assert(v.m_ExpectedDigestLength == 6);
+            assert(*((uint32_t*)v.m_Resource->m_Data) == 0xdeadbeef);
+            memset(v.m_Digest, 0x42, sizeof(v.m_Digest));
+            v.m_Result = dmLiveUpdate::RESULT_OK;
+        }
+    }
+
+    dmLiveUpdate::Result AddResourceToBatch(const dmResource::Manifest* manifest, dmResourceArchive::HArchiveIndexBatch batch, const uint8_t* digest, const dmResourceArchive::LiveUpdateResource* resource)
     {
-        out_new_index = (dmResourceArchive::HArchiveIndex) 0x5678;
         assert(manifest->m_ArchiveIndex == (dmResourceArchive::HArchiveIndexContainer) 0x1234);
-        assert(strcmp("DUMMY2", expected_digest)==0);
-        assert(expected_digest_length == 6);
+        assert(batch == (dmResourceArchive::HArchiveIndexBatch) 0x9abc);
+        assert(digest[0] == 0x42);
         assert(*((uint32_t*)resource->m_Data) == 0xdeadbeef);
+        ++g_TestBatchResourceCount;
         return dmLiveUpdate::RESULT_OK;
     }
 
+    dmLiveUpdate::Result CommitArchiveIndexBatch(const dmResource::Manifest* manifest, dmResourceArchive::HArchiveIndexBatch batch, dmResourceArchive::HArchiveIndex& out_new_index)
+    {
+        assert(batch == (dmResourceArchive::HArchiveIndexBatch) 0x9abc);
+        out_new_index = (dmResourceArchive::HArchiveIndex) 0x5678;
+        ++g_TestBatchCommitCount;
+        return dmLiveUpdate::RESULT_OK;
+    }
+
+    void DeleteArchiveIndexBatch(dmResourceArchive::HArchiveIndexBatch batch)
+    {
+        assert(batch == (dmResourceArchive::HArchiveIndexBatch) 0x9abc);
+    }
+
     void SetNewArchiveIndex(dmResourceArchive::HArchiveIndexContainer archive_container, dmResourceArchive::HArchiveIndex new_index, bool mem_mapped)
     {
         ASSERT_EQ((dmResourceArchive::HArchiveIndexContainer) 0x1234, archive_container);
@@ -117,8 +154,15 @@ static void Callback_StoreResourceInvalidHeader(bool status, void* ctx)
     ASSERT_FALSE(status);
 }
 
+static void Callback_StoreResourceCount(bool status, void* ctx)
+{
+    ++g_TestAsyncCallbackCount;
+    ASSERT_TRUE(status);
+}
+
 TEST_F(LiveUpdate, TestAsync)
 {
+    g_TestAsyncCallbackComplete = false;
     dmLiveUpdate::AsyncInitialize(g_ResourceFactory);
 
     uint8_t buf[sizeof(dmResourceArchive::LiveUpdateResourceHeader)+sizeof(uint32_t)];
@@ -156,6 +200,7 @@ TEST_F(LiveUpdate, TestAsync)
 
 TEST_F(LiveUpdate, TestAsyncInvalidResource)
 {
+    g_TestAsyncCallbackComplete = false;
     dmLiveUpdate::AsyncInitialize(g_ResourceFactory);
 
     uint8_t buf[sizeof(dmResourceArchive::LiveUpdateResourceHeader)+sizeof(uint32_t)];
@@ -193,6 +238,46 @@ TEST_F(LiveUpdate, TestAsyncInvalidResource)
     dmLiveUpdate::AsyncFinalize();
 }
 
+TEST_F(LiveUpdate, TestAsyncBatch)
+{
+    dmLiveUpdate::AsyncInitialize(g_ResourceFactory);
+
+    uint8_t buf[sizeof(dmResourceArchive::LiveUpdateResourceHeader)+sizeof(uint32_t)];
+    const size_t buf_len = sizeof(buf);
+    *((uint32_t*)&buf[sizeof(dmResourceArchive::LiveUpdateResourceHeader)]) = 0xdeadbeef;
+    dmResourceArchive::LiveUpdateResource resource((const uint8_t*) buf, buf_len);
+
+    dmResource::Manifest manifest;
+    manifest.m_ArchiveIndex = (dmResourceArchive::HArchiveIndexContainer) 0x1234;
+
+    const uint32_t request_count = 16;
+    g_TestAsyncCallbackCount = 0;
+    g_TestBatchCommitCount = 0;
+    g_TestBatchResourceCount = 0;
+    for (uint32_t i = 0; i < request_count; ++i)
+    {
+        dmLiveUpdate::AsyncResourceRequest request;
+        request.m_Manifest = &manifest;
+        request.m_ExpectedResourceDigestLength = 6;
+        request.m_ExpectedResourceDigest = "DUMMY2";
+        request.m_Resource.Set(resource);
+        request.m_Callback = Callback_StoreResourceCount;
+        ASSERT_TRUE(dmLiveUpdate::AddAsyncResourceRequest(request));
+    }
+
+    while(g_TestAsyncCallbackCount < request_count)
+    {
+        dmLiveUpdate::AsyncUpdate();
+
+        dmTime::Sleep(1000);
+    }
+
+    // All requests were queued before the worker picked them up, so the archive index is only rebuilt once
+    ASSERT_EQ(request_count, g_TestBatchResourceCount);
+    ASSERT_EQ(1u, g_TestBatchCommitCount);
+
+    dmLiveUpdate::AsyncFinalize();
+}
 
 int main(int argc, char **argv)
 {
@@ -382,6 +382,73 @@ static int ProfilerUIViewRecordedFrame(lua_State* L)
     return 0;
 }
 
+/*# starts a profile capture to file
+ * Streams the profiler samples, counters and thread names of the next frames to a file.
+ * The capture stops by itself once `frame_count` frames are written, or when
+ * [ref:profiler.stop_capture] is called.
+ *
+ * A capture can also be started at launch by setting `capture_file` (and optionally
+ * `capture_frames` and `capture_format`) under `profiler` in the `game.project` file.
+ *
+ * [icon:attention] Captures are only available in the debug version of the engine.
+ *
+ * @name profiler.start_capture
+ * @param path [type:string] the file to write
+ * @param frame_count [type:number] the number of frames to capture
+ * @param [format] [type:constant] the file format, one of
+ *
+ * - `profiler.CAPTURE_FORMAT_CHROME_TRACE` (default) JSON, loads in chrome://tracing and Perfetto
+ * - `profiler.CAPTURE_FORMAT_BINARY` a compact binary format
+ *
+ * @return started [type:boolean] true if the capture was started
+ * @examples
+ * ```lua
+ * -- Capture the next 300 frames
+ * profiler.start_capture("capture.json", 300)
+ * ```
+ */
+static int StartCapture(lua_State* L)
+{
+    DM_LUA_STACK_CHECK(L, 1)
+
+    const char* path = luaL_checkstring(L, 1);
+    int frame_count = luaL_checkinteger(L, 2);
+    int format = luaL_optinteger(L, 3, dmProfile::CAPTURE_FORMAT_CHROME_TRACE);
+    if (frame_count <= 0)
+    {
+        return DM_LUA_ERROR("The frame count must be positive");
+    }
+    if (format != dmProfile::CAPTURE_FORMAT_CHROME_TRACE && format != dmProfile::CAPTURE_FORMAT_BINARY)
+    {
+        return DM_LUA_ERROR("Unknown capture format %d", format);
+    }
+    lua_pushboolean(L, dmProfile::StartCapture(path, (dmProfile::CaptureFormat)format, (uint32_t)frame_count));
+    return 1;
+}
+
+/*# stops the current profile capture
+ * Writes the frames captured so far and closes the capture file.
+ *
+ * @name profiler.stop_capture
+ */
+static int StopCapture(lua_State* L)
+{
+    DM_LUA_STACK_CHECK(L, 0)
+    dmProfile::StopCapture();
+    return 0;
+}
+
+/*# Chrome trace-event JSON capture format
+*
+* @name profiler.CAPTURE_FORMAT_CHROME_TRACE
+* @variable
+*/
+/*# compact binary capture format
+*
+* @name profiler.CAPTURE_FORMAT_BINARY
+* @variable
+*/
+
 /*# continously show latest frame
 *
 * @name profiler.MODE_RUN
@@ -435,6 +502,8 @@ static dmExtension::Result InitializeProfiler(dmExtension::Params* params)
         {"set_ui_vsync_wait_visible", dmProfiler::SetProfileUIVSyncWaitVisible},
         {"recorded_frame_count", dmProfiler::ProfilerUIRecordedFrameCount},
         {"view_recorded_frame", dmProfiler::ProfilerUIViewRecordedFrame},
+        {"start_capture", dmProfiler::StartCapture},
+        {"stop_capture", dmProfiler::StopCapture},
         {0, 0}
     };
 
@@ -454,8 +523,21 @@ static dmExtension::Result InitializeProfiler(dmExtension::Params* params)
     lua_pushnumber(params->m_L, (lua_Number) dmProfileRender::PROFILER_VIEW_MODE_MINIMIZED);
     lua_setfield(params->m_L, -2, "VIEW_MODE_MINIMIZED");
 
+    lua_pushnumber(params->m_L, (lua_Number) dmProfile::CAPTURE_FORMAT_CHROME_TRACE);
+    lua_setfield(params->m_L, -2, "CAPTURE_FORMAT_CHROME_TRACE");
+    lua_pushnumber(params->m_L, (lua_Number) dmProfile::CAPTURE_FORMAT_BINARY);
+    lua_setfield(params->m_L, -2, "CAPTURE_FORMAT_BINARY");
+
     lua_pop(params->m_L, 1);
 
+    const char* capture_file = dmConfigFile::GetString(params->m_ConfigFile, "profiler.capture_file", 0);
+    if (capture_file && capture_file[0] != 0)
+    {
+        uint32_t capture_frames = dmConfigFile::GetInt(params->m_ConfigFile, "profiler.capture_frames", 300);
+        int capture_format = dmConfigFile::GetInt(params->m_ConfigFile, "profiler.capture_format", dmProfile::CAPTURE_FORMAT_CHROME_TRACE);
+        dmProfile::StartCapture(capture_file, (dmProfile::CaptureFormat)capture_format, capture_frames);
+    }
+
     return dmExtension::RESULT_OK;
 }
 
@@ -476,6 +558,7 @@ static dmExtension::Result UpdateProfiler(dmExtension::Params* params)
 
 static dmExtension::Result FinalizeProfiler(dmExtension::Params* params)
 {
+    dmProfile::StopCapture();
     if (dmProfiler::gRenderProfile)
     {
         dmProfileRender::DeleteRenderProfile(dmProfiler::gRenderProfile);
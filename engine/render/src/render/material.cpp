@@ -154,6 +154,17 @@ namespace dmRender
         delete material;
     }
 
+    static inline bool HasRenderObjectConstant(const RenderObject* ro, dmhash_t name_hash)
+    {
+        for (uint32_t i = 0; i < RenderObject::MAX_CONSTANT_COUNT; ++i)
+        {
+            const Constant& c = ro->m_Constants[i];
+            if (c.m_Location != -1 && c.m_NameHash == name_hash)
+                return true;
+        }
+        return false;
+    }
+
     void ApplyMaterialConstants(dmRender::HRenderContext render_context, HMaterial material, const RenderObject* ro)
     {
         const dmArray<MaterialConstant>& constants = material->m_Constants;
@@ -168,7 +179,10 @@ namespace dmRender
             {
                 case dmRenderDDF::MaterialDesc::CONSTANT_TYPE_USER:
                 {
-                    dmGraphics::SetConstantV4(graphics_context, &constant.m_Value, location);
+                    // While drawing, the render object constants are applied right after and would overwrite the value
+                    if (render_context->m_StateCache.m_Active && HasRenderObjectConstant(ro, constant.m_NameHash))
+                        break;
+                    SetConstant(render_context, &constant.m_Value, 1, location);
                     break;
                 }
                 case dmRenderDDF::MaterialDesc::CONSTANT_TYPE_VIEWPROJ:
@@ -179,27 +193,27 @@ namespace dmRender
                         ndc_matrix.setElem(2, 2, 0.5f );
                         ndc_matrix.setElem(3, 2, 0.5f );
                         const Matrix4 view_projection = ndc_matrix * render_context->m_ViewProj;
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&view_projection, location);
+                        SetConstant(render_context, (Vector4*)&view_projection, 4, location);
                     }
                     else
                     {
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&render_context->m_ViewProj, location);
+                        SetConstant(render_context, (Vector4*)&render_context->m_ViewProj, 4, location);
                     }
                     break;
                 }
                 case dmRenderDDF::MaterialDesc::CONSTANT_TYPE_WORLD:
                 {
-                    dmGraphics::SetConstantM4(graphics_context, (Vector4*)&ro->m_WorldTransform, location);
+                    SetConstant(render_context, (Vector4*)&ro->m_WorldTransform, 4, location);
                     break;
                 }
                 case dmRenderDDF::MaterialDesc::CONSTANT_TYPE_TEXTURE:
                 {
-                    dmGraphics::SetConstantM4(graphics_context, (Vector4*)&ro->m_TextureTransform, location);
+                    SetConstant(render_context, (Vector4*)&ro->m_TextureTransform, 4, location);
                     break;
                 }
                 case dmRenderDDF::MaterialDesc::CONSTANT_TYPE_VIEW:
                 {
-                    dmGraphics::SetConstantM4(graphics_context, (Vector4*)&render_context->m_View, location);
+                    SetConstant(render_context, (Vector4*)&render_context->m_View, 4, location);
                     break;
                 }
                 case dmRenderDDF::MaterialDesc::CONSTANT_TYPE_PROJECTION:
@@ -212,11 +226,11 @@ namespace dmRender
                         ndc_matrix.setElem(2, 2, 0.5f );
                         ndc_matrix.setElem(3, 2, 0.5f );
                         const Matrix4 proj = ndc_matrix * render_context->m_Projection;
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&proj, location);
+                        SetConstant(render_context, (Vector4*)&proj, 4, location);
                     }
                     else
                     {
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&render_context->m_Projection, location);
+                        SetConstant(render_context, (Vector4*)&render_context->m_Projection, 4, location);
                     }
                     break;
                 }
@@ -229,7 +243,7 @@ namespace dmRender
                         // It is always affine however
                         normalT = affineInverse(normalT);
                         normalT = transpose(normalT);
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&normalT, location);
+                        SetConstant(render_context, (Vector4*)&normalT, 4, location);
                     }
                     break;
                 }
@@ -237,7 +251,7 @@ namespace dmRender
                 {
                     {
                         Matrix4 world_view = render_context->m_View * ro->m_WorldTransform;
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&world_view, location);
+                        SetConstant(render_context, (Vector4*)&world_view, 4, location);
                     }
                     break;
                 }
@@ -249,12 +263,12 @@ namespace dmRender
                         ndc_matrix.setElem(2, 2, 0.5f );
                         ndc_matrix.setElem(3, 2, 0.5f );
                         const Matrix4 world_view_projection = ndc_matrix * render_context->m_ViewProj * ro->m_WorldTransform;
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&world_view_projection, location);
+                        SetConstant(render_context, (Vector4*)&world_view_projection, 4, location);
                     }
                     else
                     {
                         const Matrix4 world_view_projection = render_context->m_ViewProj * ro->m_WorldTransform;
-                        dmGraphics::SetConstantM4(graphics_context, (Vector4*)&world_view_projection, location);
+                        SetConstant(render_context, (Vector4*)&world_view_projection, 4, location);
                     }
                     break;
                 }
@@ -399,6 +413,28 @@ namespace dmRender
             return -1;
     }
 
+    int32_t GetMaterialAttributeLocation(HMaterial material, const char* name)
+    {
+        dmhash_t name_hash = dmHashString64(name);
+        int32_t* cached = material->m_AttributeLocations.Get(name_hash);
+        if (cached)
+            return *cached;
+
+        int32_t location = dmGraphics::GetAttributeLocation(material->m_Program, name);
+        if (material->m_AttributeLocations.Full())
+        {
+            uint32_t capacity = material->m_AttributeLocations.Capacity() + 8;
+            material->m_AttributeLocations.SetCapacity(capacity / 2 + 1, capacity);
+        }
+        material->m_AttributeLocations.Put(name_hash, location);
+        return location;
+    }
+
+    void ClearMaterialAttributeLocations(HMaterial material)
+    {
+        material->m_AttributeLocations.Clear();
+    }
+
     void SetMaterialSampler(HMaterial material, dmhash_t name_hash, uint32_t unit, dmGraphics::TextureWrap u_wrap, dmGraphics::TextureWrap v_wrap, dmGraphics::TextureFilter min_filter, dmGraphics::TextureFilter mag_filter)
     {
         dmArray<Sampler>& samplers = material->m_Samplers;
@@ -89,6 +89,7 @@ namespace dmRender
     , m_MaxCharacters(0)
     , m_CommandBufferSize(1024)
     , m_MaxDebugVertexCount(0)
+    , m_FrameMemorySize(1024 * 1024)
     {
 
     }
@@ -132,10 +133,16 @@ namespace dmRender
         InitializeTextContext(context, params.m_MaxCharacters);
 
         context->m_OutOfResources = 0;
+        context->m_OutOfFrameMemory = 0;
 
         context->m_StencilBufferCleared = 0;
 
+        memset(&context->m_StateCache, 0, sizeof(context->m_StateCache));
+
         context->m_RenderListDispatch.SetCapacity(255);
+        context->m_RenderListHighWaterMark = 0;
+
+        context->m_FrameAllocator = dmFrameAllocator::New(params.m_FrameMemorySize);
 
         dmMessage::Result r = dmMessage::NewSocket(RENDER_SOCKET_NAME, &context->m_Socket);
         assert(r == dmMessage::RESULT_OK);
@@ -152,6 +159,11 @@ namespace dmRender
         FinalizeDebugRenderer(render_context);
         FinalizeTextContext(render_context);
         dmMessage::DeleteSocket(render_context->m_Socket);
+        for (uint32_t i = 0; i < render_context->m_RenderListBuckets.Size(); ++i)
+        {
+            delete render_context->m_RenderListBuckets[i];
+        }
+        dmFrameAllocator::Delete(render_context->m_FrameAllocator);
         delete render_context;
 
         return RESULT_OK;
@@ -161,12 +173,78 @@ namespace dmRender
         return render_context->m_ScriptContext;
     }
 
+    void NewFrame(HRenderContext render_context)
+    {
+        dmFrameAllocator::HAllocator allocator = render_context->m_FrameAllocator;
+        dmFrameAllocator::Stats stats;
+        dmFrameAllocator::GetStats(allocator, &stats);
+        DM_COUNTER("FrameMemory", stats.m_Used);
+        DM_COUNTER("FrameMemoryOverflow", stats.m_Overflow);
+        if (stats.m_Overflow > 0 && !render_context->m_OutOfFrameMemory)
+        {
+            dmLogWarning("Out of frame memory (%u KB needed, %u KB available). Increase graphics.frame_memory_size to avoid heap allocations.", (stats.m_HighWaterMark + 1023) / 1024, stats.m_FrameSize / 1024);
+            render_context->m_OutOfFrameMemory = 1;
+        }
+        dmFrameAllocator::NewFrame(allocator);
+    }
+
     void RenderListBegin(HRenderContext render_context)
     {
-        render_context->m_RenderList.SetSize(0);
-        render_context->m_RenderListSortIndices.SetSize(0);
+        dmFrameAllocator::HAllocator allocator = render_context->m_FrameAllocator;
+
+        // Start with room for as many entries as the largest render list so far. Other frame memory is allocated
+        // between the submits, so the list can't grow in place and is moved when it grows.
+        // The sort buffers are allocated when drawing.
+        render_context->m_RenderListHighWaterMark = dmMath::Max(render_context->m_RenderListHighWaterMark, render_context->m_RenderList.Size());
+        dmFrameAllocator::ResetArray(render_context->m_RenderList);
+        dmFrameAllocator::SetCapacity(allocator, render_context->m_RenderList, dmMath::Max<uint32_t>(256, render_context->m_RenderListHighWaterMark));
+        dmFrameAllocator::ResetArray(render_context->m_RenderListSortValues);
+        dmFrameAllocator::ResetArray(render_context->m_RenderListSortBuffer);
         render_context->m_RenderListDispatch.SetSize(0);
-        render_context->m_RenderListRanges.SetSize(0);
+
+        // Keep the buckets (and their capacity) of the tag masks used last frame
+        dmArray<RenderListBucket*>& buckets = render_context->m_RenderListBuckets;
+        uint32_t used = 0;
+        for (uint32_t i = 0; i < buckets.Size(); ++i)
+        {
+            RenderListBucket* bucket = buckets[i];
+            if (bucket->m_Indices.Empty())
+            {
+                delete bucket;
+                continue;
+            }
+            bucket->m_Indices.SetSize(0);
+            buckets[used++] = bucket;
+        }
+        buckets.SetSize(used);
+    }
+
+    static RenderListBucket* GetRenderListBucket(HRenderContext render_context, uint32_t tag_mask)
+    {
+        // Buckets are sorted on tag mask, so that entries are visited in the same order as a (stable) sort on tag mask
+        dmArray<RenderListBucket*>& buckets = render_context->m_RenderListBuckets;
+        uint32_t i = 0;
+        for (; i < buckets.Size(); ++i)
+        {
+            if (buckets[i]->m_TagMask == tag_mask)
+                return buckets[i];
+            if (buckets[i]->m_TagMask > tag_mask)
+                break;
+        }
+
+        RenderListBucket* bucket = new RenderListBucket;
+        bucket->m_TagMask = tag_mask;
+        if (buckets.Full())
+        {
+            buckets.OffsetCapacity(16);
+        }
+        buckets.SetSize(buckets.Size() + 1);
+        for (uint32_t j = buckets.Size() - 1; j > i; --j)
+        {
+            buckets[j] = buckets[j - 1];
+        }
+        buckets[i] = bucket;
+        return bucket;
     }
 
     HRenderListDispatch RenderListMakeDispatch(HRenderContext render_context, RenderListDispatchFn fn, void *user_data)
@@ -196,9 +274,9 @@ namespace dmRender
 
         if (render_list.Remaining() < entries)
         {
-            const uint32_t needed = entries - render_list.Remaining();
-            render_list.OffsetCapacity(dmMath::Max<uint32_t>(256, needed));
-            render_context->m_RenderListSortIndices.SetCapacity(render_list.Capacity());
+            // Doubled so that a frame with a larger list than before moves it only a few times
+            const uint32_t capacity = dmMath::Max(render_list.Capacity() * 2, render_list.Size() + entries);
+            dmFrameAllocator::SetCapacity(render_context->m_FrameAllocator, render_list, capacity);
         }
 
         uint32_t size = render_list.Size();
@@ -212,21 +290,24 @@ namespace dmRender
         if (end == begin) {
             return;
         }
-        // Insert the used up indices into the sort buffer.
-        assert(end - begin <= (intptr_t)render_context->m_RenderListSortIndices.Remaining());
         assert(end <= render_context->m_RenderList.End());
 
-        // Transform pointers back to indices.
+        // Transform pointers back to indices, and put them in the bucket of their tag mask
+        // so that each predicate only needs to visit its own entries.
         RenderListEntry *base = render_context->m_RenderList.Begin();
-        uint32_t *insert = render_context->m_RenderListSortIndices.End();
-
+        RenderListBucket* bucket = 0;
         for (RenderListEntry* i=begin;i!=end;i++)
-            *insert++ = i - base;
-
-        render_context->m_RenderListSortIndices.SetSize(render_context->m_RenderListSortIndices.Size() + (end - begin));
+        {
+            if (bucket == 0 || bucket->m_TagMask != i->m_TagMask)
+                bucket = GetRenderListBucket(render_context, i->m_TagMask);
 
-        // invalidate the ranges if this is a call to the debug rendering (happening in the middle of the frame)
-        render_context->m_RenderListRanges.SetSize(0);
+            dmArray<uint32_t>& indices = bucket->m_Indices;
+            if (indices.Full())
+            {
+                indices.OffsetCapacity(dmMath::Max<uint32_t>(256, indices.Capacity()));
+            }
+            indices.Push(i - base);
+        }
     }
 
     struct RenderListSorter
@@ -258,6 +339,11 @@ namespace dmRender
         return render_context->m_GraphicsContext;
     }
 
+    dmFrameAllocator::HAllocator GetFrameAllocator(HRenderContext render_context)
+    {
+        return render_context->m_FrameAllocator;
+    }
+
     const Matrix4& GetViewProjectionMatrix(HRenderContext render_context)
     {
         return render_context->m_ViewProj;
@@ -310,10 +396,29 @@ namespace dmRender
         return RESULT_OK;
     }
 
+    static bool StencilTestParamsEqual(const StencilTestParams& a, const StencilTestParams& b)
+    {
+        return a.m_Func == b.m_Func &&
+               a.m_OpSFail == b.m_OpSFail &&
+               a.m_OpDPFail == b.m_OpDPFail &&
+               a.m_OpDPPass == b.m_OpDPPass &&
+               a.m_Ref == b.m_Ref &&
+               a.m_RefMask == b.m_RefMask &&
+               a.m_BufferMask == b.m_BufferMask &&
+               a.m_ColorBufferMask == b.m_ColorBufferMask;
+    }
+
     static void ApplyStencilTest(HRenderContext render_context, const RenderObject* ro)
     {
         dmGraphics::HContext graphics_context = dmRender::GetGraphicsContext(render_context);
         const StencilTestParams& stp = ro->m_StencilTestParams;
+        RenderStateCache& cache = render_context->m_StateCache;
+        if (!stp.m_ClearBuffer && cache.m_StencilTestSet && StencilTestParamsEqual(stp, cache.m_StencilTestParams))
+        {
+            return;
+        }
+        cache.m_StencilTestParams = stp;
+        cache.m_StencilTestSet = cache.m_Active;
         if (stp.m_ClearBuffer)
         {
             if (render_context->m_StencilBufferCleared)
@@ -335,9 +440,46 @@ namespace dmRender
         dmGraphics::SetStencilOp(graphics_context, stp.m_OpSFail, stp.m_OpDPFail, stp.m_OpDPPass);
     }
 
-    void ApplyRenderObjectConstants(HRenderContext render_context, HMaterial material, const RenderObject* ro)
+    void SetConstant(HRenderContext render_context, const Vector4* data, uint32_t count, int32_t location)
     {
+        RenderStateCache& cache = render_context->m_StateCache;
+        if (cache.m_Active)
+        {
+            CachedConstant* cached = 0;
+            for (uint32_t i = 0; i < cache.m_ConstantCount; ++i)
+            {
+                if (cache.m_Constants[i].m_Location == location)
+                {
+                    cached = &cache.m_Constants[i];
+                    break;
+                }
+            }
+            if (cached)
+            {
+                if (cached->m_Count == count && memcmp(cached->m_Value, data, sizeof(Vector4) * count) == 0)
+                    return;
+            }
+            else if (cache.m_ConstantCount < MAX_CACHED_CONSTANT_COUNT)
+            {
+                cached = &cache.m_Constants[cache.m_ConstantCount++];
+                cached->m_Location = location;
+            }
+            if (cached)
+            {
+                cached->m_Count = count;
+                memcpy(cached->m_Value, data, sizeof(Vector4) * count);
+            }
+        }
+
         dmGraphics::HContext graphics_context = dmRender::GetGraphicsContext(render_context);
+        if (count == 4)
+            dmGraphics::SetConstantM4(graphics_context, data, location);
+        else
+            dmGraphics::SetConstantV4(graphics_context, data, location);
+    }
+
+    void ApplyRenderObjectConstants(HRenderContext render_context, HMaterial material, const RenderObject* ro)
+    {
         if(!material)
         {
             for (uint32_t i = 0; i < RenderObject::MAX_CONSTANT_COUNT; ++i)
@@ -345,7 +487,7 @@ namespace dmRender
                 const Constant* c = &ro->m_Constants[i];
                 if (c->m_Location != -1)
                 {
-                    dmGraphics::SetConstantV4(graphics_context, &c->m_Value, c->m_Location);
+                    SetConstant(render_context, &c->m_Value, 1, c->m_Location);
                 }
             }
             return;
@@ -358,37 +500,23 @@ namespace dmRender
                 int32_t* location = material->m_NameHashToLocation.Get(ro->m_Constants[i].m_NameHash);
                 if (location)
                 {
-                    dmGraphics::SetConstantV4(graphics_context, &c->m_Value, *location);
+                    SetConstant(render_context, &c->m_Value, 1, *location);
                 }
             }
         }
     }
 
-    // For unit testing only
-    bool FindTagMaskRange(RenderListRange* ranges, uint32_t num_ranges, uint32_t tag_mask, RenderListRange& range)
-    {
-        for( uint32_t i = 0; i < num_ranges; ++i)
-        {
-            if(ranges[i].m_TagMask == tag_mask)
-            {
-                range = ranges[i];
-                return true;
-            }
-        }
-        return false;
-    }
-
     // Compute new sort values for everything that matches tag_mask
     static void MakeSortBuffer(HRenderContext context, uint32_t tag_mask)
     {
         DM_PROFILE(Render, "MakeSortBuffer");
 
-        const uint32_t required_capacity = context->m_RenderListSortIndices.Capacity();
-        // SetCapacity does early out if they are the same, so just call anyway.
-        context->m_RenderListSortBuffer.SetCapacity(required_capacity);
+        const uint32_t required_capacity = context->m_RenderList.Size();
+        // Does early out if the capacity is enough, e.g. when drawing several predicates
+        dmFrameAllocator::SetCapacity(context->m_FrameAllocator, context->m_RenderListSortBuffer, required_capacity);
         context->m_RenderListSortBuffer.SetSize(0);
-        context->m_RenderListSortValues.SetCapacity(required_capacity);
-        context->m_RenderListSortValues.SetSize(context->m_RenderListSortIndices.Size());
+        dmFrameAllocator::SetCapacity(context->m_FrameAllocator, context->m_RenderListSortValues, required_capacity);
+        context->m_RenderListSortValues.SetSize(context->m_RenderList.Size());
 
         RenderListSortValue* sort_values = context->m_RenderListSortValues.Begin();
         RenderListEntry* entries = context->m_RenderList.Begin();
@@ -398,18 +526,20 @@ namespace dmRender
         float minZW = FLT_MAX;
         float maxZW = -FLT_MAX;
 
-        RenderListRange* ranges = context->m_RenderListRanges.Begin();
-        uint32_t num_ranges = context->m_RenderListRanges.Size();
-        for( uint32_t i = 0; i < num_ranges; ++i)
+        RenderListBucket** buckets = context->m_RenderListBuckets.Begin();
+        uint32_t num_buckets = context->m_RenderListBuckets.Size();
+        for( uint32_t i = 0; i < num_buckets; ++i)
         {
-            RenderListRange& range = ranges[i];
-            if ( (range.m_TagMask & tag_mask) != tag_mask )
+            RenderListBucket* bucket = buckets[i];
+            if ( (bucket->m_TagMask & tag_mask) != tag_mask )
                 continue;
 
             // Write z values...
-            for (uint32_t i = range.m_Start; i < range.m_Start+range.m_Count; ++i)
+            const uint32_t* indices = bucket->m_Indices.Begin();
+            const uint32_t count = bucket->m_Indices.Size();
+            for (uint32_t i = 0; i < count; ++i)
             {
-                uint32_t idx = context->m_RenderListSortIndices[i];
+                uint32_t idx = indices[i];
                 RenderListEntry* entry = &entries[idx];
                 if (entry->m_MajorOrder != RENDER_ORDER_WORLD)
                     continue; // Could perhaps break here, if we also sorted on the major order (cost more when I tested it /MAWE)
@@ -427,15 +557,17 @@ namespace dmRender
         if (maxZW > minZW)
             rc = 1.0f / (maxZW - minZW);
 
-        for( uint32_t i = 0; i < num_ranges; ++i)
+        for( uint32_t i = 0; i < num_buckets; ++i)
         {
-            RenderListRange& range = ranges[i];
-            if ( (range.m_TagMask & tag_mask) != tag_mask )
+            RenderListBucket* bucket = buckets[i];
+            if ( (bucket->m_TagMask & tag_mask) != tag_mask )
                 continue;
 
-            for (uint32_t i = range.m_Start; i < range.m_Start+range.m_Count; ++i)
+            const uint32_t* indices = bucket->m_Indices.Begin();
+            const uint32_t count = bucket->m_Indices.Size();
+            for (uint32_t i = 0; i < count; ++i)
             {
-                uint32_t idx = context->m_RenderListSortIndices[i];
+                uint32_t idx = indices[i];
                 RenderListEntry* entry = &entries[idx];
 
                 sort_values[idx].m_MajorOrder = entry->m_MajorOrder;
@@ -457,60 +589,52 @@ namespace dmRender
         }
     }
 
-    static void CollectRenderEntryRange(void* _ctx, uint32_t tag_mask, size_t start, size_t count)
-    {
-        HRenderContext context = (HRenderContext)_ctx;
-        if (context->m_RenderListRanges.Full())
-        {
-            context->m_RenderListRanges.SetCapacity(context->m_RenderListRanges.Capacity() + 16);
-        }
-        RenderListRange range;
-        range.m_TagMask = tag_mask;
-        range.m_Start = start;
-        range.m_Count = count;
-        context->m_RenderListRanges.Push(range);
-    }
-
-    void FindRenderListRanges(uint32_t* first, size_t offset, size_t size, RenderListEntry* entries, FindRangeComparator& comp, void* ctx, RangeCallback callback )
-    {
-        if (size == 0)
-            return;
-
-        size_t half = size >> 1;
-        uint32_t* low = first + offset;
-        uint32_t* high = low + size;
-        uint32_t* middle = low + half;
-        uint32_t val = entries[*middle].m_TagMask;
-
-        low = std::lower_bound(low, middle, *middle, comp);
-        high = std::upper_bound(middle, high, *middle, comp);
-
-        callback(ctx, val, low - first, high - low);
-
-        uint32_t* rangefirst = first + offset;
-        FindRenderListRanges(first, offset, low - rangefirst, entries, comp, ctx, callback);
-        FindRenderListRanges(first, high - first, size - (high - rangefirst), entries, comp, ctx, callback);
-    }
-
+    // Components that submit their entries in render order (e.g. sprites kept sorted across frames) produce
+    // long sorted runs in the sort buffer. A few runs are merged, which is linear for an already sorted buffer,
+    // while many short runs fall back to a full sort. Both are stable.
     static void SortRenderList(HRenderContext context)
     {
-        DM_PROFILE(Render, "SortRenderList");
+        DM_PROFILE(Render, "DrawRenderList_SORT");
 
-        if (context->m_RenderList.Empty())
-            return;
+        RenderListSorter sort;
+        sort.values = context->m_RenderListSortValues.Begin();
+        uint32_t* buffer = context->m_RenderListSortBuffer.Begin();
+        uint32_t count = context->m_RenderListSortBuffer.Size();
 
-        // First sort on the tag masks
+        dmArray<uint32_t>& runs = context->m_RenderListSortRuns;
+        runs.SetSize(0);
+        for (uint32_t i = 0; i < count; ++i)
         {
-            RenderListEntrySorter sort;
-            sort.m_Base = context->m_RenderList.Begin();
-            std::stable_sort(context->m_RenderListSortIndices.Begin(), context->m_RenderListSortIndices.End(), sort);
+            if (i == 0 || sort(buffer[i], buffer[i-1]))
+            {
+                if (runs.Size() > MAX_RENDER_LIST_MERGE_RUNS)
+                {
+                    std::stable_sort(buffer, buffer + count, sort);
+                    return;
+                }
+                if (runs.Full())
+                    runs.OffsetCapacity(MAX_RENDER_LIST_MERGE_RUNS + 2);
+                runs.Push(i);
+            }
         }
-        // Now find the ranges of tag masks
+        runs.Push(count);
+
+        DM_COUNTER("RenderListSortRuns", runs.Size() - 1);
+
+        // Merge neighbouring runs pairwise until there is only one left
+        while (runs.Size() > 2)
         {
-            RenderListEntry* entries = context->m_RenderList.Begin();
-            FindRangeComparator comp;
-            comp.m_Entries = entries;
-            FindRenderListRanges(context->m_RenderListSortIndices.Begin(), 0, context->m_RenderListSortIndices.Size(), entries, comp, context, CollectRenderEntryRange);
+            uint32_t merged = 0;
+            uint32_t i = 0;
+            for (; i + 2 < runs.Size(); i += 2)
+            {
+                std::inplace_merge(buffer + runs[i], buffer + runs[i+1], buffer + runs[i+2], sort);
+                runs[merged++] = runs[i];
+            }
+            if (i + 1 < runs.Size())
+                runs[merged++] = runs[i];
+            runs[merged++] = count;
+            runs.SetSize(merged);
         }
     }
 
@@ -527,23 +651,12 @@ namespace dmRender
         if (predicate != 0x0)
             tag_mask = ConvertMaterialTagsToMask(&predicate->m_Tags[0], predicate->m_TagCount);
 
-        // Cleared once per frame
-        if (context->m_RenderListRanges.Empty())
-        {
-            SortRenderList(context);
-        }
-
         MakeSortBuffer(context, tag_mask);
 
         if (context->m_RenderListSortBuffer.Empty())
             return RESULT_OK;
 
-        {
-            DM_PROFILE(Render, "DrawRenderList_SORT");
-            RenderListSorter sort;
-            sort.values = context->m_RenderListSortValues.Begin();
-            std::stable_sort(context->m_RenderListSortBuffer.Begin(), context->m_RenderListSortBuffer.End(), sort);
-        }
+        SortRenderList(context);
 
         // Construct render objects
         context->m_RenderObjects.SetSize(0);
@@ -607,6 +720,115 @@ namespace dmRender
         return Draw(context, predicate, constant_buffer);
     }
 
+    static void BeginStateCache(HRenderContext render_context)
+    {
+        RenderStateCache& cache = render_context->m_StateCache;
+        memset(&cache, 0, sizeof(cache));
+        cache.m_Active = 1;
+    }
+
+    // Unbinds what the last draw left bound, matching the state after an uncached Draw
+    static void EndStateCache(HRenderContext render_context)
+    {
+        dmGraphics::HContext context = dmRender::GetGraphicsContext(render_context);
+        RenderStateCache& cache = render_context->m_StateCache;
+        if (cache.m_VertexDeclaration)
+            dmGraphics::DisableVertexDeclaration(context, cache.m_VertexDeclaration);
+        for (uint32_t i = 0; i < RenderObject::MAX_TEXTURE_COUNT; ++i)
+        {
+            if (cache.m_Textures[i])
+                dmGraphics::DisableTexture(context, i, cache.m_Textures[i]);
+        }
+        cache.m_Active = 0;
+    }
+
+    static void ApplyProgram(HRenderContext render_context, HMaterial material)
+    {
+        RenderStateCache& cache = render_context->m_StateCache;
+        dmGraphics::HProgram program = GetMaterialProgram(material);
+        if (program != cache.m_Program)
+        {
+            dmGraphics::EnableProgram(dmRender::GetGraphicsContext(render_context), program);
+            cache.m_Program = program;
+            // Constant values are program state
+            cache.m_ConstantCount = 0;
+        }
+    }
+
+    static void ApplyTextures(HRenderContext render_context, HMaterial material, const RenderObject* ro)
+    {
+        dmGraphics::HContext context = dmRender::GetGraphicsContext(render_context);
+        RenderStateCache& cache = render_context->m_StateCache;
+        for (uint32_t i = 0; i < RenderObject::MAX_TEXTURE_COUNT; ++i)
+        {
+            dmGraphics::HTexture texture = ro->m_Textures[i];
+            if (render_context->m_Textures[i])
+                texture = render_context->m_Textures[i];
+
+            if (!texture)
+            {
+                if (cache.m_Textures[i])
+                {
+                    dmGraphics::DisableTexture(context, i, cache.m_Textures[i]);
+                    cache.m_Textures[i] = 0;
+                }
+                continue;
+            }
+
+            if (texture == cache.m_Textures[i] && material == cache.m_SamplerMaterials[i] && texture == cache.m_SamplerTextures[i])
+                continue;
+
+            // Always bind before applying the sampler, the texture parameters are set on the active unit
+            dmGraphics::EnableTexture(context, i, texture);
+            ApplyMaterialSampler(render_context, material, i, texture);
+            cache.m_Textures[i] = texture;
+            cache.m_SamplerMaterials[i] = material;
+            cache.m_SamplerTextures[i] = texture;
+
+            // The texture parameters might have changed under another unit's cached sampler state
+            for (uint32_t j = 0; j < RenderObject::MAX_TEXTURE_COUNT; ++j)
+            {
+                if (j != i && cache.m_SamplerTextures[j] == texture)
+                {
+                    cache.m_SamplerMaterials[j] = 0;
+                    cache.m_SamplerTextures[j] = 0;
+                }
+            }
+        }
+    }
+
+    static void ApplyVertexDeclaration(HRenderContext render_context, HMaterial material, const RenderObject* ro)
+    {
+        dmGraphics::HContext context = dmRender::GetGraphicsContext(render_context);
+        RenderStateCache& cache = render_context->m_StateCache;
+        dmGraphics::HProgram program = GetMaterialProgram(material);
+        // The attribute locations depend on the program
+        if (ro->m_VertexDeclaration == cache.m_VertexDeclaration && ro->m_VertexBuffer == cache.m_VertexBuffer && program == cache.m_VertexProgram)
+            return;
+
+        if (cache.m_VertexDeclaration)
+            dmGraphics::DisableVertexDeclaration(context, cache.m_VertexDeclaration);
+        dmGraphics::EnableVertexDeclaration(context, ro->m_VertexDeclaration, ro->m_VertexBuffer, program);
+        cache.m_VertexDeclaration = ro->m_VertexDeclaration;
+        cache.m_VertexBuffer = ro->m_VertexBuffer;
+        cache.m_VertexProgram = program;
+    }
+
+    // The instance streams are not cached, they are rarely shared between render objects
+    static void DrawInstanced(dmGraphics::HContext context, HMaterial material, const RenderObject* ro)
+    {
+        if (ro->m_InstanceVertexDeclaration)
+            dmGraphics::EnableInstanceVertexDeclaration(context, ro->m_InstanceVertexDeclaration, ro->m_InstanceVertexBuffer, GetMaterialProgram(material));
+
+        if (ro->m_IndexBuffer)
+            dmGraphics::DrawElementsInstanced(context, ro->m_PrimitiveType, ro->m_VertexStart, ro->m_VertexCount, ro->m_IndexType, ro->m_IndexBuffer, ro->m_InstanceCount);
+        else
+            dmGraphics::DrawInstanced(context, ro->m_PrimitiveType, ro->m_VertexStart, ro->m_VertexCount, ro->m_InstanceCount);
+
+        if (ro->m_InstanceVertexDeclaration)
+            dmGraphics::DisableInstanceVertexDeclaration(context, ro->m_InstanceVertexDeclaration);
+    }
+
     Result Draw(HRenderContext render_context, Predicate* predicate, HNamedConstantBuffer constant_buffer)
     {
         if (render_context == 0x0)
@@ -617,12 +839,14 @@ namespace dmRender
             tag_mask = ConvertMaterialTagsToMask(&predicate->m_Tags[0], predicate->m_TagCount);
 
         dmGraphics::HContext context = dmRender::GetGraphicsContext(render_context);
+        RenderStateCache& cache = render_context->m_StateCache;
+        BeginStateCache(render_context);
 
         HMaterial material = render_context->m_Material;
         HMaterial context_material = render_context->m_Material;
         if(context_material)
         {
-            dmGraphics::EnableProgram(context, GetMaterialProgram(context_material));
+            ApplyProgram(render_context, context_material);
         }
 
         for (uint32_t i = 0; i < render_context->m_RenderObjects.Size(); ++i)
@@ -633,11 +857,8 @@ namespace dmRender
             {
                 if (!context_material)
                 {
-                    if(material != ro->m_Material)
-                    {
-                        material = ro->m_Material;
-                        dmGraphics::EnableProgram(context, GetMaterialProgram(material));
-                    }
+                    material = ro->m_Material;
+                    ApplyProgram(render_context, material);
                 }
 
                 ApplyMaterialConstants(render_context, material, ro);
@@ -647,44 +868,33 @@ namespace dmRender
                     ApplyNamedConstantBuffer(render_context, material, constant_buffer);
 
                 if (ro->m_SetBlendFactors)
-                    dmGraphics::SetBlendFunc(context, ro->m_SourceBlendFactor, ro->m_DestinationBlendFactor);
-
-                if (ro->m_SetStencilTest)
-                    ApplyStencilTest(render_context, ro);
-
-                for (uint32_t i = 0; i < RenderObject::MAX_TEXTURE_COUNT; ++i)
                 {
-                    dmGraphics::HTexture texture = ro->m_Textures[i];
-                    if (render_context->m_Textures[i])
-                        texture = render_context->m_Textures[i];
-                    if (texture)
+                    if (!cache.m_BlendFactorsSet || cache.m_SourceBlendFactor != ro->m_SourceBlendFactor || cache.m_DestinationBlendFactor != ro->m_DestinationBlendFactor)
                     {
-                        dmGraphics::EnableTexture(context, i, texture);
-                        ApplyMaterialSampler(render_context, material, i, texture);
+                        dmGraphics::SetBlendFunc(context, ro->m_SourceBlendFactor, ro->m_DestinationBlendFactor);
+                        cache.m_SourceBlendFactor = ro->m_SourceBlendFactor;
+                        cache.m_DestinationBlendFactor = ro->m_DestinationBlendFactor;
+                        cache.m_BlendFactorsSet = 1;
                     }
-
                 }
 
-                dmGraphics::EnableVertexDeclaration(context, ro->m_VertexDeclaration, ro->m_VertexBuffer, GetMaterialProgram(material));
+                if (ro->m_SetStencilTest)
+                    ApplyStencilTest(render_context, ro);
 
-                if (ro->m_IndexBuffer)
+                ApplyTextures(render_context, material, ro);
+
+                ApplyVertexDeclaration(render_context, material, ro);
+
+                if (ro->m_InstanceCount > 0)
+                    DrawInstanced(context, material, ro);
+                else if (ro->m_IndexBuffer)
                     dmGraphics::DrawElements(context, ro->m_PrimitiveType, ro->m_VertexStart, ro->m_VertexCount, ro->m_IndexType, ro->m_IndexBuffer);
                 else
                     dmGraphics::Draw(context, ro->m_PrimitiveType, ro->m_VertexStart, ro->m_VertexCount);
-
-                dmGraphics::DisableVertexDeclaration(context, ro->m_VertexDeclaration);
-
-                for (uint32_t i = 0; i < RenderObject::MAX_TEXTURE_COUNT; ++i)
-                {
-                    dmGraphics::HTexture texture = ro->m_Textures[i];
-                    if (render_context->m_Textures[i])
-                        texture = render_context->m_Textures[i];
-                    if (texture)
-                        dmGraphics::DisableTexture(context, i, texture);
-                }
-
             }
         }
+
+        EndStateCache(render_context);
         return RESULT_OK;
     }
 
@@ -794,11 +1004,11 @@ namespace dmRender
 
     struct ApplyContext
     {
-        dmGraphics::HContext m_GraphicsContext;
+        HRenderContext       m_RenderContext;
         HMaterial            m_Material;
-        ApplyContext(dmGraphics::HContext graphics_context, HMaterial material)
+        ApplyContext(HRenderContext render_context, HMaterial material)
         {
-            m_GraphicsContext = graphics_context;
+            m_RenderContext = render_context;
             m_Material = material;
         }
     };
@@ -808,15 +1018,14 @@ namespace dmRender
         int32_t* location = context->m_Material->m_NameHashToLocation.Get(*name_hash);
         if (location)
         {
-            dmGraphics::SetConstantV4(context->m_GraphicsContext, value, *location);
+            SetConstant(context->m_RenderContext, value, 1, *location);
         }
     }
 
     void ApplyNamedConstantBuffer(dmRender::HRenderContext render_context, HMaterial material, HNamedConstantBuffer buffer)
     {
         dmHashTable64<Vectormath::Aos::Vector4>& constants = buffer->m_Constants;
-        dmGraphics::HContext graphics_context = dmRender::GetGraphicsContext(render_context);
-        ApplyContext context(graphics_context, material);
+        ApplyContext context(render_context, material);
         constants.Iterate(ApplyConstant, &context);
     }
 
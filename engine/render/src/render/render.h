@@ -17,6 +17,7 @@
 #include <stdint.h>
 #include <dmsdk/vectormath/cpp/vectormath_aos.h>
 #include <dlib/hash.h>
+#include <dlib/frame_allocator.h>
 #include <script/script.h>
 #include <script/lua_source_ddf.h>
 #include <graphics/graphics.h>
@@ -134,6 +135,9 @@ namespace dmRender
         dmGraphics::HVertexBuffer       m_VertexBuffer;
         dmGraphics::HVertexDeclaration  m_VertexDeclaration;
         dmGraphics::HIndexBuffer        m_IndexBuffer;
+        /// Per-instance streams, only used when m_InstanceCount > 0
+        dmGraphics::HVertexBuffer       m_InstanceVertexBuffer;
+        dmGraphics::HVertexDeclaration  m_InstanceVertexDeclaration;
         HMaterial                       m_Material;
         dmGraphics::HTexture            m_Textures[MAX_TEXTURE_COUNT];
         dmGraphics::PrimitiveType       m_PrimitiveType;
@@ -143,6 +147,8 @@ namespace dmRender
         StencilTestParams               m_StencilTestParams;
         uint32_t                        m_VertexStart;
         uint32_t                        m_VertexCount;
+        /// Draws the object this many times in a single instanced draw call. Zero for a regular draw call
+        uint32_t                        m_InstanceCount;
         uint8_t                         m_VertexConstantMask;
         uint8_t                         m_FragmentConstantMask;
         uint8_t                         m_SetBlendFactors : 1;
@@ -167,6 +173,8 @@ namespace dmRender
         /// Max debug vertex count
         /// NOTE: This is per debug-type and not the total sum
         uint32_t                        m_MaxDebugVertexCount;
+        /// Size of each of the two buffers of the frame allocator
+        uint32_t                        m_FrameMemorySize;
     };
 
     enum RenderOrder
@@ -217,6 +225,18 @@ namespace dmRender
 
     dmScript::HContext GetScriptContext(HRenderContext render_context);
 
+    /**
+     * Start a new frame, call once per frame before the first RenderListBegin. Reports the frame memory
+     * used by the previous frame and releases the memory allocated the frame before that.
+     * @param render_context Render context
+     */
+    void NewFrame(HRenderContext render_context);
+
+    /**
+     * Start a new render list. May be called several times per frame, the render lists of a frame
+     * all use the frame memory of that frame.
+     * @param render_context Render context
+     */
     void RenderListBegin(HRenderContext render_context);
     HRenderListDispatch RenderListMakeDispatch(HRenderContext render_context, RenderListDispatchFn fn, void *user_data);
     RenderListEntry* RenderListAlloc(HRenderContext render_context, uint32_t entries);
@@ -227,6 +247,14 @@ namespace dmRender
 
     dmGraphics::HContext GetGraphicsContext(HRenderContext render_context);
 
+    /**
+     * Get the allocator for scratch memory that is only needed for a frame. It is reset at NewFrame,
+     * memory allocated one frame stays valid until NewFrame is called twice.
+     * @param render_context Render context
+     * @return Frame allocator
+     */
+    dmFrameAllocator::HAllocator GetFrameAllocator(HRenderContext render_context);
+
     const Matrix4& GetViewProjectionMatrix(HRenderContext render_context);
     void SetViewMatrix(HRenderContext render_context, const Matrix4& view);
     void SetProjectionMatrix(HRenderContext render_context, const Matrix4& projection);
@@ -336,6 +364,9 @@ namespace dmRender
     bool                            GetMaterialProgramConstantElement(HMaterial material, dmhash_t name_hash, uint32_t element_index, float& out_value);
     void                            SetMaterialProgramConstant(HMaterial material, dmhash_t name_hash, Vectormath::Aos::Vector4 constant);
     int32_t                         GetMaterialConstantLocation(HMaterial material, dmhash_t name_hash);
+    int32_t                         GetMaterialAttributeLocation(HMaterial material, const char* name);
+    // The attribute locations are cached, and must be cleared when the program is reloaded
+    void                            ClearMaterialAttributeLocations(HMaterial material);
     void                            SetMaterialSampler(HMaterial material, dmhash_t name_hash, uint32_t unit, dmGraphics::TextureWrap u_wrap, dmGraphics::TextureWrap v_wrap, dmGraphics::TextureFilter min_filter, dmGraphics::TextureFilter mag_filter);
     HRenderContext                  GetMaterialRenderContext(HMaterial material);
     dmRenderDDF::MaterialDesc::VertexSpace GetMaterialVertexSpace(HMaterial material);
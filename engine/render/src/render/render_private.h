@@ -78,6 +78,7 @@ namespace dmRender
         dmGraphics::HVertexProgram              m_VertexProgram;
         dmGraphics::HFragmentProgram            m_FragmentProgram;
         dmHashTable64<int32_t>                  m_NameHashToLocation;
+        dmHashTable64<int32_t>                  m_AttributeLocations;
         dmArray<MaterialConstant>               m_Constants;
         dmArray<Sampler>                        m_Samplers;
         uint32_t                                m_TagMask;
@@ -194,13 +195,48 @@ namespace dmRender
         };
     };
 
-    struct RenderListRange
+    // Sort buffers made of more already sorted runs than this are sorted from scratch instead of merged
+    const static uint32_t MAX_RENDER_LIST_MERGE_RUNS = 32;
+
+    struct RenderListBucket
+    {
+        dmArray<uint32_t>   m_Indices;  // Indices into the render list, in submission order
+        uint32_t            m_TagMask;
+    };
+
+    const static uint32_t MAX_CACHED_CONSTANT_COUNT = 32;
+
+    struct CachedConstant
     {
-        uint32_t m_TagMask;
-        uint32_t m_Start;   // Index into the renderlist
+        Vector4  m_Value[4];
+        int32_t  m_Location;
         uint32_t m_Count;
     };
 
+    // Graphics state set by the Draw in progress, used to skip redundant state changes.
+    // Only valid while m_Active is set, the state is unknown between Draw calls
+    struct RenderStateCache
+    {
+        dmGraphics::HProgram            m_Program;
+        dmGraphics::HVertexDeclaration  m_VertexDeclaration;
+        dmGraphics::HVertexBuffer       m_VertexBuffer;
+        // Program the vertex declaration was enabled for
+        dmGraphics::HProgram            m_VertexProgram;
+        dmGraphics::HTexture            m_Textures[RenderObject::MAX_TEXTURE_COUNT];
+        // Material and texture the sampler state of each unit was last applied for
+        HMaterial                       m_SamplerMaterials[RenderObject::MAX_TEXTURE_COUNT];
+        dmGraphics::HTexture            m_SamplerTextures[RenderObject::MAX_TEXTURE_COUNT];
+        dmGraphics::BlendFactor         m_SourceBlendFactor;
+        dmGraphics::BlendFactor         m_DestinationBlendFactor;
+        StencilTestParams               m_StencilTestParams;
+        // Constant values of the current program
+        CachedConstant                  m_Constants[MAX_CACHED_CONSTANT_COUNT];
+        uint32_t                        m_ConstantCount;
+        uint32_t                        m_Active : 1;
+        uint32_t                        m_BlendFactorsSet : 1;
+        uint32_t                        m_StencilTestSet : 1;
+    };
+
     struct RenderContext
     {
         dmGraphics::HTexture        m_Textures[RenderObject::MAX_TEXTURE_COUNT];
@@ -211,12 +247,15 @@ namespace dmRender
         dmArray<RenderObject*>      m_RenderObjects;
         dmScript::ScriptWorld*      m_ScriptWorld;
 
+        // Render list and sort buffers are allocated from the frame allocator
+        dmFrameAllocator::HAllocator m_FrameAllocator;
         dmArray<RenderListEntry>    m_RenderList;
+        uint32_t                    m_RenderListHighWaterMark;  // Most entries in a render list so far
         dmArray<RenderListDispatch> m_RenderListDispatch;
         dmArray<RenderListSortValue>m_RenderListSortValues;
         dmArray<uint32_t>           m_RenderListSortBuffer;
-        dmArray<uint32_t>           m_RenderListSortIndices;
-        dmArray<RenderListRange>    m_RenderListRanges;         // Maps tagmask to a range in the (sorted) render list
+        dmArray<uint32_t>           m_RenderListSortRuns;       // Start of each already sorted run in m_RenderListSortBuffer
+        dmArray<RenderListBucket*>  m_RenderListBuckets;        // Submitted entries per tag mask, sorted on tag mask
 
         HFontMap                    m_SystemFontMap;
 
@@ -230,7 +269,10 @@ namespace dmRender
 
         dmMessage::HSocket          m_Socket;
 
+        RenderStateCache            m_StateCache;
+
         uint32_t                    m_OutOfResources : 1;
+        uint32_t                    m_OutOfFrameMemory : 1;
         uint32_t                    m_StencilBufferCleared : 1;
     };
 
@@ -244,35 +286,8 @@ namespace dmRender
 
     void ApplyRenderObjectConstants(HRenderContext render_context, HMaterial material, const struct RenderObject* ro);
 
-
-    // Exposed here for unit testing
-    struct RenderListEntrySorter
-    {
-        bool operator()(int a, int b) const
-        {
-            // Sort them on tag mask first, then render order (due to costly z calculations)
-            const RenderListEntry& ea = m_Base[a];
-            const RenderListEntry& eb = m_Base[b];
-            return ea.m_TagMask < eb.m_TagMask;
-        }
-        RenderListEntry* m_Base;
-    };
-
-    struct FindRangeComparator
-    {
-        RenderListEntry* m_Entries;
-        bool operator() (const uint32_t& a, const uint32_t& b) const
-        {
-            return m_Entries[a].m_TagMask < m_Entries[b].m_TagMask;
-        }
-    };
-
-    typedef void (*RangeCallback)(void* ctx, uint32_t val, size_t start, size_t count);
-
-    // Invokes the callback for each range. Two ranges are not guaranteed to preceed/succeed one another.
-    void FindRenderListRanges(uint32_t* first, size_t offset, size_t size, RenderListEntry* entries, FindRangeComparator& comp, void* ctx, RangeCallback callback );
-
-    bool FindTagMaskRange(RenderListRange* ranges, uint32_t num_ranges, uint32_t tag_mask, RenderListRange& range);
+    // Sets a vector (count 1) or matrix (count 4) constant, unless the current program already has the value
+    void SetConstant(HRenderContext render_context, const Vector4* data, uint32_t count, int32_t location);
 }
 
 #endif
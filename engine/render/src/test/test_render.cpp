@@ -15,16 +15,19 @@
 #include <jc_test/jc_test.h>
 #include <dmsdk/vectormath/cpp/vectormath_aos.h>
 
+#include <dlib/dstrings.h>
 #include <dlib/hash.h>
 #include <dlib/math.h>
+#include <dlib/time.h>
 
 #include <script/script.h>
-#include <algorithm> // std::stable_sort
 
 #include "render/render.h"
 #include "render/render_private.h"
 #include "render/font_renderer_private.h"
 
+#include "../../../graphics/src/graphics_private.h"
+
 const static uint32_t WIDTH = 600;
 const static uint32_t HEIGHT = 400;
 
@@ -318,6 +321,137 @@ TEST_F(dmRenderTest, TestRenderListDraw)
     ASSERT_EQ(ctx.m_Z, orders[1]);
 }
 
+TEST_F(dmRenderTest, TestRenderListFrameMemory)
+{
+    TestDrawDispatchCtx ctx;
+    Vectormath::Aos::Matrix4 view = Vectormath::Aos::Matrix4::identity();
+    Vectormath::Aos::Matrix4 proj = Vectormath::Aos::Matrix4::orthographic(0.0f, WIDTH, HEIGHT, 0.0f, 0.1f, 1.0f);
+    dmRender::SetViewMatrix(m_Context, view);
+    dmRender::SetProjectionMatrix(m_Context, proj);
+
+    dmFrameAllocator::HAllocator allocator = dmRender::GetFrameAllocator(m_Context);
+    dmFrameAllocator::Stats stats;
+
+    const uint32_t n = 2000;
+    for (uint32_t frame = 0; frame < 3; ++frame)
+    {
+        memset(&ctx, 0x00, sizeof(TestDrawDispatchCtx));
+        dmRender::NewFrame(m_Context);
+        dmRender::RenderListBegin(m_Context);
+        dmFrameAllocator::GetStats(allocator, &stats);
+        uint32_t used_at_begin = stats.m_Used;
+
+        uint8_t dispatch = dmRender::RenderListMakeDispatch(m_Context, TestDrawDispatch, &ctx);
+
+        // The render list grows in place, so earlier entries stay where they are
+        dmRender::RenderListEntry* first = 0;
+        for (uint32_t i = 0; i < n; i += 100)
+        {
+            dmRender::RenderListEntry* out = dmRender::RenderListAlloc(m_Context, 100);
+            if (first == 0)
+                first = out;
+            ASSERT_EQ(first + i, out);
+            for (uint32_t j = 0; j < 100; ++j)
+            {
+                dmRender::RenderListEntry& entry = out[j];
+                memset(&entry, 0, sizeof(entry));
+                entry.m_WorldPosition = Point3(0, 0, i + j + 1);
+                entry.m_MajorOrder = dmRender::RENDER_ORDER_WORLD;
+                entry.m_BatchKey = j & 3;
+                entry.m_Dispatch = dispatch;
+            }
+            dmRender::RenderListSubmit(m_Context, out, out + 100);
+        }
+
+        // After the first frame the render list starts out large enough
+        dmFrameAllocator::GetStats(allocator, &stats);
+        if (frame > 0)
+            ASSERT_EQ(used_at_begin, stats.m_Used);
+
+        dmRender::RenderListEnd(m_Context);
+        dmRender::DrawRenderList(m_Context, 0, 0);
+        ASSERT_EQ((int) n, ctx.m_EntriesRendered);
+
+        dmFrameAllocator::GetStats(allocator, &stats);
+        ASSERT_LT(n * sizeof(dmRender::RenderListEntry), stats.m_Used);
+        ASSERT_EQ(0u, stats.m_Overflow);
+    }
+}
+
+// Components allocate other frame memory between their submits, so the render list can't grow in place
+TEST_F(dmRenderTest, TestRenderListInterleavedFrameMemory)
+{
+    TestDrawDispatchCtx ctx;
+    dmFrameAllocator::HAllocator allocator = dmRender::GetFrameAllocator(m_Context);
+    dmFrameAllocator::Stats stats;
+
+    const uint32_t n = 2000;
+    const uint32_t scratch_size = 64;
+    for (uint32_t frame = 0; frame < 3; ++frame)
+    {
+        memset(&ctx, 0x00, sizeof(TestDrawDispatchCtx));
+        dmRender::NewFrame(m_Context);
+        dmRender::RenderListBegin(m_Context);
+        dmFrameAllocator::GetStats(allocator, &stats);
+        uint32_t used_at_begin = stats.m_Used;
+
+        uint8_t dispatch = dmRender::RenderListMakeDispatch(m_Context, TestDrawDispatch, &ctx);
+
+        dmRender::RenderListEntry* first = 0;
+        for (uint32_t i = 0; i < n; i += 100)
+        {
+            dmRender::RenderListEntry* out = dmRender::RenderListAlloc(m_Context, 100);
+            if (first == 0)
+                first = out;
+            // After the first frame the list is reserved from the largest one so far and is never moved
+            if (frame > 0)
+                ASSERT_EQ(first + i, out);
+            for (uint32_t j = 0; j < 100; ++j)
+            {
+                dmRender::RenderListEntry& entry = out[j];
+                memset(&entry, 0, sizeof(entry));
+                entry.m_WorldPosition = Point3(0, 0, i + j + 1);
+                entry.m_MajorOrder = dmRender::RENDER_ORDER_WORLD;
+                entry.m_Dispatch = dispatch;
+            }
+            dmRender::RenderListSubmit(m_Context, out, out + 100);
+            ASSERT_NE((void*) 0, dmFrameAllocator::Alloc(allocator, scratch_size));
+        }
+
+        dmFrameAllocator::GetStats(allocator, &stats);
+        if (frame > 0)
+            ASSERT_EQ(used_at_begin + (n / 100) * scratch_size, stats.m_Used);
+
+        dmRender::RenderListEnd(m_Context);
+        dmRender::DrawRenderList(m_Context, 0, 0);
+        ASSERT_EQ((int) n, ctx.m_EntriesRendered);
+        ASSERT_EQ(0u, stats.m_Overflow);
+    }
+}
+
+TEST_F(dmRenderTest, TestRenderListsShareFrameMemory)
+{
+    dmFrameAllocator::HAllocator allocator = dmRender::GetFrameAllocator(m_Context);
+    dmFrameAllocator::Stats stats;
+
+    dmRender::NewFrame(m_Context);
+    dmRender::RenderListBegin(m_Context);
+    dmRender::RenderListEnd(m_Context);
+    dmFrameAllocator::GetStats(allocator, &stats);
+    uint32_t used = stats.m_Used;
+    ASSERT_LT(0u, used);
+
+    // A second render list in the same frame (e.g. the profiler's) doesn't start a new frame
+    dmRender::RenderListBegin(m_Context);
+    dmRender::RenderListEnd(m_Context);
+    dmFrameAllocator::GetStats(allocator, &stats);
+    ASSERT_LT(used, stats.m_Used);
+
+    dmRender::NewFrame(m_Context);
+    dmFrameAllocator::GetStats(allocator, &stats);
+    ASSERT_EQ(0u, stats.m_Used);
+}
+
 struct TestRenderListOrderDispatchCtx
 {
     int m_BeginCalls;
@@ -438,6 +572,74 @@ TEST_F(dmRenderTest, TestRenderListOrder)
     ASSERT_EQ(ctx.m_Z, orders[2]);
 }
 
+struct TestSortedRunsDispatchCtx
+{
+    uint32_t m_EntriesRendered;
+    uint32_t m_OutOfOrder;
+    float    m_Z;
+};
+
+static void TestSortedRunsDispatch(dmRender::RenderListDispatchParams const & params)
+{
+    TestSortedRunsDispatchCtx *ctx = (TestSortedRunsDispatchCtx*) params.m_UserData;
+    if (params.m_Operation != dmRender::RENDER_LIST_OPERATION_BATCH)
+        return;
+    for (uint32_t* i = params.m_Begin; i != params.m_End; ++i)
+    {
+        float z = params.m_Buf[*i].m_WorldPosition.getZ();
+        if (ctx->m_EntriesRendered > 0 && z < ctx->m_Z)
+            ctx->m_OutOfOrder++;
+        ctx->m_Z = z;
+        ctx->m_EntriesRendered++;
+    }
+}
+
+TEST_F(dmRenderTest, TestRenderListSortedRuns)
+{
+    Vectormath::Aos::Matrix4 view = Vectormath::Aos::Matrix4::identity();
+    Vectormath::Aos::Matrix4 proj = Vectormath::Aos::Matrix4::orthographic(0.0f, WIDTH, HEIGHT, 0.0f, -1000.0f, 1000.0f);
+    dmRender::SetViewMatrix(m_Context, view);
+    dmRender::SetProjectionMatrix(m_Context, proj);
+
+    // A single sorted run, a few interleaved sorted runs, and more runs than are merged
+    const uint32_t run_counts[] = {1, 3, 7, dmRender::MAX_RENDER_LIST_MERGE_RUNS + 8};
+    const uint32_t n = 1024;
+    for (uint32_t r = 0; r < sizeof(run_counts) / sizeof(run_counts[0]); ++r)
+    {
+        const uint32_t run_count = run_counts[r];
+        TestSortedRunsDispatchCtx ctx;
+        memset(&ctx, 0, sizeof(ctx));
+
+        dmRender::NewFrame(m_Context);
+        dmRender::RenderListBegin(m_Context);
+        uint8_t dispatch = dmRender::RenderListMakeDispatch(m_Context, TestSortedRunsDispatch, &ctx);
+        for (uint32_t run = 0; run < run_count; ++run)
+        {
+            // Each run is in render order by itself, and overlaps the others in z
+            uint32_t count = n / run_count;
+            dmRender::RenderListEntry* out = dmRender::RenderListAlloc(m_Context, count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                dmRender::RenderListEntry& entry = out[i];
+                entry.m_WorldPosition = Point3(0, 0, (float)(i * run_count + run_count - 1 - run) - 500.0f);
+                entry.m_MajorOrder = dmRender::RENDER_ORDER_WORLD;
+                entry.m_MinorOrder = 0;
+                entry.m_TagMask = 0;
+                entry.m_Order = 0;
+                entry.m_BatchKey = i & 1;
+                entry.m_Dispatch = dispatch;
+                entry.m_UserData = 0;
+            }
+            dmRender::RenderListSubmit(m_Context, out, out + count);
+        }
+        dmRender::RenderListEnd(m_Context);
+        dmRender::DrawRenderList(m_Context, 0, 0);
+
+        ASSERT_EQ((n / run_count) * run_count, ctx.m_EntriesRendered);
+        ASSERT_EQ(0u, ctx.m_OutOfOrder);
+    }
+}
+
 TEST_F(dmRenderTest, TestRenderListDebug)
 {
     // Test submitting debug drawing when there is no other drawing going on
@@ -471,6 +673,145 @@ static float Metric(const char* text, int n)
     ASSERT_EQ(index, lines[i].m_Index);\
     ASSERT_EQ(count, lines[i].m_Count);
 
+struct TestTagDispatchCtx
+{
+    uint32_t m_TagMask;
+    uint32_t m_EntriesRendered;
+    uint32_t m_WrongTagMask;
+    uint32_t m_LastOrder;
+    uint32_t m_OutOfOrder;
+};
+
+static void TestTagDispatch(dmRender::RenderListDispatchParams const & params)
+{
+    TestTagDispatchCtx* ctx = (TestTagDispatchCtx*) params.m_UserData;
+    if (params.m_Operation != dmRender::RENDER_LIST_OPERATION_BATCH)
+        return;
+    for (uint32_t* i = params.m_Begin; i != params.m_End; ++i)
+    {
+        const dmRender::RenderListEntry& entry = params.m_Buf[*i];
+        if ((entry.m_TagMask & ctx->m_TagMask) != ctx->m_TagMask)
+            ctx->m_WrongTagMask++;
+        if (entry.m_Order < ctx->m_LastOrder)
+            ctx->m_OutOfOrder++;
+        ctx->m_LastOrder = entry.m_Order;
+        ctx->m_EntriesRendered++;
+    }
+}
+
+static void SubmitTaggedEntries(dmRender::HRenderContext context, uint8_t dispatch, const uint32_t* tag_masks, uint32_t tag_count, uint32_t first, uint32_t count)
+{
+    dmRender::RenderListEntry* out = dmRender::RenderListAlloc(context, count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        dmRender::RenderListEntry& entry = out[i];
+        entry.m_WorldPosition = Point3(0, 0, 0);
+        entry.m_MajorOrder = dmRender::RENDER_ORDER_AFTER_WORLD;
+        entry.m_MinorOrder = 0;
+        entry.m_TagMask = tag_masks[(first + i) % tag_count];
+        entry.m_Order = first + i;
+        entry.m_BatchKey = 0;
+        entry.m_Dispatch = dispatch;
+        entry.m_UserData = 0;
+    }
+    dmRender::RenderListSubmit(context, out, out + count);
+}
+
+TEST_F(dmRenderTest, TestRenderListTagBuckets)
+{
+    const uint32_t tag_count = 4;
+    const uint32_t n = 64;
+
+    dmhash_t tags[tag_count] = { dmHashString64("bucket0"), dmHashString64("bucket1"), dmHashString64("bucket2"), dmHashString64("bucket3") };
+    uint32_t tag_masks[tag_count];
+    for (uint32_t i = 0; i < tag_count; ++i)
+        tag_masks[i] = dmRender::ConvertMaterialTagsToMask(&tags[i], 1);
+
+    for (uint32_t frame = 0; frame < 2; ++frame)
+    {
+        TestTagDispatchCtx ctx;
+        memset(&ctx, 0, sizeof(ctx));
+
+        dmRender::NewFrame(m_Context);
+        dmRender::RenderListBegin(m_Context);
+        uint8_t dispatch = dmRender::RenderListMakeDispatch(m_Context, TestTagDispatch, &ctx);
+        SubmitTaggedEntries(m_Context, dispatch, tag_masks, tag_count, 0, n / 2);
+        dmRender::RenderListEnd(m_Context);
+
+        dmRender::Predicate predicate;
+        predicate.m_Tags[0] = tags[1];
+        predicate.m_TagCount = 1;
+        ctx.m_TagMask = tag_masks[1];
+        dmRender::DrawRenderList(m_Context, &predicate, 0);
+        ASSERT_EQ(n / 2 / tag_count, ctx.m_EntriesRendered);
+
+        // Entries submitted in the middle of the frame go into the existing buckets
+        SubmitTaggedEntries(m_Context, dispatch, tag_masks, tag_count, n / 2, n / 2);
+        for (uint32_t i = 0; i < tag_count; ++i)
+        {
+            memset(&ctx, 0, sizeof(ctx));
+            predicate.m_Tags[0] = tags[i];
+            ctx.m_TagMask = tag_masks[i];
+            dmRender::DrawRenderList(m_Context, &predicate, 0);
+            ASSERT_EQ(n / tag_count, ctx.m_EntriesRendered);
+            ASSERT_EQ(0u, ctx.m_WrongTagMask);
+            ASSERT_EQ(0u, ctx.m_OutOfOrder);
+        }
+    }
+}
+
+// Measures the cost of drawing the render list with an increasing number of predicates
+TEST_F(dmRenderTest, TestPerfRenderListPredicates)
+{
+    const uint32_t tag_count = 12;
+    const uint32_t n = 24000;
+    const uint32_t frame_count = 20;
+
+    dmhash_t tags[tag_count];
+    uint32_t tag_masks[tag_count];
+    for (uint32_t i = 0; i < tag_count; ++i)
+    {
+        char name[32];
+        dmSnPrintf(name, sizeof(name), "predicate%u", i);
+        tags[i] = dmHashString64(name);
+        tag_masks[i] = dmRender::ConvertMaterialTagsToMask(&tags[i], 1);
+    }
+
+    const uint32_t predicate_counts[] = {1, 4, 8, 12};
+    for (uint32_t p = 0; p < sizeof(predicate_counts) / sizeof(predicate_counts[0]); ++p)
+    {
+        const uint32_t predicate_count = predicate_counts[p];
+        TestTagDispatchCtx ctx;
+        memset(&ctx, 0, sizeof(ctx));
+
+        uint64_t start = dmTime::GetTime();
+        for (uint32_t frame = 0; frame < frame_count; ++frame)
+        {
+            dmRender::NewFrame(m_Context);
+            dmRender::RenderListBegin(m_Context);
+            uint8_t dispatch = dmRender::RenderListMakeDispatch(m_Context, TestTagDispatch, &ctx);
+            SubmitTaggedEntries(m_Context, dispatch, tag_masks, tag_count, 0, n);
+            dmRender::RenderListEnd(m_Context);
+
+            for (uint32_t i = 0; i < predicate_count; ++i)
+            {
+                dmRender::Predicate predicate;
+                predicate.m_Tags[0] = tags[i];
+                predicate.m_TagCount = 1;
+                ctx.m_TagMask = tag_masks[i];
+                ctx.m_LastOrder = 0;
+                dmRender::DrawRenderList(m_Context, &predicate, 0);
+            }
+        }
+        uint64_t elapsed = dmTime::GetTime() - start;
+
+        ASSERT_EQ(frame_count * predicate_count * (n / tag_count), ctx.m_EntriesRendered);
+        ASSERT_EQ(0u, ctx.m_WrongTagMask);
+
+        printf("%u entries, %2u predicates: %.3f ms/frame\n", n, predicate_count, elapsed / (1000.0 * frame_count));
+    }
+}
+
 TEST(dmFontRenderer, Layout)
 {
     const uint32_t lines_count = 256;
@@ -665,101 +1006,199 @@ TEST_F(dmRenderTest, TextAlignment)
     }
 }
 
-struct SRangeCtx
+static inline dmGraphics::ShaderDesc::Shader MakeDDFShader(const char* data, uint32_t count)
 {
-    uint32_t m_NumRanges;
-    dmRender::RenderListRange m_Ranges[16];
-};
+    dmGraphics::ShaderDesc::Shader ddf;
+    memset(&ddf,0,sizeof(ddf));
+    ddf.m_Source.m_Data  = (uint8_t*)data;
+    ddf.m_Source.m_Count = count;
+    return ddf;
+}
 
-static void CollectRenderEntryRange(void* _ctx, uint32_t tag_mask, size_t start, size_t count)
+static dmGraphics::HTexture NewTestTexture(dmGraphics::HContext context)
 {
-    SRangeCtx* ctx = (SRangeCtx*)_ctx;
-    if (ctx->m_NumRanges >= sizeof(ctx->m_Ranges)/sizeof(ctx->m_Ranges[0]))
+    dmGraphics::TextureCreationParams creation_params;
+    creation_params.m_Width = 4;
+    creation_params.m_Height = 4;
+    dmGraphics::TextureParams params;
+    char data[4 * 4] = {0};
+    params.m_Data = data;
+    params.m_DataSize = sizeof(data);
+    params.m_Width = 4;
+    params.m_Height = 4;
+    params.m_Format = dmGraphics::TEXTURE_FORMAT_LUMINANCE;
+    dmGraphics::HTexture texture = dmGraphics::NewTexture(context, creation_params);
+    dmGraphics::SetTexture(texture, params);
+    return texture;
+}
+
+// Draws render objects that share (almost) all state, and checks that the state is only set once
+TEST(dmRenderStateTest, RedundantStateChanges)
+{
+    const uint32_t n = 16;
+
+    dmGraphics::Initialize();
+    dmGraphics::HContext context = dmGraphics::NewContext(dmGraphics::ContextParams());
+    dmRender::RenderContextParams params;
+    params.m_ScriptContext = dmScript::NewContext(0, 0, true);
+    params.m_MaxCharacters = 256;
+    params.m_MaxInstances = n;
+    dmRender::HRenderContext render_context = dmRender::NewRenderContext(context, params);
+
+    dmGraphics::ShaderDesc::Shader vp_shader = MakeDDFShader("uniform vec4 tint;\n", 19);
+    dmGraphics::HVertexProgram vp = dmGraphics::NewVertexProgram(context, &vp_shader);
+    dmGraphics::ShaderDesc::Shader fp_shader = MakeDDFShader("foo", 3);
+    dmGraphics::HFragmentProgram fp = dmGraphics::NewFragmentProgram(context, &fp_shader);
+    dmRender::HMaterial material = dmRender::NewMaterial(render_context, vp, fp);
+
+    dmGraphics::HTexture textures[2] = { NewTestTexture(context), NewTestTexture(context) };
+
+    float v[] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f };
+    dmGraphics::VertexElement ve[] =
     {
-        return;
-    }
-    dmRender::RenderListRange& range = ctx->m_Ranges[ctx->m_NumRanges++];
-    range.m_TagMask = tag_mask;
-    range.m_Start = start;
-    range.m_Count = count;
-}
-
-TEST_F(dmRenderTest, FindRanges)
-{
-    // Create unsorted list
-    const uint32_t count = 32; // Large enough to avoid the initial intro sort
-    dmRender::RenderListEntry entries[count];
-    uint32_t indices[count];
-    for( uint32_t i = 0; i < count; ++i) {
-        indices[i] = i;
-        entries[i].m_Order = i;
-        entries[i].m_TagMask = i % 5;
+        {"position", 0, 3, dmGraphics::TYPE_FLOAT, false },
+    };
+    dmGraphics::HVertexDeclaration vd = dmGraphics::NewVertexDeclaration(context, ve, 1);
+    dmGraphics::HVertexBuffer vb = dmGraphics::NewVertexBuffer(context, sizeof(v), v, dmGraphics::BUFFER_USAGE_STREAM_DRAW);
+
+    dmRender::RenderObject ros[n];
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        dmRender::RenderObject& ro = ros[i];
+        ro.m_Material = material;
+        ro.m_VertexDeclaration = vd;
+        ro.m_VertexBuffer = vb;
+        ro.m_PrimitiveType = dmGraphics::PRIMITIVE_TRIANGLES;
+        ro.m_VertexStart = 0;
+        ro.m_VertexCount = 3;
+        ro.m_Textures[0] = textures[0];
+        ro.m_SetBlendFactors = 1;
+        ro.m_SourceBlendFactor = dmGraphics::BLEND_FACTOR_ONE;
+        ro.m_DestinationBlendFactor = dmGraphics::BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        dmRender::EnableRenderObjectConstant(&ro, dmHashString64("tint"), Vector4(1.0f, 0.0f, 0.0f, 0.0f));
+        dmRender::AddToRender(render_context, &ro);
     }
 
-    // Sort the entries
-    dmRender::RenderListEntrySorter sort;
-    sort.m_Base = entries;
-    std::stable_sort(indices, indices + count, sort);
+    // The counters are reset by the first call after a flip
+    dmGraphics::Flip(context);
+    dmRender::Draw(render_context, 0, 0);
+    ASSERT_EQ(n, dmGraphics::GetDrawCount());
+    // Program, tint, blend func, texture and vertex declaration, then disabling the texture and vertex declaration
+    ASSERT_EQ(7u, dmGraphics::GetStateChangeCount());
 
-    // Make sure it's sorted
-    bool sorted = true;
-    uint32_t last_idx = 0;
-    uint32_t tag_mask = entries[0].m_TagMask;
-    for( uint32_t i = 0; i < count; ++i)
+    // Only the texture changes between the objects
+    for (uint32_t i = 0; i < n; ++i)
     {
-        uint32_t idx = indices[i];
+        ros[i].m_Textures[0] = textures[i & 1];
+    }
+    dmGraphics::Flip(context);
+    dmRender::Draw(render_context, 0, 0);
+    ASSERT_EQ(n, dmGraphics::GetDrawCount());
+    ASSERT_EQ(7u + n - 1, dmGraphics::GetStateChangeCount());
+
+    // The state is set again for every Draw
+    dmGraphics::Flip(context);
+    dmRender::Draw(render_context, 0, 0);
+    dmRender::Draw(render_context, 0, 0);
+    ASSERT_EQ(2 * n, dmGraphics::GetDrawCount());
+    ASSERT_EQ(2 * (7u + n - 1), dmGraphics::GetStateChangeCount());
+
+    dmRender::ClearRenderObjects(render_context);
+
+    dmGraphics::DeleteVertexBuffer(vb);
+    dmGraphics::DeleteVertexDeclaration(vd);
+    dmGraphics::DeleteTexture(textures[0]);
+    dmGraphics::DeleteTexture(textures[1]);
+    dmRender::DeleteMaterial(render_context, material);
+    dmGraphics::DeleteVertexProgram(vp);
+    dmGraphics::DeleteFragmentProgram(fp);
+    dmRender::DeleteRenderContext(render_context, 0);
+    dmGraphics::DeleteContext(context);
+    dmScript::DeleteContext(params.m_ScriptContext);
+}
 
-        if (entries[idx].m_TagMask < tag_mask)
-        {
-            sorted = false;
-            break;
-        }
-        else if(entries[idx].m_TagMask > tag_mask)
-        {
-            last_idx = idx;
-        }
+TEST(dmRenderStateTest, InstancedDraw)
+{
+    const uint32_t n = 16;
+
+    dmGraphics::Initialize();
+    dmGraphics::HContext context = dmGraphics::NewContext(dmGraphics::ContextParams());
+    dmRender::RenderContextParams params;
+    params.m_ScriptContext = dmScript::NewContext(0, 0, true);
+    params.m_MaxCharacters = 256;
+    params.m_MaxInstances = 1;
+    dmRender::HRenderContext render_context = dmRender::NewRenderContext(context, params);
+
+    const char* vp_source = "attribute highp vec4 position;\nattribute vec4 instance_offset;\n";
+    dmGraphics::ShaderDesc::Shader vp_shader = MakeDDFShader(vp_source, strlen(vp_source));
+    dmGraphics::HVertexProgram vp = dmGraphics::NewVertexProgram(context, &vp_shader);
+    dmGraphics::ShaderDesc::Shader fp_shader = MakeDDFShader("foo", 3);
+    dmGraphics::HFragmentProgram fp = dmGraphics::NewFragmentProgram(context, &fp_shader);
+    dmRender::HMaterial material = dmRender::NewMaterial(render_context, vp, fp);
+
+    ASSERT_TRUE(dmGraphics::IsInstancingSupported(context));
+    ASSERT_EQ(0, dmRender::GetMaterialAttributeLocation(material, "position"));
+    ASSERT_EQ(1, dmRender::GetMaterialAttributeLocation(material, "instance_offset"));
+    ASSERT_EQ(-1, dmRender::GetMaterialAttributeLocation(material, "texcoord0"));
+    // Served from the cache, and looked up again after a reload
+    ASSERT_EQ(1, dmRender::GetMaterialAttributeLocation(material, "instance_offset"));
+    dmRender::ClearMaterialAttributeLocations(material);
+    ASSERT_EQ(1, dmRender::GetMaterialAttributeLocation(material, "instance_offset"));
+
+    float v[] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f };
+    dmGraphics::VertexElement ve[] =
+    {
+        {"position", 0, 3, dmGraphics::TYPE_FLOAT, false },
+    };
+    dmGraphics::HVertexDeclaration vd = dmGraphics::NewVertexDeclaration(context, ve, 1);
+    dmGraphics::HVertexBuffer vb = dmGraphics::NewVertexBuffer(context, sizeof(v), v, dmGraphics::BUFFER_USAGE_STREAM_DRAW);
 
-        if (idx < last_idx)
-        {
-            sorted = false;
-            break;
-        }
+    Vector4 offsets[n];
+    dmGraphics::VertexElement instance_ve[] =
+    {
+        {"instance_offset", 0, 4, dmGraphics::TYPE_FLOAT, false },
+    };
+    dmGraphics::HVertexDeclaration instance_vd = dmGraphics::NewVertexDeclaration(context, instance_ve, 1);
+    dmGraphics::HVertexBuffer instance_vb = dmGraphics::NewVertexBuffer(context, sizeof(offsets), offsets, dmGraphics::BUFFER_USAGE_STREAM_DRAW);
 
-        tag_mask = entries[idx].m_TagMask;
-        last_idx = idx;
-    }
-    ASSERT_TRUE(sorted);
-
-    SRangeCtx ctx;
-    ctx.m_NumRanges = 0;
-
-    dmRender::FindRangeComparator comp;
-    comp.m_Entries = entries;
-    dmRender::FindRenderListRanges(indices, 0, sizeof(indices)/sizeof(indices[0]), entries, comp, &ctx, CollectRenderEntryRange);
-
-    ASSERT_EQ(5, ctx.m_NumRanges);
-
-    dmRender::RenderListRange range;
-    ASSERT_TRUE(dmRender::FindTagMaskRange(ctx.m_Ranges, ctx.m_NumRanges, 0, range));
-    ASSERT_EQ(0, range.m_TagMask);
-    ASSERT_EQ(0, range.m_Start);
-    ASSERT_EQ(7, range.m_Count);
-    ASSERT_TRUE(dmRender::FindTagMaskRange(ctx.m_Ranges, ctx.m_NumRanges, 1, range));
-    ASSERT_EQ(1, range.m_TagMask);
-    ASSERT_EQ(7, range.m_Start);
-    ASSERT_EQ(7, range.m_Count);
-    ASSERT_TRUE(dmRender::FindTagMaskRange(ctx.m_Ranges, ctx.m_NumRanges, 2, range));
-    ASSERT_EQ(2, range.m_TagMask);
-    ASSERT_EQ(14, range.m_Start);
-    ASSERT_EQ(6, range.m_Count);
-    ASSERT_TRUE(dmRender::FindTagMaskRange(ctx.m_Ranges, ctx.m_NumRanges, 3, range));
-    ASSERT_EQ(3, range.m_TagMask);
-    ASSERT_EQ(20, range.m_Start);
-    ASSERT_EQ(6, range.m_Count);
-    ASSERT_TRUE(dmRender::FindTagMaskRange(ctx.m_Ranges, ctx.m_NumRanges, 4, range));
-    ASSERT_EQ(4, range.m_TagMask);
-    ASSERT_EQ(26, range.m_Start);
-    ASSERT_EQ(6, range.m_Count);
+    dmRender::RenderObject ro;
+    ro.m_Material = material;
+    ro.m_VertexDeclaration = vd;
+    ro.m_VertexBuffer = vb;
+    ro.m_InstanceVertexDeclaration = instance_vd;
+    ro.m_InstanceVertexBuffer = instance_vb;
+    ro.m_InstanceCount = n;
+    ro.m_PrimitiveType = dmGraphics::PRIMITIVE_TRIANGLES;
+    ro.m_VertexStart = 0;
+    ro.m_VertexCount = 3;
+    dmRender::AddToRender(render_context, &ro);
+
+    dmGraphics::Flip(context);
+    dmRender::Draw(render_context, 0, 0);
+    ASSERT_EQ(1u, dmGraphics::GetDrawCount());
+    ASSERT_EQ(n, dmGraphics::GetInstanceCount());
+    // Program, vertex declaration and enabling/disabling the instance declaration, then disabling the vertex declaration
+    ASSERT_EQ(5u, dmGraphics::GetStateChangeCount());
+
+    // Regular draw calls don't count any instances
+    ro.m_InstanceCount = 0;
+    dmGraphics::Flip(context);
+    dmRender::Draw(render_context, 0, 0);
+    ASSERT_EQ(1u, dmGraphics::GetDrawCount());
+    ASSERT_EQ(0u, dmGraphics::GetInstanceCount());
+
+    dmRender::ClearRenderObjects(render_context);
+
+    dmGraphics::DeleteVertexBuffer(instance_vb);
+    dmGraphics::DeleteVertexDeclaration(instance_vd);
+    dmGraphics::DeleteVertexBuffer(vb);
+    dmGraphics::DeleteVertexDeclaration(vd);
+    dmRender::DeleteMaterial(render_context, material);
+    dmGraphics::DeleteVertexProgram(vp);
+    dmGraphics::DeleteFragmentProgram(fp);
+    dmRender::DeleteRenderContext(render_context, 0);
+    dmGraphics::DeleteContext(context);
+    dmScript::DeleteContext(params.m_ScriptContext);
 }
 
 int main(int argc, char **argv)
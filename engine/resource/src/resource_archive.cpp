@@ -25,12 +25,16 @@
 
 #include "resource.h"
 #include "resource_archive_private.h"
+#include <algorithm>
+#include <assert.h>
+#include <dlib/array.h>
 #include <dlib/crypt.h>
 #include <dlib/dstrings.h>
 #include <dlib/endian.h>
 #include <dlib/endian.h>
 #include <dlib/log.h>
 #include <dlib/lz4.h>
+#include <dlib/math.h>
 #include <dlib/memory.h>
 #include <dlib/path.h>
 #include <dlib/sys.h>
@@ -919,56 +923,262 @@ namespace dmResourceArchive
         return RESULT_OK;
     }
 
-    Result NewArchiveIndexWithResource(HArchiveIndexContainer archive_container, const char* tmp_index_path, const uint8_t* hash_digest, uint32_t hash_digest_len, const dmResourceArchive::LiveUpdateResource* resource, const char* app_support_path, HArchiveIndex& out_new_index)
+    struct BatchEntry
     {
-        out_new_index = 0x0;
+        uint8_t   m_Hash[dmResourceArchive::MAX_HASH];
+        EntryData m_Entry;
+    };
 
-        int idx = -1;
-        Result index_result = GetInsertionIndex(archive_container, hash_digest, &idx);
-        if (index_result != RESULT_OK)
+    struct ArchiveIndexBatch
+    {
+        HArchiveIndexContainer m_ArchiveContainer;
+        // Staged entries. Only the first m_SortedCount are sorted, the rest are sorted on the next lookup
+        dmArray<BatchEntry>    m_Entries;
+        uint32_t               m_SortedCount;
+        uint32_t               m_HashLength;
+    };
+
+    struct BatchEntryLess
+    {
+        uint32_t m_HashLength;
+        bool operator() (const BatchEntry& a, const BatchEntry& b) const
         {
-            dmLogError("Could not calculate valid resource insertion index, resource probably already stored in index. Result: %d", index_result);
-            return index_result;
+            return memcmp(a.m_Hash, b.m_Hash, m_HashLength) < 0;
         }
+    };
+
+    static void SortBatch(ArchiveIndexBatch* batch)
+    {
+        if (batch->m_SortedCount == batch->m_Entries.Size())
+            return;
+        BatchEntryLess less = { batch->m_HashLength };
+        std::sort(batch->m_Entries.Begin() + batch->m_SortedCount, batch->m_Entries.End(), less);
+        std::inplace_merge(batch->m_Entries.Begin(), batch->m_Entries.Begin() + batch->m_SortedCount, batch->m_Entries.End(), less);
+        batch->m_SortedCount = batch->m_Entries.Size();
+    }
+
+    static BatchEntry* FindBatchEntry(ArchiveIndexBatch* batch, const uint8_t* hash)
+    {
+        SortBatch(batch);
+        BatchEntry key;
+        memcpy(key.m_Hash, hash, batch->m_HashLength);
+        BatchEntryLess less = { batch->m_HashLength };
+        BatchEntry* it = std::lower_bound(batch->m_Entries.Begin(), batch->m_Entries.End(), key, less);
+        if (it != batch->m_Entries.End() && memcmp(it->m_Hash, hash, batch->m_HashLength) == 0)
+            return it;
+        return 0;
+    }
 
+    HArchiveIndexBatch NewArchiveIndexBatch(HArchiveIndexContainer archive_container)
+    {
+        ArchiveIndexBatch* batch = new ArchiveIndexBatch;
+        batch->m_ArchiveContainer = archive_container;
+        batch->m_SortedCount = 0;
+        batch->m_HashLength = dmEndian::ToNetwork(archive_container->m_ArchiveIndex->m_HashLength);
+        return batch;
+    }
+
+    void DeleteArchiveIndexBatch(HArchiveIndexBatch batch)
+    {
+        delete batch;
+    }
+
+    uint32_t GetBatchEntryCount(HArchiveIndexBatch batch)
+    {
+        return batch->m_Entries.Size();
+    }
+
+    Result AddResourceToBatch(HArchiveIndexBatch batch, const uint8_t* hash_digest, uint32_t hash_digest_len, const dmResourceArchive::LiveUpdateResource* resource)
+    {
+        if (FindEntryInArchive(batch->m_ArchiveContainer, hash_digest, hash_digest_len, 0) == RESULT_OK || FindBatchEntry(batch, hash_digest) != 0)
+        {
+            dmLogError("Resource already stored in the archive index");
+            return RESULT_ALREADY_STORED;
+        }
 
-        // Make deep-copy. Operate on this and only overwrite when done inserting
-        ArchiveIndex* ai_temp = 0x0;
-        NewArchiveIndexFromCopy(ai_temp, archive_container, 1);
+        // Append the data only, the data file is remapped once when the batch is committed
+        ArchiveFileIndex* afi = batch->m_ArchiveContainer->m_ArchiveFileIndex;
+        FILE* res_file = afi->m_FileResourceData;
+        fseek(res_file, 0, SEEK_END);
+        uint32_t offs = (uint32_t)ftell(res_file);
+        size_t bytes_written = fwrite(resource->m_Data, 1, resource->m_Count, res_file);
+        if (bytes_written != resource->m_Count)
+        {
+            dmLogError("All bytes not written for resource, bytes written: %zu, resource size: %zu", bytes_written, resource->m_Count);
+            return RESULT_IO_ERROR;
+        }
 
-        // Shift buffers and insert index- and resource data
-        Result insert_result = ShiftAndInsert(archive_container, ai_temp, hash_digest, hash_digest_len, idx, resource, 0x0);
+        if (batch->m_Entries.Full())
+        {
+            batch->m_Entries.OffsetCapacity(dmMath::Max(64U, batch->m_Entries.Capacity()));
+        }
+        batch->m_Entries.SetSize(batch->m_Entries.Size() + 1);
+        BatchEntry& be = batch->m_Entries.Back();
+        memset(be.m_Hash, 0, sizeof(be.m_Hash));
+        memcpy(be.m_Hash, hash_digest, hash_digest_len);
+
+        bool is_compressed = (resource->m_Header->m_Flags & ENTRY_FLAG_COMPRESSED);
+        be.m_Entry.m_ResourceDataOffset = dmEndian::ToHost(offs);
+        be.m_Entry.m_ResourceSize = is_compressed ? resource->m_Header->m_Size : dmEndian::ToHost((uint32_t)resource->m_Count);
+        be.m_Entry.m_ResourceCompressedSize = is_compressed ? dmEndian::ToHost((uint32_t)resource->m_Count) : (dmEndian::ToHost(0xffffffff));
+        be.m_Entry.m_Flags = dmEndian::ToHost((uint32_t)(resource->m_Header->m_Flags | ENTRY_FLAG_LIVEUPDATE_DATA));
+        return RESULT_OK;
+    }
 
-        if (insert_result != RESULT_OK)
+    Result FindEntryInBatch(HArchiveIndexBatch batch, const uint8_t* hash, uint32_t hash_len, EntryData* entry)
+    {
+        BatchEntry* be = FindBatchEntry(batch, hash);
+        if (be)
         {
-            delete ai_temp;
-            dmLogError("Failed to insert resource, result = %i", insert_result);
-            return insert_result;
+            if (entry)
+            {
+                entry->m_ResourceDataOffset = dmEndian::ToNetwork(be->m_Entry.m_ResourceDataOffset);
+                entry->m_ResourceSize = dmEndian::ToNetwork(be->m_Entry.m_ResourceSize);
+                entry->m_ResourceCompressedSize = dmEndian::ToNetwork(be->m_Entry.m_ResourceCompressedSize);
+                entry->m_Flags = dmEndian::ToNetwork(be->m_Entry.m_Flags);
+            }
+            return RESULT_OK;
         }
+        return FindEntryInArchive(batch->m_ArchiveContainer, hash, hash_len, entry);
+    }
 
-        // Write to temporary index file, filename liveupdate.arci.tmp
-        FILE* f_lu_index = fopen(tmp_index_path, "wb");
+    static Result RemapResourceData(ArchiveFileIndex* afi)
+    {
+        fflush(afi->m_FileResourceData); // make sure all writes flushed before mem-mapping below
+        if (!afi->m_IsMemMapped)
+            return RESULT_OK;
+
+        uint32_t size = (uint32_t)ftell(afi->m_FileResourceData);
+        void* temp_map = (void*)afi->m_ResourceData;
+        dmResource::UnmapFile(temp_map, afi->m_ResourceSize);
+
+        temp_map = 0x0;
+        uint32_t map_size = 0;
+        dmResource::Result res = dmResource::MapFile(afi->m_Path, temp_map, map_size);
+        if (res != dmResource::RESULT_OK)
+        {
+            dmLogError("Failed to map liveupdate respource file, result = %i", res);
+            return RESULT_IO_ERROR;
+        }
+        afi->m_ResourceData = (uint8_t*)temp_map;
+        afi->m_ResourceSize = map_size;
+        assert(size == map_size);
+        return RESULT_OK;
+    }
+
+    Result CommitArchiveIndexBatch(HArchiveIndexBatch batch, const char* tmp_index_path, HArchiveIndex& out_new_index)
+    {
+        out_new_index = 0x0;
+        uint32_t batch_count = batch->m_Entries.Size();
+        if (batch_count == 0)
+        {
+            return RESULT_OK;
+        }
+        SortBatch(batch);
+
+        HArchiveIndexContainer archive_container = batch->m_ArchiveContainer;
+        ArchiveIndex* ai = archive_container->m_ArchiveIndex;
+        uint32_t count = dmEndian::ToNetwork(ai->m_EntryDataCount);
+        const uint8_t* hashes;
+        const EntryData* entries;
+        if (archive_container->m_IsMemMapped)
+        {
+            hashes = (const uint8_t*)((uintptr_t)ai + dmEndian::ToNetwork(ai->m_HashOffset));
+            entries = (const EntryData*)((uintptr_t)ai + dmEndian::ToNetwork(ai->m_EntryDataOffset));
+        }
+        else
+        {
+            hashes = archive_container->m_ArchiveFileIndex->m_Hashes;
+            entries = archive_container->m_ArchiveFileIndex->m_Entries;
+        }
+
+        // Merge the sorted index and the sorted batch into a new index with the same layout as NewArchiveIndexFromCopy
+        uint32_t total_count = count + batch_count;
+        uint32_t total_size = sizeof(ArchiveIndex) + total_count * dmResourceArchive::MAX_HASH + total_count * sizeof(EntryData);
+        ArchiveIndex* ai_new = (ArchiveIndex*)new uint8_t[total_size];
+        memcpy(ai_new, ai, sizeof(ArchiveIndex));
+        ai_new->m_EntryDataCount = dmEndian::ToHost(total_count);
+        ai_new->m_HashOffset = dmEndian::ToHost((uint32_t)sizeof(ArchiveIndex));
+        ai_new->m_EntryDataOffset = dmEndian::ToHost((uint32_t)(sizeof(ArchiveIndex) + total_count * dmResourceArchive::MAX_HASH));
+        uint8_t* new_hashes = (uint8_t*)((uintptr_t)ai_new + sizeof(ArchiveIndex));
+        EntryData* new_entries = (EntryData*)((uintptr_t)new_hashes + total_count * dmResourceArchive::MAX_HASH);
+
+        uint32_t hash_len = batch->m_HashLength;
+        uint32_t i = 0, j = 0;
+        for (uint32_t k = 0; k < total_count; ++k)
+        {
+            const BatchEntry* be = j < batch_count ? &batch->m_Entries[j] : 0;
+            const uint8_t* h = i < count ? hashes + dmResourceArchive::MAX_HASH * i : 0;
+            if (h && (!be || memcmp(h, be->m_Hash, hash_len) < 0))
+            {
+                memcpy(new_hashes + dmResourceArchive::MAX_HASH * k, h, dmResourceArchive::MAX_HASH);
+                new_entries[k] = entries[i++];
+            }
+            else
+            {
+                memcpy(new_hashes + dmResourceArchive::MAX_HASH * k, be->m_Hash, dmResourceArchive::MAX_HASH);
+                new_entries[k] = be->m_Entry;
+                ++j;
+            }
+        }
+
+        Result result = RemapResourceData(archive_container->m_ArchiveFileIndex);
+        if (result != RESULT_OK)
+        {
+            Delete(ai_new);
+            return result;
+        }
+
+        // Write the complete index next to the temporary index file and rename it, so a partially written index is never used
+        char staging_path[DMPATH_MAX_PATH];
+        dmStrlCpy(staging_path, tmp_index_path, sizeof(staging_path));
+        dmStrlCat(staging_path, ".part", sizeof(staging_path));
+        FILE* f_lu_index = fopen(staging_path, "wb");
         if (!f_lu_index)
         {
-            dmLogError("Failed to create liveupdate index file: %s", tmp_index_path);
+            dmLogError("Failed to create liveupdate index file: %s", staging_path);
+            Delete(ai_new);
             return RESULT_IO_ERROR;
         }
-        uint32_t entry_count = dmEndian::ToNetwork(ai_temp->m_EntryDataCount);
-        uint32_t total_size = sizeof(ArchiveIndex) + entry_count * dmResourceArchive::MAX_HASH + entry_count * sizeof(EntryData);
-        if (fwrite((void*)ai_temp, 1, total_size, f_lu_index) != total_size)
+        if (fwrite((void*)ai_new, 1, total_size, f_lu_index) != total_size)
         {
             fclose(f_lu_index);
-            dmLogError("Failed to write %u bytes to liveupdate index file: %s", (uint32_t)total_size, tmp_index_path);
+            dmLogError("Failed to write %u bytes to liveupdate index file: %s", total_size, staging_path);
+            Delete(ai_new);
             return RESULT_IO_ERROR;
         }
         fflush(f_lu_index);
         fclose(f_lu_index);
 
-        // set result
-        out_new_index = ai_temp;
+        dmSys::Result sys_result = dmSys::RenameFile(tmp_index_path, staging_path);
+        if (sys_result != dmSys::RESULT_OK)
+        {
+            dmLogError("Failed to rename '%s' to '%s' (%i).", staging_path, tmp_index_path, sys_result);
+            Delete(ai_new);
+            return RESULT_IO_ERROR;
+        }
+
+        out_new_index = ai_new;
         return RESULT_OK;
     }
 
+    Result NewArchiveIndexWithResource(HArchiveIndexContainer archive_container, const char* tmp_index_path, const uint8_t* hash_digest, uint32_t hash_digest_len, const dmResourceArchive::LiveUpdateResource* resource, const char* app_support_path, HArchiveIndex& out_new_index)
+    {
+        out_new_index = 0x0;
+        HArchiveIndexBatch batch = NewArchiveIndexBatch(archive_container);
+        Result result = AddResourceToBatch(batch, hash_digest, hash_digest_len, resource);
+        if (result == RESULT_OK)
+        {
+            result = CommitArchiveIndexBatch(batch, tmp_index_path, out_new_index);
+        }
+        else
+        {
+            dmLogError("Failed to insert resource, result = %i", result);
+        }
+        DeleteArchiveIndexBatch(batch);
+        return result;
+    }
+
     void SetNewArchiveIndex(HArchiveIndexContainer archive_container, HArchiveIndex new_index, bool mem_mapped)
     {
         if (!archive_container->m_IsMemMapped)
@@ -278,6 +278,62 @@ namespace dmResourceArchive
      */
     Result NewArchiveIndexWithResource(HArchiveIndexContainer archive, const char* tmp_index_path, const uint8_t* hash_digest, uint32_t hash_digest_len, const dmResourceArchive::LiveUpdateResource* resource, const char* proj_id, HArchiveIndex& out_new_index);
 
+    /**
+     * Batch of LiveUpdate resources that are merged into a new archive index in a single commit.
+     * The resource data is appended to the archive as resources are added, the index is only
+     * rebuilt and written to disk when the batch is committed.
+     */
+    typedef struct ArchiveIndexBatch* HArchiveIndexBatch;
+
+    /**
+     * Create a new batch for the archive index in the archive container
+     * @param archive archive container
+     * @return batch handle
+     */
+    HArchiveIndexBatch NewArchiveIndexBatch(HArchiveIndexContainer archive);
+
+    /**
+     * Delete batch. Resources that were not committed are not visible in any archive index
+     * @param batch batch handle
+     */
+    void DeleteArchiveIndexBatch(HArchiveIndexBatch batch);
+
+    /**
+     * Get number of resources added to the batch
+     * @param batch batch handle
+     * @return number of resources
+     */
+    uint32_t GetBatchEntryCount(HArchiveIndexBatch batch);
+
+    /**
+     * Append LiveUpdate resource data to the archive and stage its entry in the batch
+     * @param batch batch handle
+     * @param hash_digest hash_digest data
+     * @param hash_digest_len size in bytes of hash_digest data
+     * @param resource LiveUpdate resource to add
+     * @return RESULT_OK on success, RESULT_ALREADY_STORED if the resource is in the archive index or in the batch
+     */
+    Result AddResourceToBatch(HArchiveIndexBatch batch, const uint8_t* hash_digest, uint32_t hash_digest_len, const dmResourceArchive::LiveUpdateResource* resource);
+
+    /**
+     * Find entry in the batch or in the archive index of the batch archive container
+     * @param batch batch handle
+     * @param hash hash digest to find
+     * @param hash_len size in bytes of hash digest
+     * @param entry entry data [out]
+     * @return RESULT_OK on success, RESULT_NOT_FOUND otherwise
+     */
+    Result FindEntryInBatch(HArchiveIndexBatch batch, const uint8_t* hash, uint32_t hash_len, EntryData* entry);
+
+    /**
+     * Merge the staged entries with a deep-copy of the archive index and write the result to the temporary index file
+     * @param batch batch handle
+     * @param tmp_index_path path to the temporary index file. Written through a rename so it is never partially written
+     * @param out_new_index reference to HArchiveIndex that will contain the new archive index (on success). 0 if the batch is empty
+     * @return RESULT_OK on success
+     */
+    Result CommitArchiveIndexBatch(HArchiveIndexBatch batch, const char* tmp_index_path, HArchiveIndex& out_new_index);
+
     /**
      * Set new archive index in archive container. Replace existing archive index if set
      * @param archive archive container
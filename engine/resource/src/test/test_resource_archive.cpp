@@ -386,6 +386,97 @@ TEST(dmResourceArchive, ShiftInsertResource_InsertIssue)
     remove(path);
 }
 
+TEST(dmResourceArchive, ArchiveIndexBatch)
+{
+    const char* resource_filename = "test_resource_liveupdate.arcd";
+    const char* index_filename = "test_resource_liveupdate.arci.tmp";
+    char host_name[512];
+    const char* path = MakeHostPath(host_name, sizeof(host_name), resource_filename);
+    char host_index_name[512];
+    const char* index_path = MakeHostPath(host_index_name, sizeof(host_index_name), index_filename);
+
+    FILE* resource_file = fopen(path, "wb");
+    bool success = resource_file != 0x0;
+    ASSERT_EQ(success, true);
+
+    // Resource data to insert
+    dmResourceArchive::LiveUpdateResource* resource = (dmResourceArchive::LiveUpdateResource*)malloc(sizeof(dmResourceArchive::LiveUpdateResource));
+    resource->m_Header = (dmResourceArchive::LiveUpdateResourceHeader*)malloc(sizeof(dmResourceArchive::LiveUpdateResourceHeader));
+    PopulateLiveUpdateResource(resource);
+
+    uint8_t* arci_copy;
+    uint32_t arci_size = GetMutableIndexData((void*&)arci_copy, 0);
+
+    dmResourceArchive::HArchiveIndexContainer archive = 0;
+    dmResourceArchive::Result result = dmResourceArchive::WrapArchiveBuffer((void*) arci_copy, arci_size, true, RESOURCES_ARCD, RESOURCES_ARCD_SIZE, false, &archive);
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, result);
+
+    archive->m_ArchiveFileIndex->m_FileResourceData = resource_file;
+
+    dmResourceArchive::SetDefaultReader(archive);
+    ASSERT_EQ(7U, dmResourceArchive::GetEntryCount(archive));
+
+    // Added out of order, the batch is kept sorted on lookup
+    dmResourceArchive::HArchiveIndexBatch batch = dmResourceArchive::NewArchiveIndexBatch(archive);
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::AddResourceToBatch(batch, sorted_last_hash, 20, resource));
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::AddResourceToBatch(batch, sorted_first_hash, 20, resource));
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::AddResourceToBatch(batch, sorted_middle_hash, 20, resource));
+    ASSERT_EQ(3U, dmResourceArchive::GetBatchEntryCount(batch));
+
+    // Already in the batch, or already in the archive index
+    ASSERT_EQ(dmResourceArchive::RESULT_ALREADY_STORED, dmResourceArchive::AddResourceToBatch(batch, sorted_first_hash, 20, resource));
+    ASSERT_EQ(dmResourceArchive::RESULT_ALREADY_STORED, dmResourceArchive::AddResourceToBatch(batch, content_hash[0], 20, resource));
+    ASSERT_EQ(3U, dmResourceArchive::GetBatchEntryCount(batch));
+
+    // Staged entries are not visible in the archive until committed
+    dmResourceArchive::EntryData entry;
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::FindEntryInBatch(batch, sorted_middle_hash, 20, &entry));
+    ASSERT_EQ(resource->m_Count, entry.m_ResourceSize);
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::FindEntryInBatch(batch, content_hash[0], 20, &entry));
+    ASSERT_EQ(dmResourceArchive::RESULT_NOT_FOUND, dmResourceArchive::FindEntryInArchive(archive, sorted_middle_hash, 20, &entry));
+
+    dmResourceArchive::HArchiveIndex new_index = 0;
+    result = dmResourceArchive::CommitArchiveIndexBatch(batch, index_path, new_index);
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, result);
+    ASSERT_NE((dmResourceArchive::HArchiveIndex) 0, new_index);
+    dmResourceArchive::DeleteArchiveIndexBatch(batch);
+
+    FILE* index_file = fopen(index_path, "rb");
+    ASSERT_NE((FILE*) 0, index_file);
+    fclose(index_file);
+
+    dmResourceArchive::SetNewArchiveIndex(archive, new_index, true);
+    ASSERT_EQ(10U, dmResourceArchive::GetEntryCount(archive));
+
+    int cmp = VerifyArchiveIndex(archive);
+    ASSERT_EQ(0, cmp);
+
+    const uint8_t* hashes[] = { sorted_first_hash, sorted_middle_hash, sorted_last_hash };
+    for (uint32_t i = 0; i < sizeof(hashes) / sizeof(hashes[0]); ++i)
+    {
+        dmResourceArchive::HArchiveIndexContainer entryarchive = 0;
+        result = dmResourceArchive::FindEntry(archive, hashes[i], 20, &entryarchive, &entry);
+        ASSERT_EQ(dmResourceArchive::RESULT_OK, result);
+        ASSERT_EQ(resource->m_Count, entry.m_ResourceSize);
+        ASSERT_NE(0U, entry.m_Flags & dmResourceArchive::ENTRY_FLAG_LIVEUPDATE_DATA);
+    }
+
+    // An empty batch does not produce a new index
+    batch = dmResourceArchive::NewArchiveIndexBatch(archive);
+    dmResourceArchive::HArchiveIndex empty_index = 0;
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::CommitArchiveIndexBatch(batch, index_path, empty_index));
+    ASSERT_EQ((dmResourceArchive::HArchiveIndex) 0, empty_index);
+    dmResourceArchive::DeleteArchiveIndexBatch(batch);
+
+    free(resource->m_Header);
+    free(resource);
+    dmResourceArchive::Delete(archive); // fclose on the FILE*
+    dmResourceArchive::Delete(new_index);
+    FreeMutableIndexData((void*&)arci_copy);
+    remove(path);
+    remove(index_path);
+}
+
 TEST(dmResourceArchive, NewArchiveIndexFromCopy)
 {
     uint32_t single_entry_offset = dmResourceArchive::MAX_HASH;
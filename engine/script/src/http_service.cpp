@@ -18,6 +18,7 @@
 #include <dlib/thread.h>
 #include <dlib/time.h>
 #include <dlib/message.h>
+#include <dlib/http_async.h>
 #include <dlib/http_client.h>
 #include <dlib/http_cache.h>
 #include <dlib/log.h>
@@ -39,6 +40,8 @@ namespace dmHttpService
     const uint32_t THREAD_STACK_SIZE = 0x20000;
     const uint32_t DEFAULT_RESPONSE_BUFFER_SIZE = 64 * 1024;
     const uint32_t DEFAULT_HEADER_BUFFER_SIZE = 16 * 1024;
+    // Time to wait for socket activity between message dispatches when requests are in flight
+    const uint32_t ASYNC_POLL_TIMEOUT = 2 * 1000;
 
 
     struct HttpService;
@@ -60,6 +63,26 @@ namespace dmHttpService
         volatile bool         m_Run;
     };
 
+    /*
+     * Plain http requests that don't go through the http cache are multiplexed
+     * on pooled keep-alive connections by a single thread instead of occupying a worker
+     * for the whole round trip. https still uses the workers, the TLS handshake is blocking.
+     */
+    struct AsyncWorker
+    {
+        dmThread::Thread      m_Thread;
+        dmDNS::HChannel       m_DNSChannel;
+        dmMessage::HSocket    m_Socket;
+        dmHttpAsync::HClient  m_Client;
+        volatile bool         m_Run;
+    };
+
+    struct AsyncRequest
+    {
+        dmMessage::URL        m_Requester;
+        const char*           m_Filepath;
+    };
+
     struct HttpService
     {
         HttpService()
@@ -71,6 +94,7 @@ namespace dmHttpService
             m_Run = false;
         }
         dmArray<Worker*>          m_Workers;
+        AsyncWorker               m_AsyncWorker;
         dmThread::Thread          m_Balancer;
         dmMessage::HSocket        m_Socket;
         dmHttpCache::HCache       m_HttpCache;
@@ -296,6 +320,96 @@ namespace dmHttpService
         }
     }
 
+    static void AsyncResponse(void* user_data, const dmHttpAsync::Response* response)
+    {
+        AsyncRequest* request = (AsyncRequest*) user_data;
+        if (response->m_Result != dmHttpAsync::RESULT_OK)
+        {
+            dmLogError("HTTP request failed (%s)", dmHttpAsync::ResultToString(response->m_Result));
+        }
+        SendResponse(&request->m_Requester, response->m_Status, response->m_Headers, response->m_HeadersLength, response->m_Content, response->m_ContentLength, request->m_Filepath);
+        delete request;
+    }
+
+    static void HandleAsyncRequest(AsyncWorker* worker, const dmMessage::URL* requester, dmHttpDDF::HttpRequest* request)
+    {
+        request->m_Method = (const char*) ((uintptr_t) request + (uintptr_t) request->m_Method);
+        request->m_Url = (const char*) ((uintptr_t) request + (uintptr_t) request->m_Url);
+
+        AsyncRequest* async_request = new AsyncRequest;
+        async_request->m_Requester = *requester;
+        async_request->m_Filepath = request->m_Path;
+
+        dmHttpAsync::RequestParams params;
+        params.m_Method = request->m_Method;
+        params.m_Url = request->m_Url;
+        params.m_Headers = (const char*) request->m_Headers;
+        params.m_HeadersLength = (uint32_t) request->m_HeadersLength;
+        params.m_Body = (const void*) request->m_Request;
+        params.m_BodyLength = request->m_RequestLength;
+        params.m_Timeout = request->m_Timeout;
+        params.m_Callback = AsyncResponse;
+        params.m_UserData = async_request;
+        dmHttpAsync::Result r = dmHttpAsync::Request(worker->m_Client, &params);
+        if (r != dmHttpAsync::RESULT_OK)
+        {
+            dmLogError("HTTP request to '%s' failed (%s)", request->m_Url, dmHttpAsync::ResultToString(r));
+            SendResponse(requester, 0, 0, 0, 0, 0, request->m_Path);
+            delete async_request;
+        }
+    }
+
+    static void AsyncDispatch(dmMessage::Message *message, void* user_ptr)
+    {
+        AsyncWorker* worker = (AsyncWorker*) user_ptr;
+        if (message->m_Descriptor == (uintptr_t) dmHttpDDF::HttpRequest::m_DDFDescriptor)
+        {
+            dmHttpDDF::HttpRequest* request = (dmHttpDDF::HttpRequest*) &message->m_Data[0];
+            // The request data is copied by the client
+            if (worker->m_Run)
+            {
+                HandleAsyncRequest(worker, &message->m_Sender, request);
+            }
+            free((void*) request->m_Headers);
+            free((void*) request->m_Request);
+        }
+        else if (message->m_Descriptor == (uintptr_t) dmHttpDDF::StopHttp::m_DDFDescriptor)
+        {
+            worker->m_Run = false;
+        }
+    }
+
+    static void AsyncLoop(void* arg)
+    {
+        AsyncWorker* worker = (AsyncWorker*) arg;
+        while (worker->m_Run)
+        {
+            if (dmHttpAsync::GetActiveCount(worker->m_Client) == 0)
+            {
+                dmMessage::DispatchBlocking(worker->m_Socket, &AsyncDispatch, worker);
+            }
+            else
+            {
+                dmMessage::Dispatch(worker->m_Socket, &AsyncDispatch, worker);
+            }
+            dmHttpAsync::Update(worker->m_Client, ASYNC_POLL_TIMEOUT);
+        }
+    }
+
+    // Requests that can be multiplexed on the async worker
+    static bool IsAsyncRequest(const HttpService* service, const dmMessage::Message* message)
+    {
+        if (message->m_Descriptor != (uintptr_t) dmHttpDDF::HttpRequest::m_DDFDescriptor || service->m_AsyncWorker.m_Client == 0)
+            return false;
+        const dmHttpDDF::HttpRequest* request = (const dmHttpDDF::HttpRequest*) &message->m_Data[0];
+        const char* method = (const char*) ((uintptr_t) request + (uintptr_t) request->m_Method);
+        const char* url = (const char*) ((uintptr_t) request + (uintptr_t) request->m_Url);
+        if (strncmp(url, "http://", 7) != 0)
+            return false;
+        // GET requests are served by the workers when they may be answered from the http cache
+        return request->m_IgnoreCache || service->m_HttpCache == 0 || strcmp(method, "GET") != 0;
+    }
+
     void LoadBalance(dmMessage::Message *message, void* user_ptr)
     {
         HttpService* service = (HttpService*) user_ptr;
@@ -303,7 +417,12 @@ namespace dmHttpService
             service->m_Run = false;
         } else {
             dmMessage::URL r = message->m_Receiver;
-            r.m_Socket = service->m_Workers[service->m_LoadBalanceCount % service->m_Workers.Size()]->m_Socket;
+            if (IsAsyncRequest(service, message)) {
+                r.m_Socket = service->m_AsyncWorker.m_Socket;
+            } else {
+                r.m_Socket = service->m_Workers[service->m_LoadBalanceCount % service->m_Workers.Size()]->m_Socket;
+                service->m_LoadBalanceCount++;
+            }
             dmMessage::Post(&message->m_Sender,
                             &r,
                             message->m_Id,
@@ -311,7 +430,6 @@ namespace dmHttpService
                             message->m_Descriptor,
                             message->m_Data,
                             message->m_DataSize, 0);
-            service->m_LoadBalanceCount++;
         }
     }
 
@@ -402,6 +520,18 @@ namespace dmHttpService
             worker->m_Thread = t;
         }
 
+        AsyncWorker* async_worker = &service->m_AsyncWorker;
+        dmMessage::NewSocket("@__http_async", &async_worker->m_Socket);
+        if (dmDNS::NewChannel(&async_worker->m_DNSChannel) != dmDNS::RESULT_OK)
+        {
+            async_worker->m_DNSChannel = 0;
+        }
+        dmHttpAsync::NewParams async_params;
+        async_params.m_DNSChannel = async_worker->m_DNSChannel;
+        async_worker->m_Client = dmHttpAsync::New(&async_params);
+        async_worker->m_Run = true;
+        async_worker->m_Thread = dmThread::New(&AsyncLoop, THREAD_STACK_SIZE, async_worker, "http_async");
+
         dmThread::Thread t = dmThread::New(&LoadBalancer, THREAD_STACK_SIZE, service, "http_balance");
         service->m_Balancer = t;
 
@@ -434,6 +564,17 @@ namespace dmHttpService
             delete worker;
         }
         dmThread::Join(http_service->m_Balancer);
+
+        AsyncWorker* async_worker = &http_service->m_AsyncWorker;
+        url.m_Socket = async_worker->m_Socket;
+        dmDNS::StopChannel(async_worker->m_DNSChannel);
+        dmMessage::Post(0, &url, 0, 0, (uintptr_t) dmHttpDDF::StopHttp::m_DDFDescriptor, 0, 0, 0);
+        dmThread::Join(async_worker->m_Thread);
+        // Outstanding requests are answered with status 0
+        dmHttpAsync::Delete(async_worker->m_Client);
+        dmMessage::DeleteSocket(async_worker->m_Socket);
+        dmDNS::DeleteChannel(async_worker->m_DNSChannel);
+
         dmMessage::DeleteSocket(http_service->m_Socket);
         if (http_service->m_HttpCache)
             dmHttpCache::Close(http_service->m_HttpCache);
@@ -17,6 +17,7 @@
 #include <dlib/math.h>
 #include <dlib/pprint.h>
 #include <dlib/profile.h>
+#include <dlib/time.h>
 
 #include "script_private.h"
 #include "script_hash.h"
@@ -80,7 +81,10 @@ namespace dmScript
         context->m_ConfigFile = config_file;
         context->m_ResourceFactory = factory;
         context->m_LuaState = lua_open();
+        RegisterTableRefState(context->m_LuaState);
         context->m_ContextTableRef = LUA_NOREF;
+        context->m_GCStepBudget = 0;
+        context->m_GCHeapAfterCycle = 0;
         context->m_EnableExtensions = enable_extensions;
         return context;
     }
@@ -88,6 +92,7 @@ namespace dmScript
     void DeleteContext(HContext context)
     {
         ClearModules(context);
+        UnregisterTableRefState(context->m_LuaState);
         lua_close(context->m_LuaState);
         delete context;
     }
@@ -229,6 +234,8 @@ namespace dmScript
 
     void Update(HContext context)
     {
+        ResetVmathScratch(context->m_LuaState);
+
         for (HScriptExtension* l = context->m_ScriptExtensions.Begin(); l != context->m_ScriptExtensions.End(); ++l)
         {
             if ((*l)->Update != 0x0)
@@ -1329,6 +1336,46 @@ namespace dmScript
         return (uint32_t)lua_gc(L, LUA_GCCOUNT, 0);
     }
 
+    void SetGCStepBudget(HContext context, uint32_t budget_us)
+    {
+        context->m_GCStepBudget = budget_us;
+        lua_gc(context->m_LuaState, budget_us > 0 ? LUA_GCSTOP : LUA_GCRESTART, 0);
+    }
+
+    uint32_t GetGCStepBudget(HContext context)
+    {
+        return context->m_GCStepBudget;
+    }
+
+    uint32_t StepGC(HContext context, uint32_t time_us)
+    {
+        DM_PROFILE(Script, "GC");
+        lua_State* L = context->m_LuaState;
+        uint64_t start = dmTime::GetTime();
+        uint64_t end = start + time_us;
+
+        // Catch up if the budget hasn't been enough to keep up with the allocations
+        uint32_t heap = (uint32_t)lua_gc(L, LUA_GCCOUNT, 0);
+        bool catch_up = context->m_GCHeapAfterCycle > 0 && heap > 2 * context->m_GCHeapAfterCycle;
+
+        do
+        {
+            // A step of size 0 is a single basic step of the incremental collector
+            if (lua_gc(L, LUA_GCSTEP, 0))
+            {
+                context->m_GCHeapAfterCycle = (uint32_t)lua_gc(L, LUA_GCCOUNT, 0);
+                break;
+            }
+        } while (catch_up || dmTime::GetTime() < end);
+
+        // Stepping rearms the automatic collector
+        if (context->m_GCStepBudget > 0)
+        {
+            lua_gc(L, LUA_GCSTOP, 0);
+        }
+        return (uint32_t)(dmTime::GetTime() - start);
+    }
+
     LuaStackCheck::LuaStackCheck(lua_State* L, int diff, const char* filename, int linenumber) : m_L(L), m_Filename(filename), m_Linenumber(linenumber), m_Top(lua_gettop(L)), m_Diff(diff)
     {
         if (!(m_Diff >= -m_Top)) {
@@ -666,6 +666,28 @@ namespace dmScript
     */
     uint32_t GetLuaGCCount(lua_State* L);
 
+    /** Sets the garbage collection mode of the context. With a step budget the automatic
+    * collector is stopped, and collection only progresses through calls to StepGC.
+    * @param context script context
+    * @param budget_us incremental step budget in microseconds per frame, 0 for automatic collection
+    */
+    void SetGCStepBudget(HContext context, uint32_t budget_us);
+
+    /** Gets the incremental step budget set with SetGCStepBudget
+    * @param context script context
+    * @return step budget in microseconds, 0 for automatic collection
+    */
+    uint32_t GetGCStepBudget(HContext context);
+
+    /** Runs incremental garbage collection steps until the time is up or the collection
+    * cycle is finished. At least one step is run. If the heap has grown to twice its size since
+    * the last finished cycle, the steps continue until the cycle is finished regardless of the time.
+    * @param context script context
+    * @param time_us time to spend in microseconds
+    * @return time spent in microseconds
+    */
+    uint32_t StepGC(HContext context, uint32_t time_us);
+
 // DEPRECATED
 // I really don't like this callback setup (mistake on my part). It's clunky.
 // Perhaps better to have a lambda function? (now that all compilers support C++11) /MAWE
@@ -47,7 +47,62 @@ namespace dmScript
      * @namespace msg
      */
 
-    const uint32_t MAX_MESSAGE_DATA_SIZE = 2048;
+    // Cache of resolved string urls, so that posting to the same url over and over again skips parsing,
+    // hashing and socket lookups. Lua strings are interned, so the string pointer is used as key while the
+    // contents are compared to catch strings that were collected and had their memory reused.
+    // Relative urls are resolved against the default url of the current instance, which is part of the key.
+    // Socket handles are name hashes, so entries stay valid when sockets are deleted and created again.
+    // Lua is only run from the main thread.
+    static const uint32_t URL_CACHE_SIZE = 256; // Must be a power of two
+    static const uint32_t URL_CACHE_MAX_URL_LENGTH = 64;
+
+    struct URLCacheEntry
+    {
+        const char*     m_Key;
+        dmMessage::URL  m_DefaultURL;
+        dmMessage::URL  m_URL;
+        uint32_t        m_Length : 31;
+        uint32_t        m_Global : 1;
+        char            m_String[URL_CACHE_MAX_URL_LENGTH];
+    };
+
+    static URLCacheEntry g_URLCache[URL_CACHE_SIZE];
+    static bool g_URLCacheEnabled = true;
+
+    static inline URLCacheEntry* GetURLCacheEntry(const char* url, dmhash_t default_url_hash)
+    {
+        uint64_t h = ((uint64_t)(uintptr_t)url ^ default_url_hash) * 0x9E3779B97F4A7C15ULL;
+        return &g_URLCache[(h >> 32) & (URL_CACHE_SIZE - 1)];
+    }
+
+    static inline dmhash_t GetDefaultURLHash(const dmMessage::URL& default_url)
+    {
+        return default_url.m_Socket ^ default_url.m_Path ^ default_url.m_Fragment;
+    }
+
+    static inline bool IsURLCacheEntry(const URLCacheEntry* entry, const char* url, uint32_t url_length)
+    {
+        return entry->m_Key == url && entry->m_Length == url_length && memcmp(entry->m_String, url, url_length) == 0;
+    }
+
+    static void PutURLCacheEntry(URLCacheEntry* entry, const char* url, uint32_t url_length, const dmMessage::URL* default_url, const dmMessage::URL& resolved_url)
+    {
+        if (!g_URLCacheEnabled || url_length >= URL_CACHE_MAX_URL_LENGTH)
+            return;
+        entry->m_Key = url;
+        entry->m_Length = url_length;
+        memcpy(entry->m_String, url, url_length);
+        entry->m_Global = default_url == 0x0;
+        if (default_url != 0x0)
+            entry->m_DefaultURL = *default_url;
+        entry->m_URL = resolved_url;
+    }
+
+    void SetURLCacheEnabled(bool enabled)
+    {
+        g_URLCacheEnabled = enabled;
+        memset(g_URLCache, 0, sizeof(g_URLCache));
+    }
 
     bool IsURL(lua_State *L, int index)
     {
@@ -443,6 +498,11 @@ namespace dmScript
         return 1;
     }
 
+    static void DestroyTableReference(dmMessage::Message* message)
+    {
+        dmScript::ReleaseTableReference((const char*)message->m_Data, message->m_DataSize);
+    }
+
     /*# posts a message to a receiving URL
      *
      * Post a message to a receiving URL. The most common case is to send messages
@@ -499,6 +559,7 @@ namespace dmScript
 
         DM_ALIGNED(16) char data[MAX_MESSAGE_DATA_SIZE];
         uint32_t data_size = 0;
+        dmMessage::MessageDestroyCallback destroy_callback = 0;
 
 
         const dmDDF::Descriptor* desc = dmDDF::GetDescriptorFromHash(message_id);
@@ -524,13 +585,30 @@ namespace dmScript
         {
             if (!lua_isnil(L, 3))
             {
-                data_size = dmScript::CheckTable(L, data, MAX_MESSAGE_DATA_SIZE, 3);
+                // A message with a component as receiver is dispatched once, so the table is handed over by
+                // reference rather than serialized and rebuilt. Broadcasts need one table per receiver.
+                if (receiver.m_Fragment != 0)
+                {
+                    data_size = dmScript::CheckTableReference(L, data, MAX_MESSAGE_DATA_SIZE, 3);
+                    if (data_size > 0)
+                    {
+                        destroy_callback = DestroyTableReference;
+                    }
+                }
+                if (data_size == 0)
+                {
+                    data_size = dmScript::CheckTable(L, data, MAX_MESSAGE_DATA_SIZE, 3);
+                }
             }
         }
 
         assert(top == lua_gettop(L));
 
-        dmMessage::Result result = dmMessage::Post(&sender, &receiver, message_id, 0, (uintptr_t) desc, data, data_size, 0);
+        dmMessage::Result result = dmMessage::Post(&sender, &receiver, message_id, 0, (uintptr_t) desc, data, data_size, destroy_callback);
+        if (result != dmMessage::RESULT_OK && destroy_callback)
+        {
+            dmScript::ReleaseTableReference(data, data_size);
+        }
         if (result == dmMessage::RESULT_SOCKET_NOT_FOUND)
         {
             char receiver_buffer[64];
@@ -669,12 +747,48 @@ namespace dmScript
         {
 
             const char* url = 0;
+            size_t url_length = 0;
+            URLCacheEntry* cache_entry = 0x0;
+            dmMessage::URL default_url;
+            bool has_default_url = false;
             dmMessage::StringURL string_url;
             dmMessage::Result parse_url_result;
             if (lua_isstring(L, index))
             {
+                url = lua_tolstring(L, index, &url_length);
+
+                // Global urls resolve the same for all instances
+                cache_entry = GetURLCacheEntry(url, 0);
+                if (cache_entry->m_Global && IsURLCacheEntry(cache_entry, url, url_length))
+                {
+                    *out_url = cache_entry->m_URL;
+                    if (out_default_url != 0x0)
+                    {
+                        dmMessage::ResetURL(*out_default_url);
+                        GetURL(L, out_default_url);
+                    }
+                    return 0;
+                }
+
+                dmMessage::ResetURL(default_url);
+                GetURL(L, &default_url);
+                has_default_url = true;
+
+                cache_entry = GetURLCacheEntry(url, GetDefaultURLHash(default_url));
+                if (!cache_entry->m_Global && IsURLCacheEntry(cache_entry, url, url_length)
+                    && cache_entry->m_DefaultURL.m_Socket == default_url.m_Socket
+                    && cache_entry->m_DefaultURL.m_Path == default_url.m_Path
+                    && cache_entry->m_DefaultURL.m_Fragment == default_url.m_Fragment)
+                {
+                    *out_url = cache_entry->m_URL;
+                    if (out_default_url != 0x0)
+                    {
+                        *out_default_url = default_url;
+                    }
+                    return 0;
+                }
+
                 // Make sure we get and parse the url only once
-                url = lua_tostring(L, index);
                 parse_url_result = dmMessage::ParseURL(url, &string_url);
                 if (parse_url_result != dmMessage::RESULT_OK)
                 {
@@ -702,10 +816,10 @@ namespace dmScript
                                 out_url->m_Socket = socket;
                                 out_url->m_Path = dmHashBuffer64(string_url.m_Path, string_url.m_PathSize);
                                 out_url->m_Fragment = dmHashBuffer64(string_url.m_Fragment, string_url.m_FragmentSize);
+                                PutURLCacheEntry(GetURLCacheEntry(url, 0), url, url_length, 0x0, *out_url);
                                 if (out_default_url != 0x0)
                                 {
-                                    dmMessage::ResetURL(*out_default_url);
-                                    GetURL(L, out_default_url);
+                                    *out_default_url = default_url;
                                 }
                                 return 0;
                             case dmMessage::RESULT_INVALID_SOCKET_NAME:
@@ -717,9 +831,11 @@ namespace dmScript
                 }
             }
             // Fetch default URL from the lua state
-            dmMessage::URL default_url;
-            dmMessage::ResetURL(default_url);
-            GetURL(L, &default_url);
+            if (!has_default_url)
+            {
+                dmMessage::ResetURL(default_url);
+                GetURL(L, &default_url);
+            }
             if (out_default_url != 0x0)
             {
                 *out_default_url = default_url;
@@ -737,7 +853,11 @@ namespace dmScript
                 {
                     result = ResolveURL(L, url, out_url, &default_url);
                 }
-                if (result != dmMessage::RESULT_OK)
+                if (result == dmMessage::RESULT_OK)
+                {
+                    PutURLCacheEntry(cache_entry, url, url_length, &default_url, *out_url);
+                }
+                else
                 {
                     switch (result)
                     {
@@ -74,9 +74,13 @@ namespace dmScript
         dmArray<HScriptExtension>   m_ScriptExtensions;
         lua_State*                  m_LuaState;
         int                         m_ContextTableRef;
+        uint32_t                    m_GCStepBudget;         // Microseconds per frame, 0 for automatic collection
+        uint32_t                    m_GCHeapAfterCycle;     // Heap size in Kb after the last finished collection cycle
         bool                        m_EnableExtensions;
     };
 
+    const uint32_t MAX_MESSAGE_DATA_SIZE = 2048;
+
     HContext GetScriptContext(lua_State* L);
 
     bool ResolvePath(lua_State* L, const char* path, uint32_t path_size, dmhash_t& out_hash);
@@ -91,6 +95,21 @@ namespace dmScript
      */
     void ClearModules(HContext context);
 
+    void RegisterTableRefState(lua_State* L);
+    void UnregisterTableRefState(lua_State* L);
+
+    /**
+     * Copy the table at index and store a reference to the copy in buffer, as an alternative to CheckTable
+     * for messages with a single receiver. The buffer can be read with PushTable, and the reference must
+     * be released with ReleaseTableReference once the message is done with.
+     * @return Number of bytes used in buffer, or 0 if the table must be serialized with CheckTable
+     */
+    uint32_t CheckTableReference(lua_State* L, char* buffer, uint32_t buffer_size, int index);
+    void ReleaseTableReference(const char* buffer, uint32_t buffer_size);
+
+    // Exposed here for the benchmark in test_script_msg.cpp. Clears the resolved url cache
+    void SetURLCacheEnabled(bool enabled);
+
     // Exposed here for tests in test_script_module.cpp
     const char* FindSuitableChunkname(const char* input);
     const char* PrefixFilename(const char *input, char prefix, char *buf, uint32_t size);
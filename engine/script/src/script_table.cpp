@@ -12,6 +12,7 @@
 
 #include <stdint.h>
 #include <string.h>
+#include <dlib/array.h>
 #include <dlib/log.h>
 #include <dlib/dstrings.h>
 #include <dlib/static_assert.h>
@@ -44,6 +45,7 @@ namespace dmScript
 {
     const int TABLE_MAGIC = 0x42544448;
     const uint32_t TABLE_VERSION_CURRENT = 3;
+    const int TABLE_REF_MAGIC = 0x46455254;
 
     /*
      * Original table serialization format:
@@ -878,6 +880,317 @@ namespace dmScript
 
 #undef CHECK_PUSHTABLE_OOB
 
+    /*
+     * Table reference payload
+     *
+     * Used by msg.post for tables sent to a single receiver. Instead of serializing the table, a copy of it is
+     * made within the sending Lua state and kept in the registry until the message has been dispatched.
+     * A receiver running in the same Lua state gets the copy as is, other receivers get it serialized on demand.
+     * The copy is needed since the sender is free to modify the table after posting it.
+     *
+     * The magic word is chosen so that it will not match the other table formats, and the payload is never
+     * stored beyond the lifetime of the message.
+     */
+    struct TableRefPayload
+    {
+        uint32_t   m_Magic;
+        int        m_Reference;
+        lua_State* m_L;
+        uint32_t   m_StateId;
+    };
+
+    // Main Lua states that table references can be created in. Messages might outlive the state they were
+    // posted from (e.g. messages to the system socket at shutdown), so the references are only touched while the state
+    // is still registered. The id guards against a new state being allocated at the address of a deleted one.
+    struct TableRefState
+    {
+        lua_State* m_L;
+        uint32_t   m_Id;
+    };
+
+    static dmArray<TableRefState> g_TableRefStates;
+    static uint32_t g_NextTableRefStateId = 1;
+
+    void RegisterTableRefState(lua_State* L)
+    {
+        if (g_TableRefStates.Full())
+        {
+            g_TableRefStates.OffsetCapacity(4);
+        }
+        TableRefState state;
+        state.m_L = L;
+        state.m_Id = g_NextTableRefStateId++;
+        g_TableRefStates.Push(state);
+    }
+
+    void UnregisterTableRefState(lua_State* L)
+    {
+        for (uint32_t i = 0; i < g_TableRefStates.Size(); ++i)
+        {
+            if (g_TableRefStates[i].m_L == L)
+            {
+                g_TableRefStates.EraseSwap(i);
+                return;
+            }
+        }
+    }
+
+    static uint32_t GetTableRefStateId(lua_State* L)
+    {
+        for (uint32_t i = 0; i < g_TableRefStates.Size(); ++i)
+        {
+            if (g_TableRefStates[i].m_L == L)
+            {
+                return g_TableRefStates[i].m_Id;
+            }
+        }
+        return 0;
+    }
+
+    // Upper bounds of the serialized sizes, including alignment, see DoCheckTable
+    static const uint32_t TABLE_REF_NUMBER_SIZE = sizeof(float) - 1 + sizeof(lua_Number);
+    static const uint32_t TABLE_REF_USERDATA_SIZE = 1 + sizeof(float) - 1;
+
+    static uint32_t GetUserDataSize(lua_State* L, int index)
+    {
+        if (ToVector3(L, index))
+            return sizeof(float) * 3;
+        else if (ToVector4(L, index) || ToQuat(L, index))
+            return sizeof(float) * 4;
+        else if (ToMatrix4(L, index))
+            return sizeof(float) * 16;
+        else if (IsHash(L, index))
+            return sizeof(dmhash_t);
+        else if (IsURL(L, index))
+            return sizeof(dmMessage::URL);
+        return 0;
+    }
+
+    static void CopyUserData(lua_State* L, int index)
+    {
+        Vectormath::Aos::Vector3* v3;
+        Vectormath::Aos::Vector4* v4;
+        Vectormath::Aos::Quat* q;
+        Vectormath::Aos::Matrix4* m;
+        if ((v3 = ToVector3(L, index)))
+            PushVector3(L, *v3);
+        else if ((v4 = ToVector4(L, index)))
+            PushVector4(L, *v4);
+        else if ((q = ToQuat(L, index)))
+            PushQuat(L, *q);
+        else if ((m = ToMatrix4(L, index)))
+            PushMatrix4(L, *m);
+        else if (IsHash(L, index))
+            PushHash(L, *(dmhash_t*)lua_touserdata(L, index));
+        else
+            PushURL(L, *(dmMessage::URL*)lua_touserdata(L, index));
+    }
+
+    // Pushes a deep copy of the table at the top of the stack. Returns false, with nothing pushed, if the table
+    // contains anything DoCheckTable would not accept or if it would not fit in size bytes when serialized.
+    // Nested tables are counted against the size as well, which also stops self referencing tables.
+    static bool CopyTable(lua_State* L, uint32_t& size)
+    {
+        int top = lua_gettop(L);
+
+        if (size < 2 || !lua_checkstack(L, 5))
+        {
+            return false;
+        }
+        size -= 2;
+
+        lua_createtable(L, lua_objlen(L, -1), 0);
+        lua_pushnil(L);
+        while (lua_next(L, -3) != 0)
+        {
+            // [-4] source table
+            // [-3] copy
+            // [-2] key
+            // [-1] value
+            uint32_t entry_size = 2;
+            int key_type = lua_type(L, -2);
+            if (key_type == LUA_TSTRING)
+            {
+                entry_size += sizeof(uint32_t) + lua_objlen(L, -2);
+            }
+            else if (key_type == LUA_TNUMBER)
+            {
+                lua_Number key = lua_tonumber(L, -2);
+                lua_Number abs_key = key < 0 ? -key : key;
+                if (abs_key > 0xffffffff || (lua_Number)(uint32_t)abs_key != abs_key)
+                {
+                    lua_settop(L, top);
+                    return false;
+                }
+                entry_size += sizeof(uint32_t);
+            }
+            else
+            {
+                lua_settop(L, top);
+                return false;
+            }
+
+            switch (lua_type(L, -1))
+            {
+                case LUA_TBOOLEAN:
+                    entry_size += 1;
+                    break;
+                case LUA_TNUMBER:
+                    entry_size += TABLE_REF_NUMBER_SIZE;
+                    break;
+                case LUA_TSTRING:
+                    entry_size += sizeof(uint32_t) + lua_objlen(L, -1);
+                    break;
+                case LUA_TUSERDATA:
+                {
+                    uint32_t user_data_size = GetUserDataSize(L, -1);
+                    if (user_data_size == 0)
+                    {
+                        lua_settop(L, top);
+                        return false;
+                    }
+                    entry_size += TABLE_REF_USERDATA_SIZE + user_data_size;
+                    CopyUserData(L, -1);
+                    lua_replace(L, -2);
+                }
+                break;
+                case LUA_TTABLE:
+                    break;
+                default:
+                    lua_settop(L, top);
+                    return false;
+            }
+
+            if (entry_size > size)
+            {
+                lua_settop(L, top);
+                return false;
+            }
+            size -= entry_size;
+
+            if (lua_type(L, -1) == LUA_TTABLE)
+            {
+                if (!CopyTable(L, size))
+                {
+                    lua_settop(L, top);
+                    return false;
+                }
+                lua_replace(L, -2);
+            }
+
+            // [-4] source table
+            // [-3] copy
+            // [-2] key
+            // [-1] value (copied)
+            lua_pushvalue(L, -2);
+            lua_insert(L, -2);
+            lua_rawset(L, -4);
+        }
+
+        assert(top + 1 == lua_gettop(L));
+        return true;
+    }
+
+    uint32_t CheckTableReference(lua_State* L, char* buffer, uint32_t buffer_size, int index)
+    {
+        DM_LUA_STACK_CHECK(L, 0);
+
+        if (buffer_size < sizeof(TableRefPayload) || lua_type(L, index) != LUA_TTABLE)
+        {
+            return 0;
+        }
+
+        lua_State* main_thread = GetMainThread(L);
+        uint32_t state_id = main_thread ? GetTableRefStateId(main_thread) : 0;
+        if (state_id == 0)
+        {
+            return 0;
+        }
+
+        uint32_t size = MAX_MESSAGE_DATA_SIZE - sizeof(TableHeader);
+        lua_pushvalue(L, index);
+        bool copied = CopyTable(L, size);
+        if (!copied)
+        {
+            lua_pop(L, 1);
+            return 0;
+        }
+        lua_remove(L, -2);
+
+        TableRefPayload* payload = (TableRefPayload*)buffer;
+        payload->m_Magic = TABLE_REF_MAGIC;
+        payload->m_Reference = Ref(L, LUA_REGISTRYINDEX);
+        payload->m_L = main_thread;
+        payload->m_StateId = state_id;
+        return sizeof(TableRefPayload);
+    }
+
+    static const TableRefPayload* GetTableRefPayload(const char* buffer, uint32_t buffer_size)
+    {
+        const TableRefPayload* payload = (const TableRefPayload*)buffer;
+        if (buffer_size != sizeof(TableRefPayload) || payload->m_Magic != (uint32_t)TABLE_REF_MAGIC)
+        {
+            return 0;
+        }
+        return payload;
+    }
+
+    void ReleaseTableReference(const char* buffer, uint32_t buffer_size)
+    {
+        const TableRefPayload* payload = GetTableRefPayload(buffer, buffer_size);
+        if (payload && GetTableRefStateId(payload->m_L) == payload->m_StateId)
+        {
+            Unref(payload->m_L, LUA_REGISTRYINDEX, payload->m_Reference);
+        }
+    }
+
+    struct SerializeTableRefContext
+    {
+        int      m_Reference;
+        char*    m_Buffer;
+        uint32_t m_Size;
+    };
+
+    static int SerializeTableRef(lua_State* L)
+    {
+        SerializeTableRefContext* ctx = (SerializeTableRefContext*)lua_touserdata(L, 1);
+        lua_rawgeti(L, LUA_REGISTRYINDEX, ctx->m_Reference);
+        ctx->m_Size = CheckTable(L, ctx->m_Buffer, MAX_MESSAGE_DATA_SIZE, -1);
+        return 0;
+    }
+
+    static void PushTableReference(lua_State* L, const TableRefPayload* payload)
+    {
+        lua_State* sender_L = payload->m_L;
+        if (GetTableRefStateId(sender_L) != payload->m_StateId)
+        {
+            dmLogError("The table was posted from a script context that has been deleted");
+            lua_newtable(L);
+            return;
+        }
+
+        if (GetMainThread(L) == sender_L)
+        {
+            lua_rawgeti(L, LUA_REGISTRYINDEX, payload->m_Reference);
+            return;
+        }
+
+        // The receiver lives in another Lua state, serialize the table as msg.post would have
+        DM_ALIGNED(16) char buffer[MAX_MESSAGE_DATA_SIZE];
+        SerializeTableRefContext ctx;
+        ctx.m_Reference = payload->m_Reference;
+        ctx.m_Buffer = buffer;
+        ctx.m_Size = 0;
+        if (lua_cpcall(sender_L, SerializeTableRef, &ctx) != 0)
+        {
+            dmLogError("Failed to serialize posted table: %s", lua_tostring(sender_L, -1));
+            lua_pop(sender_L, 1);
+            lua_newtable(L);
+            return;
+        }
+        PushTable(L, buffer, ctx.m_Size);
+    }
+
     void PushTable(lua_State*L, const char* buffer, uint32_t buffer_size)
     {
         TableHeader header;
@@ -890,6 +1203,13 @@ namespace dmScript
             luaL_error(L, "%s", str);
         }
 
+        const TableRefPayload* payload = GetTableRefPayload(buffer, buffer_size);
+        if (payload)
+        {
+            PushTableReference(L, payload);
+            return;
+        }
+
         buffer = ReadHeader(buffer, header);
         if (IsSupportedVersion(header))
         {
@@ -39,6 +39,9 @@ namespace dmScript
      * - The matrix type (`vmath.matrix4`) can be multiplied with numbers, other matrices
      *   and `vmath.vector4` values.
      * - All types performs equality comparison by each component value.
+     * - Functions ending in `_to` store the result in an existing value instead of creating a new one,
+     *   and `vmath.scratch_vector3` and friends hand out temporaries that are reused every frame.
+     *   Both avoid garbage in code that runs every frame.
      *
      * The following components are available for the various types:
      *
@@ -2265,6 +2268,493 @@ namespace dmScript
         return 1;
     }
 
+    /*# adds two vectors and stores the result
+     *
+     * Adds `v1` and `v2` and writes the result into `out`, without creating
+     * a new vector. `out` can be the same value as one of the arguments.
+     *
+     * @name vmath.add_to
+     * @param out [type:vector3|vector4] vector to store the result in
+     * @param v1 [type:vector3|vector4] first vector
+     * @param v2 [type:vector3|vector4] second vector
+     * @return out [type:vector3|vector4] the `out` argument
+     * @examples
+     *
+     * ```lua
+     * function update(self, dt)
+     *     vmath.add_to(self.position, self.position, self.velocity * dt)
+     * end
+     * ```
+     */
+    static int AddTo(lua_State* L)
+    {
+        const ScriptUserType type = GetType(L, 1);
+        if (type == SCRIPT_TYPE_VECTOR3)
+        {
+            Vectormath::Aos::Vector3* out = (Vectormath::Aos::Vector3*)lua_touserdata(L, 1);
+            *out = *CheckVector3(L, 2) + *CheckVector3(L, 3);
+        }
+        else if (type == SCRIPT_TYPE_VECTOR4)
+        {
+            Vectormath::Aos::Vector4* out = (Vectormath::Aos::Vector4*)lua_touserdata(L, 1);
+            *out = *CheckVector4(L, 2) + *CheckVector4(L, 3);
+        }
+        else
+        {
+            return luaL_error(L, "%s.%s accepts (%s|%s) as arguments.", SCRIPT_LIB_NAME, "add_to", SCRIPT_TYPE_NAME_VECTOR3, SCRIPT_TYPE_NAME_VECTOR4);
+        }
+        lua_settop(L, 1);
+        return 1;
+    }
+
+    /*# subtracts two vectors and stores the result
+     *
+     * Subtracts `v2` from `v1` and writes the result into `out`, without creating
+     * a new vector. `out` can be the same value as one of the arguments.
+     *
+     * @name vmath.sub_to
+     * @param out [type:vector3|vector4] vector to store the result in
+     * @param v1 [type:vector3|vector4] vector to subtract from
+     * @param v2 [type:vector3|vector4] vector to subtract
+     * @return out [type:vector3|vector4] the `out` argument
+     * @examples
+     *
+     * ```lua
+     * local direction = vmath.vector3()
+     * vmath.sub_to(direction, target_position, position)
+     * ```
+     */
+    static int SubTo(lua_State* L)
+    {
+        const ScriptUserType type = GetType(L, 1);
+        if (type == SCRIPT_TYPE_VECTOR3)
+        {
+            Vectormath::Aos::Vector3* out = (Vectormath::Aos::Vector3*)lua_touserdata(L, 1);
+            *out = *CheckVector3(L, 2) - *CheckVector3(L, 3);
+        }
+        else if (type == SCRIPT_TYPE_VECTOR4)
+        {
+            Vectormath::Aos::Vector4* out = (Vectormath::Aos::Vector4*)lua_touserdata(L, 1);
+            *out = *CheckVector4(L, 2) - *CheckVector4(L, 3);
+        }
+        else
+        {
+            return luaL_error(L, "%s.%s accepts (%s|%s) as arguments.", SCRIPT_LIB_NAME, "sub_to", SCRIPT_TYPE_NAME_VECTOR3, SCRIPT_TYPE_NAME_VECTOR4);
+        }
+        lua_settop(L, 1);
+        return 1;
+    }
+
+    /*# multiplies two values and stores the result
+     *
+     * Multiplies `a` and `b` and writes the result into `out`, without creating
+     * a new value. The supported combinations are the same as for the `*` operator,
+     * with `out` being of the type of the result:
+     *
+     * - `vector3` or `vector4` and a number, in any order
+     * - `quat` and `quat`
+     * - `matrix4` and `matrix4`
+     * - `matrix4` and a number, in any order
+     * - `matrix4` and `vector4`, giving a `vector4`
+     *
+     * `out` can be the same value as one of the arguments.
+     *
+     * @name vmath.mul_to
+     * @param out [type:vector3|vector4|quaternion|matrix4] value to store the result in
+     * @param a [type:vector3|vector4|quaternion|matrix4|number] first value
+     * @param b [type:vector3|vector4|quaternion|matrix4|number] second value
+     * @return out [type:vector3|vector4|quaternion|matrix4] the `out` argument
+     * @examples
+     *
+     * ```lua
+     * function update(self, dt)
+     *     vmath.mul_to(self.step, self.velocity, dt)
+     *     vmath.add_to(self.position, self.position, self.step)
+     * end
+     * ```
+     */
+    static int MulTo(lua_State* L)
+    {
+        const ScriptUserType type = GetType(L, 1);
+        if (type == SCRIPT_TYPE_VECTOR3)
+        {
+            Vectormath::Aos::Vector3* out = (Vectormath::Aos::Vector3*)lua_touserdata(L, 1);
+            if (lua_isnumber(L, 2))
+            {
+                *out = *CheckVector3(L, 3) * (float) lua_tonumber(L, 2);
+            }
+            else
+            {
+                *out = *CheckVector3(L, 2) * (float) luaL_checknumber(L, 3);
+            }
+        }
+        else if (type == SCRIPT_TYPE_VECTOR4)
+        {
+            Vectormath::Aos::Vector4* out = (Vectormath::Aos::Vector4*)lua_touserdata(L, 1);
+            if (lua_isnumber(L, 2))
+            {
+                *out = *CheckVector4(L, 3) * (float) lua_tonumber(L, 2);
+            }
+            else if (GetType(L, 2) == SCRIPT_TYPE_MATRIX4)
+            {
+                *out = *CheckMatrix4(L, 2) * *CheckVector4(L, 3);
+            }
+            else
+            {
+                *out = *CheckVector4(L, 2) * (float) luaL_checknumber(L, 3);
+            }
+        }
+        else if (type == SCRIPT_TYPE_QUAT)
+        {
+            Vectormath::Aos::Quat* out = (Vectormath::Aos::Quat*)lua_touserdata(L, 1);
+            *out = *CheckQuat(L, 2) * *CheckQuat(L, 3);
+        }
+        else if (type == SCRIPT_TYPE_MATRIX4)
+        {
+            Vectormath::Aos::Matrix4* out = (Vectormath::Aos::Matrix4*)lua_touserdata(L, 1);
+            if (lua_isnumber(L, 2))
+            {
+                *out = *CheckMatrix4(L, 3) * (float) lua_tonumber(L, 2);
+            }
+            else if (lua_isnumber(L, 3))
+            {
+                *out = *CheckMatrix4(L, 2) * (float) lua_tonumber(L, 3);
+            }
+            else
+            {
+                *out = *CheckMatrix4(L, 2) * *CheckMatrix4(L, 3);
+            }
+        }
+        else
+        {
+            return luaL_error(L, "%s.%s accepts (%s|%s|%s|%s) as first argument.", SCRIPT_LIB_NAME, "mul_to", SCRIPT_TYPE_NAME_VECTOR3, SCRIPT_TYPE_NAME_VECTOR4, SCRIPT_TYPE_NAME_QUAT, SCRIPT_TYPE_NAME_MATRIX4);
+        }
+        lua_settop(L, 1);
+        return 1;
+    }
+
+    /*# divides a vector by a number and stores the result
+     *
+     * Divides `v` by `n` and writes the result into `out`, without creating
+     * a new vector. `out` can be the same value as `v`.
+     *
+     * @name vmath.div_to
+     * @param out [type:vector3|vector4] vector to store the result in
+     * @param v [type:vector3|vector4] vector to divide
+     * @param n [type:number] number to divide by
+     * @return out [type:vector3|vector4] the `out` argument
+     * @examples
+     *
+     * ```lua
+     * vmath.div_to(self.average, self.sum, self.count)
+     * ```
+     */
+    static int DivTo(lua_State* L)
+    {
+        const ScriptUserType type = GetType(L, 1);
+        if (type == SCRIPT_TYPE_VECTOR3)
+        {
+            Vectormath::Aos::Vector3* out = (Vectormath::Aos::Vector3*)lua_touserdata(L, 1);
+            *out = *CheckVector3(L, 2) / (float) luaL_checknumber(L, 3);
+        }
+        else if (type == SCRIPT_TYPE_VECTOR4)
+        {
+            Vectormath::Aos::Vector4* out = (Vectormath::Aos::Vector4*)lua_touserdata(L, 1);
+            *out = *CheckVector4(L, 2) / (float) luaL_checknumber(L, 3);
+        }
+        else
+        {
+            return luaL_error(L, "%s.%s accepts (%s|%s) as first argument.", SCRIPT_LIB_NAME, "div_to", SCRIPT_TYPE_NAME_VECTOR3, SCRIPT_TYPE_NAME_VECTOR4);
+        }
+        lua_settop(L, 1);
+        return 1;
+    }
+
+    /*# normalizes a vector and stores the result
+     *
+     * Normalizes `v1` and writes the result into `out`, without creating
+     * a new value. `out` can be the same value as `v1`.
+     *
+     * [icon:attention] Zero length vectors cannot be normalized.
+     *
+     * @name vmath.normalize_to
+     * @param out [type:vector3|vector4|quaternion] value to store the result in
+     * @param v1 [type:vector3|vector4|quaternion] vector to normalize
+     * @return out [type:vector3|vector4|quaternion] the `out` argument
+     * @examples
+     *
+     * ```lua
+     * vmath.normalize_to(self.direction, self.velocity)
+     * ```
+     */
+    static int NormalizeTo(lua_State* L)
+    {
+        const ScriptUserType type = GetType(L, 1);
+        if (type == SCRIPT_TYPE_VECTOR3)
+        {
+            Vectormath::Aos::Vector3* out = (Vectormath::Aos::Vector3*)lua_touserdata(L, 1);
+            *out = Vectormath::Aos::normalize(*CheckVector3(L, 2));
+        }
+        else if (type == SCRIPT_TYPE_VECTOR4)
+        {
+            Vectormath::Aos::Vector4* out = (Vectormath::Aos::Vector4*)lua_touserdata(L, 1);
+            *out = Vectormath::Aos::normalize(*CheckVector4(L, 2));
+        }
+        else if (type == SCRIPT_TYPE_QUAT)
+        {
+            Vectormath::Aos::Quat* out = (Vectormath::Aos::Quat*)lua_touserdata(L, 1);
+            *out = Vectormath::Aos::normalize(*CheckQuat(L, 2));
+        }
+        else
+        {
+            return luaL_error(L, "%s.%s accepts (%s|%s|%s) as arguments.", SCRIPT_LIB_NAME, "normalize_to", SCRIPT_TYPE_NAME_VECTOR3, SCRIPT_TYPE_NAME_VECTOR4, SCRIPT_TYPE_NAME_QUAT);
+        }
+        lua_settop(L, 1);
+        return 1;
+    }
+
+    /*# calculates the cross-product of two vectors and stores the result
+     *
+     * Calculates the cross product of `v1` and `v2` and writes the result into `out`,
+     * without creating a new vector. `out` can be the same value as one of the arguments.
+     *
+     * @name vmath.cross_to
+     * @param out [type:vector3] vector to store the result in
+     * @param v1 [type:vector3] first vector
+     * @param v2 [type:vector3] second vector
+     * @return out [type:vector3] the `out` argument
+     * @examples
+     *
+     * ```lua
+     * vmath.cross_to(self.right, self.forward, self.up)
+     * ```
+     */
+    static int CrossTo(lua_State* L)
+    {
+        if (GetType(L, 1) != SCRIPT_TYPE_VECTOR3)
+        {
+            return luaL_error(L, "%s.%s accepts %s as first argument.", SCRIPT_LIB_NAME, "cross_to", SCRIPT_TYPE_NAME_VECTOR3);
+        }
+        Vectormath::Aos::Vector3* out = (Vectormath::Aos::Vector3*)lua_touserdata(L, 1);
+        *out = Vectormath::Aos::cross(*CheckVector3(L, 2), *CheckVector3(L, 3));
+        lua_settop(L, 1);
+        return 1;
+    }
+
+    /*# lerps between two values and stores the result
+     *
+     * Linearly interpolates between `v1` and `v2` and writes the result into `out`,
+     * without creating a new value. `out` can be the same value as one of the arguments.
+     *
+     * [icon:attention] The function does not clamp t between 0 and 1.
+     *
+     * @name vmath.lerp_to
+     * @param out [type:vector3|vector4|quaternion] value to store the result in
+     * @param t [type:number] interpolation parameter, 0-1
+     * @param v1 [type:vector3|vector4|quaternion] value to lerp from
+     * @param v2 [type:vector3|vector4|quaternion] value to lerp to
+     * @return out [type:vector3|vector4|quaternion] the `out` argument
+     * @examples
+     *
+     * ```lua
+     * function update(self, dt)
+     *     -- ease the camera towards the target
+     *     vmath.lerp_to(self.camera_position, 0.1, self.camera_position, self.target_position)
+     * end
+     * ```
+     */
+    static int LerpTo(lua_State* L)
+    {
+        const ScriptUserType type = GetType(L, 1);
+        float t = (float) luaL_checknumber(L, 2);
+        if (type == SCRIPT_TYPE_VECTOR3)
+        {
+            Vectormath::Aos::Vector3* out = (Vectormath::Aos::Vector3*)lua_touserdata(L, 1);
+            *out = Vectormath::Aos::lerp(t, *CheckVector3(L, 3), *CheckVector3(L, 4));
+        }
+        else if (type == SCRIPT_TYPE_VECTOR4)
+        {
+            Vectormath::Aos::Vector4* out = (Vectormath::Aos::Vector4*)lua_touserdata(L, 1);
+            *out = Vectormath::Aos::lerp(t, *CheckVector4(L, 3), *CheckVector4(L, 4));
+        }
+        else if (type == SCRIPT_TYPE_QUAT)
+        {
+            Vectormath::Aos::Quat* out = (Vectormath::Aos::Quat*)lua_touserdata(L, 1);
+            *out = Vectormath::Aos::lerp(t, *CheckQuat(L, 3), *CheckQuat(L, 4));
+        }
+        else
+        {
+            return luaL_error(L, "%s.%s accepts (%s|%s|%s) as first argument.", SCRIPT_LIB_NAME, "lerp_to", SCRIPT_TYPE_NAME_VECTOR3, SCRIPT_TYPE_NAME_VECTOR4, SCRIPT_TYPE_NAME_QUAT);
+        }
+        lua_settop(L, 1);
+        return 1;
+    }
+
+    /*# rotates a vector by a quaternion and stores the result
+     *
+     * Rotates `v1` by the rotation described by `q` and writes the result into `out`,
+     * without creating a new vector. `out` can be the same value as `v1`.
+     *
+     * @name vmath.rotate_to
+     * @param out [type:vector3] vector to store the result in
+     * @param q [type:quaternion] quaternion
+     * @param v1 [type:vector3] vector to rotate
+     * @return out [type:vector3] the `out` argument
+     * @examples
+     *
+     * ```lua
+     * vmath.rotate_to(self.forward, go.get_rotation(), vmath.vector3(0, 0, -1))
+     * ```
+     */
+    static int RotateTo(lua_State* L)
+    {
+        if (GetType(L, 1) != SCRIPT_TYPE_VECTOR3)
+        {
+            return luaL_error(L, "%s.%s accepts %s as first argument.", SCRIPT_LIB_NAME, "rotate_to", SCRIPT_TYPE_NAME_VECTOR3);
+        }
+        Vectormath::Aos::Vector3* out = (Vectormath::Aos::Vector3*)lua_touserdata(L, 1);
+        *out = Vectormath::Aos::rotate(*CheckQuat(L, 2), *CheckVector3(L, 3));
+        lua_settop(L, 1);
+        return 1;
+    }
+
+    // Temporaries handed out by the vmath.scratch_* functions. The values are created once and then reused,
+    // dmScript::Update resets the pools every frame. Each function has the scratch state and its pool table
+    // as upvalues.
+#define VMATH_SCRATCH "__vmath_scratch"
+
+    enum ScratchType
+    {
+        SCRATCH_TYPE_VECTOR3,
+        SCRATCH_TYPE_VECTOR4,
+        SCRATCH_TYPE_QUAT,
+        SCRATCH_TYPE_MATRIX4,
+        SCRATCH_TYPE_COUNT,
+    };
+
+    struct VmathScratch
+    {
+        uint32_t m_Used[SCRATCH_TYPE_COUNT];
+    };
+
+    static void* NextScratch(lua_State* L, ScratchType type, uint32_t size, const char* type_name)
+    {
+        VmathScratch* scratch = (VmathScratch*)lua_touserdata(L, lua_upvalueindex(1));
+        uint32_t index = ++scratch->m_Used[type];
+        lua_rawgeti(L, lua_upvalueindex(2), index);
+        if (lua_isnil(L, -1))
+        {
+            lua_pop(L, 1);
+            lua_newuserdata(L, size);
+            luaL_getmetatable(L, type_name);
+            lua_setmetatable(L, -2);
+            lua_pushvalue(L, -1);
+            lua_rawseti(L, lua_upvalueindex(2), index);
+        }
+        return lua_touserdata(L, -1);
+    }
+
+    /*# gets a temporary vector3
+     *
+     * Returns a vector3 from a pool of temporaries instead of creating a new one.
+     * The pool is reset at the start of every frame, after which the same vector
+     * is handed out again.
+     *
+     * [icon:attention] The vector must not be kept beyond the current frame,
+     * it will be overwritten by later calls.
+     *
+     * @name vmath.scratch_vector3
+     * @param [x] [type:number] x coordinate, default 0
+     * @param [y] [type:number] y coordinate, default 0
+     * @param [z] [type:number] z coordinate, default 0
+     * @return v [type:vector3] temporary vector
+     * @examples
+     *
+     * ```lua
+     * function update(self, dt)
+     *     local step = vmath.mul_to(vmath.scratch_vector3(), self.velocity, dt)
+     *     vmath.add_to(self.position, self.position, step)
+     * end
+     * ```
+     */
+    static int Scratch_Vector3(lua_State* L)
+    {
+        Vectormath::Aos::Vector3* v = (Vectormath::Aos::Vector3*)NextScratch(L, SCRATCH_TYPE_VECTOR3, sizeof(Vectormath::Aos::Vector3), SCRIPT_TYPE_NAME_VECTOR3);
+        *v = Vectormath::Aos::Vector3((float) luaL_optnumber(L, 1, 0), (float) luaL_optnumber(L, 2, 0), (float) luaL_optnumber(L, 3, 0));
+        return 1;
+    }
+
+    /*# gets a temporary vector4
+     *
+     * Returns a vector4 from a pool of temporaries instead of creating a new one.
+     * The pool is reset at the start of every frame.
+     *
+     * [icon:attention] The vector must not be kept beyond the current frame,
+     * it will be overwritten by later calls.
+     *
+     * @name vmath.scratch_vector4
+     * @param [x] [type:number] x coordinate, default 0
+     * @param [y] [type:number] y coordinate, default 0
+     * @param [z] [type:number] z coordinate, default 0
+     * @param [w] [type:number] w coordinate, default 0
+     * @return v [type:vector4] temporary vector
+     */
+    static int Scratch_Vector4(lua_State* L)
+    {
+        Vectormath::Aos::Vector4* v = (Vectormath::Aos::Vector4*)NextScratch(L, SCRATCH_TYPE_VECTOR4, sizeof(Vectormath::Aos::Vector4), SCRIPT_TYPE_NAME_VECTOR4);
+        *v = Vectormath::Aos::Vector4((float) luaL_optnumber(L, 1, 0), (float) luaL_optnumber(L, 2, 0), (float) luaL_optnumber(L, 3, 0), (float) luaL_optnumber(L, 4, 0));
+        return 1;
+    }
+
+    /*# gets a temporary quaternion
+     *
+     * Returns a quaternion from a pool of temporaries instead of creating a new one.
+     * The pool is reset at the start of every frame.
+     *
+     * [icon:attention] The quaternion must not be kept beyond the current frame,
+     * it will be overwritten by later calls.
+     *
+     * @name vmath.scratch_quat
+     * @param [x] [type:number] x coordinate, default 0
+     * @param [y] [type:number] y coordinate, default 0
+     * @param [z] [type:number] z coordinate, default 0
+     * @param [w] [type:number] w coordinate, default 1
+     * @return q [type:quaternion] temporary quaternion, the identity rotation if no components are given
+     */
+    static int Scratch_Quat(lua_State* L)
+    {
+        Vectormath::Aos::Quat* q = (Vectormath::Aos::Quat*)NextScratch(L, SCRATCH_TYPE_QUAT, sizeof(Vectormath::Aos::Quat), SCRIPT_TYPE_NAME_QUAT);
+        *q = Vectormath::Aos::Quat((float) luaL_optnumber(L, 1, 0), (float) luaL_optnumber(L, 2, 0), (float) luaL_optnumber(L, 3, 0), (float) luaL_optnumber(L, 4, 1));
+        return 1;
+    }
+
+    /*# gets a temporary matrix4
+     *
+     * Returns an identity matrix from a pool of temporaries instead of creating a new one.
+     * The pool is reset at the start of every frame.
+     *
+     * [icon:attention] The matrix must not be kept beyond the current frame,
+     * it will be overwritten by later calls.
+     *
+     * @name vmath.scratch_matrix4
+     * @return m [type:matrix4] temporary identity matrix
+     */
+    static int Scratch_Matrix4(lua_State* L)
+    {
+        Vectormath::Aos::Matrix4* m = (Vectormath::Aos::Matrix4*)NextScratch(L, SCRATCH_TYPE_MATRIX4, sizeof(Vectormath::Aos::Matrix4), SCRIPT_TYPE_NAME_MATRIX4);
+        *m = Vectormath::Aos::Matrix4::identity();
+        return 1;
+    }
+
+    static const luaL_reg scratch_methods[] =
+    {
+        {"scratch_vector3", Scratch_Vector3},
+        {"scratch_vector4", Scratch_Vector4},
+        {"scratch_quat", Scratch_Quat},
+        {"scratch_matrix4", Scratch_Matrix4},
+        {0, 0}
+    };
+
     static const luaL_reg methods[] =
     {
         {SCRIPT_TYPE_NAME_VECTOR, Vector_new},
@@ -2301,6 +2791,14 @@ namespace dmScript
         {"inv", Inverse},
         {"ortho_inv", OrthoInverse},
         {"mul_per_elem", MulPerElem},
+        {"add_to", AddTo},
+        {"sub_to", SubTo},
+        {"mul_to", MulTo},
+        {"div_to", DivTo},
+        {"normalize_to", NormalizeTo},
+        {"cross_to", CrossTo},
+        {"lerp_to", LerpTo},
+        {"rotate_to", RotateTo},
         {0, 0}
     };
 
@@ -2328,11 +2826,35 @@ namespace dmScript
             *types[i].m_TypeHash = dmScript::RegisterUserType(L, types[i].m_Name, types[i].m_Methods, types[i].m_Metatable);
         }
         luaL_register(L, SCRIPT_LIB_NAME, methods);
-        lua_pop(L, 1);
+
+        VmathScratch* scratch = (VmathScratch*)lua_newuserdata(L, sizeof(VmathScratch));
+        memset(scratch, 0, sizeof(VmathScratch));
+        lua_pushvalue(L, -1);
+        lua_setfield(L, LUA_REGISTRYINDEX, VMATH_SCRATCH);
+        for (const luaL_reg* method = scratch_methods; method->name != 0; ++method)
+        {
+            lua_pushvalue(L, -1);
+            lua_newtable(L);
+            lua_pushcclosure(L, method->func, 2);
+            lua_setfield(L, -3, method->name);
+        }
+        lua_pop(L, 2);
 
         assert(top == lua_gettop(L));
     }
 
+    void ResetVmathScratch(lua_State* L)
+    {
+        DM_LUA_STACK_CHECK(L, 0);
+        lua_getfield(L, LUA_REGISTRYINDEX, VMATH_SCRATCH);
+        VmathScratch* scratch = (VmathScratch*)lua_touserdata(L, -1);
+        if (scratch)
+        {
+            memset(scratch, 0, sizeof(VmathScratch));
+        }
+        lua_pop(L, 1);
+    }
+
     void PushVector(lua_State* L, dmVMath::FloatVector* v)
     {
         dmVMath::FloatVector** vp = (dmVMath::FloatVector**)lua_newuserdata(L, sizeof(dmVMath::FloatVector*));
@@ -21,6 +21,9 @@ extern "C"
 namespace dmScript
 {
     void InitializeVmath(lua_State* L);
+
+    // Makes the values handed out by vmath.scratch_* available for reuse, called once per frame
+    void ResetVmathScratch(lua_State* L);
 }
 
 #endif // DM_SCRIPT_VMATH_H
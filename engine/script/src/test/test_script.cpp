@@ -973,6 +973,46 @@ TEST_F(ScriptTest, InstanceId)
 }
 
 
+TEST_F(ScriptTest, GCStepBudget)
+{
+    ASSERT_EQ(0u, dmScript::GetGCStepBudget(m_Context));
+    dmScript::SetGCStepBudget(m_Context, 1000);
+    ASSERT_EQ(1000u, dmScript::GetGCStepBudget(m_Context));
+
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    lua_gc(L, LUA_GCSTOP, 0);
+    uint32_t heap = dmScript::GetLuaGCCount(L);
+
+    // The automatic collector is stopped, so the garbage stays around
+    ASSERT_TRUE(RunString(L,
+        "for i = 1,100000 do\n"
+        "    garbage = {i}\n"
+        "end\n"
+        ));
+    uint32_t heap_with_garbage = dmScript::GetLuaGCCount(L);
+    ASSERT_LT(heap + 1024, heap_with_garbage);
+
+    // Enough steps finish the cycle
+    for (uint32_t i = 0; i < 100000 && dmScript::GetLuaGCCount(L) >= heap_with_garbage; ++i)
+    {
+        dmScript::StepGC(m_Context, 0);
+    }
+    ASSERT_GT(heap_with_garbage, dmScript::GetLuaGCCount(L));
+
+    // Still stopped after stepping
+    heap = dmScript::GetLuaGCCount(L);
+    ASSERT_TRUE(RunString(L,
+        "for i = 1,100000 do\n"
+        "    garbage = {i}\n"
+        "end\n"
+        ));
+    ASSERT_LT(heap + 1024, dmScript::GetLuaGCCount(L));
+
+    dmScript::SetGCStepBudget(m_Context, 0);
+    ASSERT_EQ(0u, dmScript::GetGCStepBudget(m_Context));
+    ASSERT_TRUE(RunString(L, "garbage = nil"));
+}
+
 int main(int argc, char **argv)
 {
     jc_test_init(&argc, argv);
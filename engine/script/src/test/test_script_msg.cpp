@@ -15,6 +15,7 @@
 #include <string.h>
 
 #include "script.h"
+#include "script_private.h"
 #include "test/test_ddf.h"
 
 #include <dlib/dstrings.h>
@@ -749,6 +750,93 @@ TEST_F(ScriptMsgTest, TestURLCreateBeforeSocket)
 }
 
 
+void DispatchCallbackPushTable(dmMessage::Message *message, void* user_ptr)
+{
+    lua_State* L = (lua_State*)user_ptr;
+    dmScript::PushTable(L, (const char*)message->m_Data, message->m_DataSize);
+    lua_setglobal(L, "received");
+}
+
+TEST_F(ScriptMsgTest, TestPostTableReference)
+{
+    int top = lua_gettop(L);
+    int ref_count = dmScript::GetLuaRefCount();
+
+    dmMessage::HSocket socket;
+    ASSERT_EQ(dmMessage::RESULT_OK, dmMessage::NewSocket("socket", &socket));
+
+    // The receiver gets a copy, changes made after posting are not visible
+    ASSERT_TRUE(RunString(L,
+        "sent = {uint_value = 1, [3] = true, name = \"a\", id = hash(\"id\"), pos = vmath.vector3(1, 2, 3), sub = {value = 4}}\n"
+        "msg.post(\"socket:path#fragment\", \"table\", sent)\n"
+        "sent.uint_value = 2\n"
+        "sent.pos.x = 5\n"
+        "sent.sub.value = 6\n"
+        ));
+    ASSERT_EQ(ref_count + 1, dmScript::GetLuaRefCount());
+    ASSERT_EQ(1u, dmMessage::Dispatch(socket, DispatchCallbackPushTable, L));
+    ASSERT_EQ(ref_count, dmScript::GetLuaRefCount());
+    ASSERT_TRUE(RunString(L,
+        "assert(received ~= sent)\n"
+        "assert(received.uint_value == 1)\n"
+        "assert(received[3] == true)\n"
+        "assert(received.name == \"a\")\n"
+        "assert(received.id == hash(\"id\"))\n"
+        "assert(received.pos == vmath.vector3(1, 2, 3))\n"
+        "assert(received.sub.value == 4)\n"
+        ));
+
+    // Broadcasts are serialized so that every receiver gets a table of its own
+    ASSERT_TRUE(RunString(L, "msg.post(\"socket:path\", \"table\", {uint_value = 1})"));
+    ASSERT_EQ(ref_count, dmScript::GetLuaRefCount());
+    ASSERT_EQ(1u, dmMessage::Dispatch(socket, DispatchCallbackPushTable, L));
+    ASSERT_TRUE(RunString(L, "assert(received.uint_value == 1)"));
+
+    // Tables that msg.post cannot serialize are still rejected
+    ASSERT_FALSE(RunString(L, "msg.post(\"socket:path#fragment\", \"table\", {f = function() end})"));
+    ASSERT_FALSE(RunString(L, "local t = {} t.t = t msg.post(\"socket:path#fragment\", \"table\", t)"));
+    ASSERT_EQ(0u, dmMessage::Consume(socket));
+
+    // Messages that are never dispatched release the reference as well
+    ASSERT_TRUE(RunString(L, "msg.post(\"socket:path#fragment\", \"table\", {uint_value = 1})"));
+    ASSERT_EQ(ref_count + 1, dmScript::GetLuaRefCount());
+    ASSERT_EQ(dmMessage::RESULT_OK, dmMessage::DeleteSocket(socket));
+    ASSERT_EQ(ref_count, dmScript::GetLuaRefCount());
+
+    ASSERT_TRUE(RunString(L, "sent = nil received = nil"));
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
+TEST_F(ScriptMsgTest, TestPostTableReferenceOtherContext)
+{
+    int top = lua_gettop(L);
+
+    dmScript::HContext context = dmScript::NewContext(0, 0, true);
+    dmScript::Initialize(context);
+    lua_State* other_L = dmScript::GetLuaState(context);
+
+    // Received in another Lua state, the table is serialized on dispatch
+    ASSERT_TRUE(RunString(L, "msg.post(\"#fragment\", \"table\", {uint_value = 1, pos = vmath.vector3(1, 2, 3), sub = {value = 4}})"));
+    ASSERT_EQ(1u, dmMessage::Dispatch(m_DefaultURL.m_Socket, DispatchCallbackPushTable, other_L));
+    ASSERT_TRUE(RunString(other_L,
+        "assert(received.uint_value == 1)\n"
+        "assert(received.pos == vmath.vector3(1, 2, 3))\n"
+        "assert(received.sub.value == 4)\n"
+        ));
+
+    // The sending context is gone, the receiver gets an empty table
+    ASSERT_TRUE(RunString(other_L, "msg.post(\"default_socket:/default_path#fragment\", \"table\", {uint_value = 1})"));
+    dmScript::Finalize(context);
+    dmScript::DeleteContext(context);
+    ASSERT_EQ(1u, dmMessage::Dispatch(m_DefaultURL.m_Socket, DispatchCallbackPushTable, L));
+    ASSERT_TRUE(RunString(L,
+        "assert(next(received) == nil)\n"
+        "received = nil\n"
+        ));
+
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
 TEST_F(ScriptMsgTest, TestPerf)
 {
     uint64_t time = dmTime::GetTime();
@@ -765,6 +853,82 @@ TEST_F(ScriptMsgTest, TestPerf)
     printf("Time per post: %.4f\n", time / (double)count);
 }
 
+TEST_F(ScriptMsgTest, TestPerfURLCache)
+{
+    const char* urls[] = {"test_path#script", "/test_path#script", "default_socket:/test_path#script"};
+    const uint32_t count = 20000;
+    for (uint32_t u = 0; u < sizeof(urls) / sizeof(urls[0]); ++u)
+    {
+        char program[256];
+        dmSnPrintf(program, sizeof(program),
+            "for i = 1,%u do\n"
+            "    msg.post(\"%s\", \"test_message\")\n"
+            "end\n",
+            count, urls[u]);
+
+        for (uint32_t cached = 0; cached < 2; ++cached)
+        {
+            dmScript::SetURLCacheEnabled(cached != 0);
+            uint64_t time = dmTime::GetTime();
+            ASSERT_TRUE(RunString(L, program));
+            time = dmTime::GetTime() - time;
+            ASSERT_EQ(count, dmMessage::Consume(m_DefaultURL.m_Socket));
+            printf("%-34s %-9s %10.0f posts/s\n", urls[u], cached ? "cached" : "uncached", time > 0 ? count / (time / 1000000.0) : 0.0);
+        }
+    }
+    dmScript::SetURLCacheEnabled(true);
+}
+
+TEST_F(ScriptMsgTest, TestPerfTableReference)
+{
+    // Fragment-less urls are broadcasts and have their tables serialized
+    const char* urls[] = {"#script", "test_path"};
+    const char* kinds[] = {"reference", "serialized"};
+    const uint32_t count = 20000;
+    for (uint32_t u = 0; u < sizeof(urls) / sizeof(urls[0]); ++u)
+    {
+        char program[256];
+        dmSnPrintf(program, sizeof(program),
+            "local id = hash(\"enemy\")\n"
+            "local pos = vmath.vector3(1, 2, 3)\n"
+            "for i = 1,%u do\n"
+            "    msg.post(\"%s\", \"table\", {id = id, position = pos, damage = i, critical = false})\n"
+            "end\n",
+            count, urls[u]);
+
+        uint64_t time = dmTime::GetTime();
+        ASSERT_TRUE(RunString(L, program));
+        ASSERT_EQ(count, dmMessage::Dispatch(m_DefaultURL.m_Socket, DispatchCallbackPushTable, L));
+        time = dmTime::GetTime() - time;
+        printf("%-10s %10.0f messages/s\n", kinds[u], time > 0 ? count / (time / 1000000.0) : 0.0);
+    }
+    ASSERT_TRUE(RunString(L, "received = nil"));
+}
+
+TEST_F(ScriptMsgTest, TestURLCacheDefaultURL)
+{
+    // The same relative url resolves differently depending on the current instance
+    ASSERT_TRUE(RunString(L,
+        "url1 = msg.url(\"#other\")\n"
+        "assert(url1.path == hash(\"default_path\"))\n"
+        "assert(url1.fragment == hash(\"other\"))\n"
+        ));
+
+    dmMessage::URL other = m_DefaultURL;
+    other.m_Path = dmHashString64("other_path");
+    dmScript::PushURL(L, other);
+    lua_setglobal(L, DEFAULT_URL);
+
+    ASSERT_TRUE(RunString(L,
+        "url2 = msg.url(\"#other\")\n"
+        "assert(url2.path == hash(\"other_path\"))\n"
+        "assert(url2.fragment == hash(\"other\"))\n"
+        "msg.post(\"#other\", \"test_message\")\n"
+        ));
+
+    ASSERT_EQ(1u, dmMessage::Consume(m_DefaultURL.m_Socket));
+}
+
 TEST_F(ScriptMsgTest, TestPostDeletedSocket)
 {
     dmMessage::HSocket socket;
@@ -21,6 +21,7 @@
 
 #include <dlib/log.h>
 #include <dlib/dstrings.h>
+#include <dlib/time.h>
 
 extern "C"
 {
@@ -411,6 +412,182 @@ TEST_F(ScriptVmathTest, TestToValueFn)
     ASSERT_EQ(top, lua_gettop(L));
 }
 
+TEST_F(ScriptVmathTest, TestInPlace)
+{
+    int top = lua_gettop(L);
+    ASSERT_TRUE(RunString(L,
+        "local v = vmath.vector3()\n"
+        "assert(vmath.add_to(v, vmath.vector3(1, 2, 3), vmath.vector3(1, 1, 1)) == v)\n"
+        "assert(v == vmath.vector3(2, 3, 4))\n"
+        "vmath.sub_to(v, v, vmath.vector3(1, 1, 1))\n"
+        "assert(v == vmath.vector3(1, 2, 3))\n"
+        "vmath.mul_to(v, v, 2)\n"
+        "assert(v == vmath.vector3(2, 4, 6))\n"
+        "vmath.mul_to(v, 0.5, v)\n"
+        "assert(v == vmath.vector3(1, 2, 3))\n"
+        "vmath.div_to(v, v, 0.5)\n"
+        "assert(v == vmath.vector3(2, 4, 6))\n"
+        "vmath.normalize_to(v, vmath.vector3(0, 3, 0))\n"
+        "assert(v == vmath.vector3(0, 1, 0))\n"
+        "vmath.cross_to(v, vmath.vector3(1, 0, 0), v)\n"
+        "assert(v == vmath.vector3(0, 0, 1))\n"
+        "vmath.lerp_to(v, 0.5, vmath.vector3(0, 0, 0), vmath.vector3(2, 4, 6))\n"
+        "assert(v == vmath.vector3(1, 2, 3))\n"
+        "vmath.rotate_to(v, vmath.quat(), v)\n"
+        "assert(v == vmath.vector3(1, 2, 3))\n"
+        "local v4 = vmath.vector4()\n"
+        "vmath.add_to(v4, vmath.vector4(1, 2, 3, 4), vmath.vector4(1, 1, 1, 1))\n"
+        "assert(v4 == vmath.vector4(2, 3, 4, 5))\n"
+        "vmath.mul_to(v4, vmath.matrix4(), v4)\n"
+        "assert(v4 == vmath.vector4(2, 3, 4, 5))\n"
+        "local q = vmath.quat()\n"
+        "vmath.mul_to(q, vmath.quat_rotation_z(1), vmath.quat_rotation_z(2))\n"
+        "assert(vmath.length(q - vmath.quat_rotation_z(3)) < 0.0001)\n"
+        "local m = vmath.matrix4()\n"
+        "vmath.mul_to(m, vmath.matrix4_translation(vmath.vector3(1, 2, 3)), vmath.matrix4_translation(vmath.vector3(1, 1, 1)))\n"
+        "assert(m == vmath.matrix4_translation(vmath.vector3(2, 3, 4)))\n"
+        "vmath.mul_to(m, m, 2)\n"
+        "assert(m.m03 == 4)\n"
+        ));
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
+TEST_F(ScriptVmathTest, TestInPlaceFail)
+{
+    // out of the wrong type
+    ASSERT_FALSE(RunString(L, "vmath.add_to(vmath.quat(), vmath.vector3(), vmath.vector3())"));
+    ASSERT_FALSE(RunString(L, "vmath.add_to(1, vmath.vector3(), vmath.vector3())"));
+    ASSERT_FALSE(RunString(L, "vmath.cross_to(vmath.vector4(), vmath.vector3(), vmath.vector3())"));
+    // mismatching arguments
+    ASSERT_FALSE(RunString(L, "vmath.add_to(vmath.vector3(), vmath.vector4(), vmath.vector3())"));
+    ASSERT_FALSE(RunString(L, "vmath.mul_to(vmath.vector3(), vmath.vector3(), vmath.vector3())"));
+    ASSERT_FALSE(RunString(L, "vmath.mul_to(vmath.quat(), vmath.quat(), 1)"));
+    ASSERT_FALSE(RunString(L, "vmath.div_to(vmath.vector3(), vmath.vector3(), \"hej\")"));
+    ASSERT_FALSE(RunString(L, "vmath.lerp_to(vmath.vector3(), 0.5, vmath.vector3(), vmath.quat())"));
+}
+
+TEST_F(ScriptVmathTest, TestScratch)
+{
+    ASSERT_TRUE(RunString(L,
+        "a = vmath.scratch_vector3(1, 2, 3)\n"
+        "b = vmath.scratch_vector3()\n"
+        "assert(not rawequal(a, b))\n"
+        "assert(a == vmath.vector3(1, 2, 3))\n"
+        "assert(b == vmath.vector3(0, 0, 0))\n"
+        "assert(vmath.scratch_vector4(1, 2, 3, 4) == vmath.vector4(1, 2, 3, 4))\n"
+        "assert(vmath.scratch_quat() == vmath.quat())\n"
+        "assert(vmath.scratch_matrix4() == vmath.matrix4())\n"
+        ));
+
+    // The next frame hands out the same values again
+    dmScript::Update(m_Context);
+    ASSERT_TRUE(RunString(L,
+        "local c = vmath.scratch_vector3()\n"
+        "assert(rawequal(a, c))\n"
+        "assert(a == vmath.vector3(0, 0, 0))\n"
+        "assert(rawequal(b, vmath.scratch_vector3()))\n"
+        "assert(not rawequal(a, vmath.scratch_vector3()))\n"
+        "a = nil b = nil\n"
+        ));
+}
+
+static uint32_t GetLuaMemory(lua_State* L)
+{
+    return (uint32_t)lua_gc(L, LUA_GCCOUNT, 0) * 1024 + (uint32_t)lua_gc(L, LUA_GCCOUNTB, 0);
+}
+
+// Steering a number of objects towards a target, written with operators and with in-place operations
+TEST_F(ScriptVmathTest, TestPerfGCPressure)
+{
+    const uint32_t object_count = 1000;
+    const uint32_t frame_count = 100;
+
+    char program[2048];
+    dmSnPrintf(program, sizeof(program),
+        "positions = {}\n"
+        "velocities = {}\n"
+        "target = vmath.vector3(100, 100, 0)\n"
+        "for i = 1,%u do\n"
+        "    positions[i] = vmath.vector3(i, 0, 0)\n"
+        "    velocities[i] = vmath.vector3(0, 1, 0)\n"
+        "end\n"
+        "function frame_operators(dt)\n"
+        "    for i = 1,#positions do\n"
+        "        local p = positions[i]\n"
+        "        local v = velocities[i] + (target - p) * (0.1 * dt)\n"
+        "        velocities[i] = v\n"
+        "        positions[i] = p + v * dt\n"
+        "    end\n"
+        "end\n"
+        "function frame_in_place(dt)\n"
+        "    local steer = vmath.scratch_vector3()\n"
+        "    for i = 1,#positions do\n"
+        "        local p = positions[i]\n"
+        "        local v = velocities[i]\n"
+        "        vmath.sub_to(steer, target, p)\n"
+        "        vmath.mul_to(steer, steer, 0.1 * dt)\n"
+        "        vmath.add_to(v, v, steer)\n"
+        "        vmath.mul_to(steer, v, dt)\n"
+        "        vmath.add_to(p, p, steer)\n"
+        "    end\n"
+        "end\n"
+        "function new_vector3()\n"
+        "    return vmath.vector3()\n"
+        "end\n",
+        object_count);
+    ASSERT_TRUE(RunString(L, program));
+
+    // A full collection restarts the collector, so stop it after each one
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    lua_gc(L, LUA_GCSTOP, 0);
+
+    // Size of a single vector3, to express the garbage as a number of allocations
+    uint32_t memory = GetLuaMemory(L);
+    lua_getglobal(L, "new_vector3");
+    lua_call(L, 0, 1);
+    uint32_t vector3_size = GetLuaMemory(L) - memory;
+    lua_pop(L, 1);
+    ASSERT_LT(0u, vector3_size);
+
+    const char* functions[] = {"frame_operators", "frame_in_place"};
+    for (uint32_t f = 0; f < sizeof(functions) / sizeof(functions[0]); ++f)
+    {
+        // Warm up, the scratch pool is filled the first frame and the loops get compiled
+        for (uint32_t i = 0; i < 10; ++i)
+        {
+            lua_getglobal(L, functions[f]);
+            lua_pushnumber(L, 1.0 / 60.0);
+            lua_call(L, 1, 0);
+            dmScript::Update(m_Context);
+        }
+
+        memory = GetLuaMemory(L);
+        uint64_t time = dmTime::GetTime();
+        for (uint32_t i = 0; i < frame_count; ++i)
+        {
+            lua_getglobal(L, functions[f]);
+            lua_pushnumber(L, 1.0 / 60.0);
+            lua_call(L, 1, 0);
+            dmScript::Update(m_Context);
+        }
+        time = dmTime::GetTime() - time;
+        uint32_t garbage = (GetLuaMemory(L) - memory) / frame_count;
+
+        printf("%-16s %8.1f us/frame %8u bytes/frame %6u allocations/frame\n", functions[f], time / (double)frame_count, garbage, garbage / vector3_size);
+
+        // Not a single vector per frame, what remains is code generated by the JIT compiler
+        if (f == 1)
+        {
+            ASSERT_LT(garbage, vector3_size);
+        }
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        lua_gc(L, LUA_GCSTOP, 0);
+    }
+
+    lua_gc(L, LUA_GCRESTART, 0);
+    ASSERT_TRUE(RunString(L, "positions = nil velocities = nil"));
+}
+
 int main(int argc, char **argv)
 {
     jc_test_init(&argc, argv);
@@ -13,7 +13,9 @@
 #define JC_TEST_IMPLEMENTATION
 #include <jc_test/jc_test.h>
 #include <dlib/image.h>
+#include <dlib/time.h>
 #include <dlib/webp.h>
+#include <stdio.h>
 #include <string.h> // memcmp
 
 #include "../texc.h"
@@ -220,6 +222,71 @@ TEST_F(TexcTest, MipMaps)
     }
 }
 
+TEST_F(TexcTest, MipMapValues)
+{
+    dmTexc::HTexture texture = CreateDefaultRGBA32();
+    ASSERT_TRUE(dmTexc::GenMipMaps(texture));
+    dmTexc::Header header;
+    dmTexc::GetHeader(texture, &header);
+    ASSERT_EQ(2u, header.m_MipMapCount);
+    ASSERT_EQ(4u, dmTexc::GetDataSizeUncompressed(texture, 1));
+
+    // Down to 1x1 the linear filter of PVRTexLib keeps the first texel
+    uint8_t out[5*4];
+    ASSERT_EQ(20u, dmTexc::GetData(texture, out, sizeof(out)));
+    const uint8_t expected[4] = {255, 0, 0, 255};
+    ASSERT_EQ(0, memcmp(expected, out + 16, 4));
+    dmTexc::Destroy(texture);
+}
+
+// Even sized levels are halved by the 2x2 average, rounded down like the linear filter of PVRTexLib
+TEST_F(TexcTest, MipMapValuesAverage)
+{
+    uint8_t data[4*4*4];
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        data[i*4+0] = (uint8_t) (i * 17);
+        data[i*4+1] = (uint8_t) (255 - i * 13);
+        data[i*4+2] = (i & 1) ? 1 : 0;
+        data[i*4+3] = 255;
+    }
+    dmTexc::HTexture texture = dmTexc::Create(4, 4, dmTexc::PF_R8G8B8A8, dmTexc::CS_LRGB, data);
+    ASSERT_TRUE(dmTexc::GenMipMaps(texture));
+    dmTexc::Header header;
+    dmTexc::GetHeader(texture, &header);
+    ASSERT_EQ(3u, header.m_MipMapCount);
+    ASSERT_EQ(16u, dmTexc::GetDataSizeUncompressed(texture, 1));
+
+    uint8_t out[21*4];
+    ASSERT_EQ(84u, dmTexc::GetData(texture, out, sizeof(out)));
+    const uint8_t expected[4*4] = {42, 222, 0, 255,  76, 196, 0, 255,  178, 118, 0, 255,  212, 92, 0, 255};
+    ASSERT_EQ(0, memcmp(expected, out + 64, sizeof(expected)));
+    dmTexc::Destroy(texture);
+}
+
+TEST_F(TexcTest, PreMultipliedAlphaValues)
+{
+    static const uint32_t width = 64;
+    static const uint32_t height = 64;
+    dmTexc::HTexture texture = CreateDefaultRGBA32(width, height);
+    uint8_t* before = new uint8_t[width*height*4];
+    uint8_t* after = new uint8_t[width*height*4];
+    dmTexc::GetData(texture, before, width*height*4);
+    ASSERT_TRUE(dmTexc::PreMultiplyAlpha(texture));
+    dmTexc::GetData(texture, after, width*height*4);
+    for (uint32_t i = 0; i < width*height*4; i += 4)
+    {
+        uint32_t a = before[i+3];
+        ASSERT_EQ((before[i+0]*a + 127) / 255, after[i+0]);
+        ASSERT_EQ((before[i+1]*a + 127) / 255, after[i+1]);
+        ASSERT_EQ((before[i+2]*a + 127) / 255, after[i+2]);
+        ASSERT_EQ(a, after[i+3]);
+    }
+    delete[] before;
+    delete[] after;
+    dmTexc::Destroy(texture);
+}
+
 TEST_F(TexcTest, Transcode)
 {
     dmTexc::HTexture texture = CreateDefaultRGBA32();
@@ -482,6 +549,115 @@ TEST_F(TexcTest, TranscodeWebEncodedTextureFormat)
     TranscodeWebEncodedFormat(dmTexc::PF_R4G4B4A4, dmWebP::TEXTURE_ENCODE_FORMAT_RGBA4444);
 }
 
+static uint8_t* TranscodeWithThreads(uint32_t thread_count, dmTexc::PixelFormat format, dmTexc::DitherType dither_type, uint32_t* out_size)
+{
+    static const uint32_t size = 512;
+    dmTexc::SetMaxThreads(thread_count);
+    dmTexc::HTexture texture = CreateDefaultRGBA32(size, size);
+    dmTexc::PreMultiplyAlpha(texture);
+    dmTexc::GenMipMaps(texture);
+    dmTexc::Flip(texture, dmTexc::FLIP_AXIS_Y);
+    if (!dmTexc::Transcode(texture, format, dmTexc::CS_LRGB, dmTexc::CL_FAST, dmTexc::CT_DEFAULT, dither_type))
+    {
+        dmTexc::Destroy(texture);
+        return 0;
+    }
+    *out_size = dmTexc::GetTotalDataSize(texture);
+    uint8_t* data = new uint8_t[*out_size];
+    dmTexc::GetData(texture, data, *out_size);
+    dmTexc::Destroy(texture);
+    return data;
+}
+
+// Splitting the mips into tiles must not change the result
+TEST_F(TexcTest, TranscodeThreaded)
+{
+    dmTexc::PixelFormat tiled_formats[] = {dmTexc::PF_L8, dmTexc::PF_R5G6B5, dmTexc::PF_RGB_ETC1};
+    for (uint32_t i = 0; i < sizeof(tiled_formats)/sizeof(tiled_formats[0]); ++i)
+    {
+        uint32_t size_single = 0;
+        uint32_t size_threaded = 0;
+        uint8_t* single = TranscodeWithThreads(1, tiled_formats[i], dmTexc::DT_NONE, &size_single);
+        uint8_t* threaded = TranscodeWithThreads(4, tiled_formats[i], dmTexc::DT_NONE, &size_threaded);
+        ASSERT_NE((uint8_t*)0, single);
+        ASSERT_NE((uint8_t*)0, threaded);
+        ASSERT_EQ(size_single, size_threaded);
+        ASSERT_EQ(0, memcmp(single, threaded, size_single));
+        delete[] single;
+        delete[] threaded;
+    }
+    dmTexc::SetMaxThreads(4);
+}
+
+// Dithered uncompressed formats must not change either
+TEST_F(TexcTest, TranscodeThreadedDithered)
+{
+    dmTexc::PixelFormat dithered_formats[] = {dmTexc::PF_R5G6B5, dmTexc::PF_R4G4B4A4};
+    for (uint32_t i = 0; i < sizeof(dithered_formats)/sizeof(dithered_formats[0]); ++i)
+    {
+        uint32_t size_single = 0;
+        uint32_t size_threaded = 0;
+        uint8_t* single = TranscodeWithThreads(1, dithered_formats[i], dmTexc::DT_DEFAULT, &size_single);
+        uint8_t* threaded = TranscodeWithThreads(4, dithered_formats[i], dmTexc::DT_DEFAULT, &size_threaded);
+        ASSERT_NE((uint8_t*)0, single);
+        ASSERT_NE((uint8_t*)0, threaded);
+        ASSERT_EQ(size_single, size_threaded);
+        ASSERT_EQ(0, memcmp(single, threaded, size_single));
+        delete[] single;
+        delete[] threaded;
+    }
+    dmTexc::SetMaxThreads(4);
+}
+
+struct BenchmarkFormat
+{
+    const char*               m_Name;
+    dmTexc::PixelFormat       m_PixelFormat;
+    dmTexc::CompressionType   m_CompressionType;
+};
+
+// Not a test as such, prints the throughput of the texture pipeline for each format
+TEST_F(TexcTest, Benchmark)
+{
+    static const uint32_t size = 1024;
+    const BenchmarkFormat bench_formats[] =
+    {
+        {"L8", dmTexc::PF_L8, dmTexc::CT_DEFAULT},
+        {"R8G8B8A8", dmTexc::PF_R8G8B8A8, dmTexc::CT_DEFAULT},
+        {"R5G6B5", dmTexc::PF_R5G6B5, dmTexc::CT_DEFAULT},
+        {"R4G4B4A4", dmTexc::PF_R4G4B4A4, dmTexc::CT_DEFAULT},
+        {"ETC1", dmTexc::PF_RGB_ETC1, dmTexc::CT_DEFAULT},
+        {"RGBA_PVRTC_4BPPV1", dmTexc::PF_RGBA_PVRTC_4BPPV1, dmTexc::CT_DEFAULT},
+        {"R8G8B8A8 WebP", dmTexc::PF_R8G8B8A8, dmTexc::CT_WEBP},
+        {"R8G8B8A8 WebP lossy", dmTexc::PF_R8G8B8A8, dmTexc::CT_WEBP_LOSSY},
+    };
+    const uint32_t thread_counts[] = {1, 4};
+
+    for (uint32_t t = 0; t < sizeof(thread_counts)/sizeof(thread_counts[0]); ++t)
+    {
+        dmTexc::SetMaxThreads(thread_counts[t]);
+        for (uint32_t i = 0; i < sizeof(bench_formats)/sizeof(bench_formats[0]); ++i)
+        {
+            const BenchmarkFormat& format = bench_formats[i];
+            dmTexc::HTexture texture = CreateDefaultRGBA32(size, size);
+
+            uint64_t start = dmTime::GetTime();
+            ASSERT_TRUE(dmTexc::PreMultiplyAlpha(texture));
+            ASSERT_TRUE(dmTexc::GenMipMaps(texture));
+            ASSERT_TRUE(dmTexc::Flip(texture, dmTexc::FLIP_AXIS_Y));
+            uint64_t processed = dmTime::GetTime();
+            ASSERT_TRUE(dmTexc::Transcode(texture, format.m_PixelFormat, dmTexc::CS_SRGB, dmTexc::CL_FAST, format.m_CompressionType, dmTexc::DT_DEFAULT));
+            uint64_t end = dmTime::GetTime();
+
+            double megapixels = (size * size) / 1000000.0;
+            printf("%-20s threads: %u  process: %7.2f MP/s  transcode: %7.2f MP/s  total: %7.2f ms\n", format.m_Name, thread_counts[t],
+                    megapixels / ((processed - start + 1) / 1000000.0), megapixels / ((end - processed + 1) / 1000000.0), (end - start) / 1000.0);
+            dmTexc::Destroy(texture);
+        }
+    }
+    dmTexc::SetMaxThreads(4);
+}
+
 int main(int argc, char **argv)
 {
     jc_test_init(&argc, argv);
@@ -14,6 +14,7 @@
 #include "texc_private.h"
 
 #include <assert.h>
+#include <string.h>
 
 #include <dlib/log.h>
 #include <dlib/math.h>
@@ -126,6 +127,27 @@ namespace dmTexc
         return ePVRTAxisX;
     }
 
+    // Pixels processed per job when premultiplying, downsampling, flipping or transcoding in parallel
+    static const uint32_t PIXELS_PER_JOB = 64 * 1024;
+
+    static uint32_t GetJobCount(uint32_t count, uint32_t count_per_job)
+    {
+        return (count + count_per_job - 1) / count_per_job;
+    }
+
+    // A single 2D surface in a format with whole bytes per pixel, which we can process without PVRTexLib
+    static bool IsUncompressed(pvrtexture::CPVRTexture* texture)
+    {
+        return texture->getDepth() == 1 && texture->getNumArrayMembers() == 1 && texture->getNumFaces() == 1 &&
+               texture->getPixelType().Part.High != 0 && (texture->getBitsPerPixel() & 7) == 0;
+    }
+
+    static bool IsRGBA8888(pvrtexture::CPVRTexture* texture)
+    {
+        return IsUncompressed(texture) && texture->getChannelType() == ePVRTVarTypeUnsignedByteNorm &&
+               texture->getPixelType().PixelTypeID == pvrtexture::PVRStandard8PixelType.PixelTypeID;
+    }
+
     HTexture Create(uint32_t width, uint32_t height, PixelFormat pixel_format, ColorSpace color_space, void* data)
     {
         pvrtexture::PixelType pf = ConvertPixelFormat(pixel_format);
@@ -259,22 +281,307 @@ namespace dmTexc
         return pvrtexture::Resize(*t->m_PVRTexture, width, height, t->m_PVRTexture->getDepth(), pvrtexture::eResizeLinear);
     }
 
+    struct PreMultiplyContext
+    {
+        uint8_t* m_Data;
+        uint32_t m_PixelCount;
+    };
+
+    static void PreMultiplyJob(void* context, uint32_t job)
+    {
+        PreMultiplyContext* ctx = (PreMultiplyContext*) context;
+        uint32_t first = job * PIXELS_PER_JOB;
+        PreMultiplyAlphaRGBA8888(ctx->m_Data + first * 4, dmMath::Min(PIXELS_PER_JOB, ctx->m_PixelCount - first));
+    }
+
     bool PreMultiplyAlpha(HTexture texture)
     {
         Texture* t = (Texture*) texture;
-        return pvrtexture::PreMultiplyAlpha(*t->m_PVRTexture);
+        pvrtexture::CPVRTexture* pt = t->m_PVRTexture;
+        if (!IsRGBA8888(pt))
+        {
+            return pvrtexture::PreMultiplyAlpha(*pt);
+        }
+
+        // The mip levels of a single surface are stored back to back
+        PreMultiplyContext ctx;
+        ctx.m_Data = (uint8_t*) pt->getDataPtr(0);
+        ctx.m_PixelCount = pt->getDataSize() / 4;
+        RunJobs(GetJobCount(ctx.m_PixelCount, PIXELS_PER_JOB), PreMultiplyJob, &ctx);
+        pt->setIsPreMultiplied(true);
+        return true;
+    }
+
+    struct DownsampleContext
+    {
+        const uint8_t* m_Source;
+        uint8_t*       m_Target;
+        uint32_t       m_SourceWidth;
+        uint32_t       m_SourceHeight;
+        uint32_t       m_TargetHeight;
+        uint32_t       m_RowsPerJob;
+    };
+
+    static void DownsampleJob(void* context, uint32_t job)
+    {
+        DownsampleContext* ctx = (DownsampleContext*) context;
+        uint32_t y = job * ctx->m_RowsPerJob;
+        DownsampleRGBA8888(ctx->m_Source, ctx->m_SourceWidth, ctx->m_SourceHeight, ctx->m_Target, y, dmMath::Min(ctx->m_RowsPerJob, ctx->m_TargetHeight - y));
+    }
+
+    // Halving a level by the 2x2 average gives the same texels as the linear filter of PVRTexLib
+    // as long as both dimensions are even and the halved level is at least 2x2
+    static bool CanDownsample(uint32_t width, uint32_t height)
+    {
+        return (width & 1) == 0 && (height & 1) == 0 && width >= 4 && height >= 4;
     }
 
     bool GenMipMaps(HTexture texture)
     {
         Texture* t = (Texture*) texture;
-        return pvrtexture::GenerateMIPMaps(*t->m_PVRTexture, pvrtexture::eResizeLinear);
+        pvrtexture::CPVRTexture* pt = t->m_PVRTexture;
+        if (!IsRGBA8888(pt) || !CanDownsample(pt->getWidth(), pt->getHeight()))
+        {
+            return pvrtexture::GenerateMIPMaps(*pt, pvrtexture::eResizeLinear);
+        }
+
+        // Full chain down to 1x1, each level filtered from the previous one
+        uint32_t width = pt->getWidth();
+        uint32_t height = pt->getHeight();
+        uint32_t mip_maps = 1;
+        while ((width >> mip_maps) > 0 || (height >> mip_maps) > 0)
+        {
+            ++mip_maps;
+        }
+
+        pvrtexture::CPVRTextureHeader header(pt->getPixelType().PixelTypeID, height, width, 1, mip_maps, 1, 1,
+                pt->getColourSpace(), pt->getChannelType(), pt->isPreMultiplied());
+        pvrtexture::CPVRTexture* mipmapped = new pvrtexture::CPVRTexture(header, 0x0);
+        memcpy(mipmapped->getDataPtr(0), pt->getDataPtr(0), pt->getDataSize(0));
+
+        uint32_t mip_map = 1;
+        for (; mip_map < mip_maps && CanDownsample(mipmapped->getWidth(mip_map - 1), mipmapped->getHeight(mip_map - 1)); ++mip_map)
+        {
+            DownsampleContext ctx;
+            ctx.m_Source = (const uint8_t*) mipmapped->getDataPtr(mip_map - 1);
+            ctx.m_Target = (uint8_t*) mipmapped->getDataPtr(mip_map);
+            ctx.m_SourceWidth = mipmapped->getWidth(mip_map - 1);
+            ctx.m_SourceHeight = mipmapped->getHeight(mip_map - 1);
+            ctx.m_TargetHeight = mipmapped->getHeight(mip_map);
+            ctx.m_RowsPerJob = dmMath::Max(1U, PIXELS_PER_JOB / mipmapped->getWidth(mip_map));
+            RunJobs(GetJobCount(ctx.m_TargetHeight, ctx.m_RowsPerJob), DownsampleJob, &ctx);
+        }
+
+        // The small levels left, and the odd sized ones, are filtered by PVRTexLib from the last level above
+        if (mip_map < mip_maps)
+        {
+            uint32_t last = mip_map - 1;
+            pvrtexture::CPVRTextureHeader tail_header(pt->getPixelType().PixelTypeID, mipmapped->getHeight(last), mipmapped->getWidth(last), 1, 1, 1, 1,
+                    pt->getColourSpace(), pt->getChannelType(), pt->isPreMultiplied());
+            pvrtexture::CPVRTexture tail(tail_header, mipmapped->getDataPtr(last));
+            if (!pvrtexture::GenerateMIPMaps(tail, pvrtexture::eResizeLinear) || tail.getNumMIPLevels() != mip_maps - last)
+            {
+                delete mipmapped;
+                return false;
+            }
+            for (; mip_map < mip_maps; ++mip_map)
+            {
+                memcpy(mipmapped->getDataPtr(mip_map), tail.getDataPtr(mip_map - last), mipmapped->getDataSize(mip_map));
+            }
+        }
+
+        delete pt;
+        t->m_PVRTexture = mipmapped;
+        return true;
+    }
+
+    struct FlipContext
+    {
+        uint8_t* m_Data;
+        uint32_t m_Width;
+        uint32_t m_Height;
+        uint32_t m_BytesPerPixel;
+        uint32_t m_RowsPerJob;
+        uint32_t m_RowCount;
+        FlipAxis m_Axis;
+    };
+
+    static void FlipJob(void* context, uint32_t job)
+    {
+        FlipContext* ctx = (FlipContext*) context;
+        uint32_t stride = ctx->m_Width * ctx->m_BytesPerPixel;
+        uint32_t first = job * ctx->m_RowsPerJob;
+        uint32_t count = dmMath::Min(ctx->m_RowsPerJob, ctx->m_RowCount - first);
+        if (ctx->m_Axis == FLIP_AXIS_X)
+        {
+            FlipRowsX(ctx->m_Data + first * stride, ctx->m_Width, count, ctx->m_BytesPerPixel);
+        }
+        else
+        {
+            for (uint32_t y = first; y < first + count; ++y)
+            {
+                SwapRows(ctx->m_Data + y * stride, ctx->m_Data + (ctx->m_Height - 1 - y) * stride, stride);
+            }
+        }
     }
 
     bool Flip(HTexture texture, FlipAxis flip_axis)
     {
         Texture* t = (Texture*) texture;
-        return pvrtexture::Flip(*t->m_PVRTexture, ConvertFlipAxis(flip_axis));
+        pvrtexture::CPVRTexture* pt = t->m_PVRTexture;
+        if (!IsUncompressed(pt))
+        {
+            return pvrtexture::Flip(*pt, ConvertFlipAxis(flip_axis));
+        }
+
+        // Nothing to flip along Z with a depth of one
+        if (flip_axis == FLIP_AXIS_Z)
+        {
+            return true;
+        }
+
+        uint32_t mip_maps = pt->getNumMIPLevels();
+        for (uint32_t mip_map = 0; mip_map < mip_maps; ++mip_map)
+        {
+            FlipContext ctx;
+            ctx.m_Data = (uint8_t*) pt->getDataPtr(mip_map);
+            ctx.m_Width = pt->getWidth(mip_map);
+            ctx.m_Height = pt->getHeight(mip_map);
+            ctx.m_BytesPerPixel = pt->getBitsPerPixel() / 8;
+            ctx.m_RowsPerJob = dmMath::Max(1U, PIXELS_PER_JOB / ctx.m_Width);
+            // Flipping along Y swaps the top half of the rows with the bottom half
+            ctx.m_RowCount = flip_axis == FLIP_AXIS_X ? ctx.m_Height : ctx.m_Height / 2;
+            ctx.m_Axis = flip_axis;
+            RunJobs(GetJobCount(ctx.m_RowCount, ctx.m_RowsPerJob), FlipJob, &ctx);
+        }
+        return true;
+    }
+
+    struct TranscodeJob
+    {
+        uint32_t m_MipMap;
+        uint32_t m_Y;
+        uint32_t m_Height;
+        uint32_t m_Offset;
+        bool     m_Result;
+    };
+
+    struct TranscodeContext
+    {
+        dmArray<TranscodeJob>          m_Jobs;
+        pvrtexture::CPVRTexture*       m_Source;
+        pvrtexture::CPVRTexture*       m_Target;
+        pvrtexture::PixelType          m_PixelType;
+        EPVRTColourSpace               m_ColorSpace;
+        pvrtexture::ECompressorQuality m_Quality;
+        bool                           m_Dither;
+    };
+
+    static void TranscodeTileJob(void* context, uint32_t index)
+    {
+        TranscodeContext* ctx = (TranscodeContext*) context;
+        TranscodeJob& job = ctx->m_Jobs[index];
+        pvrtexture::CPVRTexture* src = ctx->m_Source;
+        uint32_t width = src->getWidth(job.m_MipMap);
+        uint32_t src_offset = job.m_Y * width * (src->getBitsPerPixel() / 8);
+
+        pvrtexture::CPVRTextureHeader header(src->getPixelType().PixelTypeID, job.m_Height, width, 1, 1, 1, 1,
+                src->getColourSpace(), src->getChannelType(), src->isPreMultiplied());
+        pvrtexture::CPVRTexture tile(header, (uint8_t*) src->getDataPtr(job.m_MipMap) + src_offset);
+        job.m_Result = pvrtexture::Transcode(tile, ctx->m_PixelType, ePVRTVarTypeUnsignedByteNorm, ctx->m_ColorSpace, ctx->m_Quality, ctx->m_Dither);
+        if (!job.m_Result)
+        {
+            return;
+        }
+
+        uint32_t size = tile.getDataSize();
+        if (job.m_Offset + size > ctx->m_Target->getDataSize(job.m_MipMap))
+        {
+            job.m_Result = false;
+            return;
+        }
+        memcpy((uint8_t*) ctx->m_Target->getDataPtr(job.m_MipMap) + job.m_Offset, tile.getDataPtr(), size);
+    }
+
+    // Transcodes each mip as a separate texture, and large mips in horizontal bands when the target format allows it.
+    // Block formats need the bands to be whole block rows, and PVRTC blocks depend on their neighbours so those mips
+    // are never split. Dithering carries the error over to the following texels, so dithered uncompressed targets are
+    // transcoded as a whole. Returns false if the texture isn't suitable, leaving it untouched.
+    static bool TranscodeTiles(Texture* t, PixelFormat pixel_format, pvrtexture::PixelType pf, EPVRTColourSpace cs, pvrtexture::ECompressorQuality quality, bool dither, bool* out_result)
+    {
+        pvrtexture::CPVRTexture* pt = t->m_PVRTexture;
+        bool uncompressed_target = pf.Part.High != 0;
+        if (GetMaxThreads() < 2 || !IsUncompressed(pt) || (dither && uncompressed_target))
+        {
+            return false;
+        }
+
+        bool can_split = uncompressed_target || pixel_format == PF_RGB_ETC1;
+        const uint32_t block_height = 4;
+
+        pvrtexture::CPVRTextureHeader header(pf.PixelTypeID, pt->getHeight(), pt->getWidth(), 1, pt->getNumMIPLevels(), 1, 1,
+                cs, ePVRTVarTypeUnsignedByteNorm, pt->isPreMultiplied());
+        pvrtexture::CPVRTexture* target = new pvrtexture::CPVRTexture(header, 0x0);
+
+        TranscodeContext ctx;
+        ctx.m_Source = pt;
+        ctx.m_Target = target;
+        ctx.m_PixelType = pf;
+        ctx.m_ColorSpace = cs;
+        ctx.m_Quality = quality;
+        ctx.m_Dither = dither;
+
+        uint32_t mip_maps = pt->getNumMIPLevels();
+        for (uint32_t mip_map = 0; mip_map < mip_maps; ++mip_map)
+        {
+            uint32_t width = pt->getWidth(mip_map);
+            uint32_t height = pt->getHeight(mip_map);
+            uint32_t rows_per_job = height;
+            if (can_split && (width % block_height) == 0)
+            {
+                rows_per_job = dmMath::Max(block_height, (PIXELS_PER_JOB / width) & ~(block_height - 1));
+            }
+
+            for (uint32_t y = 0; y < height; y += rows_per_job)
+            {
+                if (ctx.m_Jobs.Full())
+                {
+                    ctx.m_Jobs.OffsetCapacity(dmMath::Max(16U, ctx.m_Jobs.Capacity()));
+                }
+                TranscodeJob job;
+                job.m_MipMap = mip_map;
+                job.m_Y = y;
+                job.m_Height = dmMath::Min(rows_per_job, height - y);
+                // Tiles only start on block row boundaries, where the byte offset is the same as for whole rows
+                job.m_Offset = (uint32_t) (((uint64_t) y * width * target->getBitsPerPixel()) / 8);
+                job.m_Result = false;
+                ctx.m_Jobs.Push(job);
+            }
+        }
+
+        if (ctx.m_Jobs.Size() < 2)
+        {
+            delete target;
+            return false;
+        }
+
+        RunJobs(ctx.m_Jobs.Size(), TranscodeTileJob, &ctx);
+
+        *out_result = true;
+        for (uint32_t i = 0; i < ctx.m_Jobs.Size(); ++i)
+        {
+            *out_result &= ctx.m_Jobs[i].m_Result;
+        }
+        if (*out_result)
+        {
+            delete pt;
+            t->m_PVRTexture = target;
+        }
+        else
+        {
+            delete target;
+        }
+        return true;
     }
 
     bool Transcode(HTexture texture, PixelFormat pixel_format, ColorSpace color_space, CompressionLevel compression_level, CompressionType compression_type, DitherType dither_type)
@@ -284,7 +591,12 @@ namespace dmTexc
         EPVRTVariableType var_type = ePVRTVarTypeUnsignedByteNorm;
         EPVRTColourSpace cs = ConvertColorSpace(color_space);
         pvrtexture::ECompressorQuality quality = ConvertCompressionLevel(compression_level);
-        if(!pvrtexture::Transcode(*t->m_PVRTexture, pf, var_type, cs, quality, dither_type == DT_DEFAULT))
+        bool transcoded = false;
+        if(!TranscodeTiles(t, pixel_format, pf, cs, quality, dither_type == DT_DEFAULT, &transcoded))
+        {
+            transcoded = pvrtexture::Transcode(*t->m_PVRTexture, pf, var_type, cs, quality, dither_type == DT_DEFAULT);
+        }
+        if(!transcoded)
         {
             dmLogError("Failed to transcode texture");
             return false;
@@ -370,6 +682,7 @@ namespace dmTexc
     DM_TEXC_TRAMPOLINE1(bool, GenMipMaps, HTexture);
     DM_TEXC_TRAMPOLINE2(bool, Flip, HTexture, FlipAxis);
     DM_TEXC_TRAMPOLINE6(bool, Transcode, HTexture, PixelFormat, ColorSpace, CompressionLevel, CompressionType, DitherType);
+    DM_TEXC_TRAMPOLINE1(void, SetMaxThreads, uint32_t);
     DM_TEXC_TRAMPOLINE8(HBuffer, CompressWebPBuffer, uint32_t, uint32_t, uint32_t, void*, uint32_t, PixelFormat, CompressionLevel, CompressionType);
     DM_TEXC_TRAMPOLINE1(uint32_t, GetTotalBufferDataSize, HBuffer);
     DM_TEXC_TRAMPOLINE3(uint32_t, GetBufferData, HBuffer, void*, uint32_t);
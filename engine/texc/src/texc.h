@@ -184,6 +184,9 @@ namespace dmTexc
      */
     DM_TEXC_PROTO(bool, Transcode, HTexture texture, PixelFormat pixelFormat, ColorSpace color_space, CompressionLevel compressionLevel, CompressionType compression_type, DitherType dither_type);
 
+    // Sets the number of threads used to process and compress a texture, including the calling thread. Default is 4
+    DM_TEXC_PROTO(void, SetMaxThreads, uint32_t thread_count);
+
     // Compresses an image buffer
     DM_TEXC_PROTO(HBuffer, CompressWebPBuffer, uint32_t width, uint32_t height, uint32_t bpp, void* data, uint32_t size, PixelFormat pixelFormat, CompressionLevel compressionLevel, CompressionType compression_type);
 
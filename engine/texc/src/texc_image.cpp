@@ -0,0 +1,164 @@
+// Copyright 2020 The Defold Foundation
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+// 
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+// 
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <dlib/math.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define DM_TEXC_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace dmTexc
+{
+    // Rounded c * a / 255, exact for all 8 bit inputs
+    static inline uint8_t MulDiv255(uint32_t c, uint32_t a)
+    {
+        uint32_t t = c * a + 128;
+        return (uint8_t) ((t + (t >> 8)) >> 8);
+    }
+
+    void PreMultiplyAlphaRGBA8888(uint8_t* data, uint32_t pixel_count)
+    {
+        uint32_t i = 0;
+#if defined(DM_TEXC_SSE2)
+        // Same arithmetic as MulDiv255, on 16 bit lanes. The alpha lanes are multiplied by 255 which leaves them unchanged
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rgb_mask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+        const __m128i alpha_one = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+        const __m128i bias = _mm_set1_epi16(128);
+        for (; i + 4 <= pixel_count; i += 4)
+        {
+            __m128i* p = (__m128i*) (data + i * 4);
+            __m128i c = _mm_loadu_si128(p);
+            __m128i c_lo = _mm_unpacklo_epi8(c, zero);
+            __m128i c_hi = _mm_unpackhi_epi8(c, zero);
+            __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c_lo, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+            __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c_hi, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+            a_lo = _mm_or_si128(_mm_and_si128(a_lo, rgb_mask), alpha_one);
+            a_hi = _mm_or_si128(_mm_and_si128(a_hi, rgb_mask), alpha_one);
+            __m128i t_lo = _mm_add_epi16(_mm_mullo_epi16(c_lo, a_lo), bias);
+            __m128i t_hi = _mm_add_epi16(_mm_mullo_epi16(c_hi, a_hi), bias);
+            t_lo = _mm_srli_epi16(_mm_add_epi16(t_lo, _mm_srli_epi16(t_lo, 8)), 8);
+            t_hi = _mm_srli_epi16(_mm_add_epi16(t_hi, _mm_srli_epi16(t_hi, 8)), 8);
+            _mm_storeu_si128(p, _mm_packus_epi16(t_lo, t_hi));
+        }
+#endif
+        for (; i < pixel_count; ++i)
+        {
+            uint8_t* p = data + i * 4;
+            uint32_t a = p[3];
+            p[0] = MulDiv255(p[0], a);
+            p[1] = MulDiv255(p[1], a);
+            p[2] = MulDiv255(p[2], a);
+        }
+    }
+
+    // Averages 2x2 texels into one, rows [dst_y, dst_y + dst_row_count) of the destination are written.
+    // Rounds down like the linear filter of PVRTexLib, both source dimensions must be even.
+    void DownsampleRGBA8888(const uint8_t* src, uint32_t src_width, uint32_t src_height, uint8_t* dst, uint32_t dst_y, uint32_t dst_row_count)
+    {
+        assert((src_width & 1) == 0 && (src_height & 1) == 0);
+        uint32_t dst_width = src_width >> 1;
+        uint32_t src_stride = src_width * 4;
+        for (uint32_t y = dst_y; y < dst_y + dst_row_count; ++y)
+        {
+            const uint8_t* row0 = src + (y * 2) * src_stride;
+            const uint8_t* row1 = row0 + src_stride;
+            uint8_t* out = dst + y * dst_width * 4;
+            uint32_t x = 0;
+#if defined(DM_TEXC_SSE2)
+            const __m128i zero = _mm_setzero_si128();
+            // Two destination texels per iteration, from four texels on each source row
+            for (; x + 2 <= dst_width; x += 2)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i*) (row0 + x * 8));
+                __m128i b = _mm_loadu_si128((const __m128i*) (row1 + x * 8));
+                __m128i sum_lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                __m128i sum_hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                sum_lo = _mm_add_epi16(sum_lo, _mm_srli_si128(sum_lo, 8));
+                sum_hi = _mm_add_epi16(sum_hi, _mm_srli_si128(sum_hi, 8));
+                __m128i sum = _mm_srli_epi16(_mm_unpacklo_epi64(sum_lo, sum_hi), 2);
+                _mm_storel_epi64((__m128i*) (out + x * 4), _mm_packus_epi16(sum, sum));
+            }
+#endif
+            for (; x < dst_width; ++x)
+            {
+                const uint8_t* a = row0 + x * 8;
+                const uint8_t* b = row1 + x * 8;
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    out[x * 4 + c] = (uint8_t) ((a[c] + a[c + 4] + b[c] + b[c + 4]) >> 2);
+                }
+            }
+        }
+    }
+
+    void FlipRowsX(uint8_t* data, uint32_t width, uint32_t row_count, uint32_t bytes_per_pixel)
+    {
+        for (uint32_t y = 0; y < row_count; ++y)
+        {
+            uint8_t* row = data + y * width * bytes_per_pixel;
+            uint32_t left = 0;
+            uint32_t right = width;
+#if defined(DM_TEXC_SSE2)
+            if (bytes_per_pixel == 4)
+            {
+                // Swap four texels from each end per iteration, reversing their order
+                for (; left + 8 <= right; left += 4, right -= 4)
+                {
+                    __m128i* pl = (__m128i*) (row + left * 4);
+                    __m128i* pr = (__m128i*) (row + (right - 4) * 4);
+                    __m128i l = _mm_loadu_si128(pl);
+                    __m128i r = _mm_loadu_si128(pr);
+                    _mm_storeu_si128(pl, _mm_shuffle_epi32(r, _MM_SHUFFLE(0,1,2,3)));
+                    _mm_storeu_si128(pr, _mm_shuffle_epi32(l, _MM_SHUFFLE(0,1,2,3)));
+                }
+            }
+#endif
+            for (; left + 1 < right; ++left, --right)
+            {
+                uint8_t* pl = row + left * bytes_per_pixel;
+                uint8_t* pr = row + (right - 1) * bytes_per_pixel;
+                for (uint32_t c = 0; c < bytes_per_pixel; ++c)
+                {
+                    uint8_t tmp = pl[c];
+                    pl[c] = pr[c];
+                    pr[c] = tmp;
+                }
+            }
+        }
+    }
+
+    void SwapRows(uint8_t* row_a, uint8_t* row_b, uint32_t size)
+    {
+        uint32_t i = 0;
+#if defined(DM_TEXC_SSE2)
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i*) (row_a + i));
+            __m128i b = _mm_loadu_si128((const __m128i*) (row_b + i));
+            _mm_storeu_si128((__m128i*) (row_a + i), b);
+            _mm_storeu_si128((__m128i*) (row_b + i), a);
+        }
+#endif
+        for (; i < size; ++i)
+        {
+            uint8_t tmp = row_a[i];
+            row_a[i] = row_b[i];
+            row_b[i] = tmp;
+        }
+    }
+}
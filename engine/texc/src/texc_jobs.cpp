@@ -0,0 +1,82 @@
+// Copyright 2020 The Defold Foundation
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+// 
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+// 
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "texc.h"
+#include "texc_private.h"
+
+#include <dlib/atomic.h>
+#include <dlib/math.h>
+#include <dlib/thread.h>
+
+namespace dmTexc
+{
+    // Compressors keep most of their state on the heap, but PVRTexLib is a black box so be generous
+    static const uint32_t JOB_THREAD_STACK_SIZE = 0x100000;
+
+    static uint32_t g_MaxThreads = DEFAULT_MAX_THREADS;
+
+    struct JobRunner
+    {
+        JobFunction    m_Function;
+        void*          m_Context;
+        uint32_t       m_JobCount;
+        int32_atomic_t m_NextJob;
+    };
+
+    static void RunJobsThread(void* context)
+    {
+        JobRunner* runner = (JobRunner*) context;
+        while (true)
+        {
+            uint32_t job = (uint32_t) dmAtomicIncrement32(&runner->m_NextJob);
+            if (job >= runner->m_JobCount)
+                break;
+            runner->m_Function(runner->m_Context, job);
+        }
+    }
+
+    void SetMaxThreads(uint32_t thread_count)
+    {
+        g_MaxThreads = dmMath::Clamp(thread_count, 1U, MAX_THREADS);
+    }
+
+    uint32_t GetMaxThreads()
+    {
+        return g_MaxThreads;
+    }
+
+    // Threads only live for the duration of a call. Textures are processed one step at a time from the
+    // content pipeline, and the thread start cost is small compared to compressing a mip
+    void RunJobs(uint32_t job_count, JobFunction fn, void* context)
+    {
+        JobRunner runner;
+        runner.m_Function = fn;
+        runner.m_Context = context;
+        runner.m_JobCount = job_count;
+        runner.m_NextJob = 0;
+
+        dmThread::Thread threads[MAX_THREADS];
+        uint32_t thread_count = 0;
+        uint32_t max_threads = dmMath::Min(g_MaxThreads, job_count);
+        for (uint32_t i = 1; i < max_threads; ++i)
+        {
+            threads[thread_count++] = dmThread::New(RunJobsThread, JOB_THREAD_STACK_SIZE, &runner, "texc");
+        }
+
+        RunJobsThread(&runner);
+
+        for (uint32_t i = 0; i < thread_count; ++i)
+        {
+            dmThread::Join(threads[i]);
+        }
+    }
+}
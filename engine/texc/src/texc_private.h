@@ -25,6 +25,8 @@
 namespace dmTexc
 {
     static const uint32_t COMPRESSION_ENABLED_PIXELCOUNT_THRESHOLD = 64; // do not compress mips with less than this pixelcount
+    static const uint32_t MAX_THREADS = 32;                              // upper limit for SetMaxThreads
+    static const uint32_t DEFAULT_MAX_THREADS = 4;
 
     struct TextureData
     {
@@ -41,6 +43,17 @@ namespace dmTexc
     };
 
 
+    // Runs fn(context, i) for each i in [0, job_count) spread over at most GetMaxThreads() threads, including the calling thread
+    typedef void (*JobFunction)(void* context, uint32_t job);
+    void RunJobs(uint32_t job_count, JobFunction fn, void* context);
+    uint32_t GetMaxThreads();
+
+    // Pixel processing on tightly packed 8 bit per channel data. SSE2 is used where available
+    void PreMultiplyAlphaRGBA8888(uint8_t* data, uint32_t pixel_count);
+    void DownsampleRGBA8888(const uint8_t* src, uint32_t src_width, uint32_t src_height, uint8_t* dst, uint32_t dst_y, uint32_t dst_row_count);
+    void FlipRowsX(uint8_t* data, uint32_t width, uint32_t row_count, uint32_t bytes_per_pixel);
+    void SwapRows(uint8_t* row_a, uint8_t* row_b, uint32_t size);
+
     bool CompressWebP(HTexture texture, PixelFormat pixel_format, ColorSpace color_space, CompressionLevel compression_level, CompressionType compression_type);
     HBuffer CompressWebPBuffer(uint32_t width, uint32_t height, uint32_t bpp, void* data, uint32_t size, PixelFormat pixel_format, CompressionLevel compression_level, CompressionType compression_type);
 
@@ -257,6 +257,35 @@ namespace dmTexc
     }
 
 
+    struct WebPJob
+    {
+        WebPConfig  m_Config;
+        uint32_t    m_MipMap;
+        TextureData m_Data;
+        bool        m_Result;
+    };
+
+    struct WebPContext
+    {
+        dmArray<WebPJob>         m_Jobs;
+        pvrtexture::CPVRTexture* m_Texture;
+        PixelFormat              m_PixelFormat;
+        CompressionLevel         m_CompressionLevel;
+        CompressionType          m_CompressionType;
+    };
+
+    static void CompressWebPJob(void* context, uint32_t index)
+    {
+        WebPContext* ctx = (WebPContext*) context;
+        WebPJob& job = ctx->m_Jobs[index];
+        pvrtexture::CPVRTexture* pt = ctx->m_Texture;
+        uint32_t outsize = 0;
+        job.m_Result = CompressWebPInternal(&job.m_Config, pt->getWidth(job.m_MipMap), pt->getHeight(job.m_MipMap), pt->getBitsPerPixel(),
+                (uint8_t*) pt->getDataPtr(job.m_MipMap), pt->getDataSize(job.m_MipMap), &job.m_Data.m_Data, &outsize,
+                ctx->m_PixelFormat, ctx->m_CompressionLevel, ctx->m_CompressionType);
+        job.m_Data.m_ByteSize = job.m_Result ? outsize : 0;
+    }
+
     bool CompressWebP(HTexture texture, PixelFormat pixel_format, ColorSpace color_space, CompressionLevel compression_level, CompressionType compression_type)
     {
         Texture* t = (Texture*) texture;
@@ -267,7 +296,6 @@ namespace dmTexc
         pvrtexture::CPVRTexture* pt = (pvrtexture::CPVRTexture*)t->m_PVRTexture;
         uint32_t mip_maps = t->m_PVRTexture->getNumMIPLevels();
         uint32_t mip_map = 0;
-        uint32_t bits_per_pixel = pt->getBitsPerPixel();
 
         // validate dimensions
         if((pt->getWidth() > WEBP_MAX_DIMENSION) || (pt->getHeight() > WEBP_MAX_DIMENSION))
@@ -310,41 +338,49 @@ namespace dmTexc
             }
         }
 
+        // Mips are independent WebP streams, compress them in parallel
+        WebPContext ctx;
+        ctx.m_Texture = pt;
+        ctx.m_PixelFormat = pixel_format;
+        ctx.m_CompressionLevel = compression_level;
+        ctx.m_CompressionType = compression_type;
+        ctx.m_Jobs.SetCapacity(mip_maps);
         for(; mip_map < mip_maps; ++mip_map)
         {
-            uint32_t mip_width = pt->getWidth(mip_map);
-            uint32_t mip_height = pt->getHeight(mip_map);
-
             // check compression size threshold
-            if((mip_width * mip_height) <= COMPRESSION_ENABLED_PIXELCOUNT_THRESHOLD)
+            if((pt->getWidth(mip_map) * pt->getHeight(mip_map)) <= COMPRESSION_ENABLED_PIXELCOUNT_THRESHOLD)
             {
-                mip_map = mip_maps;
                 break;
             }
-
-            uint32_t datasize = pt->getDataSize(mip_map);
-            uint8_t* data = (uint8_t*) pt->getDataPtr(mip_map);
-            uint32_t outsize;
-            TextureData ctd;
-            if (!CompressWebPInternal(&config, mip_width, mip_height, bits_per_pixel, data, datasize, &ctd.m_Data, &outsize, pixel_format, compression_level, compression_type)) {
-                dmLogError("Failed to compress mip %d", mip_map);
-                mip_map = mip_maps;
-                break;
-            }
-            ctd.m_ByteSize = outsize;
-            t->m_CompressedMips.Push(ctd);
+            WebPJob job;
+            job.m_Config = config;
+            job.m_MipMap = mip_map;
+            job.m_Data.m_ByteSize = 0;
+            job.m_Data.m_IsCompressed = 1;
+            job.m_Data.m_Data = 0;
+            job.m_Result = false;
+            ctx.m_Jobs.Push(job);
         }
 
-        // if we haven't got a complete mip-map chain, something went' wrong so free all used memory
-        if(mip_map != mip_maps)
+        RunJobs(ctx.m_Jobs.Size(), CompressWebPJob, &ctx);
+
+        // if we haven't got a complete mip-map chain, something went wrong so free all used memory
+        for(uint32_t i = 0; i < ctx.m_Jobs.Size(); ++i)
         {
-            dmLogError("WebPEncode compression failed at mip index(%d)", mip_map);
-            for(size_t i = 0; i < t->m_CompressedMips.Size(); ++i)
+            if(!ctx.m_Jobs[i].m_Result)
             {
-                delete[] &t->m_CompressedMips[i].m_Data;
+                dmLogError("WebPEncode compression failed at mip index(%d)", ctx.m_Jobs[i].m_MipMap);
+                for(uint32_t j = 0; j < ctx.m_Jobs.Size(); ++j)
+                {
+                    delete[] ctx.m_Jobs[j].m_Data.m_Data;
+                }
+                return false;
             }
-            t->m_CompressedMips.SetSize(0);
-            return false;
+        }
+
+        for(uint32_t i = 0; i < ctx.m_Jobs.Size(); ++i)
+        {
+            t->m_CompressedMips.Push(ctx.m_Jobs[i].m_Data);
         }
 
         // compression success, free source picture